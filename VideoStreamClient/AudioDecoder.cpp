@@ -0,0 +1,151 @@
+﻿#include "AudioDecoder.h"
+#include <QDebug>
+#include <algorithm>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+
+AudioDecoder::AudioDecoder(int out_rate, int out_channels)
+    : out_rate_(out_rate), out_channels_(out_channels)
+{
+}
+
+AudioDecoder::~AudioDecoder()
+{
+    cleanup();
+}
+
+void AudioDecoder::cleanup()
+{
+    if (opus_ctx_) avcodec_free_context(&opus_ctx_);
+    if (frame_) av_frame_free(&frame_);
+    if (packet_) av_packet_free(&packet_);
+    if (swr_ctx_) swr_free(&swr_ctx_);
+    swr_in_format_ = -1;
+}
+
+void AudioDecoder::reset()
+{
+    if (opus_ctx_) avcodec_flush_buffers(opus_ctx_);
+    // 重采样器缓冲着上一段的尾部样本，直接重建
+    if (swr_ctx_) swr_free(&swr_ctx_);
+    swr_in_format_ = -1;
+}
+
+bool AudioDecoder::init_opus()
+{
+    if (opus_ctx_) return true;
+    if (opus_failed_) return false;
+    opus_failed_ = true;
+
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_OPUS);
+    if (!codec) {
+        qDebug() << "[AudioDecoder] 错误: 找不到 Opus 解码器。";
+        return false;
+    }
+    opus_ctx_ = avcodec_alloc_context3(codec);
+    if (!opus_ctx_) return false;
+    // 裸 Opus 包不带 OpusHead，采样率与声道数取协商时使用的固定值
+    opus_ctx_->sample_rate = AppConfig::OPUS_RATE;
+    av_channel_layout_default(&opus_ctx_->ch_layout, AppConfig::OPUS_CHANNELS);
+    if (avcodec_open2(opus_ctx_, codec, nullptr) < 0) {
+        qDebug() << "[AudioDecoder] 错误: 无法打开 Opus 解码器。";
+        avcodec_free_context(&opus_ctx_);
+        return false;
+    }
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    opus_failed_ = false;
+    qDebug() << "[AudioDecoder] Opus 解码器已初始化 ->" << AppConfig::OPUS_RATE << "Hz x" << AppConfig::OPUS_CHANNELS;
+    return true;
+}
+
+bool AudioDecoder::ensure_resampler(int in_rate, int in_channels, int in_format)
+{
+    if (swr_ctx_ && in_rate == swr_in_rate_ && in_channels == swr_in_channels_ && in_format == swr_in_format_) {
+        return true;
+    }
+    if (swr_ctx_) swr_free(&swr_ctx_);
+
+    AVChannelLayout in_layout;
+    AVChannelLayout out_layout;
+    av_channel_layout_default(&in_layout, in_channels);
+    av_channel_layout_default(&out_layout, out_channels_);
+    swr_alloc_set_opts2(&swr_ctx_, &out_layout, AV_SAMPLE_FMT_S16, out_rate_,
+        &in_layout, static_cast<AVSampleFormat>(in_format), in_rate, 0, nullptr);
+    if (!swr_ctx_ || swr_init(swr_ctx_) < 0) {
+        qDebug() << "[AudioDecoder] 错误: 无法初始化重采样器" << in_rate << "Hz x" << in_channels;
+        if (swr_ctx_) swr_free(&swr_ctx_);
+        return false;
+    }
+    swr_in_rate_ = in_rate;
+    swr_in_channels_ = in_channels;
+    swr_in_format_ = in_format;
+    return true;
+}
+
+int AudioDecoder::convert(const uint8_t** in, int in_frames, int64_t& pts_ms, std::vector<int16_t>& out)
+{
+    // 本次输出的第一个样本对应的是上次调用时留在重采样器里的输入，时间戳相应前移
+    const int64_t delay = swr_get_delay(swr_ctx_, out_rate_);
+    pts_ms -= (delay * 1000 + out_rate_ / 2) / out_rate_;
+
+    const int capacity = swr_get_out_samples(swr_ctx_, in_frames);
+    if (capacity <= 0) return 0;
+    const size_t offset = out.size();
+    out.resize(offset + static_cast<size_t>(capacity) * out_channels_);
+    uint8_t* out_ptr = reinterpret_cast<uint8_t*>(out.data() + offset);
+    const int converted = swr_convert(swr_ctx_, &out_ptr, capacity, in, in_frames);
+    out.resize(offset + static_cast<size_t>(std::max(converted, 0)) * out_channels_);
+    return std::max(converted, 0);
+}
+
+int AudioDecoder::decode(AppConfig::PacketType type, const uint8_t* data, int size, int64_t& pts_ms, std::vector<int16_t>& out)
+{
+    out.clear();
+    if (!data || size <= 0) return 0;
+
+    if (type == AppConfig::PacketType::Audio) {
+        const int frames = size / static_cast<int>(sizeof(int16_t) * AppConfig::AUDIO_CHANNELS);
+        if (frames <= 0) return 0;
+        // 格式相同就直接拷贝，避免重采样器的时延
+        if (AppConfig::AUDIO_RATE == out_rate_ && AppConfig::AUDIO_CHANNELS == out_channels_) {
+            const int16_t* samples = reinterpret_cast<const int16_t*>(data);
+            out.assign(samples, samples + static_cast<size_t>(frames) * out_channels_);
+            return frames;
+        }
+        if (!ensure_resampler(AppConfig::AUDIO_RATE, AppConfig::AUDIO_CHANNELS, AV_SAMPLE_FMT_S16)) return 0;
+        const uint8_t* in[] = { data };
+        return convert(in, frames, pts_ms, out);
+    }
+
+    if (type != AppConfig::PacketType::AudioOpus || !init_opus()) return 0;
+
+    packet_->data = const_cast<uint8_t*>(data);
+    packet_->size = size;
+    const int ret = avcodec_send_packet(opus_ctx_, packet_);
+    packet_->data = nullptr;
+    packet_->size = 0;
+    if (ret < 0) {
+        // 损坏的包当作丢包处理，由播放调度做丢包隐藏
+        return 0;
+    }
+
+    // 一个 Opus 包只解出一帧；仍循环取完，防止残留
+    int total = 0;
+    int64_t first_pts = pts_ms;
+    while (avcodec_receive_frame(opus_ctx_, frame_) == 0) {
+        int64_t frame_pts = pts_ms + static_cast<int64_t>(total) * 1000 / out_rate_;
+        if (ensure_resampler(frame_->sample_rate, frame_->ch_layout.nb_channels, frame_->format)) {
+            const int converted = convert(const_cast<const uint8_t**>(frame_->extended_data), frame_->nb_samples, frame_pts, out);
+            if (total == 0) first_pts = frame_pts;
+            total += converted;
+        }
+        av_frame_unref(frame_);
+    }
+    pts_ms = first_pts;
+    return total;
+}
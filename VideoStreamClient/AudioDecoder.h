@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "shared_config.h"
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwrContext;
+
+// 【新增】把收到的音频包统一转换成输出设备的格式（交织 S16）：
+// - PacketType::Audio：旧格式的原始 PCM（AUDIO_RATE / AUDIO_CHANNELS），只做重采样
+// - PacketType::AudioOpus：Opus 包，经 FFmpeg 解码后再转换
+// 包的类型写在数据报头里，不依赖 play_info 的到达顺序
+class AudioDecoder
+{
+public:
+    AudioDecoder(int out_rate, int out_channels);
+    ~AudioDecoder();
+
+    // 转换一个包，结果覆盖写入 out，返回输出帧数（每声道）；
+    // pts_ms 输入为包的时间戳，输出为第一个输出样本的时间戳（扣除重采样器的缓冲时延）
+    int decode(AppConfig::PacketType type, const uint8_t* data, int size, int64_t& pts_ms, std::vector<int16_t>& out);
+    // 跳转/重新播放时清空解码器与重采样器的内部状态
+    void reset();
+
+    AudioDecoder(const AudioDecoder&) = delete;
+    AudioDecoder& operator=(const AudioDecoder&) = delete;
+
+private:
+    bool init_opus();
+    bool ensure_resampler(int in_rate, int in_channels, int in_format);
+    int convert(const uint8_t** in, int in_frames, int64_t& pts_ms, std::vector<int16_t>& out);
+    void cleanup();
+
+    int out_rate_;
+    int out_channels_;
+
+    AVCodecContext* opus_ctx_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    bool opus_failed_ = false;   // 初始化失败后不再反复尝试
+
+    SwrContext* swr_ctx_ = nullptr;
+    int swr_in_rate_ = 0;
+    int swr_in_channels_ = 0;
+    int swr_in_format_ = -1;
+};
@@ -0,0 +1,162 @@
+﻿#include "AudioKernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define AUDIO_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define AUDIO_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang 需要按函数开启指令集；MSVC 可以直接使用所有内建函数
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace AudioKernels {
+namespace {
+
+    constexpr int UNITY_GAIN_Q15 = 32768;
+
+    using GainFn = void(*)(int16_t* samples, size_t begin, size_t end, int gain_q15);
+
+    struct KernelTable {
+        Isa isa;
+        GainFn gain;
+    };
+
+    // ---------------- 标量参考实现 ----------------
+
+    void gain_scalar(int16_t* samples, size_t begin, size_t end, int gain_q15) {
+        for (size_t i = begin; i < end; ++i) {
+            samples[i] = static_cast<int16_t>((samples[i] * gain_q15 + 0x4000) >> 15);
+        }
+    }
+
+    const KernelTable SCALAR_TABLE = { Isa::Scalar, &gain_scalar };
+
+#if defined(AUDIO_X86)
+    // ---------------- SSE4.1（pmulhrsw 属于 SSSE3，SSE4.1 的 CPU 均支持）----------------
+
+    TARGET_SSE41 void gain_sse41(int16_t* samples, size_t begin, size_t end, int gain_q15) {
+        const __m128i g = _mm_set1_epi16(static_cast<int16_t>(gain_q15));
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m128i* p = reinterpret_cast<__m128i*>(samples + i);
+            _mm_storeu_si128(p, _mm_mulhrs_epi16(_mm_loadu_si128(p), g));
+        }
+        gain_scalar(samples, i, end, gain_q15);
+    }
+
+    const KernelTable SSE41_TABLE = { Isa::SSE41, &gain_sse41 };
+
+    // ---------------- AVX2 ----------------
+
+    TARGET_AVX2 void gain_avx2(int16_t* samples, size_t begin, size_t end, int gain_q15) {
+        const __m256i g = _mm256_set1_epi16(static_cast<int16_t>(gain_q15));
+        size_t i = begin;
+        for (; i + 16 <= end; i += 16) {
+            __m256i* p = reinterpret_cast<__m256i*>(samples + i);
+            _mm256_storeu_si256(p, _mm256_mulhrs_epi16(_mm256_loadu_si256(p), g));
+        }
+        gain_sse41(samples, i, end, gain_q15);
+    }
+
+    const KernelTable AVX2_TABLE = { Isa::AVX2, &gain_avx2 };
+#endif
+
+#if defined(AUDIO_NEON)
+    // ---------------- NEON ----------------
+    // vqrdmulh 计算 (2 * s * g + 0x8000) >> 16，与 (s * g + 0x4000) >> 15 相同；g <= 32767 时不会饱和
+
+    void gain_neon(int16_t* samples, size_t begin, size_t end, int gain_q15) {
+        const int16x8_t g = vdupq_n_s16(static_cast<int16_t>(gain_q15));
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            vst1q_s16(samples + i, vqrdmulhq_s16(vld1q_s16(samples + i), g));
+        }
+        gain_scalar(samples, i, end, gain_q15);
+    }
+
+    const KernelTable NEON_TABLE = { Isa::NEON, &gain_neon };
+#endif
+
+    const KernelTable* table_for(Isa isa) {
+        const CpuFeatures& cpu = CpuFeatures::get();
+        switch (isa) {
+        case Isa::Scalar:
+            return &SCALAR_TABLE;
+#if defined(AUDIO_X86)
+        case Isa::SSE41:
+            return cpu.sse41 ? &SSE41_TABLE : nullptr;
+        case Isa::AVX2:
+            return cpu.avx2 ? &AVX2_TABLE : nullptr;
+#endif
+#if defined(AUDIO_NEON)
+        case Isa::NEON:
+            return cpu.neon ? &NEON_TABLE : nullptr;
+#endif
+        default:
+            return nullptr;
+        }
+    }
+
+    const KernelTable* best_table() {
+        for (Isa isa : { Isa::AVX2, Isa::SSE41, Isa::NEON }) {
+            if (const KernelTable* table = table_for(isa)) return table;
+        }
+        return &SCALAR_TABLE;
+    }
+
+    std::atomic<const KernelTable*>& current_table() {
+        static std::atomic<const KernelTable*> table{ best_table() };
+        return table;
+    }
+}
+
+int gain_to_q15(double gain)
+{
+    if (!(gain > 0.0)) return 0; // 同时处理 NaN
+    if (gain >= 1.0) return UNITY_GAIN_Q15;
+    return static_cast<int>(std::lround(gain * UNITY_GAIN_Q15));
+}
+
+void apply_gain(int16_t* samples, size_t count, int gain_q15)
+{
+    if (gain_q15 >= UNITY_GAIN_Q15) return;
+    current_table().load(std::memory_order_relaxed)->gain(samples, 0, count, std::max(gain_q15, 0));
+}
+
+Isa active_isa()
+{
+    return current_table().load()->isa;
+}
+
+const char* isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar: return "Scalar";
+    case Isa::SSE41: return "SSE4.1";
+    case Isa::AVX2: return "AVX2";
+    case Isa::NEON: return "NEON";
+    }
+    return "Unknown";
+}
+
+bool select_isa(Isa isa)
+{
+    const KernelTable* table = table_for(isa);
+    if (!table) return false;
+    current_table().store(table);
+    return true;
+}
+
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 16 位 PCM 音量（增益）内核，在音频回调中原地处理，不分配内存。
+// 增益限制在 [0, 1]，换算为 Q15 定点数: out = (s * g + 0x4000) >> 15，
+// 与 SSSE3 的 pmulhrsw / NEON 的 vqrdmulh 语义一致，所有实现与标量参考版逐样本一致。
+namespace AudioKernels {
+
+    enum class Isa { Scalar, SSE41, AVX2, NEON };
+
+    // 把 [0, 1] 的音量换算为 Q15 增益（1.0 对应 32768，即不做处理）
+    int gain_to_q15(double gain);
+
+    // 原地施加 Q15 增益；gain_q15 >= 32768 时直接返回
+    void apply_gain(int16_t* samples, size_t count, int gain_q15);
+
+    // 当前使用的实现，默认取 CPU 支持的最优者
+    Isa active_isa();
+    const char* isa_name(Isa isa);
+    // 强制切换实现（用于对比验证），CPU 不支持时返回 false
+    bool select_isa(Isa isa);
+}
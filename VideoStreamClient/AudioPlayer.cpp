@@ -1,21 +1,49 @@
 ﻿#include "AudioPlayer.h"
+#include "AudioKernels.h"
 #include "JitterBuffer.h"
 #include "MasterClock.h"
 #include "shared_config.h"
+#include <QDateTime>
 #include <QDebug>
-#include <vector>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
 #include <qcoreapplication.h>
 
 constexpr int64_t AUDIO_SYNC_THRESHOLD_LATE = 100;
 
+namespace {
+    // 环形缓冲区容量（毫秒），远大于正常的排队深度，只在时钟暂停等情况下兜底
+    constexpr int RING_CAPACITY_MS = 500;
+    // 回调每次请求的帧数：小缓冲降低输出时延，数据由环形缓冲区平滑
+    constexpr unsigned long CALLBACK_FRAMES = 128;
+    // 包的播放时刻比环形缓冲区末尾晚不超过该值时直接写入，否则等待
+    constexpr int64_t AUDIO_SYNC_THRESHOLD_EARLY = 5;
+    // 【新增】环形缓冲区的填充水位（毫秒）：覆盖回调周期与填充线程的调度延迟，
+    // 抖动余量由 AudioPlayout 在此之上按测得的抖动决定
+    constexpr int RING_TARGET_MS = 30;
+    // 播放调度统计的汇总间隔
+    constexpr int STATS_INTERVAL_MS = 500;
+
+    // 【修改】设备固定按输出格式打开，与传输的音频编码无关
+    constexpr int SAMPLES_PER_MS = AppConfig::AUDIO_OUTPUT_RATE * AppConfig::AUDIO_OUTPUT_CHANNELS / 1000;
+}
+
 AudioPlayer::AudioPlayer(JitterBuffer& inputBuffer, MasterClock& clock, QObject* parent)
     : QObject(parent),
     m_isPlaying(false),
-    m_volume(1.0),
+    m_gainQ15(AudioKernels::gain_to_q15(1.0)),
+    m_flushRequested(false),
+    m_playoutResetRequested(false),
+    m_underruns(0),
     m_inputBuffer(inputBuffer),
-    m_clock(clock)
+    m_clock(clock),
+    m_ring(static_cast<size_t>(SAMPLES_PER_MS) * RING_CAPACITY_MS),
+    m_decoder(AppConfig::AUDIO_OUTPUT_RATE, AppConfig::AUDIO_OUTPUT_CHANNELS),
+    m_playout(AppConfig::AUDIO_OUTPUT_RATE, AppConfig::AUDIO_OUTPUT_CHANNELS)
 {
-    m_silenceBuffer.resize(AppConfig::AUDIO_CHUNK_SAMPLES * AppConfig::AUDIO_CHANNELS, 0);
+    m_playout.set_output_buffer_ms(RING_TARGET_MS);
+    m_outputBlock.resize(m_playout.max_pull_frames() * AppConfig::AUDIO_OUTPUT_CHANNELS);
 }
 
 AudioPlayer::~AudioPlayer()
@@ -24,7 +52,6 @@ AudioPlayer::~AudioPlayer()
     cleanupPortAudio();
 }
 
-// ... initPortAudio 和 cleanupPortAudio 保持不变 ...
 bool AudioPlayer::initPortAudio()
 {
     PaError err = Pa_Initialize();
@@ -33,15 +60,27 @@ bool AudioPlayer::initPortAudio()
         return false;
     }
 
-    err = Pa_OpenDefaultStream(
+    // 【修改】回调模式，并按设备的低延迟建议值打开输出流
+    PaStreamParameters outputParams;
+    outputParams.device = Pa_GetDefaultOutputDevice();
+    if (outputParams.device == paNoDevice) {
+        qDebug() << "[AudioPlayer] 没有可用的音频输出设备。";
+        return false;
+    }
+    outputParams.channelCount = AppConfig::AUDIO_OUTPUT_CHANNELS;
+    outputParams.sampleFormat = paInt16;
+    outputParams.suggestedLatency = Pa_GetDeviceInfo(outputParams.device)->defaultLowOutputLatency;
+    outputParams.hostApiSpecificStreamInfo = nullptr;
+
+    err = Pa_OpenStream(
         &m_stream,
-        0,
-        AppConfig::AUDIO_CHANNELS,
-        paInt16,
-        AppConfig::AUDIO_RATE,
-        AppConfig::AUDIO_CHUNK_SAMPLES,
         nullptr,
-        nullptr
+        &outputParams,
+        AppConfig::AUDIO_OUTPUT_RATE,
+        CALLBACK_FRAMES,
+        paNoFlag,
+        &AudioPlayer::paCallback,
+        this
     );
 
     if (err != paNoError) {
@@ -49,7 +88,8 @@ bool AudioPlayer::initPortAudio()
         return false;
     }
 
-    qDebug() << "[AudioPlayer] PortAudio 初始化成功。";
+    qDebug() << "[AudioPlayer] PortAudio 初始化成功，输出时延:" << Pa_GetStreamInfo(m_stream)->outputLatency * 1000.0
+        << "ms, 增益内核:" << AudioKernels::isa_name(AudioKernels::active_isa());
     return true;
 }
 
@@ -68,6 +108,8 @@ void AudioPlayer::startPlaying()
 {
     if (m_isPlaying) return;
     if (!initPortAudio()) return;
+    m_flushRequested = true;
+    m_playoutResetRequested = true;
     Pa_StartStream(m_stream);
     m_isPlaying = true;
     qDebug() << "[AudioPlayer] 音频播放循环启动。";
@@ -81,70 +123,146 @@ void AudioPlayer::stopPlaying()
 
 void AudioPlayer::setVolume(double volume)
 {
-    m_volume.store(volume);
+    m_gainQ15.store(AudioKernels::gain_to_q15(volume));
+}
+
+void AudioPlayer::requestFlush()
+{
+    m_flushRequested = true;
+    m_playoutResetRequested = true;
+}
+
+AudioPlayoutStats AudioPlayer::takeStats()
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    AudioPlayoutStats stats = m_stats;
+    // 水位类字段保留最近一次的值，计数类字段清零
+    m_stats.concealments = 0;
+    m_stats.concealed_ms = 0.0;
+    m_stats.accelerated = 0;
+    m_stats.expanded = 0;
+    m_stats.late_dropped = 0;
+    m_stats.skipped_ms = 0.0;
+    m_stats.rebuffers = 0;
+    m_stats.underruns = 0;
+    return stats;
+}
+
+void AudioPlayer::publishStats()
+{
+    AudioPlayoutStats window = m_playout.take_stats();
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.buffer_ms = window.buffer_ms;
+    m_stats.target_ms = window.target_ms;
+    m_stats.jitter_ms = window.jitter_ms;
+    m_stats.stretch_ratio = window.stretch_ratio;
+    m_stats.concealments += window.concealments;
+    m_stats.concealed_ms += window.concealed_ms;
+    m_stats.accelerated += window.accelerated;
+    m_stats.expanded += window.expanded;
+    m_stats.late_dropped += window.late_dropped;
+    m_stats.skipped_ms += window.skipped_ms;
+    m_stats.rebuffers += window.rebuffers;
+    m_stats.underruns += m_underruns.exchange(0);
+}
+
+int AudioPlayer::paCallback(const void* /*input*/, void* output, unsigned long frameCount,
+    const PaStreamCallbackTimeInfo* /*timeInfo*/, PaStreamCallbackFlags /*statusFlags*/, void* userData)
+{
+    static_cast<AudioPlayer*>(userData)->renderOutput(static_cast<int16_t*>(output), frameCount);
+    return paContinue;
+}
+
+// 运行在 PortAudio 的实时线程中：只做无锁读取、memset 与原地增益
+void AudioPlayer::renderOutput(int16_t* output, unsigned long frameCount)
+{
+    const size_t samples = static_cast<size_t>(frameCount) * AppConfig::AUDIO_OUTPUT_CHANNELS;
+    if (m_flushRequested.exchange(false)) {
+        m_ring.discard_all();
+    }
+    // 暂停时输出静音但保留缓冲内容，恢复后从原位置继续
+    if (m_clock.is_paused()) {
+        std::memset(output, 0, samples * sizeof(int16_t));
+        return;
+    }
+
+    const size_t got = m_ring.read(output, samples);
+    if (got < samples) {
+        std::memset(output + got, 0, (samples - got) * sizeof(int16_t));
+        if (m_clock.is_started()) m_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    AudioKernels::apply_gain(output, got, m_gainQ15.load(std::memory_order_relaxed));
 }
 
+// 【修改】填充线程：到达的包全部交给 AudioPlayout（打上到达时间用于抖动估计），
+// 再按环形缓冲区的水位从 AudioPlayout 取样本。新写入样本的播放时刻 = 当前时钟 + 排队时长。
 void AudioPlayer::playLoop()
 {
+    QElapsedTimer statsTimer;
+    statsTimer.start();
     while (m_isPlaying)
     {
         QCoreApplication::processEvents();
+        if (m_playoutResetRequested.exchange(false)) {
+            m_playout.reset();
+            m_decoder.reset();
+        }
         if (m_clock.is_paused()) { // 等待时钟启动后再检查暂停
             QThread::msleep(10);
             continue;
         }
 
-        auto mediaPacket = m_inputBuffer.get_packet();
-        if (!mediaPacket) {
-            // JitterBuffer 为空或检测到丢包
-            if (m_clock.is_started()) {
-                // 只有在时钟启动后才播放静音，避免一开始就播放
-                Pa_WriteStream(m_stream, m_silenceBuffer.data(), m_silenceBuffer.size());
-            }
-            else {
-                // 时钟还没启动，继续等待第一个包
-                QThread::msleep(5);
-            }
-            continue;
+        const int64_t arrival_ms = QDateTime::currentMSecsSinceEpoch();
+        while (std::unique_ptr<MediaPacket> packet = m_inputBuffer.get_packet()) {
+            // 【修改】先解码/重采样成设备格式；解不出样本的包当作丢失，由 AudioPlayout 隐藏
+            int64_t pts = packet->ts;
+            const int frames = m_decoder.decode(packet->type, reinterpret_cast<const uint8_t*>(packet->payload.constData()),
+                packet->payload.size(), pts, m_decoded);
+            if (frames <= 0) continue;
+            m_playout.push(pts, m_decoded.data(), m_decoded.size(), arrival_ms);
         }
 
-        // 【核心修改】检查并启动主时钟
-        if (!m_clock.is_started()) {
-            m_clock.start(mediaPacket->ts);
+        fillRing();
+
+        if (statsTimer.elapsed() >= STATS_INTERVAL_MS) {
+            publishStats();
+            statsTimer.restart();
         }
+        QThread::msleep(2);
+    }
 
-        int64_t master_time_ms = m_clock.get_time_ms();
-        int64_t packet_pts_ms = mediaPacket->ts;
-        int64_t time_diff = packet_pts_ms - master_time_ms;
+    Pa_StopStream(m_stream);
+    qDebug() << "[AudioPlayer] 音频播放循环结束。";
+}
 
-        if (time_diff < -AUDIO_SYNC_THRESHOLD_LATE) {
-            qDebug() << "[AudioPlayer] 丢弃过时的音频包, PTS:" << packet_pts_ms << "ms, MasterClock:" << master_time_ms << "ms, Diff:" << time_diff << "ms";
+void AudioPlayer::fillRing()
+{
+    // 预缓冲到目标时延后才开始输出，并以此启动主时钟
+    if (!m_playout.ready()) return;
+    if (!m_clock.is_started()) {
+        m_clock.start(m_playout.next_pts_ms());
+    }
+
+    const size_t target_samples = static_cast<size_t>(SAMPLES_PER_MS) * RING_TARGET_MS;
+    while (m_ring.available() < target_samples) {
+        const double queued_ms = static_cast<double>(m_ring.available()) / SAMPLES_PER_MS;
+        const double playout_ms = m_clock.get_time_ms() + queued_ms;
+        const double sync_error = m_playout.next_pts_ms() - playout_ms;
+
+        if (sync_error < -AUDIO_SYNC_THRESHOLD_LATE) {
+            // 落后太多，时间伸缩追不上，直接跳到当前应播放的位置
+            const double skipped = m_playout.skip_to(static_cast<int64_t>(playout_ms));
+            qDebug() << "[AudioPlayer] 音频落后主时钟" << -sync_error << "ms，跳过" << skipped << "ms";
+            if (skipped <= 0.0) break;
             continue;
         }
-
-        if (time_diff > 0) {
-            QThread::msleep(static_cast<unsigned long>(time_diff));
+        if (sync_error > AUDIO_SYNC_THRESHOLD_EARLY) {
+            // 音频超前（如跳转后先到的包），等时钟追上，回调暂时输出静音
+            break;
         }
 
-        const int16_t* audio_data_ptr = reinterpret_cast<const int16_t*>(mediaPacket->payload.data());
-        size_t data_size = mediaPacket->payload.size() / sizeof(int16_t);
-        double current_volume = m_volume.load();
-
-        if (data_size > 0)
-        {
-            if (std::abs(current_volume - 1.0) > 1e-6) {
-                std::vector<int16_t> temp_buffer(data_size);
-                for (size_t i = 0; i < data_size; ++i) {
-                    temp_buffer[i] = static_cast<int16_t>(audio_data_ptr[i] * current_volume);
-                }
-                Pa_WriteStream(m_stream, temp_buffer.data(), data_size);
-            }
-            else {
-                Pa_WriteStream(m_stream, audio_data_ptr, data_size);
-            }
-        }
+        const size_t frames = m_playout.pull(m_outputBlock.data(), m_playout.max_pull_frames(), queued_ms, sync_error);
+        if (frames == 0) break;
+        m_ring.write(m_outputBlock.data(), frames * AppConfig::AUDIO_OUTPUT_CHANNELS);
     }
-
-    Pa_StopStream(m_stream);
-    qDebug() << "[AudioPlayer] 音频播放循环结束。";
-}
\ No newline at end of file
+}
@@ -3,12 +3,21 @@
 #include <QObject>
 #include <QThread>
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <portaudio.h>
+#include "AudioDecoder.h"
+#include "AudioPlayout.h"
+#include "AudioRingBuffer.h"
 
 // 前向声明
 class JitterBuffer;
 class MasterClock;
 
+// 【修改】回调模式的音频输出：
+// - 播放线程（playLoop）从 JitterBuffer 取包，经 AudioDecoder 统一成设备格式（AUDIO_OUTPUT_RATE / AUDIO_OUTPUT_CHANNELS）后交给 AudioPlayout，由它按抖动决定缓冲深度、
+//   做丢包隐藏与时间伸缩，生成的样本写入无锁环形缓冲区
+// - PortAudio 回调只从环形缓冲区读取并原地施加音量，不加锁、不分配内存；数据不足时补静音
 class AudioPlayer : public QObject
 {
     Q_OBJECT
@@ -17,6 +26,11 @@ public:
     AudioPlayer(JitterBuffer& inputBuffer, MasterClock& clock, QObject* parent = nullptr);
     ~AudioPlayer();
 
+    // 【新增】跳转/重新播放时丢弃已写入环形缓冲区但尚未播放的样本，可从任意线程调用
+    void requestFlush();
+    // 【新增】取出播放调度的统计（缓冲水位、隐藏次数、伸缩比例等），可从任意线程调用
+    AudioPlayoutStats takeStats();
+
 public slots:
     void startPlaying();
     void stopPlaying();
@@ -26,13 +40,29 @@ private:
     bool initPortAudio();
     void cleanupPortAudio();
     void playLoop();
+    void fillRing();
+    void publishStats();
+
+    static int paCallback(const void* input, void* output, unsigned long frameCount,
+        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void* userData);
+    void renderOutput(int16_t* output, unsigned long frameCount);
 
 private:
     std::atomic<bool> m_isPlaying;
-    std::atomic<double> m_volume;
+    std::atomic<int> m_gainQ15;           // 【修改】音量换算后的 Q15 增益，供回调使用
+    std::atomic<bool> m_flushRequested;   // 由回调（消费者）执行清空
+    std::atomic<bool> m_playoutResetRequested; // 由播放线程执行重置
+    std::atomic<int> m_underruns;         // 回调取不到足够样本的次数
     JitterBuffer& m_inputBuffer;
     MasterClock& m_clock;
 
     PaStream* m_stream = nullptr;
-    std::vector<int16_t> m_silenceBuffer;
-};
\ No newline at end of file
+    AudioRingBuffer m_ring;
+    AudioDecoder m_decoder;               // 【新增】仅播放线程访问
+    std::vector<int16_t> m_decoded;
+    AudioPlayout m_playout;               // 仅播放线程访问
+    std::vector<int16_t> m_outputBlock;
+
+    std::mutex m_statsMutex;
+    AudioPlayoutStats m_stats;
+};
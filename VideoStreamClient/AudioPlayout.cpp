@@ -0,0 +1,411 @@
+﻿#include "AudioPlayout.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // 正常输出的块长（毫秒），伸缩与隐藏也按这个粒度决策
+    constexpr int BLOCK_MS = 10;
+    // 基音搜索范围：400Hz ~ 70Hz
+    constexpr int MAX_PITCH_HZ = 400;
+    constexpr int MIN_PITCH_HZ = 70;
+    // 相关性比较窗口（毫秒）
+    constexpr int CORR_WINDOW_MS = 5;
+    // RFC 3550 的抖动平滑增益
+    constexpr double JITTER_GAIN = 1.0 / 16.0;
+    // 目标时延 = 输出缓冲 + clamp(包时长 + 块长 + 系数 * 抖动, MIN, MAX)
+    constexpr double TARGET_JITTER_FACTOR = 4.0;
+    constexpr double MIN_TARGET_MS = 20.0;
+    constexpr double MAX_TARGET_MS = 250.0;
+    // 缓冲偏离目标超过 max(MIN_HYSTERESIS_MS, 抖动余量/4) 才伸缩，避免来回调整
+    constexpr double MIN_HYSTERESIS_MS = 8.0;
+    // 落后主时钟超过该值且缓冲不低于目标时也加速，用于吸收时钟漂移
+    constexpr double SYNC_TOLERANCE_MS = 20.0;
+    // 相关性低于该值（如噪声段）时不做伸缩，交叉淡化会产生明显失真
+    constexpr double MIN_STRETCH_CORRELATION = 0.3;
+    // 隐藏信号在该时长内线性衰减到零，超过 CONCEAL_MAX_MS 仍无数据则重新预缓冲
+    constexpr int CONCEAL_FADE_MS = 60;
+    constexpr int CONCEAL_MAX_MS = 100;
+    // 隐藏结束后与真实音频交叉淡化的时长
+    constexpr int MERGE_MS = 3;
+    // 包头晚于缓冲末尾不超过该值仍视为连续（容忍 pts 取整到毫秒的误差）
+    constexpr double CONTIGUOUS_TOLERANCE_MS = 1.0;
+}
+
+AudioPlayout::AudioPlayout(int sample_rate, int channels)
+    : sample_rate_(sample_rate),
+    channels_(channels),
+    block_frames_(static_cast<size_t>(sample_rate * BLOCK_MS / 1000)),
+    min_lag_(sample_rate / MAX_PITCH_HZ),
+    max_lag_(sample_rate / MIN_PITCH_HZ),
+    corr_window_(sample_rate * CORR_WINDOW_MS / 1000),
+    output_buffer_ms_(0.0),
+    history_(static_cast<size_t>(max_lag_ + corr_window_) * channels)
+{
+    reset();
+}
+
+void AudioPlayout::reset()
+{
+    started_ = false;
+    next_pts_ms_ = -1.0;
+    fifo_.clear();
+    fifo_read_ = 0;
+    packets_.clear();
+    last_arrival_ms_ = -1;
+    last_pts_ms_ = -1;
+    jitter_ms_ = 0.0;
+    packet_ms_ = 0.0;
+    history_frames_ = 0;
+    conceal_src_.clear();
+    conceal_lag_ = 0;
+    conceal_phase_ = 0;
+    conceal_frames_ = 0;
+    stats_ = AudioPlayoutStats();
+    out_frames_ = 0;
+    in_frames_ = 0;
+    queued_ms_ = 0.0;
+}
+
+void AudioPlayout::set_output_buffer_ms(double ms)
+{
+    output_buffer_ms_ = std::max(0.0, ms);
+}
+
+void AudioPlayout::push(int64_t pts_ms, const int16_t* samples, size_t sample_count, int64_t arrival_ms)
+{
+    const size_t frames = sample_count / channels_;
+    if (frames == 0) return;
+    packet_ms_ = frames_to_ms(frames);
+
+    // 到达间隔与发送间隔之差的平滑均值；乱序包不参与估计
+    if (pts_ms > last_pts_ms_) {
+        if (last_arrival_ms_ >= 0) {
+            const double d = static_cast<double>((arrival_ms - last_arrival_ms_) - (pts_ms - last_pts_ms_));
+            jitter_ms_ += (std::abs(d) - jitter_ms_) * JITTER_GAIN;
+        }
+        last_arrival_ms_ = arrival_ms;
+        last_pts_ms_ = pts_ms;
+    }
+
+    if (next_pts_ms_ >= 0.0 && pts_ms + packet_ms_ <= next_pts_ms_) {
+        stats_.late_dropped++;
+        return;
+    }
+    packets_[pts_ms].assign(samples, samples + frames * channels_);
+}
+
+bool AudioPlayout::ready()
+{
+    if (started_) return true;
+    if (packets_.empty() && fifo_frames() == 0) return false;
+    // 首包（或断流后的第一个包）决定播放起点
+    if (next_pts_ms_ < 0.0) {
+        next_pts_ms_ = static_cast<double>(packets_.begin()->first);
+    }
+    move_contiguous_packets();
+    started_ = buffer_ms() >= target_ms();
+    return started_;
+}
+
+double AudioPlayout::buffer_ms() const
+{
+    if (next_pts_ms_ < 0.0) return 0.0;
+    double end_ms = next_pts_ms_ + frames_to_ms(fifo_frames());
+    if (!packets_.empty()) {
+        const auto& last = *packets_.rbegin();
+        end_ms = std::max(end_ms, last.first + frames_to_ms(last.second.size() / channels_));
+    }
+    return end_ms - next_pts_ms_;
+}
+
+double AudioPlayout::target_ms() const
+{
+    return output_buffer_ms_
+        + std::clamp(packet_ms_ + BLOCK_MS + TARGET_JITTER_FACTOR * jitter_ms_, MIN_TARGET_MS, MAX_TARGET_MS);
+}
+
+size_t AudioPlayout::max_pull_frames() const
+{
+    return std::max(block_frames_, static_cast<size_t>(max_lag_));
+}
+
+// 把与缓冲末尾连续的包移入 fifo_；已经播放过的部分（隐藏期间到达的迟到包）截掉
+void AudioPlayout::move_contiguous_packets()
+{
+    while (!packets_.empty()) {
+        auto it = packets_.begin();
+        const double end_ms = next_pts_ms_ + frames_to_ms(fifo_frames());
+        const size_t frames = it->second.size() / channels_;
+        if (it->first > end_ms + CONTIGUOUS_TOLERANCE_MS) break; // 前面还有缺口
+
+        const size_t skip = it->first < end_ms ? std::min(frames, ms_to_frames(end_ms - it->first)) : 0;
+        if (skip == frames) {
+            stats_.late_dropped++;
+        }
+        else {
+            fifo_.insert(fifo_.end(), it->second.begin() + skip * channels_, it->second.end());
+        }
+        packets_.erase(it);
+    }
+}
+
+void AudioPlayout::consume(size_t frames)
+{
+    fifo_read_ += frames;
+    next_pts_ms_ += frames_to_ms(frames);
+    if (fifo_read_ * channels_ >= fifo_.size()) {
+        fifo_.clear();
+        fifo_read_ = 0;
+    }
+    else if (fifo_read_ >= block_frames_ * 16) {
+        fifo_.erase(fifo_.begin(), fifo_.begin() + fifo_read_ * channels_);
+        fifo_read_ = 0;
+    }
+}
+
+void AudioPlayout::append_history(const int16_t* samples, size_t frames)
+{
+    const size_t capacity = history_.size() / channels_;
+    if (frames >= capacity) {
+        std::memcpy(history_.data(), samples + (frames - capacity) * channels_, history_.size() * sizeof(int16_t));
+        history_frames_ = capacity;
+        return;
+    }
+    const size_t keep = capacity - frames;
+    std::memmove(history_.data(), history_.data() + frames * channels_, keep * channels_ * sizeof(int16_t));
+    std::memcpy(history_.data() + keep * channels_, samples, frames * channels_ * sizeof(int16_t));
+    history_frames_ = std::min(capacity, history_frames_ + frames);
+}
+
+// 归一化互相关，只看第一个声道。静音段返回 1，任何位移都可以
+int AudioPlayout::find_pitch(const int16_t* ref, bool backward, double* correlation) const
+{
+    double ref_energy = 0.0;
+    for (int n = 0; n < corr_window_; ++n) {
+        const double a = ref[n * channels_];
+        ref_energy += a * a;
+    }
+
+    int best_lag = min_lag_;
+    double best = -1.0;
+    for (int lag = min_lag_; lag <= max_lag_; ++lag) {
+        const int16_t* cand = backward ? ref - lag * channels_ : ref + lag * channels_;
+        double cross = 0.0;
+        double energy = 0.0;
+        for (int n = 0; n < corr_window_; ++n) {
+            const double a = ref[n * channels_];
+            const double b = cand[n * channels_];
+            cross += a * b;
+            energy += b * b;
+        }
+        const double denom = std::sqrt(ref_energy * energy);
+        const double c = denom > 1.0 ? cross / denom : 1.0;
+        if (c > best) {
+            best = c;
+            best_lag = lag;
+        }
+    }
+    *correlation = best;
+    return best_lag;
+}
+
+size_t AudioPlayout::emit_normal(int16_t* out, size_t frames)
+{
+    std::memcpy(out, fifo_data(), frames * channels_ * sizeof(int16_t));
+    consume(frames);
+    in_frames_ += frames;
+    out_frames_ += frames;
+    return frames;
+}
+
+// 删去一个基音周期：两个相邻周期交叉淡化成一个，消耗 2*lag 帧、输出 lag 帧
+size_t AudioPlayout::emit_accelerate(int16_t* out, int lag)
+{
+    const int16_t* x = fifo_data();
+    for (int n = 0; n < lag; ++n) {
+        const double w = (n + 1.0) / (lag + 1.0);
+        for (int c = 0; c < channels_; ++c) {
+            const double a = x[n * channels_ + c];
+            const double b = x[(n + lag) * channels_ + c];
+            out[n * channels_ + c] = static_cast<int16_t>(std::lround(a * (1.0 - w) + b * w));
+        }
+    }
+    consume(static_cast<size_t>(lag) * 2);
+    in_frames_ += static_cast<size_t>(lag) * 2;
+    out_frames_ += lag;
+    stats_.accelerated++;
+    return lag;
+}
+
+// 插入一个基音周期：从即将播放的样本淡入到上一个周期的重复，结尾与 fifo_ 开头衔接，
+// 不消耗输入、输出 lag 帧
+size_t AudioPlayout::emit_expand(int16_t* out, int lag)
+{
+    const int16_t* x = fifo_data();
+    const int16_t* h = history_.data() + (history_frames_ - lag) * channels_;
+    for (int n = 0; n < lag; ++n) {
+        const double w = (n + 1.0) / lag;
+        for (int c = 0; c < channels_; ++c) {
+            const double a = x[n * channels_ + c];
+            const double b = h[n * channels_ + c];
+            out[n * channels_ + c] = static_cast<int16_t>(std::lround(a * (1.0 - w) + b * w));
+        }
+    }
+    out_frames_ += lag;
+    stats_.expanded++;
+    return lag;
+}
+
+double AudioPlayout::conceal_gain() const
+{
+    const double fade_frames = sample_rate_ * CONCEAL_FADE_MS / 1000.0;
+    return std::max(0.0, 1.0 - conceal_frames_ / fade_frames);
+}
+
+// 丢包隐藏：重复丢包前最后一个基音周期并线性衰减，播放位置照常前进
+size_t AudioPlayout::emit_conceal(int16_t* out, size_t frames)
+{
+    if (conceal_frames_ == 0) {
+        conceal_lag_ = 0;
+        conceal_phase_ = 0;
+        if (history_frames_ >= static_cast<size_t>(max_lag_ + corr_window_)) {
+            double correlation = 0.0;
+            const int16_t* ref = history_.data() + (history_frames_ - corr_window_) * channels_;
+            conceal_lag_ = find_pitch(ref, true, &correlation);
+            const int16_t* src = history_.data() + (history_frames_ - conceal_lag_) * channels_;
+            conceal_src_.assign(src, src + conceal_lag_ * channels_);
+        }
+        stats_.concealments++;
+    }
+
+    const double fade_frames = sample_rate_ * CONCEAL_FADE_MS / 1000.0;
+    for (size_t n = 0; n < frames; ++n) {
+        const double gain = std::max(0.0, 1.0 - (conceal_frames_ + n) / fade_frames);
+        for (int c = 0; c < channels_; ++c) {
+            double v = 0.0;
+            if (conceal_lag_ > 0 && gain > 0.0) {
+                v = conceal_src_[((conceal_phase_ + n) % conceal_lag_) * channels_ + c] * gain;
+            }
+            out[n * channels_ + c] = static_cast<int16_t>(std::lround(v));
+        }
+    }
+    conceal_phase_ += frames;
+    conceal_frames_ += frames;
+    next_pts_ms_ += frames_to_ms(frames);
+    stats_.concealed_ms += frames_to_ms(frames);
+    return frames;
+}
+
+// 隐藏结束后的第一段真实音频：从隐藏信号的延续交叉淡化过来，避免接缝处的爆音
+void AudioPlayout::merge_after_conceal(int16_t* out, size_t frames)
+{
+    if (conceal_frames_ == 0) return;
+    if (conceal_lag_ > 0) {
+        const double gain = conceal_gain();
+        const size_t merge = std::min(frames, static_cast<size_t>(sample_rate_ * MERGE_MS / 1000));
+        for (size_t n = 0; n < merge; ++n) {
+            const double w = (n + 1.0) / (merge + 1.0);
+            for (int c = 0; c < channels_; ++c) {
+                const double a = conceal_src_[((conceal_phase_ + n) % conceal_lag_) * channels_ + c] * gain;
+                const double b = out[n * channels_ + c];
+                out[n * channels_ + c] = static_cast<int16_t>(std::lround(a * (1.0 - w) + b * w));
+            }
+        }
+    }
+    conceal_frames_ = 0;
+}
+
+// 长时间没有数据：停止输出，等缓冲重新达到目标后从新到的包开始播放。
+// 保留隐藏状态（此时增益已衰减到零），恢复时的第一段音频会从静音淡入
+void AudioPlayout::enter_rebuffer()
+{
+    started_ = false;
+    next_pts_ms_ = -1.0;
+    fifo_.clear();
+    fifo_read_ = 0;
+    stats_.rebuffers++;
+}
+
+size_t AudioPlayout::pull(int16_t* out, size_t max_frames, double queued_ms, double sync_error_ms)
+{
+    queued_ms_ = queued_ms;
+    if (!ready()) return 0;
+    move_contiguous_packets();
+
+    const size_t available = fifo_frames();
+    const double level = buffer_ms() + queued_ms;
+    const double target = target_ms();
+    const double hysteresis = std::max(MIN_HYSTERESIS_MS, (target - output_buffer_ms_) / 4.0);
+    size_t produced = 0;
+
+    if (available >= block_frames_) {
+        const bool accelerate = level > target + hysteresis
+            || (sync_error_ms < -SYNC_TOLERANCE_MS && level > target);
+        // 刚结束隐藏时历史中是衰减过的隐藏信号，不能拿来重复
+        const bool expand = level < target - hysteresis && conceal_frames_ == 0;
+        double correlation = 0.0;
+
+        if (accelerate && available >= static_cast<size_t>(max_lag_) * 2) {
+            const int lag = find_pitch(fifo_data(), false, &correlation);
+            if (correlation >= MIN_STRETCH_CORRELATION) {
+                produced = emit_accelerate(out, lag);
+            }
+        }
+        else if (expand && available >= static_cast<size_t>(max_lag_)
+            && history_frames_ >= static_cast<size_t>(max_lag_ + corr_window_)) {
+            const int16_t* ref = history_.data() + (history_frames_ - corr_window_) * channels_;
+            const int lag = find_pitch(ref, true, &correlation);
+            if (correlation >= MIN_STRETCH_CORRELATION) {
+                produced = emit_expand(out, lag);
+            }
+        }
+        if (produced == 0) {
+            produced = emit_normal(out, std::min(block_frames_, max_frames));
+        }
+        merge_after_conceal(out, produced);
+        append_history(out, produced);
+        return produced;
+    }
+
+    // 不足一块：说明后面的包丢失或迟到。剩余的真实样本先播完（隐藏要从它们的末尾延续），其余部分做隐藏
+    const size_t block = std::min(block_frames_, max_frames);
+    if (available > 0) {
+        produced = emit_normal(out, available);
+        merge_after_conceal(out, produced);
+        append_history(out, produced);
+    }
+    int16_t* concealed = out + produced * channels_;
+    const size_t concealed_frames = emit_conceal(concealed, block - produced);
+    append_history(concealed, concealed_frames);
+    if (conceal_frames_ >= static_cast<size_t>(sample_rate_ * CONCEAL_MAX_MS / 1000) && started_) {
+        enter_rebuffer();
+    }
+    return produced + concealed_frames;
+}
+
+double AudioPlayout::skip_to(int64_t pts_ms)
+{
+    if (next_pts_ms_ < 0.0 || pts_ms <= next_pts_ms_) return 0.0;
+    move_contiguous_packets();
+    const double skipped = pts_ms - next_pts_ms_;
+    const size_t frames = std::min(fifo_frames(), ms_to_frames(skipped));
+    consume(frames);
+    next_pts_ms_ = static_cast<double>(pts_ms);
+    conceal_frames_ = 0;
+    stats_.skipped_ms += skipped;
+    return skipped;
+}
+
+AudioPlayoutStats AudioPlayout::take_stats()
+{
+    AudioPlayoutStats stats = stats_;
+    stats.buffer_ms = buffer_ms() + queued_ms_;
+    stats.target_ms = target_ms();
+    stats.jitter_ms = jitter_ms_;
+    stats.stretch_ratio = in_frames_ > 0 ? static_cast<double>(out_frames_) / in_frames_ : 1.0;
+    stats_ = AudioPlayoutStats();
+    out_frames_ = 0;
+    in_frames_ = 0;
+    return stats;
+}
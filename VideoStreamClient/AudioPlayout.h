@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 音频播放调度的统计信息（由 take_stats 取出后清零计数项）
+struct AudioPlayoutStats {
+    double buffer_ms = 0.0;     // 当前缓冲的音频时长（含尚未连续的包与输出端排队）
+    double target_ms = 0.0;     // 按到达抖动计算的目标时延（含输出端）
+    double jitter_ms = 0.0;     // 到达间隔抖动估计（RFC 3550）
+    int concealments = 0;       // 丢包隐藏的次数（连续隐藏计一次）
+    double concealed_ms = 0.0;  // 丢包隐藏生成的总时长
+    int accelerated = 0;        // 加速（删去一个基音周期）的次数
+    int expanded = 0;           // 减速（插入一个基音周期）的次数
+    int late_dropped = 0;       // 晚于播放位置而丢弃的包
+    double skipped_ms = 0.0;    // 落后主时钟过多而跳过的时长
+    int rebuffers = 0;          // 长时间断流后重新预缓冲的次数
+    int underruns = 0;          // 声卡回调取不到数据的次数（由 AudioPlayer 填写）
+    double stretch_ratio = 1.0; // 输出时长 / 消耗的输入时长，< 1 表示加速
+};
+
+// 【新增】自适应音频播放调度（仅在音频填充线程中使用，非线程安全）
+// - 按包的到达间隔抖动估计目标缓冲时延，首次播放与长时间断流后先预缓冲到目标值
+// - 缓冲高于目标时用 WSOLA 删去一个基音周期（加速），低于目标时插入一个基音周期（减速），
+//   以此吸收抖动和时钟漂移，而不是插入静音或丢包
+// - 期望的包没有到达时按最近输出的基音周期做丢包隐藏（逐块衰减），恢复时与真实音频交叉淡化
+// 样本为交织的 int16 PCM，基音搜索只使用第一个声道。
+class AudioPlayout
+{
+public:
+    AudioPlayout(int sample_rate, int channels);
+
+    void reset();
+
+    // 放入一个包，arrival_ms 为到达时的系统时间
+    void push(int64_t pts_ms, const int16_t* samples, size_t sample_count, int64_t arrival_ms);
+
+    // 是否已完成预缓冲、可以开始输出
+    bool ready();
+    // 下一个输出样本对应的媒体时间，尚未收到包时为 -1
+    int64_t next_pts_ms() const { return static_cast<int64_t>(next_pts_ms_); }
+
+    // 输出端（环形缓冲区）常驻的时长，计入目标时延：预缓冲需要多攒这么多，
+    // 否则开始播放时填满输出端就会把抖动余量耗光
+    void set_output_buffer_ms(double ms);
+
+    // 生成一段输出（交织样本），返回帧数；未就绪时返回 0。
+    // queued_ms = 输出端已排队的时长；sync_error_ms = 本段的播放时刻相对主时钟的偏差，
+    // 落后较多且缓冲充足时优先加速追赶
+    size_t pull(int16_t* out, size_t max_frames, double queued_ms, double sync_error_ms);
+    // 丢弃 pts 之前的音频（落后主时钟过多时直接追上），返回丢弃的时长
+    double skip_to(int64_t pts_ms);
+
+    // 单次 pull 可能输出的最大帧数，调用方的缓冲区至少要这么大
+    size_t max_pull_frames() const;
+
+    AudioPlayoutStats take_stats();
+
+private:
+    double frames_to_ms(size_t frames) const { return frames * 1000.0 / sample_rate_; }
+    size_t ms_to_frames(double ms) const { return static_cast<size_t>(ms * sample_rate_ / 1000.0 + 0.5); }
+    size_t fifo_frames() const { return fifo_.size() / channels_ - fifo_read_; }
+    const int16_t* fifo_data() const { return fifo_.data() + fifo_read_ * channels_; }
+    double buffer_ms() const;
+    double target_ms() const;
+
+    void move_contiguous_packets();
+    void consume(size_t frames);
+    void append_history(const int16_t* samples, size_t frames);
+    // 在 [min_lag_, max_lag_] 中找与 ref 最相似的位移：backward 为 true 时向前（历史方向）找
+    int find_pitch(const int16_t* ref, bool backward, double* correlation) const;
+    double conceal_gain() const;
+
+    size_t emit_normal(int16_t* out, size_t frames);
+    size_t emit_accelerate(int16_t* out, int lag);
+    size_t emit_expand(int16_t* out, int lag);
+    size_t emit_conceal(int16_t* out, size_t frames);
+    void merge_after_conceal(int16_t* out, size_t frames);
+    void enter_rebuffer();
+
+    const int sample_rate_;
+    const int channels_;
+    const size_t block_frames_;
+    const int min_lag_;
+    const int max_lag_;
+    const int corr_window_;
+    double output_buffer_ms_;
+
+    bool started_;
+    double next_pts_ms_;                    // 下一个输出样本的媒体时间，-1 表示等待首包
+    std::vector<int16_t> fifo_;             // 与播放位置连续的样本
+    size_t fifo_read_;                      // fifo_ 中已消耗的帧数
+    std::map<int64_t, std::vector<int16_t>> packets_; // 尚未连续（前面有缺口）的包
+
+    // 抖动估计
+    int64_t last_arrival_ms_;
+    int64_t last_pts_ms_;
+    double jitter_ms_;
+    double packet_ms_;
+
+    // 丢包隐藏
+    std::vector<int16_t> history_;          // 最近输出的样本（交织），固定长度
+    size_t history_frames_;                 // history_ 中的有效帧数
+    std::vector<int16_t> conceal_src_;      // 隐藏开始时截取的最后一个基音周期
+    int conceal_lag_;
+    size_t conceal_phase_;
+    size_t conceal_frames_;                 // 本次连续隐藏的帧数
+
+    AudioPlayoutStats stats_;
+    size_t out_frames_;                     // 用于统计伸缩比例
+    size_t in_frames_;
+    double queued_ms_;                      // 最近一次 pull 时输出端的排队时长
+};
@@ -0,0 +1,62 @@
+﻿#include "AudioRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer(size_t min_capacity)
+    : write_pos_(0), read_pos_(0)
+{
+    size_t capacity = 1;
+    while (capacity < min_capacity) capacity <<= 1;
+    data_.assign(capacity, 0);
+    mask_ = capacity - 1;
+}
+
+size_t AudioRingBuffer::write(const int16_t* src, size_t count)
+{
+    const size_t w = write_pos_.load(std::memory_order_relaxed);
+    const size_t r = read_pos_.load(std::memory_order_acquire);
+    const size_t n = std::min(count, data_.size() - (w - r));
+    if (n == 0) return 0;
+
+    // 跨过缓冲区末尾时分两段拷贝
+    const size_t offset = w & mask_;
+    const size_t first = std::min(n, data_.size() - offset);
+    std::memcpy(data_.data() + offset, src, first * sizeof(int16_t));
+    std::memcpy(data_.data(), src + first, (n - first) * sizeof(int16_t));
+
+    write_pos_.store(w + n, std::memory_order_release);
+    return n;
+}
+
+size_t AudioRingBuffer::read(int16_t* dst, size_t count)
+{
+    const size_t r = read_pos_.load(std::memory_order_relaxed);
+    const size_t w = write_pos_.load(std::memory_order_acquire);
+    const size_t n = std::min(count, w - r);
+    if (n == 0) return 0;
+
+    const size_t offset = r & mask_;
+    const size_t first = std::min(n, data_.size() - offset);
+    std::memcpy(dst, data_.data() + offset, first * sizeof(int16_t));
+    std::memcpy(dst + first, data_.data(), (n - first) * sizeof(int16_t));
+
+    read_pos_.store(r + n, std::memory_order_release);
+    return n;
+}
+
+void AudioRingBuffer::discard_all()
+{
+    read_pos_.store(write_pos_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t AudioRingBuffer::available() const
+{
+    const size_t r = read_pos_.load(std::memory_order_acquire);
+    const size_t w = write_pos_.load(std::memory_order_acquire);
+    return w - r;
+}
+
+size_t AudioRingBuffer::free_space() const
+{
+    return data_.size() - available();
+}
@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 【新增】单生产者 / 单消费者的无锁 PCM 样本环形缓冲区
+// - 生产者（填充线程）只调用 write / free_space，消费者（PortAudio 回调）只调用 read / discard_all
+// - 容量取 2 的幂，读写位置单调递增，用掩码定位槽位；两端各自只写自己的位置，以 acquire/release 同步
+// - 构造之后不再分配内存，可在实时音频回调中使用
+class AudioRingBuffer
+{
+public:
+    explicit AudioRingBuffer(size_t min_capacity);
+
+    // 生产者：尽量写入 count 个样本，返回实际写入数
+    size_t write(const int16_t* src, size_t count);
+    // 消费者：尽量读出 count 个样本，返回实际读出数
+    size_t read(int16_t* dst, size_t count);
+    // 消费者：丢弃当前所有可读样本（跳转/重新播放时清空）
+    void discard_all();
+
+    // 任意线程：当前可读样本数 / 可写空间（并发时只是近似值）
+    size_t available() const;
+    size_t free_space() const;
+    size_t capacity() const { return data_.size(); }
+
+private:
+    std::vector<int16_t> data_;
+    size_t mask_;
+    // 读写位置分处不同缓存行，避免两个线程互相争用
+    alignas(64) std::atomic<size_t> write_pos_;
+    alignas(64) std::atomic<size_t> read_pos_;
+};
@@ -2,6 +2,7 @@
 #include "QuicClient.h"
 #include "NetworkMonitor.h"
 #include "JitterBuffer.h"
+#include "LatencyTracker.h" // 【新增】
 #include "shared_config.h"
 #include "MediaPacket.h"
 
@@ -9,8 +10,10 @@
 #include <QThread>
 #include <QTimer>
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QDateTime>
+#include <cmath>
 
 #ifdef _WIN32
 #include <winsock2.h> 
@@ -29,15 +32,26 @@ inline uint64_t ntohll_portable(uint64_t value) {
     else { return value; }
 }
 
+// 【新增】VideoTiming 负载中的 u32 字段
+inline uint32_t ntohl_portable(uint32_t value) {
+#ifdef _WIN32
+    return _byteswap_ulong(value);
+#else
+    return ntohl(value);
+#endif
+}
+
 ClientWorker::ClientWorker(
     NetworkMonitor& monitor,
     JitterBuffer& videoBuffer,
     JitterBuffer& audioBuffer,
+    LatencyTracker& latencyTracker,
     QObject* parent)
     : QObject(parent),
     m_monitor(monitor),
     m_videoJitterBuffer(videoBuffer),
     m_audioJitterBuffer(audioBuffer),
+    m_latencyTracker(latencyTracker),
     m_isConnected(false)
 {
     m_quicThread = new QThread(this);
@@ -48,15 +62,21 @@ ClientWorker::ClientWorker(
     connect(m_quicClient, &QuicClient::connectionFailed, this, &ClientWorker::onQuicConnectionFailed);
     connect(m_quicClient, &QuicClient::playInfoReceived, this, &ClientWorker::onQuicPlayInfoReceived);
     connect(m_quicClient, &QuicClient::latencyUpdated, this, &ClientWorker::onQuicLatencyUpdated);
+    connect(m_quicClient, &QuicClient::videoRefreshModeReceived, this, &ClientWorker::videoRefreshModeReceived);
     connect(m_quicClient, &QuicClient::bandwidthUpdated, this, &ClientWorker::onBandwidthUpdated);
     connect(m_quicClient, &QuicClient::videoPacketReceived, this, &ClientWorker::processVideoPacket);
     connect(m_quicClient, &QuicClient::audioPacketReceived, this, &ClientWorker::processAudioPacket);
+    connect(m_quicClient, &QuicClient::videoTimingReceived, this, &ClientWorker::processVideoTiming);
+    connect(m_quicClient, &QuicClient::clockSampleReceived, this, &ClientWorker::onClockSampleReceived);
 
     connect(m_quicThread, &QThread::finished, m_quicClient, &QObject::deleteLater);
     m_quicThread->start();
 
     m_heartbeatTimer = new QTimer(this);
     connect(m_heartbeatTimer, &QTimer::timeout, this, &ClientWorker::sendHeartbeat);
+
+    m_feedbackTimer = new QTimer(this);
+    connect(m_feedbackTimer, &QTimer::timeout, this, &ClientWorker::sendTransportFeedback);
 }
 
 ClientWorker::~ClientWorker()
@@ -85,6 +105,8 @@ void ClientWorker::requestPlay(const QString& source)
     QJsonObject req;
     req["command"] = "play";
     req["source"] = source;
+    // 【新增】声明支持的音频编码（按偏好排序），服务端不支持 Opus 时回落到原始 PCM
+    req["audio_codecs"] = QJsonArray{ AppConfig::AUDIO_CODEC_OPUS, AppConfig::AUDIO_CODEC_PCM };
     QByteArray command = QJsonDocument(req).toJson(QJsonDocument::Compact);
     QMetaObject::invokeMethod(m_quicClient, "sendControlCommand", Qt::QueuedConnection, Q_ARG(QByteArray, command));
 }
@@ -114,11 +136,21 @@ void ClientWorker::requestResume()
     QMetaObject::invokeMethod(m_quicClient, "sendControlCommand", Qt::QueuedConnection, Q_ARG(QByteArray, command));
 }
 
+void ClientWorker::requestKeyframe(const QString& reason)
+{
+    if (!m_isConnected) return;
+    QJsonObject req;
+    req["command"] = "keyframe_request";
+    req["reason"] = reason;
+    QByteArray command = QJsonDocument(req).toJson(QJsonDocument::Compact);
+    QMetaObject::invokeMethod(m_quicClient, "sendControlCommand", Qt::QueuedConnection, Q_ARG(QByteArray, command));
+}
+
 void ClientWorker::onQuicConnectionSuccess(const QList<QString>& videoList)
 {
     m_isConnected = true;
     m_heartbeatTimer->start(1000); // 心跳间隔1秒
-    m_packet_history.clear(); // 清空历史记录
+    m_feedbackTimer->start(AppConfig::TRANSPORT_FEEDBACK_INTERVAL_MS);
     emit connectionSuccess(videoList);
 }
 
@@ -126,6 +158,7 @@ void ClientWorker::onQuicConnectionFailed(const QString& reason)
 {
     m_isConnected = false;
     m_heartbeatTimer->stop();
+    m_feedbackTimer->stop();
     emit connectionFailed(reason);
 }
 
@@ -134,7 +167,7 @@ void ClientWorker::onQuicPlayInfoReceived(double duration)
     m_monitor.reset();
     m_videoJitterBuffer.reset();
     m_audioJitterBuffer.reset();
-    m_packet_history.clear(); // 开始播放时重置
+    m_latencyTracker.reset(); // 【新增】
     emit playInfoReceived(duration);
 }
 
@@ -156,24 +189,56 @@ void ClientWorker::sendHeartbeat()
         return;
     }
 
-    NetworkTrend trend = getNetworkTrend();
-    QString trend_str = "hold";
-    if (trend == NetworkTrend::Increase) {
-        trend_str = "increase";
-    }
-    else if (trend == NetworkTrend::Decrease) {
-        trend_str = "decrease";
-    }
-
+    // 【修改】心跳只用于测量时延，码率由传输层反馈驱动
     QJsonObject heartbeatObject;
     heartbeatObject["command"] = "heartbeat";
-    heartbeatObject["trend"] = trend_str;
     heartbeatObject["client_ts"] = QDateTime::currentMSecsSinceEpoch();
 
     QByteArray command = QJsonDocument(heartbeatObject).toJson(QJsonDocument::Compact);
     QMetaObject::invokeMethod(m_quicClient, "sendControlCommand", Qt::QueuedConnection, Q_ARG(QByteArray, command));
 }
 
+void ClientWorker::sendTransportFeedback()
+{
+    if (!m_isConnected) {
+        m_feedbackTimer->stop();
+        return;
+    }
+
+    const TransportFeedbackReport report = m_quicClient->transportFeedback().take_report();
+    if (report.arrival_us.empty()) {
+        return;
+    }
+
+    // 到达间隔量化为 TRANSPORT_FEEDBACK_DELTA_UNIT_US 的整数倍；按量化后的时间累加，误差不会累积
+    const int64_t unit = AppConfig::TRANSPORT_FEEDBACK_DELTA_UNIT_US;
+    int64_t ref_us = -1;
+    int64_t last_us = 0;
+    QJsonArray deltas;
+    for (int64_t arrival_us : report.arrival_us) {
+        if (arrival_us < 0) {
+            deltas.append(QJsonValue()); // null 表示丢失
+            continue;
+        }
+        if (ref_us < 0) {
+            ref_us = arrival_us;
+            last_us = arrival_us;
+        }
+        const int64_t delta = std::llround(static_cast<double>(arrival_us - last_us) / unit);
+        last_us += delta * unit;
+        deltas.append(static_cast<qint64>(delta));
+    }
+
+    QJsonObject feedbackObject;
+    feedbackObject["command"] = "transport_feedback";
+    feedbackObject["base_seq"] = static_cast<int>(report.base_seq);
+    feedbackObject["ref_us"] = static_cast<qint64>(ref_us);
+    feedbackObject["deltas"] = deltas;
+
+    QByteArray command = QJsonDocument(feedbackObject).toJson(QJsonDocument::Compact);
+    QMetaObject::invokeMethod(m_quicClient, "sendControlCommand", Qt::QueuedConnection, Q_ARG(QByteArray, command));
+}
+
 void ClientWorker::processVideoPacket(const QByteArray& packet)
 {
     const int TYPE_H_SIZE = sizeof(AppConfig::PacketType);
@@ -185,8 +250,6 @@ void ClientWorker::processVideoPacket(const QByteArray& packet)
     memcpy(&pts_net, packet.constData() + TYPE_H_SIZE, PTS_H_SIZE);
     int64_t ts = ntohll_portable(pts_net);
 
-    analyzePacketArrival(ts, packet.size());
-
     auto mediaPacket = std::make_unique<MediaPacket>();
     mediaPacket->ts = ts;
     static uint32_t video_seq = 0;
@@ -197,9 +260,43 @@ void ClientWorker::processVideoPacket(const QByteArray& packet)
     m_videoJitterBuffer.add_packet(std::move(mediaPacket));
 }
 
+// 【新增】负载格式见 AppConfig::VIDEO_TIMING_PAYLOAD_SIZE
+void ClientWorker::processVideoTiming(const QByteArray& packet, qint64 arrivalUs)
+{
+    if (packet.size() < AppConfig::DATAGRAM_HEADER_SIZE + AppConfig::VIDEO_TIMING_PAYLOAD_SIZE) return;
+
+    const char* data = packet.constData();
+    int64_t pts_net;
+    memcpy(&pts_net, data + 1, sizeof(int64_t));
+    const int64_t pts = ntohll_portable(pts_net);
+
+    const char* payload = data + AppConfig::DATAGRAM_HEADER_SIZE;
+    int64_t capture_net;
+    memcpy(&capture_net, payload, sizeof(int64_t));
+    uint32_t offsets[4];
+    for (int i = 0; i < 4; ++i) {
+        uint32_t offset_net;
+        memcpy(&offset_net, payload + sizeof(int64_t) + i * sizeof(uint32_t), sizeof(uint32_t));
+        offsets[i] = ntohl_portable(offset_net);
+    }
+
+    FrameTimingSample timing;
+    timing.capture_wall_us = ntohll_portable(capture_net);
+    timing.converted_us = offsets[0];
+    timing.encode_start_us = offsets[1];
+    timing.encoded_us = offsets[2];
+    timing.sent_us = offsets[3];
+    m_latencyTracker.on_frame_timing(pts, timing, arrivalUs);
+}
+
+void ClientWorker::onClockSampleReceived(qint64 clientSendMs, qint64 serverUs, qint64 clientRecvMs)
+{
+    m_latencyTracker.on_clock_sample(clientSendMs, serverUs, clientRecvMs);
+}
+
 void ClientWorker::processAudioPacket(const QByteArray& packet)
 {
-    const int HEADER_SIZE = 1 + 8 + 2 + 2;
+    const int HEADER_SIZE = AppConfig::DATAGRAM_HEADER_SIZE;
     if (packet.size() <= HEADER_SIZE) return;
 
     const char* data_ptr = packet.constData();
@@ -210,48 +307,10 @@ void ClientWorker::processAudioPacket(const QByteArray& packet)
 
     auto mediaPacket = std::make_unique<MediaPacket>();
     mediaPacket->ts = ts;
+    mediaPacket->type = static_cast<AppConfig::PacketType>(static_cast<uint8_t>(data_ptr[0]));
     static uint32_t audio_seq = 0;
     mediaPacket->seq = audio_seq++;
     mediaPacket->payload = packet.mid(HEADER_SIZE);
 
     m_audioJitterBuffer.add_packet(std::move(mediaPacket));
 }
-
-void ClientWorker::analyzePacketArrival(int64_t timestamp_ms, int packet_size)
-{
-    m_packet_history.push_back({
-        QDateTime::currentMSecsSinceEpoch(),
-        timestamp_ms,
-        packet_size
-        });
-
-    if (m_packet_history.size() > HISTORY_SIZE) {
-        m_packet_history.pop_front();
-    }
-}
-
-NetworkTrend ClientWorker::getNetworkTrend()
-{
-    if (m_packet_history.size() < 50) {
-        return NetworkTrend::Hold;
-    }
-
-    int64_t media_delta_ms = m_packet_history.back().media_timestamp_ms - m_packet_history.front().media_timestamp_ms;
-    qint64 arrival_delta_ms = m_packet_history.back().arrival_time_ms - m_packet_history.front().arrival_time_ms;
-
-    if (media_delta_ms <= 0) {
-        return NetworkTrend::Hold;
-    }
-
-    double delay_gradient = static_cast<double>(arrival_delta_ms - media_delta_ms) / media_delta_ms;
-
-    if (delay_gradient > 0.05) { // 阈值可以调整，0.05表示延迟增加了5%
-        return NetworkTrend::Decrease;
-    }
-    else if (delay_gradient < -0.05) { // 延迟减少了5%
-        return NetworkTrend::Increase;
-    }
-    else {
-        return NetworkTrend::Hold;
-    }
-}
\ No newline at end of file
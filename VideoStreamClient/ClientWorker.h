@@ -3,19 +3,12 @@
 #include <QObject>
 #include <QList>
 #include <qtimer.h>
-#include <deque> // 【新增】
 
 // 前向声明
 class NetworkMonitor;
 class JitterBuffer;
 class QuicClient;
-
-// 【新增】定义网络趋势反馈类型
-enum class NetworkTrend {
-    Increase,
-    Decrease,
-    Hold
-};
+class LatencyTracker;
 
 class ClientWorker : public QObject
 {
@@ -26,6 +19,7 @@ public:
         NetworkMonitor& monitor,
         JitterBuffer& videoBuffer,
         JitterBuffer& audioBuffer,
+        LatencyTracker& latencyTracker, // 【新增】
         QObject* parent = nullptr);
 
     ~ClientWorker();
@@ -37,6 +31,8 @@ public slots:
     void requestSeek(double timeSec);
     void requestPause();
     void requestResume();
+    // 【新增】解码端发现参考链断裂，请求服务端发送关键帧
+    void requestKeyframe(const QString& reason);
 private slots:
     void onQuicConnectionSuccess(const QList<QString>& videoList);
     void onQuicConnectionFailed(const QString& reason);
@@ -45,34 +41,33 @@ private slots:
     void onBandwidthUpdated(uint64_t bits_per_second); // 保留但逻辑上不再核心
     void processVideoPacket(const QByteArray& packet);
     void processAudioPacket(const QByteArray& packet);
+    // 【新增】端到端时延测量：服务端逐帧时间戳与心跳的时钟样本
+    void processVideoTiming(const QByteArray& packet, qint64 arrivalUs);
+    void onClockSampleReceived(qint64 clientSendMs, qint64 serverUs, qint64 clientRecvMs);
     void sendHeartbeat();
+    // 【新增】把这段时间内数据报的到达时间发回服务端，供其估计带宽
+    void sendTransportFeedback();
 
 signals:
     void connectionSuccess(const QList<QString>& videoList);
     void connectionFailed(const QString& reason);
     void playInfoReceived(double duration);
     void latencyUpdated(double latencyMs);
+    void videoRefreshModeReceived(bool intraRefresh);
 
 private:
     QuicClient* m_quicClient;
     QThread* m_quicThread;
     QTimer* m_heartbeatTimer;
+    QTimer* m_feedbackTimer;
 
     NetworkMonitor& m_monitor;
     JitterBuffer& m_videoJitterBuffer;
     JitterBuffer& m_audioJitterBuffer;
+    LatencyTracker& m_latencyTracker; // 【新增】
 
     bool m_isConnected;
 
-    // 【新增】用于网络趋势分析的成员
-    void analyzePacketArrival(int64_t timestamp_ms, int packet_size);
-    NetworkTrend getNetworkTrend();
-
-    struct PacketArrivalInfo {
-        qint64 arrival_time_ms;
-        int64_t media_timestamp_ms;
-        int size;
-    };
-    std::deque<PacketArrivalInfo> m_packet_history;
-    const int HISTORY_SIZE = 100;
+    // 【移除】客户端不再自行判断网络趋势（analyzePacketArrival / getNetworkTrend），
+    // 改为上报逐包到达时间，由服务端的带宽估计器决策
 };
\ No newline at end of file
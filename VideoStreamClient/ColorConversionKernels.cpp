@@ -0,0 +1,277 @@
+﻿#include "ColorConversionKernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define COLOR_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace ColorConversionKernels {
+namespace {
+
+    // BT.601 有限范围系数，输出直接除以 255 归一化
+    constexpr float Y_SCALE = 1.164383f / 255.0f;
+    constexpr float R_FROM_V = 1.596027f / 255.0f;
+    constexpr float G_FROM_U = -0.391762f / 255.0f;
+    constexpr float G_FROM_V = -0.812968f / 255.0f;
+    constexpr float B_FROM_U = 2.017232f / 255.0f;
+
+    // RGB [0,1] → YUV 8 位
+    constexpr float Y_FROM_R = 65.481f, Y_FROM_G = 128.553f, Y_FROM_B = 24.966f;
+    constexpr float U_FROM_R = -37.797f, U_FROM_G = -74.203f, U_FROM_B = 112.0f;
+    constexpr float V_FROM_R = 112.0f, V_FROM_G = -93.786f, V_FROM_B = -18.214f;
+
+    // 一行的转换函数：处理 [begin, end) 列
+    struct PreRow {
+        const uint8_t* y;
+        const uint8_t* u;
+        const uint8_t* v;
+        float* r;
+        float* g;
+        float* b;
+    };
+    struct PostRows {
+        const float* r0; const float* g0; const float* b0; // 偶数行
+        const float* r1; const float* g1; const float* b1; // 奇数行（高度为奇数时与偶数行相同）
+        uint8_t* y0;
+        uint8_t* y1;
+        uint8_t* u;
+        uint8_t* v;
+    };
+    using PreRowFn = void(*)(const PreRow& row, int begin, int end);
+    using PostRowFn = void(*)(const PostRows& rows, int begin, int end, int width, bool write_y1);
+
+    inline float clamp01(float x) {
+        return std::min(1.0f, std::max(0.0f, x));
+    }
+
+    inline uint8_t to_u8(float x) {
+        // 与 SIMD 的 cvtps_epi32 一致：就近舍入到偶数，再饱和
+        const int i = static_cast<int>(std::nearbyint(x));
+        return static_cast<uint8_t>(std::min(255, std::max(0, i)));
+    }
+
+    // ---------------- 标量参考实现 ----------------
+
+    void pre_row_scalar(const PreRow& row, int begin, int end) {
+        for (int x = begin; x < end; ++x) {
+            const float ys = (static_cast<float>(row.y[x]) - 16.0f) * Y_SCALE;
+            const float us = static_cast<float>(row.u[x >> 1]) - 128.0f;
+            const float vs = static_cast<float>(row.v[x >> 1]) - 128.0f;
+            row.r[x] = clamp01(ys + vs * R_FROM_V);
+            row.g[x] = clamp01(ys + us * G_FROM_U + vs * G_FROM_V);
+            row.b[x] = clamp01(ys + us * B_FROM_U);
+        }
+    }
+
+    // begin 为偶数；每次处理两列、两行
+    void post_row_scalar(const PostRows& rows, int begin, int end, int width, bool write_y1) {
+        for (int x = begin; x < end; x += 2) {
+            const int x1 = (x + 1 < width) ? x + 1 : x;
+            float rs = 0.0f, gs = 0.0f, bs = 0.0f;
+            const int xs[2] = { x, x1 };
+            for (int i = 0; i < 2; ++i) {
+                const int xi = xs[i];
+                const float r0 = clamp01(rows.r0[xi]), g0 = clamp01(rows.g0[xi]), b0 = clamp01(rows.b0[xi]);
+                const float r1 = clamp01(rows.r1[xi]), g1 = clamp01(rows.g1[xi]), b1 = clamp01(rows.b1[xi]);
+                if (i == 0 || x + 1 < width) {
+                    rows.y0[xi] = to_u8(r0 * Y_FROM_R + g0 * Y_FROM_G + b0 * Y_FROM_B + 16.0f);
+                    if (write_y1) rows.y1[xi] = to_u8(r1 * Y_FROM_R + g1 * Y_FROM_G + b1 * Y_FROM_B + 16.0f);
+                }
+                rs += r0 + r1; gs += g0 + g1; bs += b0 + b1;
+            }
+            rs *= 0.25f; gs *= 0.25f; bs *= 0.25f;
+            rows.u[x >> 1] = to_u8(rs * U_FROM_R + gs * U_FROM_G + bs * U_FROM_B + 128.0f);
+            rows.v[x >> 1] = to_u8(rs * V_FROM_R + gs * V_FROM_G + bs * V_FROM_B + 128.0f);
+        }
+    }
+
+#if defined(COLOR_X86)
+    // ---------------- SSE4.1：每次 4 个像素 ----------------
+
+    TARGET_SSE41 void pre_row_sse41(const PreRow& row, int begin, int end) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 fzero = _mm_setzero_ps();
+        int x = begin;
+        for (; x + 4 <= end; x += 4) {
+            // begin 为 0 时 x 始终为偶数，两个色度样本各覆盖两列
+            int y4, u2 = 0, v2 = 0;
+            std::memcpy(&y4, row.y + x, 4);
+            std::memcpy(&u2, row.u + (x >> 1), 2);
+            std::memcpy(&v2, row.v + (x >> 1), 2);
+            const __m128 yf = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(y4)));
+            const __m128 uf = _mm_cvtepi32_ps(_mm_shuffle_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(u2)), _MM_SHUFFLE(1, 1, 0, 0)));
+            const __m128 vf = _mm_cvtepi32_ps(_mm_shuffle_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v2)), _MM_SHUFFLE(1, 1, 0, 0)));
+
+            const __m128 ys = _mm_mul_ps(_mm_sub_ps(yf, _mm_set1_ps(16.0f)), _mm_set1_ps(Y_SCALE));
+            const __m128 us = _mm_sub_ps(uf, _mm_set1_ps(128.0f));
+            const __m128 vs = _mm_sub_ps(vf, _mm_set1_ps(128.0f));
+
+            const __m128 r = _mm_add_ps(ys, _mm_mul_ps(vs, _mm_set1_ps(R_FROM_V)));
+            const __m128 g = _mm_add_ps(_mm_add_ps(ys, _mm_mul_ps(us, _mm_set1_ps(G_FROM_U))), _mm_mul_ps(vs, _mm_set1_ps(G_FROM_V)));
+            const __m128 b = _mm_add_ps(ys, _mm_mul_ps(us, _mm_set1_ps(B_FROM_U)));
+
+            _mm_storeu_ps(row.r + x, _mm_min_ps(one, _mm_max_ps(fzero, r)));
+            _mm_storeu_ps(row.g + x, _mm_min_ps(one, _mm_max_ps(fzero, g)));
+            _mm_storeu_ps(row.b + x, _mm_min_ps(one, _mm_max_ps(fzero, b)));
+        }
+        pre_row_scalar(row, x, end);
+    }
+
+    TARGET_SSE41 inline __m128 clamp01_ps(__m128 x) {
+        return _mm_min_ps(_mm_set1_ps(1.0f), _mm_max_ps(_mm_setzero_ps(), x));
+    }
+
+    TARGET_SSE41 inline __m128 luma_ps(__m128 r, __m128 g, __m128 b) {
+        return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(Y_FROM_R)), _mm_mul_ps(g, _mm_set1_ps(Y_FROM_G))),
+            _mm_mul_ps(b, _mm_set1_ps(Y_FROM_B))), _mm_set1_ps(16.0f));
+    }
+
+    // 4 个 int32 饱和打包为 4 个字节
+    TARGET_SSE41 inline int pack4_u8(__m128 x) {
+        const __m128i i32 = _mm_cvtps_epi32(x);
+        const __m128i i16 = _mm_packs_epi32(i32, i32);
+        return _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16));
+    }
+
+    TARGET_SSE41 void post_row_sse41(const PostRows& rows, int begin, int end, int width, bool write_y1) {
+        int x = begin;
+        // 每次 4 列：输出 4 个亮度 ×2 行、2 个色度
+        for (; x + 4 <= end && x + 4 <= width; x += 4) {
+            const __m128 r0 = clamp01_ps(_mm_loadu_ps(rows.r0 + x)), g0 = clamp01_ps(_mm_loadu_ps(rows.g0 + x)), b0 = clamp01_ps(_mm_loadu_ps(rows.b0 + x));
+            const __m128 r1 = clamp01_ps(_mm_loadu_ps(rows.r1 + x)), g1 = clamp01_ps(_mm_loadu_ps(rows.g1 + x)), b1 = clamp01_ps(_mm_loadu_ps(rows.b1 + x));
+
+            const int y0 = pack4_u8(luma_ps(r0, g0, b0));
+            std::memcpy(rows.y0 + x, &y0, 4);
+            if (write_y1) {
+                const int y1 = pack4_u8(luma_ps(r1, g1, b1));
+                std::memcpy(rows.y1 + x, &y1, 4);
+            }
+
+            // 与标量版相同的求和顺序: (p0r0 + p0r1) + (p1r0 + p1r1)
+            const __m128 quarter = _mm_set1_ps(0.25f);
+            const __m128 rs = _mm_mul_ps(_mm_hadd_ps(_mm_add_ps(r0, r1), _mm_setzero_ps()), quarter);
+            const __m128 gs = _mm_mul_ps(_mm_hadd_ps(_mm_add_ps(g0, g1), _mm_setzero_ps()), quarter);
+            const __m128 bs = _mm_mul_ps(_mm_hadd_ps(_mm_add_ps(b0, b1), _mm_setzero_ps()), quarter);
+
+            const __m128 u = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rs, _mm_set1_ps(U_FROM_R)), _mm_mul_ps(gs, _mm_set1_ps(U_FROM_G))),
+                _mm_mul_ps(bs, _mm_set1_ps(U_FROM_B))), _mm_set1_ps(128.0f));
+            const __m128 v = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rs, _mm_set1_ps(V_FROM_R)), _mm_mul_ps(gs, _mm_set1_ps(V_FROM_G))),
+                _mm_mul_ps(bs, _mm_set1_ps(V_FROM_B))), _mm_set1_ps(128.0f));
+            const int u4 = pack4_u8(u);
+            const int v4 = pack4_u8(v);
+            std::memcpy(rows.u + (x >> 1), &u4, 2);
+            std::memcpy(rows.v + (x >> 1), &v4, 2);
+        }
+        post_row_scalar(rows, x, end, width, write_y1);
+    }
+
+    // ---------------- AVX2：预处理每次 8 个像素 ----------------
+
+    TARGET_AVX2 void pre_row_avx2(const PreRow& row, int begin, int end) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 fzero = _mm256_setzero_ps();
+        const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        int x = begin;
+        for (; x + 8 <= end; x += 8) {
+            int u4, v4;
+            std::memcpy(&u4, row.u + (x >> 1), 4);
+            std::memcpy(&v4, row.v + (x >> 1), 4);
+            const __m256 yf = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row.y + x))));
+            const __m256 uf = _mm256_cvtepi32_ps(_mm256_permutevar8x32_epi32(_mm256_cvtepu8_epi32(_mm_cvtsi32_si128(u4)), dup));
+            const __m256 vf = _mm256_cvtepi32_ps(_mm256_permutevar8x32_epi32(_mm256_cvtepu8_epi32(_mm_cvtsi32_si128(v4)), dup));
+
+            const __m256 ys = _mm256_mul_ps(_mm256_sub_ps(yf, _mm256_set1_ps(16.0f)), _mm256_set1_ps(Y_SCALE));
+            const __m256 us = _mm256_sub_ps(uf, _mm256_set1_ps(128.0f));
+            const __m256 vs = _mm256_sub_ps(vf, _mm256_set1_ps(128.0f));
+
+            const __m256 r = _mm256_add_ps(ys, _mm256_mul_ps(vs, _mm256_set1_ps(R_FROM_V)));
+            const __m256 g = _mm256_add_ps(_mm256_add_ps(ys, _mm256_mul_ps(us, _mm256_set1_ps(G_FROM_U))), _mm256_mul_ps(vs, _mm256_set1_ps(G_FROM_V)));
+            const __m256 b = _mm256_add_ps(ys, _mm256_mul_ps(us, _mm256_set1_ps(B_FROM_U)));
+
+            _mm256_storeu_ps(row.r + x, _mm256_min_ps(one, _mm256_max_ps(fzero, r)));
+            _mm256_storeu_ps(row.g + x, _mm256_min_ps(one, _mm256_max_ps(fzero, g)));
+            _mm256_storeu_ps(row.b + x, _mm256_min_ps(one, _mm256_max_ps(fzero, b)));
+        }
+        pre_row_sse41(row, x, end);
+    }
+#endif
+
+    struct KernelTable {
+        const char* name;
+        PreRowFn pre_row;
+        PostRowFn post_row;
+    };
+
+    const KernelTable& table() {
+        static const KernelTable selected = [] {
+#if defined(COLOR_X86)
+            const CpuFeatures& cpu = CpuFeatures::get();
+            // 后处理受限于水平配对与字节打包，AVX2 收益不大，沿用 SSE4.1
+            if (cpu.avx2 && cpu.sse41) return KernelTable{ "AVX2", &pre_row_avx2, &post_row_sse41 };
+            if (cpu.sse41) return KernelTable{ "SSE4.1", &pre_row_sse41, &post_row_sse41 };
+#endif
+            return KernelTable{ "Scalar", &pre_row_scalar, &post_row_scalar };
+        }();
+        return selected;
+    }
+}
+
+void yuv420p_to_rgb_planar(const YuvPlanes& src, int width, int height,
+    float* dst, int tensor_width, int tensor_height)
+{
+    const KernelTable& k = table();
+    const size_t plane = static_cast<size_t>(tensor_width) * tensor_height;
+    const int w = std::min(width, tensor_width);
+    const int h = std::min(height, tensor_height);
+    for (int y = 0; y < h; ++y) {
+        const size_t offset = static_cast<size_t>(y) * tensor_width;
+        PreRow row{
+            src.data[0] + static_cast<ptrdiff_t>(y) * src.stride[0],
+            src.data[1] + static_cast<ptrdiff_t>(y >> 1) * src.stride[1],
+            src.data[2] + static_cast<ptrdiff_t>(y >> 1) * src.stride[2],
+            dst + offset, dst + plane + offset, dst + 2 * plane + offset };
+        k.pre_row(row, 0, w);
+    }
+}
+
+void rgb_planar_to_yuv420p(const float* src, int tensor_width, int tensor_height,
+    const YuvPlanes& dst, int width, int height)
+{
+    const KernelTable& k = table();
+    const size_t plane = static_cast<size_t>(tensor_width) * tensor_height;
+    const int w = std::min(width, tensor_width);
+    const int h = std::min(height, tensor_height);
+    for (int y = 0; y < h; y += 2) {
+        const int y1 = (y + 1 < h) ? y + 1 : y;
+        const float* r = src;
+        const float* g = src + plane;
+        const float* b = src + 2 * plane;
+        PostRows rows{
+            r + static_cast<size_t>(y) * tensor_width, g + static_cast<size_t>(y) * tensor_width, b + static_cast<size_t>(y) * tensor_width,
+            r + static_cast<size_t>(y1) * tensor_width, g + static_cast<size_t>(y1) * tensor_width, b + static_cast<size_t>(y1) * tensor_width,
+            dst.data[0] + static_cast<ptrdiff_t>(y) * dst.stride[0],
+            dst.data[0] + static_cast<ptrdiff_t>(y1) * dst.stride[0],
+            dst.data[1] + static_cast<ptrdiff_t>(y >> 1) * dst.stride[1],
+            dst.data[2] + static_cast<ptrdiff_t>(y >> 1) * dst.stride[2] };
+        k.post_row(rows, 0, w, w, y1 != y);
+    }
+}
+
+const char* active_isa_name()
+{
+    return table().name;
+}
+
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// YUV420P 与模型输入/输出张量（平面 RGB float，取值 [0,1]）之间的融合转换内核。
+// 一次遍历完成色彩空间转换、归一化与平面拆分，张量宽高可以大于图像（右侧和下方为填充区，不写入）。
+// 色彩矩阵为 BT.601 有限范围，与 swscale 的默认行为一致；色度按最近邻上采样，回写时按 2x2 平均。
+namespace ColorConversionKernels {
+
+    struct YuvPlanes {
+        uint8_t* data[3];
+        int stride[3];
+    };
+
+    // YUV420P → 平面 RGB float
+    // dst 依次为 R/G/B 三个平面，每个平面 tensor_width * tensor_height 个元素
+    void yuv420p_to_rgb_planar(const YuvPlanes& src, int width, int height,
+        float* dst, int tensor_width, int tensor_height);
+
+    // 平面 RGB float → YUV420P，只读取张量左上角 width x height 的区域，超出 [0,1] 的值先截断
+    void rgb_planar_to_yuv420p(const float* src, int tensor_width, int tensor_height,
+        const YuvPlanes& dst, int width, int height);
+
+    const char* active_isa_name();
+}
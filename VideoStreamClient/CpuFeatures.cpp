@@ -0,0 +1,72 @@
+﻿#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CPU_FEATURES_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+#if defined(CPU_FEATURES_X86)
+    void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, leaf, subleaf);
+        for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned int>(r[i]);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+    }
+#endif
+
+    CpuFeatures detect() {
+        CpuFeatures f;
+#if defined(CPU_FEATURES_X86)
+        unsigned int regs[4] = {};
+        cpuid(0, 0, regs);
+        const unsigned int max_leaf = regs[0];
+        if (max_leaf < 1) return f;
+
+        cpuid(1, 0, regs);
+        const unsigned int ecx1 = regs[2];
+        f.sse41 = (ecx1 & (1u << 19)) != 0;
+
+        // AVX 系列还需要操作系统保存 YMM 状态 (OSXSAVE 且 XCR0 的 bit1/bit2 置位)
+        const bool osxsave = (ecx1 & (1u << 27)) != 0;
+        const bool avx = (ecx1 & (1u << 28)) != 0;
+        const bool ymm_enabled = osxsave && (xgetbv0() & 0x6) == 0x6;
+        if (avx && ymm_enabled) {
+            f.f16c = (ecx1 & (1u << 29)) != 0;
+            f.fma = (ecx1 & (1u << 12)) != 0;
+            if (max_leaf >= 7) {
+                cpuid(7, 0, regs);
+                f.avx2 = (regs[1] & (1u << 5)) != 0;
+            }
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+        // AArch64 上 NEON 是基础指令集
+        f.neon = true;
+#endif
+        return f;
+    }
+}
+
+const CpuFeatures& CpuFeatures::get()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
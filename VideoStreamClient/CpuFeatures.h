@@ -0,0 +1,13 @@
+﻿#pragma once
+
+// 运行时 CPU 特性检测，供 SIMD 内核在启动时选择实现
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+    bool f16c = false;
+    bool fma = false;
+    bool neon = false;
+
+    // 首次调用时检测，之后返回缓存结果
+    static const CpuFeatures& get();
+};
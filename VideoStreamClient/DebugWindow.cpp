@@ -1,18 +1,26 @@
 ﻿#include "DebugWindow.h"
 #include "ChartWidget.h"
 #include <QtWidgets/QVBoxLayout>
+#include <QtWidgets/QLabel>
 #include <QtWidgets/QWidget>
 
 DebugWindow::DebugWindow(QWidget* parent)
     : QMainWindow(parent)
 {
     setWindowTitle("高级调试 - 实时图表");
-    setGeometry(150, 150, 800, 700);
+    setGeometry(150, 150, 800, 900);
 
-    // 创建三个图表实例
+    // 创建图表实例
     m_bitrateChart = new ChartWidget("码率 (kbps)", "kbps", this);
     m_fpsChart = new ChartWidget("帧率 (FPS)", "FPS", this);
     m_latencyChart = new ChartWidget("时延 (ms)", "ms", this);
+    m_presentErrorChart = new ChartWidget("帧显示时刻误差 (ms)", "ms", this);
+    m_presentationLabel = new QLabel("呈现统计: N/A", this);
+    m_framePoolLabel = new QLabel("帧池: N/A", this);
+    m_interpolationLabel = new QLabel("RIFE 插帧: 关闭", this);
+    m_enhancementLabel = new QLabel("增强档位: 未启用", this);
+    m_audioLabel = new QLabel("音频: N/A", this);
+    m_glassToGlassLabel = new QLabel("端到端时延: N/A", this);
 
     // 设置中心窗口和布局
     QWidget* centralWidget = new QWidget(this);
@@ -20,6 +28,13 @@ DebugWindow::DebugWindow(QWidget* parent)
     layout->addWidget(m_bitrateChart);
     layout->addWidget(m_fpsChart);
     layout->addWidget(m_latencyChart);
+    layout->addWidget(m_presentErrorChart);
+    layout->addWidget(m_presentationLabel);
+    layout->addWidget(m_glassToGlassLabel);
+    layout->addWidget(m_audioLabel);
+    layout->addWidget(m_interpolationLabel);
+    layout->addWidget(m_enhancementLabel);
+    layout->addWidget(m_framePoolLabel);
     setCentralWidget(centralWidget);
 }
 
@@ -27,10 +42,41 @@ DebugWindow::~DebugWindow()
 {
 }
 
-// 实现三个 getter 函数
+// 实现 getter 函数
 ChartWidget* DebugWindow::bitrateChart() const { return m_bitrateChart; }
 ChartWidget* DebugWindow::fpsChart() const { return m_fpsChart; }
 ChartWidget* DebugWindow::latencyChart() const { return m_latencyChart; }
+ChartWidget* DebugWindow::presentErrorChart() const { return m_presentErrorChart; }
+
+void DebugWindow::setPresentationInfo(const QString& text)
+{
+    m_presentationLabel->setText(text);
+}
+
+void DebugWindow::setFramePoolInfo(const QString& text)
+{
+    m_framePoolLabel->setText(text);
+}
+
+void DebugWindow::setInterpolationInfo(const QString& text)
+{
+    m_interpolationLabel->setText(text);
+}
+
+void DebugWindow::setEnhancementInfo(const QString& text)
+{
+    m_enhancementLabel->setText(text);
+}
+
+void DebugWindow::setAudioInfo(const QString& text)
+{
+    m_audioLabel->setText(text);
+}
+
+void DebugWindow::setGlassToGlassInfo(const QString& text)
+{
+    m_glassToGlassLabel->setText(text);
+}
 
 // 当调试窗口关闭时，需要通知主窗口
 void DebugWindow::closeEvent(QCloseEvent* event)
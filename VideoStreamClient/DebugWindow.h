@@ -3,6 +3,7 @@
 #include <QtWidgets/QMainWindow>
 
 class ChartWidget; // 前向声明
+class QLabel;
 
 class DebugWindow : public QMainWindow
 {
@@ -16,6 +17,20 @@ public:
     ChartWidget* bitrateChart() const;
     ChartWidget* fpsChart() const;
     ChartWidget* latencyChart() const;
+    ChartWidget* presentErrorChart() const;
+
+    // 显示呈现调度的统计信息（刷新周期、vsync 误差、丢帧/重复帧）
+    void setPresentationInfo(const QString& text);
+    // 显示帧池各规格的使用峰值
+    void setFramePoolInfo(const QString& text);
+    // 显示后台插帧的统计信息
+    void setInterpolationInfo(const QString& text);
+    // 【新增】显示增强档位调节器的当前档位与决策原因
+    void setEnhancementInfo(const QString& text);
+    // 【新增】显示音频播放调度的缓冲水位、丢包隐藏与时间伸缩
+    void setAudioInfo(const QString& text);
+    // 【新增】显示端到端时延（采集到呈现）及各阶段的平均耗时
+    void setGlassToGlassInfo(const QString& text);
 
 protected:
     void closeEvent(QCloseEvent* event) override;
@@ -24,4 +39,11 @@ private:
     ChartWidget* m_bitrateChart;
     ChartWidget* m_fpsChart;
     ChartWidget* m_latencyChart;
+    ChartWidget* m_presentErrorChart;
+    QLabel* m_presentationLabel;
+    QLabel* m_framePoolLabel;
+    QLabel* m_interpolationLabel;
+    QLabel* m_enhancementLabel;
+    QLabel* m_audioLabel;
+    QLabel* m_glassToGlassLabel;
 };
\ No newline at end of file
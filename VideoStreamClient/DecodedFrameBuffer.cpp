@@ -1,5 +1,8 @@
 ﻿#include "DecodedFrameBuffer.h"
+#include "FramePool.h"
+#include "InterpolationKernels.h"
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 extern "C" {
@@ -8,14 +11,28 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
-DecodedFrame::DecodedFrame(AVFrame* fr)
-    : frame(fr, [](AVFrame* f) { av_frame_free(&f); })
+DecodedFrame::DecodedFrame(AVFrame* fr, bool is_interpolated)
+    : frame(fr, [](AVFrame* f) { av_frame_free(&f); }), interpolated(is_interpolated)
 {
 }
 
 DecodedFrame::~DecodedFrame() = default;
 
-DecodedFrameBuffer::DecodedFrameBuffer() : buffer_size_ms_(200)
+namespace {
+    // 环形缓冲区的槽位数，足以容纳 240fps 下约 2 秒的帧
+    constexpr size_t RING_CAPACITY = 512;
+    // 缓冲区保留的最大时间跨度 = buffer_size_ms_ * 该系数（且不少于 MIN_SPAN_MS）
+    constexpr int64_t SPAN_LIMIT_FACTOR = 4;
+    constexpr int64_t MIN_SPAN_MS = 500;
+    // 默认内存上限
+    constexpr size_t DEFAULT_MEMORY_LIMIT_BYTES = 512ull * 1024 * 1024;
+    // 相邻两帧间隔超过该值（卡顿、跳转）时不做混合，避免长时间的重影
+    constexpr int64_t MAX_BLEND_GAP_MS = 100;
+}
+
+DecodedFrameBuffer::DecodedFrameBuffer()
+    : ring_(RING_CAPACITY), head_(0), count_(0), buffer_size_ms_(200), dropped_frames_(0),
+    memory_bytes_(0), memory_limit_bytes_(DEFAULT_MEMORY_LIMIT_BYTES)
 {
     reset();
 }
@@ -25,154 +42,261 @@ DecodedFrameBuffer::~DecodedFrameBuffer() = default;
 void DecodedFrameBuffer::reset()
 {
     std::lock_guard<std::mutex> lock(mtx_);
-    queue_.clear();
+    pop_front(count_, false);
+    head_ = 0;
+    memory_bytes_ = 0;
     last_played_pts_ = -1;
+    last_played_.reset();
+    dropped_frames_ = 0;
+}
+
+std::unique_ptr<DecodedFrame>& DecodedFrameBuffer::slot(size_t index)
+{
+    return ring_[(head_ + index) % ring_.size()];
+}
+
+const std::unique_ptr<DecodedFrame>& DecodedFrameBuffer::slot(size_t index) const
+{
+    return ring_[(head_ + index) % ring_.size()];
+}
+
+size_t DecodedFrameBuffer::lower_bound_pts(int64_t pts) const
+{
+    size_t lo = 0, hi = count_;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (slot(mid)->frame->pts < pts) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void DecodedFrameBuffer::insert_at(size_t index, std::unique_ptr<DecodedFrame> frame)
+{
+    // 调用方保证 count_ < ring_.size()
+    memory_bytes_ += frame_bytes(frame->frame.get());
+    count_++;
+    // 乱序插入时把 index 之后的元素整体后移一位（仅在少见的乱序情况下发生）
+    for (size_t i = count_ - 1; i > index; --i) {
+        slot(i) = std::move(slot(i - 1));
+    }
+    slot(index) = std::move(frame);
+}
+
+void DecodedFrameBuffer::pop_front(size_t n, bool count_as_dropped)
+{
+    for (size_t i = 0; i < n && count_ > 0; ++i) {
+        auto& front = ring_[head_];
+        // 插帧结果被跳过不算丢帧，只统计解码得到的原始帧
+        if (count_as_dropped && front && !front->interpolated) dropped_frames_++;
+        if (front) {
+            memory_bytes_ -= std::min(memory_bytes_, frame_bytes(front->frame.get()));
+            front.reset(); // 缓冲区归还帧池
+        }
+        head_ = (head_ + 1) % ring_.size();
+        count_--;
+    }
+}
+
+void DecodedFrameBuffer::enforce_limits()
+{
+    const int64_t span_limit = std::max<int64_t>(MIN_SPAN_MS, static_cast<int64_t>(buffer_size_ms_) * SPAN_LIMIT_FACTOR);
+    while (count_ > 1) {
+        const int64_t span = slot(count_ - 1)->frame->pts - slot(0)->frame->pts;
+        if (span <= span_limit && memory_bytes_ <= memory_limit_bytes_) break;
+        pop_front(1, true);
+    }
+}
+
+size_t DecodedFrameBuffer::frame_bytes(const AVFrame* frame)
+{
+    int size = av_image_get_buffer_size(static_cast<AVPixelFormat>(frame->format), frame->width, frame->height, 1);
+    return size > 0 ? static_cast<size_t>(size) : 0;
 }
 
 void DecodedFrameBuffer::add_frame(std::unique_ptr<DecodedFrame> frame)
 {
     if (!frame || !frame->frame) return;
     std::lock_guard<std::mutex> lock(mtx_);
-    queue_.push_back(std::move(frame));
-    std::sort(queue_.begin(), queue_.end(), [](const auto& a, const auto& b) {
-        return a->frame->pts < b->frame->pts;
-        });
+
+    const int64_t pts = frame->frame->pts;
+    // 早于已显示位置的帧不会再被显示
+    if (last_played_pts_ >= 0 && pts <= last_played_pts_) {
+        if (!frame->interpolated) dropped_frames_++;
+        return;
+    }
+
+    if (count_ == ring_.size()) {
+        pop_front(1, true);
+    }
+
+    // 常见情况：按序到达，直接追加到尾部
+    if (count_ == 0 || slot(count_ - 1)->frame->pts <= pts) {
+        insert_at(count_, std::move(frame));
+    }
+    else {
+        insert_at(lower_bound_pts(pts), std::move(frame));
+    }
+
+    enforce_limits();
 }
 
 void DecodedFrameBuffer::set_buffer_duration(int ms)
 {
     std::lock_guard<std::mutex> lock(mtx_);
     buffer_size_ms_ = ms;
+    enforce_limits();
 }
 
-// 【重要修改】恢复为一个简单、正确的实现
+void DecodedFrameBuffer::set_memory_limit(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    memory_limit_bytes_ = bytes;
+    enforce_limits();
+}
+
+// 【重要修改】二分查找最后一个 pts <= target 的帧，并丢弃其之前的所有帧
 std::unique_ptr<DecodedFrame> DecodedFrameBuffer::get_frame(int64_t target_pts_ms)
 {
     std::lock_guard<std::mutex> lock(mtx_);
-    if (queue_.empty()) {
+    if (count_ == 0) {
         return nullptr;
     }
 
-    auto best_frame_it = queue_.end();
-    for (auto it = queue_.begin(); it != queue_.end(); ++it) {
-        if ((*it)->frame->pts <= target_pts_ms) {
-            best_frame_it = it;
-        }
-        else {
-            break;
-        }
-    }
-
-    if (best_frame_it == queue_.end()) {
+    // 第一个 pts > target 的位置，其前一个即为最佳帧
+    size_t upper = lower_bound_pts(target_pts_ms + 1);
+    if (upper == 0) {
         return nullptr;
     }
+    const size_t best = upper - 1;
 
-    last_played_pts_ = (*best_frame_it)->frame->pts;
-    auto best_frame = std::move(*best_frame_it);
+    // 比选中帧更早的帧将被清理而从未显示，计为丢帧
+    pop_front(best, true);
 
-    // 清理所有比刚取出的帧更旧的帧（包括它自己，因为它已经被 move 了）
-    auto new_end_it = std::remove_if(queue_.begin(), queue_.end(),
-        [this](const auto& frm) {
-            return !frm || frm->frame->pts <= this->last_played_pts_;
-        });
-    queue_.erase(new_end_it, queue_.end());
+    auto best_frame = std::move(ring_[head_]);
+    memory_bytes_ -= std::min(memory_bytes_, frame_bytes(best_frame->frame.get()));
+    head_ = (head_ + 1) % ring_.size();
+    count_--;
 
+    last_played_pts_ = best_frame->frame->pts;
+    // 【新增】保留一份引用，下一帧到来之前的 vsync 用它与下一帧混合
+    AVFrame* played_ref = av_frame_clone(best_frame->frame.get());
+    if (played_ref) {
+        last_played_ = std::make_unique<DecodedFrame>(played_ref, best_frame->interpolated);
+    }
+    else {
+        last_played_.reset();
+    }
     return best_frame;
 }
 
 std::unique_ptr<DecodedFrame> DecodedFrameBuffer::get_interpolated_frame(int64_t target_pts_ms)
 {
-    const AVFrame* prev_frame = nullptr;
-    const AVFrame* next_frame = nullptr;
+    AVFrame* prev_frame = nullptr;
+    AVFrame* next_frame = nullptr;
     double factor = 0.0;
 
-    get_interpolation_frames(target_pts_ms, prev_frame, next_frame, factor);
-
-    if (!prev_frame || !next_frame) {
+    if (!get_interpolation_frames(target_pts_ms, prev_frame, next_frame, factor)) {
         return nullptr;
     }
 
     AVFrame* interpolated_frame_raw = interpolate(prev_frame, next_frame, factor);
+    av_frame_free(&prev_frame);
+    av_frame_free(&next_frame);
     if (!interpolated_frame_raw) return nullptr;
 
-    auto interpolated_frame_wrapper = std::make_unique<DecodedFrame>(interpolated_frame_raw);
+    auto interpolated_frame_wrapper = std::make_unique<DecodedFrame>(interpolated_frame_raw, true);
     interpolated_frame_wrapper->frame->pts = target_pts_ms;
     return interpolated_frame_wrapper;
 }
 
-void DecodedFrameBuffer::get_interpolation_frames(int64_t target_pts_ms, const AVFrame*& out_prev, const AVFrame*& out_next, double& out_factor)
+bool DecodedFrameBuffer::get_interpolation_frames(int64_t target_pts_ms, AVFrame*& out_prev, AVFrame*& out_next, double& out_factor)
 {
     std::lock_guard<std::mutex> lock(mtx_);
     out_prev = nullptr;
     out_next = nullptr;
     out_factor = 0.0;
 
-    if (queue_.size() < 2) return;
+    if (count_ == 0) return false;
 
-    auto it = queue_.begin();
-    while (it != queue_.end() && (*it)->frame->pts < target_pts_ms) {
-        ++it;
-    }
+    // 第一个 pts >= target 的帧作为 next
+    size_t next_index = lower_bound_pts(target_pts_ms);
+    if (next_index == count_) return false;
 
-    if (it == queue_.begin() || it == queue_.end()) return;
+    // 【修改】渲染路径上 target 之前的帧已被 get_frame 取走，prev 即为最近一次显示的帧
+    const DecodedFrame* next_wrapper = slot(next_index).get();
+    const DecodedFrame* prev_wrapper = next_index > 0 ? slot(next_index - 1).get() : last_played_.get();
+    if (!prev_wrapper) return false;
+    // 【新增】任一端是插帧线程生成的中间帧，说明这段区间已由 RIFE 覆盖，不再叠加混合
+    if (prev_wrapper->interpolated || next_wrapper->interpolated) return false;
+    const AVFrame* next = next_wrapper->frame.get();
+    const AVFrame* prev = prev_wrapper->frame.get();
+    if (next->pts <= prev->pts || next->pts - prev->pts > MAX_BLEND_GAP_MS) return false;
 
-    out_next = (*it)->frame.get();
-    out_prev = (*(it - 1))->frame.get();
+    double factor_calc = static_cast<double>(target_pts_ms - prev->pts) / static_cast<double>(next->pts - prev->pts);
+    // 权重为 0 的结果就是 prev 本身，无需混合
+    if (factor_calc * 256.0 < 1.0 || factor_calc > 1.0) {
+        return false;
+    }
 
-    double factor_calc = static_cast<double>(target_pts_ms - out_prev->pts) / static_cast<double>(out_next->pts - out_prev->pts);
-    if (factor_calc < 0.0 || factor_calc > 1.0) {
-        out_prev = nullptr;
-        out_next = nullptr;
-        return;
+    out_prev = av_frame_clone(prev);
+    out_next = av_frame_clone(next);
+    if (!out_prev || !out_next) {
+        av_frame_free(&out_prev);
+        av_frame_free(&out_next);
+        return false;
     }
     out_factor = factor_calc;
+    return true;
+}
+
+bool DecodedFrameBuffer::get_interpolation_pair(int64_t from_pts_ms, AVFrame*& out_prev, AVFrame*& out_next)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    out_prev = nullptr;
+    out_next = nullptr;
+
+    // 只有紧邻的两个原始帧才是待处理的一对；中间已有插帧结果说明处理过了
+    for (size_t i = lower_bound_pts(from_pts_ms); i + 1 < count_; ++i) {
+        const auto& prev = slot(i);
+        const auto& next = slot(i + 1);
+        if (prev->interpolated || next->interpolated) continue;
+        if (next->frame->pts - prev->frame->pts < 2) continue;
+
+        out_prev = av_frame_clone(prev->frame.get());
+        out_next = av_frame_clone(next->frame.get());
+        if (!out_prev || !out_next) {
+            av_frame_free(&out_prev);
+            av_frame_free(&out_next);
+            return false;
+        }
+        return true;
+    }
+    return false;
 }
 
 AVFrame* DecodedFrameBuffer::interpolate(const AVFrame* prev, const AVFrame* next, double factor) {
     if (prev->format != AV_PIX_FMT_YUV420P || next->format != AV_PIX_FMT_YUV420P) {
         return nullptr;
     }
-    AVFrame* interpolated_frame = av_frame_alloc();
-    if (!interpolated_frame) return nullptr;
-    interpolated_frame->width = prev->width;
-    interpolated_frame->height = prev->height;
-    interpolated_frame->format = AV_PIX_FMT_YUV420P;
-    if (av_frame_get_buffer(interpolated_frame, 32) < 0) {
-        av_frame_free(&interpolated_frame);
+    if (prev->width != next->width || prev->height != next->height) {
         return nullptr;
     }
-    for (int y = 1; y < prev->height - 1; ++y) {
-        for (int x = 1; x < prev->width - 1; ++x) {
-            int gx_prev = std::abs(prev->data[0][y * prev->linesize[0] + x + 1] - prev->data[0][y * prev->linesize[0] + x - 1]);
-            int gy_prev = std::abs(prev->data[0][(y + 1) * prev->linesize[0] + x] - prev->data[0][(y - 1) * prev->linesize[0] + x]);
-            int gx_next = std::abs(next->data[0][y * next->linesize[0] + x + 1] - next->data[0][y * next->linesize[0] + x - 1]);
-            int gy_next = std::abs(next->data[0][(y + 1) * next->linesize[0] + x] - next->data[0][(y - 1) * next->linesize[0] + x]);
-            int gradient_prev = std::max(gx_prev, gy_prev);
-            int gradient_next = std::max(gx_next, gy_next);
-            int prev_value = prev->data[0][y * prev->linesize[0] + x];
-            int next_value = next->data[0][y * next->linesize[0] + x];
-            if (gradient_prev > 20 || gradient_next > 20) {
-                double edge_factor = factor * 0.7;
-                interpolated_frame->data[0][y * interpolated_frame->linesize[0] + x] = static_cast<uint8_t>(prev_value + edge_factor * (next_value - prev_value));
-            }
-            else {
-                interpolated_frame->data[0][y * interpolated_frame->linesize[0] + x] = static_cast<uint8_t>(prev_value + factor * (next_value - prev_value));
-            }
-        }
-    }
-    for (int y = 0; y < prev->height / 2; ++y) {
-        for (int x = 0; x < prev->width / 2; ++x) {
-            int prev_value = prev->data[1][y * prev->linesize[1] + x];
-            int next_value = next->data[1][y * next->linesize[1] + x];
-            interpolated_frame->data[1][y * interpolated_frame->linesize[1] + x] = static_cast<uint8_t>(prev_value + factor * (next_value - prev_value));
-        }
-    }
-    for (int y = 0; y < prev->height / 2; ++y) {
-        for (int x = 0; x < prev->width / 2; ++x) {
-            int prev_value = prev->data[2][y * prev->linesize[2] + x];
-            int next_value = next->data[2][y * next->linesize[2] + x];
-            interpolated_frame->data[2][y * interpolated_frame->linesize[2] + x] = static_cast<uint8_t>(prev_value + factor * (next_value - prev_value));
-        }
+    AVFrame* interpolated_frame = FramePool::instance().acquire(prev->width, prev->height, AV_PIX_FMT_YUV420P);
+    if (!interpolated_frame) return nullptr;
+
+    // 【修改】定点 Q8 权重 + SIMD 内核（运行时按 CPU 特性选择），边缘处仍使用 0.7 倍的权重
+    const int weight_q8 = static_cast<int>(std::lround(factor * 256.0));
+    const int edge_weight_q8 = static_cast<int>(std::lround(factor * 0.7 * 256.0));
+
+    InterpolationKernels::Plane luma{ prev->data[0], prev->linesize[0], next->data[0], next->linesize[0],
+        interpolated_frame->data[0], interpolated_frame->linesize[0], prev->width, prev->height };
+    InterpolationKernels::blend_luma(luma, weight_q8, edge_weight_q8);
+
+    for (int i = 1; i <= 2; ++i) {
+        InterpolationKernels::Plane chroma{ prev->data[i], prev->linesize[i], next->data[i], next->linesize[i],
+            interpolated_frame->data[i], interpolated_frame->linesize[i], prev->width / 2, prev->height / 2 };
+        InterpolationKernels::blend_plane(chroma, weight_q8);
     }
     return interpolated_frame;
 }
@@ -184,9 +308,17 @@ AVFrame* DecodedFrameBuffer::mat_to_avframe(const cv::Mat& mat, int width, int h
 int64_t DecodedFrameBuffer::get_current_duration_ms() const
 {
     std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mtx_));
-    if (queue_.size() < 2) {
+    if (count_ < 2) {
         return 0;
     }
     // 返回最后一帧和第一帧的时间戳之差
-    return queue_.back()->frame->pts - queue_.front()->frame->pts;
+    return slot(count_ - 1)->frame->pts - slot(0)->frame->pts;
+}
+
+int DecodedFrameBuffer::take_dropped_count()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    int count = dropped_frames_;
+    dropped_frames_ = 0;
+    return count;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
-#include <deque>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -16,8 +17,10 @@ class DecodedFrame {
 public:
     // 使用自定义删除器的unique_ptr来管理AVFrame
     std::unique_ptr<AVFrame, void(*)(AVFrame*)> frame;
+    // 【新增】是否为插帧线程生成的中间帧（而非解码得到的原始帧）
+    bool interpolated;
 
-    explicit DecodedFrame(AVFrame* fr);
+    explicit DecodedFrame(AVFrame* fr, bool is_interpolated = false);
     ~DecodedFrame();
 
     // 禁用拷贝构造和拷贝赋值
@@ -25,6 +28,10 @@ public:
     DecodedFrame& operator=(const DecodedFrame&) = delete;
 };
 
+// 按 PTS 有序的有界环形缓冲区
+// - 顺序到达的帧 O(1) 追加，乱序帧二分定位后插入
+// - get_frame / get_interpolation_frames 使用二分查找
+// - 超出时长跨度（buffer_size_ms_ 的倍数）或内存上限时淘汰最旧的帧，被淘汰/跳过的帧释放后缓冲区归还 FramePool
 class DecodedFrameBuffer
 {
 public:
@@ -34,14 +41,28 @@ public:
     void reset();
     void add_frame(std::unique_ptr<DecodedFrame> frame);
     std::unique_ptr<DecodedFrame> get_frame(int64_t target_pts_ms);
+    // 【修改】target 落在上一次 get_frame 返回的帧与下一帧之间时，返回两者的线性混合（pts = target）
     std::unique_ptr<DecodedFrame> get_interpolated_frame(int64_t target_pts_ms);
     void set_buffer_duration(int ms);
 
     // 【新增】获取当前缓冲区内帧的时间跨度
     int64_t get_current_duration_ms() const;
 
-    // 必须公开，以便渲染逻辑调用
-    void get_interpolation_frames(int64_t target_pts_ms, const AVFrame*& out_prev, const AVFrame*& out_next, double& out_factor);
+    // 【新增】取出自上次调用以来未被显示就被跳过的帧数
+    int take_dropped_count();
+
+    // 【新增】缓冲区可占用的最大内存（字节）
+    void set_memory_limit(size_t bytes);
+
+    // 【修改】返回的 out_prev / out_next 是在锁内 av_frame_clone 得到的新引用，调用方负责 av_frame_free，
+    // 这样缓冲区随后淘汰或回收这些帧也不会影响调用方。
+    // target 之前的帧已被 get_frame 取走时，以最近一次显示的帧作为 out_prev；
+    // 【修改】任一端为插帧线程生成的中间帧时返回 false（该区间已有 RIFE 结果）
+    bool get_interpolation_frames(int64_t target_pts_ms, AVFrame*& out_prev, AVFrame*& out_next, double& out_factor);
+
+    // 【新增】供插帧线程使用：找出 pts >= from_pts 的第一对相邻原始帧（两者之间还没有插帧结果），
+    // 同样返回新引用
+    bool get_interpolation_pair(int64_t from_pts_ms, AVFrame*& out_prev, AVFrame*& out_next);
 
 private:
     // 辅助函数
@@ -49,9 +70,24 @@ private:
     bool avframe_to_mat_gray(const AVFrame* av_frame, cv::Mat& out_mat);
     AVFrame* mat_to_avframe(const cv::Mat& mat, int width, int height);
 
-    std::deque<std::unique_ptr<DecodedFrame>> queue_;
+    // 环形存储的辅助函数（调用方需持有 mtx_）
+    std::unique_ptr<DecodedFrame>& slot(size_t index);
+    const std::unique_ptr<DecodedFrame>& slot(size_t index) const;
+    size_t lower_bound_pts(int64_t pts) const; // 第一个 pts >= 给定值的逻辑下标
+    void insert_at(size_t index, std::unique_ptr<DecodedFrame> frame);
+    void pop_front(size_t n, bool count_as_dropped);
+    void enforce_limits();
+    static size_t frame_bytes(const AVFrame* frame);
+
+    std::vector<std::unique_ptr<DecodedFrame>> ring_;
+    size_t head_;  // 最旧帧所在槽位
+    size_t count_; // 当前帧数
     mutable std::mutex mtx_; // 【修改】设为 mutable 以便在 const 函数中加锁
     int64_t last_played_pts_;
+    std::unique_ptr<DecodedFrame> last_played_; // 【新增】最近一次 get_frame 返回的帧（新引用），供混合使用
     int buffer_size_ms_; // 缓冲时长（毫秒）
+    int dropped_frames_; // get_frame 跳过的旧帧数
+    size_t memory_bytes_;       // 当前缓冲帧占用的内存
+    size_t memory_limit_bytes_; // 内存上限
 };
 
@@ -0,0 +1,129 @@
+﻿#include "EnhancementGovernor.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // 压力超过该值计为过载周期；超过 SEVERE 时立即降档
+    constexpr double OVERLOAD_PRESSURE = 1.0;
+    constexpr double SEVERE_PRESSURE = 2.0;
+    // 压力低于该值计为空闲周期。Reduced 档只有约一半的推理量，升回 Full 后压力大约翻倍，所以阈值取 0.45
+    constexpr double HEADROOM_PRESSURE = 0.45;
+    constexpr int OVERLOAD_WINDOWS = 2;
+    // 升档等待时间：初始 5 个周期，升档失败后加倍，最多 60 个周期
+    constexpr int BASE_UP_HOLD_WINDOWS = 5;
+    constexpr int MAX_UP_HOLD_WINDOWS = 60;
+    // 升档后在该周期数内又降档视为升档失败
+    constexpr int PROBE_WINDOWS = 5;
+    // 插帧超时跳过的比例达到该值时压力记为 1.0
+    constexpr double INTERP_DROP_RATIO_LIMIT = 0.2;
+}
+
+EnhancementGovernor::EnhancementGovernor()
+{
+    reset();
+}
+
+void EnhancementGovernor::reset()
+{
+    level_ = EnhancementLevel::Full;
+    over_windows_ = 0;
+    under_windows_ = 0;
+    up_hold_windows_ = BASE_UP_HOLD_WINDOWS;
+    since_step_up_ = -1;
+    last_ = EnhancementDecision();
+    last_.reason = "初始";
+}
+
+const char* EnhancementGovernor::level_name(EnhancementLevel level)
+{
+    switch (level) {
+    case EnhancementLevel::Full: return "完整";
+    case EnhancementLevel::Reduced: return "降级";
+    case EnhancementLevel::Off: return "关闭";
+    }
+    return "未知";
+}
+
+void EnhancementGovernor::step_to(EnhancementLevel level, bool down)
+{
+    if (down && since_step_up_ >= 0 && since_step_up_ < PROBE_WINDOWS) {
+        up_hold_windows_ = std::min(up_hold_windows_ * 2, MAX_UP_HOLD_WINDOWS);
+    }
+    since_step_up_ = down ? -1 : 0;
+    level_ = level;
+    over_windows_ = 0;
+    under_windows_ = 0;
+}
+
+EnhancementDecision EnhancementGovernor::update(const EnhancementLoad& load)
+{
+    // 各项压力取最大值：超分与源帧间隔比较，插帧与帧对间隔比较，并参考插帧超时跳过的比例
+    char buf[128];
+    double pressure = 0.0;
+    std::string source = "空闲";
+    if (load.upscale_frames > 0 && load.frame_budget_ms > 0.0) {
+        const double p = load.upscale_avg_ms / load.frame_budget_ms;
+        if (p > pressure) {
+            pressure = p;
+            std::snprintf(buf, sizeof(buf), "超分 %.1f/%.1f ms", load.upscale_avg_ms, load.frame_budget_ms);
+            source = buf;
+        }
+    }
+    if (load.interp_avg_ms > 0.0 && load.interp_budget_ms > 0.0) {
+        const double p = load.interp_avg_ms / load.interp_budget_ms;
+        if (p > pressure) {
+            pressure = p;
+            std::snprintf(buf, sizeof(buf), "插帧 %.1f/%.1f ms", load.interp_avg_ms, load.interp_budget_ms);
+            source = buf;
+        }
+    }
+    const int interp_total = load.interp_generated + load.interp_dropped;
+    if (interp_total > 0) {
+        const double ratio = static_cast<double>(load.interp_dropped) / interp_total;
+        const double p = ratio / INTERP_DROP_RATIO_LIMIT;
+        if (p > pressure) {
+            pressure = p;
+            std::snprintf(buf, sizeof(buf), "插帧超时 %d/%d", load.interp_dropped, interp_total);
+            source = buf;
+        }
+    }
+
+    if (since_step_up_ >= 0 && ++since_step_up_ >= PROBE_WINDOWS) {
+        // 升档后稳定运行了一个观察期，逐步恢复升档的灵敏度
+        since_step_up_ = -1;
+        up_hold_windows_ = std::max(BASE_UP_HOLD_WINDOWS, up_hold_windows_ / 2);
+    }
+
+    if (pressure > OVERLOAD_PRESSURE) {
+        over_windows_++;
+        under_windows_ = 0;
+    }
+    else if (pressure < HEADROOM_PRESSURE) {
+        under_windows_++;
+        over_windows_ = 0;
+    }
+    else {
+        over_windows_ = 0;
+        under_windows_ = 0;
+    }
+
+    EnhancementDecision decision;
+    decision.pressure = pressure;
+    const EnhancementLevel before = level_;
+    if (level_ != EnhancementLevel::Off && (pressure > SEVERE_PRESSURE || over_windows_ >= OVERLOAD_WINDOWS)) {
+        step_to(level_ == EnhancementLevel::Full ? EnhancementLevel::Reduced : EnhancementLevel::Off, true);
+        decision.reason = "过载降档: " + source;
+    }
+    else if (level_ != EnhancementLevel::Full && under_windows_ >= up_hold_windows_) {
+        step_to(level_ == EnhancementLevel::Off ? EnhancementLevel::Reduced : EnhancementLevel::Full, false);
+        std::snprintf(buf, sizeof(buf), "空闲 %d 个周期后升档", up_hold_windows_);
+        decision.reason = buf;
+    }
+    else {
+        decision.reason = last_.reason;
+    }
+    decision.level = level_;
+    decision.changed = (level_ != before);
+    last_ = decision;
+    return decision;
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <string>
+
+// 【新增】AI 增强（FSRCNN 超分 / RIFE 插帧）的档位
+// - Full:    每帧超分、默认块大小；插帧按刷新率选择 2x/4x
+// - Reduced: 超分改用小块并隔帧推理（其余帧只做双三次放大），插帧限制为 2x 且隔一对帧处理
+//            （未处理的帧对由渲染线程线性混合）
+// - Off:     暂停超分与插帧（用户开关保持不变，负载恢复后自动重新开启）
+enum class EnhancementLevel {
+    Full = 0,
+    Reduced = 1,
+    Off = 2
+};
+
+// 一个统计周期（约 1 秒）内增强相关的负载
+struct EnhancementLoad {
+    double frame_budget_ms = 0.0;   // 超分每帧可用的时间（源帧间隔）
+    int upscale_frames = 0;         // 本周期做过超分的帧数（含只做双三次放大的帧）
+    double upscale_avg_ms = 0.0;    // 超分的平均耗时（按上面的帧数摊薄）
+    double interp_budget_ms = 0.0;  // 每对源帧可用的推理时间（源帧间隔）
+    double interp_avg_ms = 0.0;     // RIFE 每对帧的平均推理耗时，0 表示本周期没有推理
+    int interp_generated = 0;
+    int interp_dropped = 0;         // 因截止时间跳过的中间帧
+};
+
+// 最近一次 update 的结论，供调试窗口显示
+struct EnhancementDecision {
+    EnhancementLevel level = EnhancementLevel::Full;
+    bool changed = false;
+    double pressure = 0.0;  // 负载压力：1.0 表示刚好用满预算
+    std::string reason;
+};
+
+// 【新增】增强档位调节器：每个统计周期根据推理耗时与呈现截止时间的比值计算压力，
+// 连续过载时降档，连续空闲时升档。升档后很快又过载说明上一档撑不住，
+// 之后的升档等待时间加倍，避免在两档之间来回抖动。
+// 非线程安全，只应在 GUI 线程中使用。
+class EnhancementGovernor {
+public:
+    EnhancementGovernor();
+
+    EnhancementDecision update(const EnhancementLoad& load);
+    EnhancementLevel level() const { return level_; }
+    const EnhancementDecision& last_decision() const { return last_; }
+
+    // 新播放或用户切换开关后回到 Full 重新评估
+    void reset();
+
+    static const char* level_name(EnhancementLevel level);
+
+private:
+    void step_to(EnhancementLevel level, bool down);
+
+    EnhancementLevel level_;
+    int over_windows_;      // 连续过载的周期数
+    int under_windows_;     // 连续空闲的周期数
+    int up_hold_windows_;   // 升档前需要的连续空闲周期数
+    int since_step_up_;     // 距上次升档的周期数，-1 表示不在观察期
+    EnhancementDecision last_;
+};
@@ -0,0 +1,272 @@
+﻿#include "EnhancementStage.h"
+#include "DecodedFrameBuffer.h"
+#include "EnhancementGovernor.h"
+#include "FSRCNNUpscaler.h"
+#include "MasterClock.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+    // 各档位下 FSRCNN 的分块大小
+    constexpr int FULL_TILE_SIZE = 256;
+    constexpr int REDUCED_TILE_SIZE = 128;
+    // 队列深度上限的下限，以及源帧间隔未知时使用的默认值
+    constexpr size_t MIN_QUEUE_LIMIT = 2;
+    constexpr size_t DEFAULT_QUEUE_LIMIT = 4;
+    // 截止时间的安全余量（毫秒），覆盖入缓冲区与上传的开销
+    constexpr double DEADLINE_MARGIN_MS = 5.0;
+    constexpr double EMA_ALPHA = 0.2;
+    // 连续这么多帧因截止时间跳过模型后，强制运行一次重新测量耗时；
+    // 否则一次偶发的慢调用会让估计停在高位，模型再也不会运行
+    constexpr int PROBE_AFTER_DEADLINE_SKIPS = 30;
+    constexpr int DEFAULT_BUFFER_DELAY_MS = 100;
+}
+
+EnhancementStage::EnhancementStage(DecodedFrameBuffer& output, MasterClock& clock, FSRCNNUpscaler& upscaler, QObject* parent)
+    : QObject(parent),
+    m_output(output),
+    m_clock(clock),
+    m_upscaler(upscaler),
+    m_running(false),
+    m_enabled(false),
+    m_level(static_cast<int>(EnhancementLevel::Full)),
+    m_bufferDelayMs(DEFAULT_BUFFER_DELAY_MS)
+{
+}
+
+EnhancementStage::~EnhancementStage()
+{
+    stopProcessing();
+}
+
+void EnhancementStage::push(std::unique_ptr<DecodedFrame> frame)
+{
+    if (!frame || !frame->frame) return;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    const int64_t pts = frame->frame->pts;
+    if (m_lastSourcePts >= 0 && pts > m_lastSourcePts) {
+        const double interval = static_cast<double>(pts - m_lastSourcePts);
+        m_frameIntervalEmaMs = (m_frameIntervalEmaMs <= 0.0) ? interval
+            : m_frameIntervalEmaMs + EMA_ALPHA * (interval - m_frameIntervalEmaMs);
+    }
+    m_lastSourcePts = pts;
+
+    // 超分关闭且没有排队的帧时不经过超分线程，保持原有的解码时延
+    if (!m_enabled && m_queue.empty()) {
+        lock.unlock();
+        passThrough(std::move(frame));
+        return;
+    }
+    m_queue.push_back(std::move(frame));
+    const int depth = static_cast<int>(m_queue.size());
+    lock.unlock();
+    m_queueCv.notify_one();
+    std::lock_guard<std::mutex> statsLock(m_statsMutex);
+    m_stats.max_queue_depth = std::max(m_stats.max_queue_depth, depth);
+}
+
+void EnhancementStage::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_queueCv.notify_one();
+}
+
+void EnhancementStage::setLevel(EnhancementLevel level)
+{
+    m_level = static_cast<int>(level);
+}
+
+void EnhancementStage::setBufferDelay(int delay_ms)
+{
+    if (delay_ms > 0) m_bufferDelayMs = delay_ms;
+}
+
+void EnhancementStage::requestReset()
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_queue.clear();
+    m_lastSourcePts = -1;
+    m_estimateResetRequested = true;
+}
+
+// 仅在超分线程中调用
+void EnhancementStage::resetUpscaleEstimate()
+{
+    m_upscaleEmaMs = 0.0;
+    m_warmupPending = true;
+    m_deadlineSkips = 0;
+}
+
+EnhancementStageStats EnhancementStage::takeStats()
+{
+    size_t limit;
+    double interval;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        limit = queueLimit();
+        interval = m_frameIntervalEmaMs;
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    EnhancementStageStats stats = m_stats;
+    stats.avg_upscale_ms = m_upscaleSamples > 0 ? m_upscaleSumMs / m_upscaleSamples : 0.0;
+    stats.avg_frame_interval_ms = interval;
+    stats.queue_limit = static_cast<int>(limit);
+    // 分辨率保留到下一周期，其余计数清零
+    m_stats = EnhancementStageStats();
+    m_stats.source_width = stats.source_width;
+    m_stats.source_height = stats.source_height;
+    m_stats.output_width = stats.output_width;
+    m_stats.output_height = stats.output_height;
+    m_upscaleSumMs = 0.0;
+    m_upscaleSamples = 0;
+    return stats;
+}
+
+// 调用方需持有 m_queueMutex
+size_t EnhancementStage::queueLimit() const
+{
+    if (m_frameIntervalEmaMs <= 0.0) return DEFAULT_QUEUE_LIMIT;
+    const size_t frames = static_cast<size_t>(std::ceil(m_bufferDelayMs.load() / m_frameIntervalEmaMs));
+    return std::max(MIN_QUEUE_LIMIT, frames);
+}
+
+void EnhancementStage::startProcessing()
+{
+    if (m_running) return;
+    m_running = true;
+    qDebug() << "[Enhance] 超分线程启动。";
+    processingLoop();
+    qDebug() << "[Enhance] 超分线程已退出。";
+}
+
+void EnhancementStage::stopProcessing()
+{
+    m_running = false;
+    m_queueCv.notify_one();
+}
+
+void EnhancementStage::processingLoop()
+{
+    while (m_running)
+    {
+        QCoreApplication::processEvents();
+
+        std::unique_ptr<DecodedFrame> frame;
+        size_t backlog = 0;
+        size_t limit = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCv.wait_for(lock, std::chrono::milliseconds(10), [this] { return !m_queue.empty() || !m_running; });
+            if (m_queue.empty()) continue;
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+            backlog = m_queue.size();
+            limit = queueLimit();
+        }
+        processFrame(std::move(frame), backlog >= limit);
+    }
+}
+
+void EnhancementStage::passThrough(std::unique_ptr<DecodedFrame> frame)
+{
+    const int width = frame->frame->width;
+    const int height = frame->frame->height;
+    m_output.add_frame(std::move(frame));
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.passed_frames++;
+    m_stats.source_width = width;
+    m_stats.source_height = height;
+    m_stats.output_width = width;
+    m_stats.output_height = height;
+}
+
+void EnhancementStage::processFrame(std::unique_ptr<DecodedFrame> frame, bool behind)
+{
+    const EnhancementLevel level = static_cast<EnhancementLevel>(m_level.load());
+    if (!m_enabled || !m_upscaler.is_initialized() || level == EnhancementLevel::Off) {
+        passThrough(std::move(frame));
+        return;
+    }
+
+    if (m_estimateResetRequested.exchange(false)) {
+        resetUpscaleEstimate();
+    }
+    if (m_appliedLevel != static_cast<int>(level)) {
+        m_upscaler.set_tile_size(level == EnhancementLevel::Full ? FULL_TILE_SIZE : REDUCED_TILE_SIZE);
+        m_appliedLevel = static_cast<int>(level);
+        m_runModelNext = true;
+        // 【新增】分块大小改变后耗时随之改变，且首次运行要重新分配
+        resetUpscaleEstimate();
+    }
+
+    // 降级档隔帧运行模型；排队过深或预计赶不上显示时刻时只做双三次放大
+    bool run_model = true;
+    if (level == EnhancementLevel::Reduced) {
+        run_model = m_runModelNext;
+        m_runModelNext = !m_runModelNext;
+    }
+    if (behind) run_model = false;
+    const int64_t now = m_clock.get_time_ms();
+    bool probe = false;
+    if (run_model && now >= 0 && !m_clock.is_paused()
+        && static_cast<double>(frame->frame->pts - now) < m_upscaleEmaMs + DEADLINE_MARGIN_MS) {
+        // 【修改】跳过的帧不产生新样本，连续跳过足够多帧后仍运行一次，用实测值替换估计
+        if (++m_deadlineSkips >= PROBE_AFTER_DEADLINE_SKIPS) {
+            probe = true;
+            m_deadlineSkips = 0;
+        }
+        else {
+            run_model = false;
+        }
+    }
+    else if (run_model) {
+        m_deadlineSkips = 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    AVFrame* upscaled = m_upscaler.upscale(frame->frame.get(), run_model);
+    const double elapsed_ms = timer.nsecsElapsed() / 1e6;
+    if (run_model) {
+        if (m_warmupPending) {
+            m_warmupPending = false;
+        }
+        else if (probe || m_upscaleEmaMs <= 0.0) {
+            m_upscaleEmaMs = elapsed_ms;
+        }
+        else {
+            m_upscaleEmaMs += EMA_ALPHA * (elapsed_ms - m_upscaleEmaMs);
+        }
+    }
+
+    if (!upscaled) {
+        // 超分失败时转交原始帧，画面不中断
+        passThrough(std::move(frame));
+        return;
+    }
+    // 放入缓冲区后帧可能立即被淘汰，尺寸需提前取出
+    const int output_width = upscaled->width;
+    const int output_height = upscaled->height;
+    const int source_width = frame->frame->width;
+    const int source_height = frame->frame->height;
+    frame.reset(); // 原始帧尽早归还帧池
+    m_output.add_frame(std::make_unique<DecodedFrame>(upscaled));
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (run_model) m_stats.model_frames++;
+    else m_stats.resized_frames++;
+    m_upscaleSumMs += elapsed_ms;
+    m_upscaleSamples++;
+    m_stats.source_width = source_width;
+    m_stats.source_height = source_height;
+    m_stats.output_width = output_width;
+    m_stats.output_height = output_height;
+}
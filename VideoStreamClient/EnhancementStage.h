@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include <QObject>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+class DecodedFrame;
+class DecodedFrameBuffer;
+class FSRCNNUpscaler;
+class MasterClock;
+enum class EnhancementLevel;
+
+// 超分阶段的统计信息（由 takeStats 取出后清零）
+struct EnhancementStageStats {
+    int model_frames = 0;       // 运行了模型的帧
+    int resized_frames = 0;     // 只做了双三次放大的帧（降级档隔帧、排队过深或赶不上截止时间）
+    int passed_frames = 0;      // 未处理直接转交的帧（超分关闭或档位为 Off）
+    double avg_upscale_ms = 0.0;      // 每帧超分的平均耗时（含双三次放大的帧）
+    double avg_frame_interval_ms = 0.0; // 源帧的平均间隔，即每帧可用的时间预算
+    int max_queue_depth = 0;    // 本周期的最大排队帧数
+    int queue_limit = 0;        // 当前的队列深度上限
+    int source_width = 0, source_height = 0; // 最近一帧的解码分辨率与放入缓冲区时的分辨率
+    int output_width = 0, output_height = 0;
+};
+
+// 【新增】解码后的超分阶段：位于 VideoDecoder 与 DecodedFrameBuffer 之间，
+// 每个解码帧只在自己的线程里超分一次后再放入帧缓冲区，渲染线程不再承担推理耗时，
+// 高刷新率下重复呈现同一帧也不会重复超分。
+// 队列深度上限 = 缓冲时延 / 源帧间隔：排队超过上限、或按当前耗时估计赶不上显示时刻的帧
+// 改用双三次放大，保证输出分辨率不变且不会越积越多。
+class EnhancementStage : public QObject
+{
+    Q_OBJECT
+
+public:
+    EnhancementStage(DecodedFrameBuffer& output, MasterClock& clock, FSRCNNUpscaler& upscaler, QObject* parent = nullptr);
+    ~EnhancementStage();
+
+    // 以下接口可从任意线程调用
+    // 解码线程调用：超分关闭且队列为空时直接放入帧缓冲区，否则入队
+    void push(std::unique_ptr<DecodedFrame> frame);
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+    // 由 EnhancementGovernor 决定的档位，在超分线程中生效
+    void setLevel(EnhancementLevel level);
+    // 缓冲时延（毫秒），决定队列深度上限
+    void setBufferDelay(int delay_ms);
+    // 新播放/跳转时丢弃排队中的帧
+    void requestReset();
+    EnhancementStageStats takeStats();
+
+public slots:
+    void startProcessing();
+    void stopProcessing();
+
+private:
+    void processingLoop();
+    void processFrame(std::unique_ptr<DecodedFrame> frame, bool behind);
+    void passThrough(std::unique_ptr<DecodedFrame> frame);
+    // 【新增】丢弃超分耗时估计，下一次运行模型重新预热、测量
+    void resetUpscaleEstimate();
+    size_t queueLimit() const;
+
+    DecodedFrameBuffer& m_output;
+    MasterClock& m_clock;
+    FSRCNNUpscaler& m_upscaler;
+
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_enabled;
+    std::atomic<int> m_level;
+    std::atomic<int> m_bufferDelayMs;
+    std::atomic<bool> m_estimateResetRequested{ false }; // 【新增】requestReset 跨线程通知超分线程清除耗时估计
+
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCv;
+    std::deque<std::unique_ptr<DecodedFrame>> m_queue;
+    int64_t m_lastSourcePts = -1;       // 以下两项由 m_queueMutex 保护
+    double m_frameIntervalEmaMs = 0.0;
+
+    // 仅在超分线程中访问
+    int m_appliedLevel = -1;
+    bool m_runModelNext = true;
+    double m_upscaleEmaMs = 0.0;
+    bool m_warmupPending = true;  // 【新增】下一次模型运行是预热（会话首次运行、内存池增长），不计入耗时估计
+    int m_deadlineSkips = 0;      // 【新增】连续因截止时间跳过模型的帧数，达到上限时强制运行一次重新测量
+
+    std::mutex m_statsMutex;
+    EnhancementStageStats m_stats;
+    double m_upscaleSumMs = 0.0;
+    int m_upscaleSamples = 0;
+};
@@ -1,4 +1,7 @@
 ﻿#include "FSRCNNUpscaler.h"
+#include "FramePool.h"
+#include "InferenceRuntime.h"
+#include "Float16Kernels.h"
 #include <stdexcept>
 #include <vector>
 #include <opencv2/opencv.hpp>
@@ -6,8 +9,6 @@
 #include <algorithm>
 #include <cstdint>
 
-#include <onnxruntime_c_api.h>
-
 extern "C" {
 #include <libavutil/frame.h>
 #include <libavutil/imgutils.h>
@@ -15,186 +16,208 @@ extern "C" {
 }
 
 namespace {
-    // 辅助函数 #1: float32 -> float16
-    uint16_t float32_to_float16(float f) {
-        uint32_t x;
-        memcpy(&x, &f, sizeof(float));
-        uint32_t sign = (x >> 16) & 0x8000;
-        int32_t exponent = ((x >> 23) & 0xff) - 127;
-        uint32_t mantissa = x & 0x7fffff;
-        if (exponent > 15) return sign | 0x7c00;
-        if (exponent < -14) return sign;
-        exponent += 15;
-        mantissa >>= 13;
-        return sign | (exponent << 10) | mantissa;
-    }
+    // 【新增】分块推理参数：默认块大小（输入像素）、相邻块的重叠宽度、动态 batch 模型一次 Run 的块数
+    constexpr int DEFAULT_TILE_SIZE = 256;
+    constexpr int TILE_OVERLAP = 16;
+    constexpr int MAX_TILES_PER_RUN = 8;
 
-    // 辅助函数 #2: float16 -> float32
-    float float16_to_float32(uint16_t h) {
-        uint32_t sign = (h >> 15) & 1;
-        uint32_t exponent = (h >> 10) & 0x1f;
-        uint32_t mantissa = h & 0x3ff;
-        uint32_t f;
-        if (exponent == 0) {
-            if (mantissa == 0) {
-                f = sign << 31;
-            }
-            else {
-                exponent = 127 - 14;
-                mantissa <<= 1;
-                while ((mantissa & 0x400) == 0) {
-                    mantissa <<= 1;
-                    exponent--;
-                }
-                mantissa &= 0x3ff;
-                f = (sign << 31) | ((exponent + (127 - 15)) << 23) | (mantissa << 13);
-            }
+    // 沿一个方向均匀排布的块起点：块数取满足重叠要求的最小值，首尾贴边
+    std::vector<int> tile_starts(int length, int tile, int overlap) {
+        if (length <= tile) return { 0 };
+        const int count = (length - overlap + (tile - overlap) - 1) / (tile - overlap);
+        std::vector<int> starts(count);
+        for (int i = 0; i < count; ++i) {
+            starts[i] = static_cast<int>(static_cast<int64_t>(i) * (length - tile) / (count - 1));
         }
-        else if (exponent == 0x1f) {
-            f = (sign << 31) | 0x7f800000 | (mantissa << 13);
+        return starts;
+    }
+
+    // 块在一个方向上的融合权重：非图像边界的一侧在 ramp 宽度内线性衰减，其余为 1
+    std::vector<float> tile_weights(int size, int ramp, bool fade_begin, bool fade_end) {
+        std::vector<float> weights(size, 1.0f);
+        for (int i = 0; i < size; ++i) {
+            if (fade_begin) weights[i] = std::min(weights[i], (i + 0.5f) / ramp);
+            if (fade_end) weights[i] = std::min(weights[i], (size - i - 0.5f) / ramp);
         }
-        else {
-            f = (sign << 31) | ((exponent + (127 - 15)) << 23) | (mantissa << 13);
+        return weights;
+    }
+
+    struct TileAxis {
+        std::vector<int> starts;                 // 输入坐标
+        std::vector<std::vector<float>> weights; // 每个块的输出权重
+        std::vector<float> weight_sum;           // 输出坐标上所有块权重之和
+    };
+
+    TileAxis build_axis(const std::vector<int>& starts, int tile, int scale, int out_length) {
+        TileAxis axis;
+        axis.starts = starts;
+        axis.weight_sum.assign(out_length, 0.0f);
+        for (size_t i = 0; i < starts.size(); ++i) {
+            axis.weights.push_back(tile_weights(tile * scale, TILE_OVERLAP * scale, i > 0, i + 1 < starts.size()));
+            const int offset = starts[i] * scale;
+            for (int k = 0; k < tile * scale; ++k) axis.weight_sum[offset + k] += axis.weights.back()[k];
         }
-        float val;
-        memcpy(&val, &f, sizeof(float));
-        return val;
+        return axis;
     }
 }
 
 struct FSRCNNUpscaler::Impl {
-    const OrtApi* ort_api = nullptr;
-    OrtEnv* env = nullptr;
-    OrtSessionOptions* session_options = nullptr;
-    OrtSession* session = nullptr;
-    OrtAllocator* allocator = nullptr;
+    // 【修改】会话、OrtEnv 与输入输出绑定交给共享的推理运行时
+    InferenceSession session{ "FSRCNN" };
     std::vector<uint16_t> input_tensor_values;
-    std::vector<std::string> input_node_name_strings;
-    std::vector<std::string> output_node_name_strings;
-    std::vector<const char*> input_node_names;
-    std::vector<const char*> output_node_names;
     bool initialized = false;
+    bool dynamic_batch = false;
+    int tile_size = DEFAULT_TILE_SIZE;
+    int last_scale = 0; // 【新增】最近一次推理得到的放大倍数
 
-    void CheckStatus(OrtStatus* status) const {
-        if (status != nullptr) {
-            const char* msg = ort_api->GetErrorMessage(status);
-            std::string error_message = "ONNX Runtime Error (FSRCNN): ";
-            error_message += msg;
-            ort_api->ReleaseStatus(status);
-            throw std::runtime_error(error_message);
-        }
-    }
+    // 【新增】跨帧复用的 CLAHE 对象与输出累加缓冲区
+    cv::Ptr<cv::CLAHE> clahe;
+    std::vector<float> accum;
 
     Impl() = default;
-    ~Impl() {
-        if (ort_api) {
-            if (session) ort_api->ReleaseSession(session);
-            if (session_options) ort_api->ReleaseSessionOptions(session_options);
-            if (env) ort_api->ReleaseEnv(env);
-        }
-    }
+    ~Impl() = default;
 
     bool initialize(const std::string& model_path, std::string& error_message) {
-        ort_api = OrtGetApiBase()->GetApi(ORT_API_VERSION);
-        if (!ort_api) {
-            error_message = "Fatal: Could not get ONNX Runtime API base.";
+        qInfo() << "[FSRCNN] Using CPU for inference.";
+        if (!session.load(model_path, false, error_message)) {
+            initialized = false;
+            return false;
+        }
+        if (session.input_count() != 1 || session.output_count() < 1) {
+            error_message = "Invalid ONNX model. Expected 1 input for FSRCNN.";
+            initialized = false;
             return false;
         }
         try {
-            CheckStatus(ort_api->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "FSRCNN-Upscaler", &env));
-            CheckStatus(ort_api->CreateSessionOptions(&session_options));
-            qInfo() << "[FSRCNN] Using CPU for inference.";
-            std::wstring model_path_w(model_path.begin(), model_path.end());
-            CheckStatus(ort_api->CreateSession(env, model_path_w.c_str(), session_options, &session));
-            CheckStatus(ort_api->GetAllocatorWithDefaultOptions(&allocator));
-            size_t num_input_nodes, num_output_nodes;
-            CheckStatus(ort_api->SessionGetInputCount(session, &num_input_nodes));
-            CheckStatus(ort_api->SessionGetOutputCount(session, &num_output_nodes));
-            if (num_input_nodes != 1) throw std::runtime_error("Invalid ONNX model. Expected 1 input for FSRCNN.");
-            char* input_name_ptr = nullptr;
-            CheckStatus(ort_api->SessionGetInputName(session, 0, allocator, &input_name_ptr));
-            input_node_name_strings.emplace_back(input_name_ptr);
-            allocator->Free(allocator, input_name_ptr);
-            input_node_names.push_back(input_node_name_strings[0].c_str());
-            char* output_name_ptr = nullptr;
-            CheckStatus(ort_api->SessionGetOutputName(session, 0, allocator, &output_name_ptr));
-            output_node_name_strings.emplace_back(output_name_ptr);
-            allocator->Free(allocator, output_name_ptr);
-            output_node_names.push_back(output_node_name_strings[0].c_str());
-            initialized = true;
-            return true;
+            const std::vector<int64_t> dims = session.input_dims(0);
+            dynamic_batch = !dims.empty() && dims[0] < 0;
         }
         catch (const std::runtime_error& e) {
             error_message = e.what();
             initialized = false;
             return false;
         }
+        clahe = cv::createCLAHE(0.2, cv::Size(16, 16));
+        initialized = true;
+        return true;
     }
 
-    void preprocess(const cv::Mat& img_y, std::vector<uint16_t>& input_tensor) {
-        cv::Mat float_img;
-        img_y.convertTo(float_img, CV_32FC1, 1.0 / 255.0);
-        const size_t pixel_count = (size_t)float_img.rows * float_img.cols;
-        input_tensor.resize(pixel_count);
-        const float* float_data = (float*)float_img.data;
-        for (size_t i = 0; i < pixel_count; ++i) {
-            input_tensor[i] = float32_to_float16(float_data[i]);
-        }
-    }
+    // 【修改】分块超分：Y 平面切成带重叠的块，多个块拼成一个 batch 张量推理（ONNX Runtime 内部按核数并行），
+    // 块的打包与融合用 cv::parallel_for_ 分摊到多个线程；重叠区按线性权重融合以消除接缝。
+    // 峰值内存只与块大小和 batch 有关，不再随整帧分辨率增长。
+    cv::Mat run_inference_y_channel(const uint8_t* src, int src_stride, int width, int height) {
+        try {
+            const int tw = (tile_size > 0) ? std::min(tile_size, width) : width;
+            const int th = (tile_size > 0) ? std::min(tile_size, height) : height;
+            const std::vector<int> xs = tile_starts(width, tw, TILE_OVERLAP);
+            const std::vector<int> ys = tile_starts(height, th, TILE_OVERLAP);
+            const int tile_count = static_cast<int>(xs.size() * ys.size());
+            const int batch = std::min(tile_count, dynamic_batch ? MAX_TILES_PER_RUN : 1);
+            const size_t tile_pixels = static_cast<size_t>(tw) * th;
 
-    cv::Mat postprocess(OrtValue* output_tensor, int out_h, int out_w) {
-        uint16_t* pdata_16;
-        CheckStatus(ort_api->GetTensorMutableData(output_tensor, (void**)&pdata_16));
+            input_tensor_values.resize(batch * tile_pixels);
+            const std::vector<int64_t> input_shape = { batch, 1, th, tw };
+            session.bind_input(0, input_tensor_values.data(), input_tensor_values.size() * sizeof(uint16_t),
+                input_shape, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16);
 
-        cv::Mat result_mat(out_h, out_w, CV_32FC1);
-        for (int i = 0; i < out_h * out_w; ++i) {
-            result_mat.at<float>(i) = float16_to_float32(pdata_16[i]);
-        }
+            int scale = 0;
+            int out_w = 0, out_h = 0;
+            TileAxis axis_x, axis_y;
 
-        // 【核心修改】移除归一化，直接将模型输出（通常在0-1范围）转换为0-255范围
-        result_mat *= 255.0;
+            for (int first = 0; first < tile_count; first += batch) {
+                const int count = std::min(batch, tile_count - first);
 
-        cv::Mat final_img;
-        result_mat.convertTo(final_img, CV_8UC1);
-        return final_img;
-    }
+                // 打包：u8 → 归一化 fp16，不足一个 batch 时剩余槽位保持上一次的内容（结果被忽略）
+                cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+                    for (int i = range.start; i < range.end; ++i) {
+                        const int tile = first + i;
+                        const int x0 = xs[tile % xs.size()];
+                        const int y0 = ys[tile / xs.size()];
+                        uint16_t* dst = input_tensor_values.data() + i * tile_pixels;
+                        for (int y = 0; y < th; ++y) {
+                            const uint8_t* row = src + static_cast<ptrdiff_t>(y0 + y) * src_stride + x0;
+                            Float16Kernels::u8_to_half_normalized(row, dst + static_cast<size_t>(y) * tw, tw);
+                        }
+                    }
+                });
 
-    cv::Mat run_inference_y_channel(const cv::Mat& input_y_mat) {
-        preprocess(input_y_mat, input_tensor_values);
-        std::vector<int64_t> input_shape = { 1, 1, (int64_t)input_y_mat.rows, (int64_t)input_y_mat.cols };
-        OrtValue* input_tensor = nullptr;
-        OrtValue* output_tensor = nullptr;
-        try {
-            OrtMemoryInfo* memory_info;
-            CheckStatus(ort_api->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
-            CheckStatus(ort_api->CreateTensorWithDataAsOrtValue(
-                memory_info, input_tensor_values.data(), input_tensor_values.size() * sizeof(uint16_t),
-                input_shape.data(), input_shape.size(), ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16, &input_tensor));
-            ort_api->ReleaseMemoryInfo(memory_info);
-            CheckStatus(ort_api->Run(
-                session, nullptr,
-                input_node_names.data(), (const OrtValue* const*)&input_tensor, 1,
-                output_node_names.data(), output_node_names.size(),
-                &output_tensor));
-            OrtTensorTypeAndShapeInfo* shape_info;
-            CheckStatus(ort_api->GetTensorTypeAndShape(output_tensor, &shape_info));
-            std::vector<int64_t> output_shape;
-            size_t num_dims;
-            CheckStatus(ort_api->GetDimensionsCount(shape_info, &num_dims));
-            output_shape.resize(num_dims);
-            CheckStatus(ort_api->GetDimensions(shape_info, output_shape.data(), num_dims));
-            const int out_h = static_cast<int>(output_shape[2]);
-            const int out_w = static_cast<int>(output_shape[3]);
-            cv::Mat result_y = postprocess(output_tensor, out_h, out_w);
-            if (shape_info) ort_api->ReleaseTensorTypeAndShapeInfo(shape_info);
-            if (input_tensor) ort_api->ReleaseValue(input_tensor);
-            if (output_tensor) ort_api->ReleaseValue(output_tensor);
-            return result_y;
+                session.run();
+
+                const std::vector<int64_t>& output_shape = session.output_shape(0);
+                if (output_shape.size() != 4 || output_shape[0] != batch || output_shape[2] % th != 0 || output_shape[3] % tw != 0
+                    || output_shape[2] / th != output_shape[3] / tw) {
+                    throw std::runtime_error("Unexpected FSRCNN output shape.");
+                }
+                if (scale == 0) {
+                    scale = static_cast<int>(output_shape[3] / tw);
+                    out_w = width * scale;
+                    out_h = height * scale;
+                    axis_x = build_axis(xs, tw, scale, out_w);
+                    axis_y = build_axis(ys, th, scale, out_h);
+                    // 累加缓冲区在每帧归一化时已清零，尺寸不变时直接复用
+                    const size_t accum_size = static_cast<size_t>(out_w) * out_h;
+                    if (tile_count > 1 && accum.size() != accum_size) accum.assign(accum_size, 0.0f);
+                }
+
+                const uint16_t* out = static_cast<const uint16_t*>(session.output_data(0));
+                const int otw = tw * scale, oth = th * scale;
+
+                // 只有一个块（整帧）时无需融合，fp16 → u8 一次完成
+                if (tile_count == 1) {
+                    cv::Mat result(out_h, out_w, CV_8UC1);
+                    cv::parallel_for_(cv::Range(0, out_h), [&](const cv::Range& range) {
+                        for (int r = range.start; r < range.end; ++r) {
+                            Float16Kernels::half_to_u8_clamped(out + static_cast<size_t>(r) * otw, result.ptr<uint8_t>(r), out_w);
+                        }
+                    });
+                    return result;
+                }
+
+                // 融合：按输出行并行，每一行只由一个线程写入，块之间的重叠不会产生竞争
+                const int row_begin = ys[first / xs.size()] * scale;
+                const int row_end = ys[(first + count - 1) / xs.size()] * scale + oth;
+                cv::parallel_for_(cv::Range(row_begin, row_end), [&](const cv::Range& range) {
+                    std::vector<float> values(otw);
+                    for (int r = range.start; r < range.end; ++r) {
+                        float* acc_row = accum.data() + static_cast<size_t>(r) * out_w;
+                        for (int i = 0; i < count; ++i) {
+                            const int tile = first + i;
+                            const size_t col = tile % xs.size();
+                            const size_t row = tile / xs.size();
+                            const int oy = ys[row] * scale;
+                            if (r < oy || r >= oy + oth) continue;
+                            const float wy = axis_y.weights[row][r - oy];
+                            const float* wx = axis_x.weights[col].data();
+                            const uint16_t* tile_row = out + i * static_cast<size_t>(otw) * oth + static_cast<size_t>(r - oy) * otw;
+                            float* dst = acc_row + xs[col] * scale;
+                            Float16Kernels::half_to_float(tile_row, values.data(), otw);
+                            for (int x = 0; x < otw; ++x) {
+                                dst[x] += wy * wx[x] * values[x];
+                            }
+                        }
+                    }
+                });
+            }
+
+            // 归一化（权重和可分离为行、列两部分）并转换为 u8
+            cv::Mat result(out_h, out_w, CV_8UC1);
+            cv::parallel_for_(cv::Range(0, out_h), [&](const cv::Range& range) {
+                for (int r = range.start; r < range.end; ++r) {
+                    float* acc_row = accum.data() + static_cast<size_t>(r) * out_w;
+                    uint8_t* dst = result.ptr<uint8_t>(r);
+                    const float wy = axis_y.weight_sum[r];
+                    for (int x = 0; x < out_w; ++x) {
+                        const float v = acc_row[x] / (wy * axis_x.weight_sum[x]) * 255.0f;
+                        dst[x] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, v + 0.5f)));
+                        acc_row[x] = 0.0f; // 顺便清零，供下一帧使用
+                    }
+                }
+            });
+            return result;
         }
         catch (const std::runtime_error& e) {
             qCritical() << "[FSRCNN] Inference failed:" << e.what();
-            if (input_tensor) ort_api->ReleaseValue(input_tensor);
-            if (output_tensor) ort_api->ReleaseValue(output_tensor);
+            std::fill(accum.begin(), accum.end(), 0.0f);
             return {};
         }
     }
@@ -213,24 +236,34 @@ bool FSRCNNUpscaler::is_initialized() const {
     return pimpl && pimpl->initialized;
 }
 
-AVFrame* FSRCNNUpscaler::upscale(const AVFrame* input_frame) {
+void FSRCNNUpscaler::set_tile_size(int tile_size) {
+    pimpl->tile_size = (tile_size > 0) ? std::max(tile_size, 4 * TILE_OVERLAP) : 0;
+}
+
+AVFrame* FSRCNNUpscaler::upscale(const AVFrame* input_frame, bool run_model) {
     if (!is_initialized() || !input_frame || input_frame->format != AV_PIX_FMT_YUV420P) {
         qWarning() << "[FSRCNN] Invalid input: Uninitialized or non-YUV420P frame";
         return nullptr;
     }
 
-    // 步骤 1: 直接从AVFrame的Y通道数据创建一个cv::Mat，无需转换色彩空间
-    cv::Mat input_y_channel(input_frame->height, input_frame->width, CV_8UC1, input_frame->data[0], input_frame->linesize[0]);
-
-    // 步骤 2: 对Y通道进行超分
-    // 注意：需要clone()来确保内存连续，因为原始AVFrame的内存布局可能有填充
-    cv::Mat upscaled_y_channel = pimpl->run_inference_y_channel(input_y_channel.clone());
-    if (upscaled_y_channel.empty()) {
-        qCritical() << "[FSRCNN] Y-channel inference failed.";
-        return nullptr;
+    // 步骤 1+2: 直接从 AVFrame 的 Y 平面分块读取并超分（按 linesize 逐行读取，无需 clone）
+    cv::Mat upscaled_y_channel;
+    if (run_model || pimpl->last_scale <= 0) {
+        upscaled_y_channel = pimpl->run_inference_y_channel(input_frame->data[0], input_frame->linesize[0],
+            input_frame->width, input_frame->height);
+        if (upscaled_y_channel.empty()) {
+            qCritical() << "[FSRCNN] Y-channel inference failed.";
+            return nullptr;
+        }
+        pimpl->last_scale = upscaled_y_channel.cols / input_frame->width;
     }
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(0.2, cv::Size(16, 16));
-    clahe->apply(upscaled_y_channel, upscaled_y_channel);
+    else {
+        // 【新增】跳过模型的帧：亮度同样按双三次放大到相同尺寸，CLAHE 照常应用，避免相邻帧观感跳变
+        cv::Mat y_channel(input_frame->height, input_frame->width, CV_8UC1, input_frame->data[0], input_frame->linesize[0]);
+        cv::resize(y_channel, upscaled_y_channel,
+            cv::Size(input_frame->width * pimpl->last_scale, input_frame->height * pimpl->last_scale), 0, 0, cv::INTER_CUBIC);
+    }
+    pimpl->clahe->apply(upscaled_y_channel, upscaled_y_channel);
     // 步骤 3: 同样地，直接包装U和V通道数据，并使用双三次插值法(CUBIC)将其放大
     cv::Mat u_channel(input_frame->height / 2, input_frame->width / 2, CV_8UC1, input_frame->data[1], input_frame->linesize[1]);
     cv::Mat v_channel(input_frame->height / 2, input_frame->width / 2, CV_8UC1, input_frame->data[2], input_frame->linesize[2]);
@@ -244,23 +277,13 @@ AVFrame* FSRCNNUpscaler::upscale(const AVFrame* input_frame) {
     cv::resize(v_channel, upscaled_v_channel, cv::Size(target_width / 2, target_height / 2), 0, 0, cv::INTER_CUBIC);
 
     // 步骤 4: 创建一个新的AVFrame，并将超分后的Y、U、V通道数据拷贝进去
-    AVFrame* result_frame = av_frame_alloc();
+    AVFrame* result_frame = FramePool::instance().acquire(target_width, target_height, AV_PIX_FMT_YUV420P);
     if (!result_frame) {
-        qCritical() << "[FSRCNN] Failed to allocate result frame.";
+        qCritical() << "[FSRCNN] Failed to acquire result frame from pool.";
         return nullptr;
     }
-
-    result_frame->width = target_width;
-    result_frame->height = target_height;
-    result_frame->format = AV_PIX_FMT_YUV420P;
     result_frame->pts = input_frame->pts; // 保持原始时间戳
 
-    if (av_frame_get_buffer(result_frame, 32) < 0) {
-        qCritical() << "[FSRCNN] Failed to allocate buffer for result frame.";
-        av_frame_free(&result_frame);
-        return nullptr;
-    }
-
     // 逐行拷贝数据，以正确处理内存对齐（stride/linesize）
     // 拷贝Y通道
     for (int y = 0; y < result_frame->height; ++y) {
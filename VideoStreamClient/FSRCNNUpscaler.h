@@ -15,7 +15,12 @@ public:
     bool initialize(const std::string& model_path, std::string& error_message);
 
     bool is_initialized() const;
-    AVFrame* upscale(const AVFrame* input_frame);
+    // 【修改】run_model 为 false 时亮度只做双三次放大（倍数沿用上一次模型推理的结果），
+    // 供降级档隔帧使用，保持输出分辨率不变；还没推理过时仍会运行模型
+    AVFrame* upscale(const AVFrame* input_frame, bool run_model = true);
+
+    // 【新增】分块大小（输入像素，默认 256），0 表示整帧一次推理
+    void set_tile_size(int tile_size);
 
     // 允许移动，但禁止拷贝
     FSRCNNUpscaler(FSRCNNUpscaler&&) noexcept;
@@ -0,0 +1,332 @@
+﻿#include "Float16Kernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define FP16_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+// 半精度转换指令只在 AArch64 上是基础指令集的一部分
+#define FP16_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang 需要按函数开启指令集；MSVC 可以直接使用所有内建函数
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_F16C __attribute__((target("avx2,f16c")))
+#else
+#define TARGET_F16C
+#endif
+
+namespace Float16Kernels {
+
+// ---------------- 标量参考实现 ----------------
+
+uint16_t float_to_half(float value)
+{
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t abs = x & 0x7fffffff;
+    const uint32_t exponent = abs >> 23;
+
+    // 无穷大 / NaN（NaN 保留高位载荷并置为 quiet，与 F16C 的行为一致）
+    if (exponent == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 | ((abs >> 13) & 0x3ff) : 0));
+    }
+    // >= 2^16 必然溢出为无穷大（65520 ~ 65536 由下面的进位处理）
+    if (exponent >= 143) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    // 规格化数：截掉 13 位尾数后就近舍入到偶数，进位可能传到指数（直至无穷大）
+    if (exponent >= 113) {
+        uint32_t half = ((exponent - 112) << 10) | ((abs & 0x7fffff) >> 13);
+        const uint32_t rest = abs & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    // 小于 2^-25 的值舍入为 0（恰好 2^-25 时向偶数舍入也为 0）
+    if (exponent < 102) {
+        return static_cast<uint16_t>(sign);
+    }
+    // 非规格化数：以 2^-24 为单位，右移后就近舍入到偶数，进位到 0x400 恰好是最小规格化数
+    const uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+    const uint32_t shift = 126 - exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) half++;
+    return static_cast<uint16_t>(sign | half);
+}
+
+float half_to_float(uint16_t value)
+{
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0) {
+        // 零或非规格化数：mantissa * 2^-24 在 float 中可精确表示
+        const float magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 0x1f) {
+        // 无穷大 / NaN（NaN 置为 quiet）
+        bits = sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+    }
+    else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+namespace {
+
+    constexpr float INV_255 = 1.0f / 255.0f;
+
+    using FloatToHalfFn = void(*)(const float* src, uint16_t* dst, size_t begin, size_t end);
+    using HalfToFloatFn = void(*)(const uint16_t* src, float* dst, size_t begin, size_t end);
+    using U8ToHalfFn = void(*)(const uint8_t* src, uint16_t* dst, size_t begin, size_t end);
+    using HalfToU8Fn = void(*)(const uint16_t* src, uint8_t* dst, size_t begin, size_t end);
+
+    struct KernelTable {
+        Isa isa;
+        FloatToHalfFn float_to_half;
+        HalfToFloatFn half_to_float;
+        U8ToHalfFn u8_to_half;
+        HalfToU8Fn half_to_u8;
+    };
+
+    inline uint8_t clamp_to_u8(float value) {
+        // 先乘后截断；NaN 在比较中为假，落到 0
+        float v = value * 255.0f;
+        v = v > 0.0f ? v : 0.0f;
+        v = v < 255.0f ? v : 255.0f;
+        return static_cast<uint8_t>(std::nearbyint(v));
+    }
+
+    // 256 项查找表：标量路径下 u8 → half 只需查表
+    const uint16_t* u8_half_table() {
+        static const struct Table {
+            uint16_t values[256];
+            Table() {
+                for (int i = 0; i < 256; ++i) values[i] = float_to_half(static_cast<float>(i) * INV_255);
+            }
+        } table;
+        return table.values;
+    }
+
+    // 65536 项查找表（64KB）：标量路径下 half → u8 也只需查表
+    const uint8_t* half_u8_table() {
+        static const struct Table {
+            uint8_t values[65536];
+            Table() {
+                for (uint32_t i = 0; i < 65536; ++i) values[i] = clamp_to_u8(half_to_float(static_cast<uint16_t>(i)));
+            }
+        } table;
+        return table.values;
+    }
+
+    void float_to_half_scalar(const float* src, uint16_t* dst, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst[i] = float_to_half(src[i]);
+    }
+
+    void half_to_float_scalar(const uint16_t* src, float* dst, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dst[i] = half_to_float(src[i]);
+    }
+
+    void u8_to_half_scalar(const uint8_t* src, uint16_t* dst, size_t begin, size_t end) {
+        const uint16_t* table = u8_half_table();
+        for (size_t i = begin; i < end; ++i) dst[i] = table[src[i]];
+    }
+
+    void half_to_u8_scalar(const uint16_t* src, uint8_t* dst, size_t begin, size_t end) {
+        const uint8_t* table = half_u8_table();
+        for (size_t i = begin; i < end; ++i) dst[i] = table[src[i]];
+    }
+
+    const KernelTable SCALAR_TABLE = { Isa::Scalar, &float_to_half_scalar, &half_to_float_scalar, &u8_to_half_scalar, &half_to_u8_scalar };
+
+#if defined(FP16_X86)
+    // ---------------- F16C (配合 AVX2)：每次 8 个值 ----------------
+
+    TARGET_F16C void float_to_half_f16c(const float* src, uint16_t* dst, size_t begin, size_t end) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+        }
+        float_to_half_scalar(src, dst, i, end);
+    }
+
+    TARGET_F16C void half_to_float_f16c(const uint16_t* src, float* dst, size_t begin, size_t end) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+        }
+        half_to_float_scalar(src, dst, i, end);
+    }
+
+    TARGET_F16C void u8_to_half_f16c(const uint8_t* src, uint16_t* dst, size_t begin, size_t end) {
+        const __m256 scale = _mm256_set1_ps(INV_255);
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256i u32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+            const __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(u32), scale);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+        }
+        u8_to_half_scalar(src, dst, i, end);
+    }
+
+    TARGET_F16C void half_to_u8_f16c(const uint16_t* src, uint8_t* dst, size_t begin, size_t end) {
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256 f = _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))), scale);
+            f = _mm256_max_ps(f, zero); // 任一操作数为 NaN 时返回第二个操作数，即 0
+            f = _mm256_min_ps(f, scale);
+            const __m256i i32 = _mm256_cvtps_epi32(f);
+            const __m128i i16 = _mm_packs_epi32(_mm256_castsi256_si128(i32), _mm256_extracti128_si256(i32, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(i16, i16));
+        }
+        half_to_u8_scalar(src, dst, i, end);
+    }
+
+    const KernelTable F16C_TABLE = { Isa::F16C, &float_to_half_f16c, &half_to_float_f16c, &u8_to_half_f16c, &half_to_u8_f16c };
+#endif
+
+#if defined(FP16_NEON)
+    // ---------------- NEON：每次 8 个值 ----------------
+
+    void float_to_half_neon(const float* src, uint16_t* dst, size_t begin, size_t end) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const float16x4_t lo = vcvt_f16_f32(vld1q_f32(src + i));
+            const float16x4_t hi = vcvt_f16_f32(vld1q_f32(src + i + 4));
+            vst1q_u16(dst + i, vcombine_u16(vreinterpret_u16_f16(lo), vreinterpret_u16_f16(hi)));
+        }
+        float_to_half_scalar(src, dst, i, end);
+    }
+
+    void half_to_float_neon(const uint16_t* src, float* dst, size_t begin, size_t end) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const uint16x8_t h = vld1q_u16(src + i);
+            vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vget_low_u16(h))));
+            vst1q_f32(dst + i + 4, vcvt_f32_f16(vreinterpret_f16_u16(vget_high_u16(h))));
+        }
+        half_to_float_scalar(src, dst, i, end);
+    }
+
+    void u8_to_half_neon(const uint8_t* src, uint16_t* dst, size_t begin, size_t end) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const uint16x8_t u16 = vmovl_u8(vld1_u8(src + i));
+            const float32x4_t lo = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(u16))), INV_255);
+            const float32x4_t hi = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(u16))), INV_255);
+            vst1q_u16(dst + i, vcombine_u16(vreinterpret_u16_f16(vcvt_f16_f32(lo)), vreinterpret_u16_f16(vcvt_f16_f32(hi))));
+        }
+        u8_to_half_scalar(src, dst, i, end);
+    }
+
+    void half_to_u8_neon(const uint16_t* src, uint8_t* dst, size_t begin, size_t end) {
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t max = vdupq_n_f32(255.0f);
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const uint16x8_t h = vld1q_u16(src + i);
+            float32x4_t lo = vmulq_n_f32(vcvt_f32_f16(vreinterpret_f16_u16(vget_low_u16(h))), 255.0f);
+            float32x4_t hi = vmulq_n_f32(vcvt_f32_f16(vreinterpret_f16_u16(vget_high_u16(h))), 255.0f);
+            // vmaxnm 在一个操作数为 NaN 时返回另一个，即 0
+            lo = vminq_f32(vmaxnmq_f32(lo, zero), max);
+            hi = vminq_f32(vmaxnmq_f32(hi, zero), max);
+            const uint16x8_t u16 = vcombine_u16(vqmovun_s32(vcvtnq_s32_f32(lo)), vqmovun_s32(vcvtnq_s32_f32(hi)));
+            vst1_u8(dst + i, vqmovn_u16(u16));
+        }
+        half_to_u8_scalar(src, dst, i, end);
+    }
+
+    const KernelTable NEON_TABLE = { Isa::NEON, &float_to_half_neon, &half_to_float_neon, &u8_to_half_neon, &half_to_u8_neon };
+#endif
+
+    const KernelTable* table_for(Isa isa) {
+        const CpuFeatures& cpu = CpuFeatures::get();
+        switch (isa) {
+        case Isa::Scalar:
+            return &SCALAR_TABLE;
+#if defined(FP16_X86)
+        case Isa::F16C:
+            return (cpu.f16c && cpu.avx2) ? &F16C_TABLE : nullptr;
+#endif
+#if defined(FP16_NEON)
+        case Isa::NEON:
+            return cpu.neon ? &NEON_TABLE : nullptr;
+#endif
+        default:
+            return nullptr;
+        }
+    }
+
+    const KernelTable* best_table() {
+        for (Isa isa : { Isa::F16C, Isa::NEON }) {
+            if (const KernelTable* table = table_for(isa)) return table;
+        }
+        return &SCALAR_TABLE;
+    }
+
+    std::atomic<const KernelTable*>& current_table() {
+        static std::atomic<const KernelTable*> table{ best_table() };
+        return table;
+    }
+}
+
+void float_to_half(const float* src, uint16_t* dst, size_t count)
+{
+    current_table().load(std::memory_order_relaxed)->float_to_half(src, dst, 0, count);
+}
+
+void half_to_float(const uint16_t* src, float* dst, size_t count)
+{
+    current_table().load(std::memory_order_relaxed)->half_to_float(src, dst, 0, count);
+}
+
+void u8_to_half_normalized(const uint8_t* src, uint16_t* dst, size_t count)
+{
+    current_table().load(std::memory_order_relaxed)->u8_to_half(src, dst, 0, count);
+}
+
+void half_to_u8_clamped(const uint16_t* src, uint8_t* dst, size_t count)
+{
+    current_table().load(std::memory_order_relaxed)->half_to_u8(src, dst, 0, count);
+}
+
+Isa active_isa()
+{
+    return current_table().load()->isa;
+}
+
+const char* isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar: return "Scalar";
+    case Isa::F16C: return "F16C";
+    case Isa::NEON: return "NEON";
+    }
+    return "Unknown";
+}
+
+bool select_isa(Isa isa)
+{
+    const KernelTable* table = table_for(isa);
+    if (!table) return false;
+    current_table().store(table);
+    return true;
+}
+
+}
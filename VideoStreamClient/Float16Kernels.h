@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// IEEE 754 半精度 (fp16) 转换内核，供 FSRCNN 的 fp16 模型输入输出使用。
+// float → half 使用就近舍入到偶数，正确处理非规格化数、溢出到无穷大以及 NaN；
+// half → float 是精确转换。SIMD 实现 (F16C / NEON) 与标量参考版逐位一致。
+namespace Float16Kernels {
+
+    enum class Isa { Scalar, F16C, NEON };
+
+    // 标量参考实现（单个值）
+    uint16_t float_to_half(float value);
+    float half_to_float(uint16_t value);
+
+    // 批量转换
+    void float_to_half(const float* src, uint16_t* dst, size_t count);
+    void half_to_float(const uint16_t* src, float* dst, size_t count);
+
+    // 融合转换：u8 像素 → 归一化到 [0,1] 的 half（x * (1/255)）
+    void u8_to_half_normalized(const uint8_t* src, uint16_t* dst, size_t count);
+    // 融合转换：half → 乘 255 后截断到 [0,255] 并就近舍入的 u8（NaN 视为 0）
+    void half_to_u8_clamped(const uint16_t* src, uint8_t* dst, size_t count);
+
+    // 当前使用的实现，默认取 CPU 支持的最优者
+    Isa active_isa();
+    const char* isa_name(Isa isa);
+    // 强制切换实现（用于对比验证），CPU 不支持时返回 false
+    bool select_isa(Isa isa);
+}
@@ -0,0 +1,164 @@
+﻿#include "FramePool.h"
+#include <QDebug>
+#include <atomic>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+namespace {
+    // 平面对齐，满足 SIMD 加载与 GL 上传的要求
+    constexpr int PLANE_ALIGN = 32;
+    // 同时保留的规格数；分辨率切换后，最久未用的规格会被释放
+    constexpr size_t MAX_POOLS = 6;
+}
+
+struct FramePool::Pool {
+    AVBufferPool* buffer_pool = nullptr;
+    size_t frame_bytes = 0;
+    int linesizes[4] = {};
+    size_t plane_offsets[4] = {};
+    int plane_count = 0;
+    uint64_t last_used = 0;
+    std::atomic<int64_t> acquired{ 0 };
+    std::atomic<int> allocated{ 0 };
+
+    ~Pool() {
+        // 已取出的缓冲区在归还时才会真正释放，这里只标记池为待销毁
+        if (buffer_pool) av_buffer_pool_uninit(&buffer_pool);
+    }
+
+    // AVBufferPool 只在空闲列表为空时才调用分配函数，因此分配次数即为在用帧数的峰值
+    static AVBufferRef* alloc(void* opaque, size_t size) {
+        auto* self = static_cast<Pool*>(opaque);
+        AVBufferRef* buf = av_buffer_alloc(size);
+        if (buf) self->allocated++;
+        return buf;
+    }
+};
+
+FramePool& FramePool::instance()
+{
+    static FramePool pool;
+    return pool;
+}
+
+FramePool::FramePool() : use_counter_(0)
+{
+}
+
+FramePool::~FramePool() = default;
+
+FramePool::Pool* FramePool::find_or_create_pool(const Key& key)
+{
+    auto it = pools_.find(key);
+    if (it != pools_.end()) {
+        it->second->last_used = ++use_counter_;
+        return it->second.get();
+    }
+
+    auto pool = std::make_unique<Pool>();
+    const AVPixelFormat fmt = static_cast<AVPixelFormat>(key.format);
+    if (av_image_fill_linesizes(pool->linesizes, fmt, FFALIGN(key.width, PLANE_ALIGN)) < 0) {
+        return nullptr;
+    }
+
+    // 计算每个平面在单块缓冲区中的偏移
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; ++i) linesizes[i] = pool->linesizes[i];
+    size_t plane_sizes[4] = {};
+    if (av_image_fill_plane_sizes(plane_sizes, fmt, key.height, linesizes) < 0) {
+        return nullptr;
+    }
+    size_t offset = 0;
+    for (int i = 0; i < 4 && plane_sizes[i] > 0; ++i) {
+        pool->plane_offsets[i] = offset;
+        offset += FFALIGN(plane_sizes[i], static_cast<size_t>(PLANE_ALIGN));
+        pool->plane_count = i + 1;
+    }
+    pool->frame_bytes = offset;
+
+    pool->buffer_pool = av_buffer_pool_init2(pool->frame_bytes, pool.get(), &Pool::alloc, nullptr);
+    if (!pool->buffer_pool) {
+        return nullptr;
+    }
+    pool->last_used = ++use_counter_;
+
+    qDebug() << "[FramePool] 新建帧池" << key.width << "x" << key.height << "format" << key.format
+        << "单帧" << pool->frame_bytes << "字节";
+
+    Pool* result = pool.get();
+    pools_.emplace(key, std::move(pool));
+    evict_idle_pools();
+    return result;
+}
+
+void FramePool::evict_idle_pools()
+{
+    while (pools_.size() > MAX_POOLS) {
+        auto oldest = pools_.begin();
+        for (auto it = pools_.begin(); it != pools_.end(); ++it) {
+            if (it->second->last_used < oldest->second->last_used) oldest = it;
+        }
+        pools_.erase(oldest);
+    }
+}
+
+AVFrame* FramePool::acquire(int width, int height, int format)
+{
+    if (width <= 0 || height <= 0 || format < 0) return nullptr;
+
+    AVBufferRef* buf = nullptr;
+    int linesizes[4] = {};
+    size_t offsets[4] = {};
+    int plane_count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Pool* pool = find_or_create_pool({ width, height, format });
+        if (!pool) return nullptr;
+        buf = av_buffer_pool_get(pool->buffer_pool);
+        if (!buf) return nullptr;
+        pool->acquired++;
+        for (int i = 0; i < 4; ++i) {
+            linesizes[i] = pool->linesizes[i];
+            offsets[i] = pool->plane_offsets[i];
+        }
+        plane_count = pool->plane_count;
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    if (!frame) {
+        av_buffer_unref(&buf);
+        return nullptr;
+    }
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+    frame->buf[0] = buf;
+    for (int i = 0; i < plane_count; ++i) {
+        frame->data[i] = buf->data + offsets[i];
+        frame->linesize[i] = linesizes[i];
+    }
+    return frame;
+}
+
+std::vector<FramePoolStats> FramePool::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<FramePoolStats> stats;
+    stats.reserve(pools_.size());
+    for (const auto& entry : pools_) {
+        const auto& pool = entry.second;
+        FramePoolStats s;
+        s.width = entry.first.width;
+        s.height = entry.first.height;
+        s.format = entry.first.format;
+        s.frame_bytes = pool->frame_bytes;
+        s.acquired = pool->acquired.load();
+        s.high_water = pool->allocated.load();
+        stats.push_back(s);
+    }
+    return stats;
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct AVFrame;
+struct AVBufferPool;
+
+// 帧池中某一规格 (宽, 高, 像素格式) 的统计信息
+struct FramePoolStats {
+    int width = 0;
+    int height = 0;
+    int format = -1;
+    size_t frame_bytes = 0;    // 单帧缓冲区大小
+    int64_t acquired = 0;      // 累计取出次数
+    int high_water = 0;        // 同时在用帧数的峰值（即池实际分配过的缓冲区数）
+};
+
+// 客户端共享的帧池，基于 AVBufferPool，按 (宽, 高, 像素格式) 分池。
+// acquire 返回的 AVFrame 的数据缓冲区来自池；av_frame_free / av_frame_unref 后缓冲区自动归还，
+// 因此 av_frame_clone 得到的引用也可以照常在任意线程释放。
+class FramePool
+{
+public:
+    static FramePool& instance();
+
+    // 取出一个可写帧（平面按 32 字节对齐），失败返回 nullptr
+    AVFrame* acquire(int width, int height, int format);
+
+    std::vector<FramePoolStats> get_stats() const;
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+private:
+    FramePool();
+    ~FramePool();
+
+    struct Key {
+        int width;
+        int height;
+        int format;
+        bool operator<(const Key& other) const {
+            if (width != other.width) return width < other.width;
+            if (height != other.height) return height < other.height;
+            return format < other.format;
+        }
+    };
+
+    struct Pool;
+    Pool* find_or_create_pool(const Key& key);
+    void evict_idle_pools();
+
+    std::map<Key, std::unique_ptr<Pool>> pools_;
+    mutable std::mutex mtx_;
+    uint64_t use_counter_;
+};
@@ -0,0 +1,312 @@
+﻿#include "InferenceRuntime.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    // 返回 0 表示不支持的元素类型
+    size_t element_size(ONNXTensorElementDataType type) {
+        switch (type) {
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: return 2;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+}
+
+// ---------------- InferenceRuntime ----------------
+
+InferenceRuntime& InferenceRuntime::instance()
+{
+    static InferenceRuntime runtime;
+    return runtime;
+}
+
+InferenceRuntime::InferenceRuntime()
+    : api_(OrtGetApiBase()->GetApi(ORT_API_VERSION)), env_(nullptr), intra_op_threads_(0), inter_op_threads_(0)
+{
+}
+
+InferenceRuntime::~InferenceRuntime()
+{
+    if (api_ && env_) api_->ReleaseEnv(env_);
+}
+
+OrtEnv* InferenceRuntime::env()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!api_) throw std::runtime_error("Fatal: Could not get ONNX Runtime API base.");
+    if (!env_) {
+        check(api_->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "VideoStreamClient", &env_), "CreateEnv");
+    }
+    return env_;
+}
+
+void InferenceRuntime::set_thread_counts(int intra_op_threads, int inter_op_threads)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    intra_op_threads_ = std::max(0, intra_op_threads);
+    inter_op_threads_ = std::max(0, inter_op_threads);
+}
+
+int InferenceRuntime::intra_op_threads() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return intra_op_threads_;
+}
+
+int InferenceRuntime::inter_op_threads() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return inter_op_threads_;
+}
+
+void InferenceRuntime::record_run(const std::string& tag, double elapsed_ms, bool rebound)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    InferenceTiming& timing = timings_[tag];
+    timing.tag = tag;
+    // avg_ms 在 take_timings 之前暂存累计值
+    timing.avg_ms += elapsed_ms;
+    timing.max_ms = std::max(timing.max_ms, elapsed_ms);
+    timing.runs++;
+    if (rebound) timing.rebinds++;
+}
+
+std::vector<InferenceTiming> InferenceRuntime::take_timings()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<InferenceTiming> result;
+    for (auto& entry : timings_) {
+        InferenceTiming timing = entry.second;
+        if (timing.runs > 0) timing.avg_ms /= timing.runs;
+        result.push_back(timing);
+        entry.second = InferenceTiming{};
+        entry.second.tag = entry.first;
+    }
+    return result;
+}
+
+void InferenceRuntime::check(OrtStatus* status, const char* context) const
+{
+    if (status == nullptr) return;
+    std::string error_message = "ONNX Runtime Error (";
+    error_message += context;
+    error_message += "): ";
+    error_message += api_->GetErrorMessage(status);
+    api_->ReleaseStatus(status);
+    throw std::runtime_error(error_message);
+}
+
+// ---------------- InferenceSession ----------------
+
+InferenceSession::InferenceSession(std::string tag)
+    : tag_(std::move(tag)), api_(InferenceRuntime::instance().api()), session_options_(nullptr), session_(nullptr),
+    io_binding_(nullptr), memory_info_(nullptr), outputs_bound_(false)
+{
+}
+
+InferenceSession::~InferenceSession()
+{
+    if (!api_) return;
+    for (Binding& binding : inputs_) release_binding(binding);
+    for (Binding& binding : outputs_) release_binding(binding);
+    if (io_binding_) api_->ReleaseIoBinding(io_binding_);
+    if (memory_info_) api_->ReleaseMemoryInfo(memory_info_);
+    if (session_) api_->ReleaseSession(session_);
+    if (session_options_) api_->ReleaseSessionOptions(session_options_);
+}
+
+bool InferenceSession::load(const std::string& model_path, bool try_cuda, std::string& error_message)
+{
+    InferenceRuntime& runtime = InferenceRuntime::instance();
+    try {
+        OrtEnv* env = runtime.env();
+        runtime.check(api_->CreateSessionOptions(&session_options_), "CreateSessionOptions");
+
+        const int intra = runtime.intra_op_threads();
+        const int inter = runtime.inter_op_threads();
+        if (intra > 0) runtime.check(api_->SetIntraOpNumThreads(session_options_, intra), "SetIntraOpNumThreads");
+        if (inter > 0) runtime.check(api_->SetInterOpNumThreads(session_options_, inter), "SetInterOpNumThreads");
+        if (inter > 1) runtime.check(api_->SetSessionExecutionMode(session_options_, ORT_PARALLEL), "SetSessionExecutionMode");
+        runtime.check(api_->SetSessionGraphOptimizationLevel(session_options_, ORT_ENABLE_ALL), "SetSessionGraphOptimizationLevel");
+
+        if (try_cuda) {
+            OrtCUDAProviderOptions cuda_options{};
+            OrtStatus* cuda_status = api_->SessionOptionsAppendExecutionProvider_CUDA(session_options_, &cuda_options);
+            if (cuda_status != nullptr) {
+                qWarning() << "[Inference]" << tag_.c_str() << "Could not enable CUDA execution provider. Reason:" << api_->GetErrorMessage(cuda_status);
+                api_->ReleaseStatus(cuda_status);
+                qWarning() << "[Inference]" << tag_.c_str() << "Falling back to CPU. Performance will be limited.";
+            }
+            else {
+                qInfo() << "[Inference]" << tag_.c_str() << "CUDA execution provider enabled successfully.";
+            }
+        }
+
+        std::wstring model_path_w(model_path.begin(), model_path.end());
+        runtime.check(api_->CreateSession(env, model_path_w.c_str(), session_options_, &session_), "CreateSession");
+        runtime.check(api_->CreateIoBinding(session_, &io_binding_), "CreateIoBinding");
+        runtime.check(api_->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info_), "CreateCpuMemoryInfo");
+
+        OrtAllocator* allocator = nullptr;
+        runtime.check(api_->GetAllocatorWithDefaultOptions(&allocator), "GetAllocatorWithDefaultOptions");
+
+        size_t num_input_nodes = 0, num_output_nodes = 0;
+        runtime.check(api_->SessionGetInputCount(session_, &num_input_nodes), "SessionGetInputCount");
+        runtime.check(api_->SessionGetOutputCount(session_, &num_output_nodes), "SessionGetOutputCount");
+        for (size_t i = 0; i < num_input_nodes; ++i) {
+            char* name = nullptr;
+            runtime.check(api_->SessionGetInputName(session_, i, allocator, &name), "SessionGetInputName");
+            input_names_.emplace_back(name);
+            allocator->Free(allocator, name);
+        }
+        for (size_t i = 0; i < num_output_nodes; ++i) {
+            char* name = nullptr;
+            runtime.check(api_->SessionGetOutputName(session_, i, allocator, &name), "SessionGetOutputName");
+            output_names_.emplace_back(name);
+            allocator->Free(allocator, name);
+        }
+        inputs_.resize(num_input_nodes);
+        outputs_.resize(num_output_nodes);
+
+        qInfo() << "[Inference]" << tag_.c_str() << "loaded, intra/inter threads:" << intra << "/" << inter;
+        return true;
+    }
+    catch (const std::runtime_error& e) {
+        error_message = e.what();
+        if (session_) { api_->ReleaseSession(session_); session_ = nullptr; }
+        return false;
+    }
+}
+
+std::vector<int64_t> InferenceSession::input_dims(size_t index) const
+{
+    InferenceRuntime& runtime = InferenceRuntime::instance();
+    OrtTypeInfo* type_info = nullptr;
+    runtime.check(api_->SessionGetInputTypeInfo(session_, index, &type_info), "SessionGetInputTypeInfo");
+    std::vector<int64_t> dims;
+    const OrtTensorTypeAndShapeInfo* tensor_info = nullptr;
+    size_t num_dims = 0;
+    OrtStatus* status = api_->CastTypeInfoToTensorInfo(type_info, &tensor_info);
+    if (!status && tensor_info) status = api_->GetDimensionsCount(tensor_info, &num_dims);
+    if (!status && tensor_info) {
+        dims.resize(num_dims);
+        status = api_->GetDimensions(tensor_info, dims.data(), num_dims);
+    }
+    api_->ReleaseTypeInfo(type_info);
+    runtime.check(status, "GetInputDimensions");
+    return dims;
+}
+
+void InferenceSession::release_binding(Binding& binding)
+{
+    if (binding.value) api_->ReleaseValue(binding.value);
+    binding.value = nullptr;
+    binding.data = nullptr;
+}
+
+void InferenceSession::bind_input(size_t index, void* data, size_t bytes, const std::vector<int64_t>& shape, ONNXTensorElementDataType type)
+{
+    Binding& binding = inputs_.at(index);
+    if (binding.value && binding.data == data && binding.shape == shape && binding.type == type) return;
+
+    InferenceRuntime& runtime = InferenceRuntime::instance();
+    // 形状变化时输出形状也可能随之变化，下一次运行重新确定输出
+    if (binding.shape != shape) outputs_bound_ = false;
+
+    release_binding(binding);
+    runtime.check(api_->CreateTensorWithDataAsOrtValue(memory_info_, data, bytes, shape.data(), shape.size(), type, &binding.value), "CreateTensorWithDataAsOrtValue");
+    binding.data = data;
+    binding.shape = shape;
+    binding.type = type;
+    runtime.check(api_->BindInput(io_binding_, input_names_[index].c_str(), binding.value), "BindInput");
+}
+
+void InferenceSession::adopt_outputs()
+{
+    InferenceRuntime& runtime = InferenceRuntime::instance();
+    OrtAllocator* allocator = nullptr;
+    runtime.check(api_->GetAllocatorWithDefaultOptions(&allocator), "GetAllocatorWithDefaultOptions");
+
+    OrtValue** values = nullptr;
+    size_t count = 0;
+    runtime.check(api_->GetBoundOutputValues(io_binding_, allocator, &values, &count), "GetBoundOutputValues");
+
+    OrtStatus* status = nullptr;
+    bool unsupported_type = false;
+    for (size_t i = 0; i < count && i < outputs_.size() && !status && !unsupported_type; ++i) {
+        Binding& binding = outputs_[i];
+        release_binding(binding);
+
+        OrtTensorTypeAndShapeInfo* shape_info = nullptr;
+        status = api_->GetTensorTypeAndShape(values[i], &shape_info);
+        size_t num_dims = 0;
+        if (!status) status = api_->GetDimensionsCount(shape_info, &num_dims);
+        if (!status) {
+            binding.shape.assign(num_dims, 0);
+            status = api_->GetDimensions(shape_info, binding.shape.data(), num_dims);
+        }
+        if (!status) status = api_->GetTensorElementType(shape_info, &binding.type);
+        if (shape_info) api_->ReleaseTensorTypeAndShapeInfo(shape_info);
+
+        if (!status && element_size(binding.type) == 0) {
+            unsupported_type = true;
+            break;
+        }
+
+        void* src = nullptr;
+        if (!status) status = api_->GetTensorMutableData(values[i], &src);
+        if (!status) {
+            size_t elements = 1;
+            for (int64_t dim : binding.shape) elements *= static_cast<size_t>(dim);
+            const size_t bytes = elements * element_size(binding.type);
+            binding.storage.resize(bytes);
+            std::memcpy(binding.storage.data(), src, bytes);
+            status = api_->CreateTensorWithDataAsOrtValue(memory_info_, binding.storage.data(), bytes,
+                binding.shape.data(), binding.shape.size(), binding.type, &binding.value);
+        }
+        if (!status) {
+            binding.data = binding.storage.data();
+            status = api_->BindOutput(io_binding_, output_names_[i].c_str(), binding.value);
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) api_->ReleaseValue(values[i]);
+    allocator->Free(allocator, values);
+    runtime.check(status, "AdoptOutputs");
+    if (unsupported_type) throw std::runtime_error("Unsupported output tensor element type (" + tag_ + ").");
+    outputs_bound_ = true;
+}
+
+void InferenceSession::run()
+{
+    InferenceRuntime& runtime = InferenceRuntime::instance();
+    const bool rebind = !outputs_bound_;
+    if (rebind) {
+        // 形状未知：先让 ONNX Runtime 分配输出，运行后再换成持久缓冲区
+        api_->ClearBoundOutputs(io_binding_);
+        for (const std::string& name : output_names_) {
+            runtime.check(api_->BindOutputToDevice(io_binding_, name.c_str(), memory_info_), "BindOutputToDevice");
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    runtime.check(api_->RunWithBinding(session_, nullptr, io_binding_), "RunWithBinding");
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (rebind) adopt_outputs();
+    runtime.record_run(tag_, elapsed_ms, rebind);
+}
+
+const void* InferenceSession::output_data(size_t index) const
+{
+    return outputs_.at(index).data;
+}
+
+const std::vector<int64_t>& InferenceSession::output_shape(size_t index) const
+{
+    return outputs_.at(index).shape;
+}
@@ -0,0 +1,112 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_c_api.h>
+
+// 某个模型会话的推理耗时统计（由 take_timings 取出后清零）
+struct InferenceTiming {
+    std::string tag;
+    int runs = 0;
+    double avg_ms = 0.0;
+    double max_ms = 0.0;
+    int rebinds = 0; // 因输入形状变化而重新绑定的次数
+};
+
+// 客户端共享的 ONNX Runtime 环境：整个进程只创建一个 OrtEnv，
+// 所有模型会话（RIFE、FSRCNN）使用同一套线程设置，并在这里汇总耗时。
+class InferenceRuntime
+{
+public:
+    static InferenceRuntime& instance();
+
+    const OrtApi* api() const { return api_; }
+    // 首次调用时创建 OrtEnv，失败抛出 std::runtime_error
+    OrtEnv* env();
+
+    // 之后创建的会话使用的线程数，0 表示使用 ONNX Runtime 默认值
+    void set_thread_counts(int intra_op_threads, int inter_op_threads);
+    int intra_op_threads() const;
+    int inter_op_threads() const;
+
+    void record_run(const std::string& tag, double elapsed_ms, bool rebound);
+    std::vector<InferenceTiming> take_timings();
+
+    // 把 OrtStatus 转换为异常（status 为空时什么也不做）
+    void check(OrtStatus* status, const char* context) const;
+
+    InferenceRuntime(const InferenceRuntime&) = delete;
+    InferenceRuntime& operator=(const InferenceRuntime&) = delete;
+
+private:
+    InferenceRuntime();
+    ~InferenceRuntime();
+
+    const OrtApi* api_;
+    OrtEnv* env_;
+    int intra_op_threads_;
+    int inter_op_threads_;
+    std::map<std::string, InferenceTiming> timings_;
+    mutable std::mutex mtx_;
+};
+
+// 单个模型会话 + OrtIoBinding。
+// - 输入由调用方提供持久缓冲区，地址与形状不变时不会重新绑定；
+// - 输出绑定到会话自有的持久缓冲区：输入形状变化后的第一次运行由 ONNX Runtime 分配输出，
+//   记下其形状后分配缓冲区并重新绑定，之后的帧直接写入同一缓冲区。
+// 一个会话只应在一个线程中使用。
+class InferenceSession
+{
+public:
+    explicit InferenceSession(std::string tag);
+    ~InferenceSession();
+
+    // try_cuda 为真时尝试启用 CUDA 执行提供程序，失败回退 CPU
+    bool load(const std::string& model_path, bool try_cuda, std::string& error_message);
+    bool is_loaded() const { return session_ != nullptr; }
+
+    size_t input_count() const { return input_names_.size(); }
+    size_t output_count() const { return output_names_.size(); }
+    // 模型声明的输入形状（-1 为动态维）
+    std::vector<int64_t> input_dims(size_t index) const;
+
+    void bind_input(size_t index, void* data, size_t bytes, const std::vector<int64_t>& shape, ONNXTensorElementDataType type);
+    // 执行一次推理，失败抛出 std::runtime_error
+    void run();
+
+    const void* output_data(size_t index) const;
+    const std::vector<int64_t>& output_shape(size_t index) const;
+
+    InferenceSession(const InferenceSession&) = delete;
+    InferenceSession& operator=(const InferenceSession&) = delete;
+
+private:
+    struct Binding {
+        OrtValue* value = nullptr;
+        const void* data = nullptr;
+        std::vector<int64_t> shape;
+        ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+        std::vector<uint8_t> storage; // 仅输出使用
+    };
+
+    void release_binding(Binding& binding);
+    void adopt_outputs(); // 把 ONNX Runtime 分配的输出转为持久缓冲区并绑定
+
+    std::string tag_;
+    const OrtApi* api_;
+    OrtSessionOptions* session_options_;
+    OrtSession* session_;
+    OrtIoBinding* io_binding_;
+    OrtMemoryInfo* memory_info_;
+    std::vector<std::string> input_names_;
+    std::vector<std::string> output_names_;
+    std::vector<Binding> inputs_;
+    std::vector<Binding> outputs_;
+    bool outputs_bound_;
+};
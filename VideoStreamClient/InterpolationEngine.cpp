@@ -0,0 +1,226 @@
+﻿#include "InterpolationEngine.h"
+#include "DecodedFrameBuffer.h"
+#include "MasterClock.h"
+#include "RIFEInterpolator.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace {
+    // 推理耗时估计的平滑系数
+    constexpr double INFERENCE_EMA_ALPHA = 0.2;
+    // 截止时间的安全余量（毫秒），覆盖入队与上传的开销
+    constexpr int64_t DEADLINE_MARGIN_MS = 5;
+    // 插帧倍数上限；不带 timestep 的模型以递归中点实现，只取 2 的幂
+    constexpr int MAX_MULTIPLIER = 4;
+    constexpr double DEFAULT_DISPLAY_INTERVAL_MS = 1000.0 / 60.0;
+    // 连续这么多帧对因截止时间跳过后，强制推理一次重新测量耗时；
+    // 否则一次偶发的慢推理会让估计停在高位，之后再也不会推理
+    constexpr int PROBE_AFTER_DEADLINE_SKIPS = 30;
+}
+
+InterpolationEngine::InterpolationEngine(DecodedFrameBuffer& buffer, MasterClock& clock, RIFEInterpolator& interpolator, QObject* parent)
+    : QObject(parent),
+    m_buffer(buffer),
+    m_clock(clock),
+    m_interpolator(interpolator),
+    m_running(false),
+    m_enabled(false),
+    m_resetRequested(false),
+    m_displayIntervalMs(DEFAULT_DISPLAY_INTERVAL_MS),
+    m_reduced(false)
+{
+}
+
+InterpolationEngine::~InterpolationEngine()
+{
+    stopInterpolating();
+}
+
+void InterpolationEngine::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    if (enabled) m_resetRequested = true;
+}
+
+void InterpolationEngine::requestReset()
+{
+    m_resetRequested = true;
+}
+
+InterpolationStats InterpolationEngine::takeStats()
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    InterpolationStats stats;
+    stats.generated = m_generated;
+    stats.dropped_deadline = m_droppedDeadline;
+    stats.avg_inference_ms = m_inferenceSamples > 0 ? m_inferenceSumMs / m_inferenceSamples : 0.0;
+    stats.multiplier = m_lastMultiplier;
+    stats.avg_pair_interval_ms = m_inferenceSamples > 0 ? static_cast<double>(m_pairIntervalSumMs) / m_inferenceSamples : 0.0;
+    m_generated = 0;
+    m_droppedDeadline = 0;
+    m_inferenceSumMs = 0.0;
+    m_inferenceSamples = 0;
+    m_pairIntervalSumMs = 0;
+    return stats;
+}
+
+void InterpolationEngine::setDisplayInterval(double interval_ms)
+{
+    if (interval_ms > 0.0) m_displayIntervalMs = interval_ms;
+}
+
+void InterpolationEngine::setReducedMode(bool reduced)
+{
+    m_reduced = reduced;
+}
+
+// 帧间隔约为刷新间隔的几倍就插几倍，取 2 的幂并限制在 [2, MAX_MULTIPLIER]
+int InterpolationEngine::chooseMultiplier(int64_t pair_interval_ms) const
+{
+    const double ratio = pair_interval_ms / m_displayIntervalMs.load();
+    const int max_multiplier = m_reduced ? 2 : MAX_MULTIPLIER;
+    int multiplier = 2;
+    while (multiplier * 2 <= max_multiplier && ratio >= multiplier * 2 - 0.5) {
+        multiplier *= 2;
+    }
+    // 中间帧之间至少相隔 1ms，否则 pts 会重复
+    while (multiplier > 2 && pair_interval_ms < multiplier) {
+        multiplier /= 2;
+    }
+    return multiplier;
+}
+
+void InterpolationEngine::startInterpolating()
+{
+    if (m_running) return;
+    m_running = true;
+    qDebug() << "[Interp] 插帧线程启动。";
+    interpolationLoop();
+    qDebug() << "[Interp] 插帧线程已退出。";
+}
+
+void InterpolationEngine::stopInterpolating()
+{
+    m_running = false;
+}
+
+void InterpolationEngine::interpolationLoop()
+{
+    while (m_running)
+    {
+        QCoreApplication::processEvents();
+
+        if (!m_enabled || !m_interpolator.is_initialized() || !m_clock.is_started() || m_clock.is_paused()) {
+            QThread::msleep(10);
+            continue;
+        }
+
+        if (m_resetRequested.exchange(false)) {
+            m_nextSearchPts = 0;
+            // 【新增】换片、跳转后 pts 会重复出现，丢弃按 pts 缓存的中间帧
+            m_interpolator.clear_cache();
+            // 【新增】重新启用或跳转后重新预热、测量推理耗时
+            m_inferenceEmaMs = 0.0;
+            m_warmupPending = true;
+            m_deadlineSkips = 0;
+        }
+
+        if (!processNextPair()) {
+            QThread::msleep(2);
+        }
+    }
+}
+
+bool InterpolationEngine::processNextPair()
+{
+    const int64_t now = m_clock.get_time_ms();
+    if (now < 0) return false;
+
+    AVFrame* prev = nullptr;
+    AVFrame* next = nullptr;
+    if (!m_buffer.get_interpolation_pair(std::max(now, m_nextSearchPts), prev, next)) {
+        return false;
+    }
+
+    const int64_t interval = next->pts - prev->pts;
+    const int multiplier = chooseMultiplier(interval);
+    const int64_t first_pts = prev->pts + interval / multiplier;
+    // 无论成败，这一对都不再重复尝试
+    m_nextSearchPts = next->pts;
+
+    // 【新增】降级模式下隔一对处理一对；被跳过的帧对之间没有中间帧，渲染线程逐 vsync 做线性混合
+    if (m_reduced) {
+        m_skipNextPair = !m_skipNextPair;
+        if (!m_skipNextPair) {
+            av_frame_free(&prev);
+            av_frame_free(&next);
+            return true;
+        }
+    }
+
+    // 截止时间判断：第一个中间帧必须在时钟走到它之前插入缓冲区
+    // 【修改】跳过的帧对同样由渲染线程线性混合；跳过不产生新样本，连续跳过足够多对后仍推理一次，用实测值替换估计
+    const int64_t expected_ready = now + static_cast<int64_t>(m_inferenceEmaMs) + DEADLINE_MARGIN_MS;
+    bool probe = false;
+    if (expected_ready >= first_pts) {
+        if (++m_deadlineSkips < PROBE_AFTER_DEADLINE_SKIPS) {
+            av_frame_free(&prev);
+            av_frame_free(&next);
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_droppedDeadline += multiplier - 1;
+            return true;
+        }
+        probe = true;
+    }
+    m_deadlineSkips = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<AVFrame*> results = m_interpolator.interpolate_steps(prev, next, multiplier);
+    const double elapsed_ms = timer.nsecsElapsed() / 1e6;
+    const int64_t prev_pts = prev->pts;
+    av_frame_free(&prev);
+    av_frame_free(&next);
+
+    if (m_warmupPending) {
+        m_warmupPending = false;
+    }
+    else if (probe || m_inferenceEmaMs <= 0.0) {
+        m_inferenceEmaMs = elapsed_ms;
+    }
+    else {
+        m_inferenceEmaMs += INFERENCE_EMA_ALPHA * (elapsed_ms - m_inferenceEmaMs);
+    }
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_inferenceSumMs += elapsed_ms;
+    m_inferenceSamples++;
+    // 降级模式下两对帧才推理一次，可用时间也按两对计
+    m_pairIntervalSumMs += m_reduced ? interval * 2 : interval;
+    m_lastMultiplier = multiplier;
+
+    const int64_t done = m_clock.get_time_ms();
+    for (size_t i = 0; i < results.size(); ++i) {
+        AVFrame* result = results[i];
+        if (!result) continue;
+        const int64_t pts = prev_pts + interval * static_cast<int64_t>(i + 1) / multiplier;
+        // 生成完成时若已经过了显示时刻，插入也只会被跳过
+        if (done >= pts) {
+            av_frame_free(&result);
+            m_droppedDeadline++;
+            continue;
+        }
+        result->pts = pts;
+        m_buffer.add_frame(std::make_unique<DecodedFrame>(result, true));
+        m_generated++;
+    }
+    return true;
+}
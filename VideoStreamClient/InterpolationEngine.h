@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <QObject>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+class DecodedFrameBuffer;
+class MasterClock;
+class RIFEInterpolator;
+
+// 插帧线程的统计信息（由 takeStats 取出后清零）
+struct InterpolationStats {
+    int generated = 0;          // 成功插入缓冲区的中间帧
+    int dropped_deadline = 0;   // 预计来不及而跳过、或生成后已过期的帧
+    double avg_inference_ms = 0.0;
+    int multiplier = 2;         // 【新增】最近一次使用的插帧倍数
+    double avg_pair_interval_ms = 0.0; // 【新增】每次推理平均可用的时间（推理过的帧对间隔，降级模式下按两对计）
+};
+
+// 后台 RIFE 插帧引擎：在时钟之前扫描 DecodedFrameBuffer 中相邻的原始帧对，
+// 按显示刷新间隔选择倍数（2x / 4x），一次生成该帧对之间的全部中间帧并插回缓冲区。
+// 渲染线程只需通过 get_frame 取用已完成的帧。
+// 若按当前推理耗时估计第一个中间帧无法在其显示时刻之前完成，则直接跳过该帧对。
+class InterpolationEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    InterpolationEngine(DecodedFrameBuffer& buffer, MasterClock& clock, RIFEInterpolator& interpolator, QObject* parent = nullptr);
+    ~InterpolationEngine();
+
+    // 以下接口可从任意线程调用
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+    // 缓冲区被清空（新播放/跳转）后调用，丢弃进度
+    void requestReset();
+    InterpolationStats takeStats();
+    // 【新增】显示器的刷新间隔（毫秒），用于决定插帧倍数
+    void setDisplayInterval(double interval_ms);
+    // 【新增】降级模式：倍数限制为 2x，并且每两对帧只处理一对（由 EnhancementGovernor 控制）
+    void setReducedMode(bool reduced);
+
+public slots:
+    void startInterpolating();
+    void stopInterpolating();
+
+private:
+    void interpolationLoop();
+    bool processNextPair();
+    int chooseMultiplier(int64_t pair_interval_ms) const;
+
+    DecodedFrameBuffer& m_buffer;
+    MasterClock& m_clock;
+    RIFEInterpolator& m_interpolator;
+
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_enabled;
+    std::atomic<bool> m_resetRequested;
+    std::atomic<double> m_displayIntervalMs;
+    std::atomic<bool> m_reduced;
+
+    int64_t m_nextSearchPts = 0;    // 下一次从该 pts 开始找帧对，跳过已尝试过的
+    double m_inferenceEmaMs = 0.0;  // 推理耗时的滑动平均，用于截止时间判断
+    bool m_warmupPending = true;    // 【新增】下一次推理是预热（会话首次运行），不计入耗时估计
+    int m_deadlineSkips = 0;        // 【新增】连续因截止时间跳过的帧对数，达到上限时强制推理一次重新测量
+    bool m_skipNextPair = false;    // 降级模式下交替跳过帧对
+
+    std::mutex m_statsMutex;
+    int m_generated = 0;
+    int m_droppedDeadline = 0;
+    double m_inferenceSumMs = 0.0;
+    int m_inferenceSamples = 0;
+    int64_t m_pairIntervalSumMs = 0;
+    int m_lastMultiplier = 2;
+};
@@ -0,0 +1,358 @@
+﻿#include "InterpolationKernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <atomic>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define INTERP_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define INTERP_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang 需要按函数开启指令集；MSVC 可以直接使用所有内建函数
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace InterpolationKernels {
+namespace {
+
+    // 一行亮度的边缘感知混合，处理 [begin, end) 区间，需要上下行和左右相邻像素
+    struct EdgeRow {
+        const uint8_t* prev_up;
+        const uint8_t* prev;
+        const uint8_t* prev_down;
+        const uint8_t* next_up;
+        const uint8_t* next;
+        const uint8_t* next_down;
+        uint8_t* dst;
+    };
+
+    using EdgeRowFn = void(*)(const EdgeRow& row, int begin, int end, int weight, int edge_weight);
+    using BlendRowFn = void(*)(const uint8_t* prev, const uint8_t* next, uint8_t* dst, int begin, int end, int weight);
+
+    struct KernelTable {
+        Isa isa;
+        EdgeRowFn edge_row;
+        BlendRowFn blend_row;
+    };
+
+    // ---------------- 标量参考实现 ----------------
+
+    inline uint8_t lerp_q8(int p, int n, int weight) {
+        return static_cast<uint8_t>((p * (256 - weight) + n * weight + 128) >> 8);
+    }
+
+    inline int abs_diff(int a, int b) {
+        return a > b ? a - b : b - a;
+    }
+
+    void blend_row_scalar(const uint8_t* prev, const uint8_t* next, uint8_t* dst, int begin, int end, int weight) {
+        for (int x = begin; x < end; ++x) {
+            dst[x] = lerp_q8(prev[x], next[x], weight);
+        }
+    }
+
+    void edge_row_scalar(const EdgeRow& r, int begin, int end, int weight, int edge_weight) {
+        // 先取到局部变量：dst 的写入是 uint8_t，编译器否则会假设它可能改写 r 中的指针
+        const uint8_t* prev_up = r.prev_up;
+        const uint8_t* prev = r.prev;
+        const uint8_t* prev_down = r.prev_down;
+        const uint8_t* next_up = r.next_up;
+        const uint8_t* next = r.next;
+        const uint8_t* next_down = r.next_down;
+        uint8_t* dst = r.dst;
+        for (int x = begin; x < end; ++x) {
+            const int gp = std::max(abs_diff(prev[x + 1], prev[x - 1]), abs_diff(prev_down[x], prev_up[x]));
+            const int gn = std::max(abs_diff(next[x + 1], next[x - 1]), abs_diff(next_down[x], next_up[x]));
+            // 掩码选择权重，避免分支
+            const int edge_mask = -static_cast<int>(std::max(gp, gn) > EDGE_GRADIENT_THRESHOLD);
+            const int w = weight ^ ((weight ^ edge_weight) & edge_mask);
+            dst[x] = lerp_q8(prev[x], next[x], w);
+        }
+    }
+
+    const KernelTable SCALAR_TABLE = { Isa::Scalar, &edge_row_scalar, &blend_row_scalar };
+
+#if defined(INTERP_X86)
+    // ---------------- SSE4.1 ----------------
+
+    TARGET_SSE41 inline __m128i abs_diff_epu8(__m128i a, __m128i b) {
+        return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+    }
+
+    // 16 位通道上的 (p * (256 - w) + n * w + 128) >> 8，乘积与和都不超过 65408，无溢出
+    TARGET_SSE41 inline __m128i lerp_q8_epi16(__m128i p, __m128i n, __m128i w) {
+        const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(256), w);
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(p, inv), _mm_mullo_epi16(n, w));
+        sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+        return _mm_srli_epi16(sum, 8);
+    }
+
+    TARGET_SSE41 void blend_row_sse41(const uint8_t* prev, const uint8_t* next, uint8_t* dst, int begin, int end, int weight) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i w = _mm_set1_epi16(static_cast<short>(weight));
+        int x = begin;
+        for (; x + 16 <= end; x += 16) {
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+            const __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(next + x));
+            const __m128i lo = lerp_q8_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi8(n, zero), w);
+            const __m128i hi = lerp_q8_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi8(n, zero), w);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+        }
+        blend_row_scalar(prev, next, dst, x, end, weight);
+    }
+
+    TARGET_SSE41 void edge_row_sse41(const EdgeRow& r, int begin, int end, int weight, int edge_weight) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i threshold = _mm_set1_epi8(static_cast<char>(EDGE_GRADIENT_THRESHOLD));
+        const __m128i w = _mm_set1_epi16(static_cast<short>(weight));
+        const __m128i we = _mm_set1_epi16(static_cast<short>(edge_weight));
+        int x = begin;
+        // 需要读取 x + 16 处的右邻像素，因此 x + 16 <= end (end 为宽度 - 1)
+        for (; x + 16 <= end; x += 16) {
+            const __m128i gp = _mm_max_epu8(
+                abs_diff_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r.prev + x + 1)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.prev + x - 1))),
+                abs_diff_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r.prev_down + x)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.prev_up + x))));
+            const __m128i gn = _mm_max_epu8(
+                abs_diff_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r.next + x + 1)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.next + x - 1))),
+                abs_diff_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r.next_down + x)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.next_up + x))));
+            // g > T  <=>  subs(g, T) != 0；edge 为 0xFF 的通道使用 edge_weight
+            const __m128i flat = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_max_epu8(gp, gn), threshold), zero);
+            const __m128i edge = _mm_xor_si128(flat, _mm_set1_epi8(-1));
+
+            const __m128i w_lo = _mm_blendv_epi8(w, we, _mm_unpacklo_epi8(edge, edge));
+            const __m128i w_hi = _mm_blendv_epi8(w, we, _mm_unpackhi_epi8(edge, edge));
+
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.prev + x));
+            const __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r.next + x));
+            const __m128i lo = lerp_q8_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi8(n, zero), w_lo);
+            const __m128i hi = lerp_q8_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi8(n, zero), w_hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(r.dst + x), _mm_packus_epi16(lo, hi));
+        }
+        edge_row_scalar(r, x, end, weight, edge_weight);
+    }
+
+    const KernelTable SSE41_TABLE = { Isa::SSE41, &edge_row_sse41, &blend_row_sse41 };
+
+    // ---------------- AVX2 ----------------
+    // unpack/pack 都在 128 位通道内进行，二者配对使用时像素顺序保持不变
+
+    TARGET_AVX2 inline __m256i abs_diff_epu8_avx2(__m256i a, __m256i b) {
+        return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+    }
+
+    TARGET_AVX2 inline __m256i lerp_q8_epi16_avx2(__m256i p, __m256i n, __m256i w) {
+        const __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(256), w);
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(p, inv), _mm256_mullo_epi16(n, w));
+        sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(sum, 8);
+    }
+
+    TARGET_AVX2 inline __m256i load256(const uint8_t* ptr) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    }
+
+    TARGET_AVX2 void blend_row_avx2(const uint8_t* prev, const uint8_t* next, uint8_t* dst, int begin, int end, int weight) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i w = _mm256_set1_epi16(static_cast<short>(weight));
+        int x = begin;
+        for (; x + 32 <= end; x += 32) {
+            const __m256i p = load256(prev + x);
+            const __m256i n = load256(next + x);
+            const __m256i lo = lerp_q8_epi16_avx2(_mm256_unpacklo_epi8(p, zero), _mm256_unpacklo_epi8(n, zero), w);
+            const __m256i hi = lerp_q8_epi16_avx2(_mm256_unpackhi_epi8(p, zero), _mm256_unpackhi_epi8(n, zero), w);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_packus_epi16(lo, hi));
+        }
+        blend_row_sse41(prev, next, dst, x, end, weight);
+    }
+
+    TARGET_AVX2 void edge_row_avx2(const EdgeRow& r, int begin, int end, int weight, int edge_weight) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i threshold = _mm256_set1_epi8(static_cast<char>(EDGE_GRADIENT_THRESHOLD));
+        const __m256i w = _mm256_set1_epi16(static_cast<short>(weight));
+        const __m256i we = _mm256_set1_epi16(static_cast<short>(edge_weight));
+        int x = begin;
+        for (; x + 32 <= end; x += 32) {
+            const __m256i gp = _mm256_max_epu8(
+                abs_diff_epu8_avx2(load256(r.prev + x + 1), load256(r.prev + x - 1)),
+                abs_diff_epu8_avx2(load256(r.prev_down + x), load256(r.prev_up + x)));
+            const __m256i gn = _mm256_max_epu8(
+                abs_diff_epu8_avx2(load256(r.next + x + 1), load256(r.next + x - 1)),
+                abs_diff_epu8_avx2(load256(r.next_down + x), load256(r.next_up + x)));
+            const __m256i flat = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_max_epu8(gp, gn), threshold), zero);
+            const __m256i edge = _mm256_xor_si256(flat, _mm256_set1_epi8(-1));
+
+            const __m256i w_lo = _mm256_blendv_epi8(w, we, _mm256_unpacklo_epi8(edge, edge));
+            const __m256i w_hi = _mm256_blendv_epi8(w, we, _mm256_unpackhi_epi8(edge, edge));
+
+            const __m256i p = load256(r.prev + x);
+            const __m256i n = load256(r.next + x);
+            const __m256i lo = lerp_q8_epi16_avx2(_mm256_unpacklo_epi8(p, zero), _mm256_unpacklo_epi8(n, zero), w_lo);
+            const __m256i hi = lerp_q8_epi16_avx2(_mm256_unpackhi_epi8(p, zero), _mm256_unpackhi_epi8(n, zero), w_hi);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(r.dst + x), _mm256_packus_epi16(lo, hi));
+        }
+        edge_row_sse41(r, x, end, weight, edge_weight);
+    }
+
+    const KernelTable AVX2_TABLE = { Isa::AVX2, &edge_row_avx2, &blend_row_avx2 };
+#endif
+
+#if defined(INTERP_NEON)
+    // ---------------- NEON ----------------
+
+    inline uint8x8_t lerp_q8_u16(uint8x8_t p, uint8x8_t n, uint16x8_t w) {
+        const uint16x8_t inv = vsubq_u16(vdupq_n_u16(256), w);
+        uint16x8_t sum = vmulq_u16(vmovl_u8(p), inv);
+        sum = vmlaq_u16(sum, vmovl_u8(n), w);
+        sum = vaddq_u16(sum, vdupq_n_u16(128));
+        return vshrn_n_u16(sum, 8);
+    }
+
+    void blend_row_neon(const uint8_t* prev, const uint8_t* next, uint8_t* dst, int begin, int end, int weight) {
+        const uint16x8_t w = vdupq_n_u16(static_cast<uint16_t>(weight));
+        int x = begin;
+        for (; x + 16 <= end; x += 16) {
+            const uint8x16_t p = vld1q_u8(prev + x);
+            const uint8x16_t n = vld1q_u8(next + x);
+            const uint8x8_t lo = lerp_q8_u16(vget_low_u8(p), vget_low_u8(n), w);
+            const uint8x8_t hi = lerp_q8_u16(vget_high_u8(p), vget_high_u8(n), w);
+            vst1q_u8(dst + x, vcombine_u8(lo, hi));
+        }
+        blend_row_scalar(prev, next, dst, x, end, weight);
+    }
+
+    void edge_row_neon(const EdgeRow& r, int begin, int end, int weight, int edge_weight) {
+        const uint8x16_t threshold = vdupq_n_u8(static_cast<uint8_t>(EDGE_GRADIENT_THRESHOLD));
+        const uint16x8_t w = vdupq_n_u16(static_cast<uint16_t>(weight));
+        const uint16x8_t we = vdupq_n_u16(static_cast<uint16_t>(edge_weight));
+        int x = begin;
+        for (; x + 16 <= end; x += 16) {
+            const uint8x16_t gp = vmaxq_u8(vabdq_u8(vld1q_u8(r.prev + x + 1), vld1q_u8(r.prev + x - 1)),
+                vabdq_u8(vld1q_u8(r.prev_down + x), vld1q_u8(r.prev_up + x)));
+            const uint8x16_t gn = vmaxq_u8(vabdq_u8(vld1q_u8(r.next + x + 1), vld1q_u8(r.next + x - 1)),
+                vabdq_u8(vld1q_u8(r.next_down + x), vld1q_u8(r.next_up + x)));
+            const uint8x16_t edge = vcgtq_u8(vmaxq_u8(gp, gn), threshold);
+            // 0xFF 掩码符号扩展到 16 位
+            const uint16x8_t edge_lo = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(vget_low_u8(edge))));
+            const uint16x8_t edge_hi = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(vget_high_u8(edge))));
+
+            const uint8x16_t p = vld1q_u8(r.prev + x);
+            const uint8x16_t n = vld1q_u8(r.next + x);
+            const uint8x8_t lo = lerp_q8_u16(vget_low_u8(p), vget_low_u8(n), vbslq_u16(edge_lo, we, w));
+            const uint8x8_t hi = lerp_q8_u16(vget_high_u8(p), vget_high_u8(n), vbslq_u16(edge_hi, we, w));
+            vst1q_u8(r.dst + x, vcombine_u8(lo, hi));
+        }
+        edge_row_scalar(r, x, end, weight, edge_weight);
+    }
+
+    const KernelTable NEON_TABLE = { Isa::NEON, &edge_row_neon, &blend_row_neon };
+#endif
+
+    const KernelTable* table_for(Isa isa) {
+        const CpuFeatures& cpu = CpuFeatures::get();
+        switch (isa) {
+        case Isa::Scalar:
+            return &SCALAR_TABLE;
+#if defined(INTERP_X86)
+        case Isa::SSE41:
+            return cpu.sse41 ? &SSE41_TABLE : nullptr;
+        case Isa::AVX2:
+            return (cpu.avx2 && cpu.sse41) ? &AVX2_TABLE : nullptr;
+#endif
+#if defined(INTERP_NEON)
+        case Isa::NEON:
+            return cpu.neon ? &NEON_TABLE : nullptr;
+#endif
+        default:
+            return nullptr;
+        }
+    }
+
+    const KernelTable* best_table() {
+        for (Isa isa : { Isa::AVX2, Isa::SSE41, Isa::NEON }) {
+            if (const KernelTable* table = table_for(isa)) return table;
+        }
+        return &SCALAR_TABLE;
+    }
+
+    std::atomic<const KernelTable*>& current_table() {
+        static std::atomic<const KernelTable*> table{ best_table() };
+        return table;
+    }
+
+    inline int clamp_weight(int weight) {
+        return std::min(256, std::max(0, weight));
+    }
+}
+
+void blend_plane(const Plane& plane, int weight_q8)
+{
+    const KernelTable* table = current_table().load(std::memory_order_relaxed);
+    const int w = clamp_weight(weight_q8);
+    for (int y = 0; y < plane.height; ++y) {
+        table->blend_row(plane.prev + static_cast<ptrdiff_t>(y) * plane.prev_stride,
+            plane.next + static_cast<ptrdiff_t>(y) * plane.next_stride,
+            plane.dst + static_cast<ptrdiff_t>(y) * plane.dst_stride,
+            0, plane.width, w);
+    }
+}
+
+void blend_luma(const Plane& plane, int weight_q8, int edge_weight_q8)
+{
+    const int w = clamp_weight(weight_q8);
+    const int we = clamp_weight(edge_weight_q8);
+    if (plane.width < 3 || plane.height < 3) {
+        blend_plane(plane, w);
+        return;
+    }
+
+    const KernelTable* table = current_table().load(std::memory_order_relaxed);
+    auto prev_row = [&](int y) { return plane.prev + static_cast<ptrdiff_t>(y) * plane.prev_stride; };
+    auto next_row = [&](int y) { return plane.next + static_cast<ptrdiff_t>(y) * plane.next_stride; };
+    auto dst_row = [&](int y) { return plane.dst + static_cast<ptrdiff_t>(y) * plane.dst_stride; };
+
+    // 首尾两行没有上下邻居，按普通权重混合
+    table->blend_row(prev_row(0), next_row(0), dst_row(0), 0, plane.width, w);
+    table->blend_row(prev_row(plane.height - 1), next_row(plane.height - 1), dst_row(plane.height - 1), 0, plane.width, w);
+
+    for (int y = 1; y < plane.height - 1; ++y) {
+        EdgeRow row{ prev_row(y - 1), prev_row(y), prev_row(y + 1), next_row(y - 1), next_row(y), next_row(y + 1), dst_row(y) };
+        // 首尾两列同理
+        row.dst[0] = lerp_q8(row.prev[0], row.next[0], w);
+        row.dst[plane.width - 1] = lerp_q8(row.prev[plane.width - 1], row.next[plane.width - 1], w);
+        table->edge_row(row, 1, plane.width - 1, w, we);
+    }
+}
+
+Isa active_isa()
+{
+    return current_table().load()->isa;
+}
+
+const char* isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar: return "Scalar";
+    case Isa::SSE41: return "SSE4.1";
+    case Isa::AVX2: return "AVX2";
+    case Isa::NEON: return "NEON";
+    }
+    return "Unknown";
+}
+
+bool select_isa(Isa isa)
+{
+    const KernelTable* table = table_for(isa);
+    if (!table) return false;
+    current_table().store(table);
+    return true;
+}
+
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// YUV420P 帧间插值（线性混合）的 SIMD 内核。
+// 权重使用 Q8 定点数: out = (prev * (256 - w) + next * w + 128) >> 8。
+// 亮度平面在内部像素上做边缘感知：任一帧的局部梯度超过阈值时改用 edge_weight，
+// 选择通过比较掩码完成，没有分支。所有实现与标量参考版逐字节一致。
+namespace InterpolationKernels {
+
+    enum class Isa { Scalar, SSE41, AVX2, NEON };
+
+    struct Plane {
+        const uint8_t* prev;
+        int prev_stride;
+        const uint8_t* next;
+        int next_stride;
+        uint8_t* dst;
+        int dst_stride;
+        int width;
+        int height;
+    };
+
+    // 亮度平面：边缘感知混合（边界行列使用普通权重）
+    void blend_luma(const Plane& plane, int weight_q8, int edge_weight_q8);
+    // 色度平面：普通混合
+    void blend_plane(const Plane& plane, int weight_q8);
+
+    // 当前使用的实现，默认取 CPU 支持的最优者
+    Isa active_isa();
+    const char* isa_name(Isa isa);
+    // 强制切换实现（用于对比验证），CPU 不支持时返回 false
+    bool select_isa(Isa isa);
+
+    // 梯度阈值，与原标量实现一致
+    constexpr int EDGE_GRADIENT_THRESHOLD = 20;
+}
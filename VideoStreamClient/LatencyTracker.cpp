@@ -0,0 +1,131 @@
+﻿#include "LatencyTracker.h"
+#include <algorithm>
+#include <chrono>
+
+LatencyTracker::LatencyTracker()
+{
+    reset();
+}
+
+int64_t LatencyTracker::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void LatencyTracker::reset()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_.clear();
+    clock_samples_.clear();
+    clock_synced_ = false;
+    clock_offset_us_ = 0;
+    clock_rtt_us_ = 0;
+    frames_ = 0;
+    synced_frames_ = 0;
+    convert_sum_ms_ = 0.0;
+    ring_wait_sum_ms_ = 0.0;
+    encode_sum_ms_ = 0.0;
+    packetize_sum_ms_ = 0.0;
+    client_sum_ms_ = 0.0;
+    network_sum_ms_ = 0.0;
+    total_sum_ms_ = 0.0;
+    max_total_ms_ = 0.0;
+}
+
+void LatencyTracker::on_clock_sample(int64_t client_send_ms, int64_t server_us, int64_t client_recv_ms)
+{
+    const int64_t rtt_us = (client_recv_ms - client_send_ms) * 1000;
+    if (rtt_us < 0) {
+        return;
+    }
+    // 假设去程与回程对称：服务端回复的时刻对应客户端发出与收到的中点
+    const int64_t offset_us = server_us - (client_send_ms + client_recv_ms) * 1000 / 2;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    clock_samples_.push_back({ rtt_us, offset_us });
+    while (clock_samples_.size() > CLOCK_SAMPLE_WINDOW) {
+        clock_samples_.pop_front();
+    }
+    // 往返时延最小的样本受排队影响最小
+    const auto best = std::min_element(clock_samples_.begin(), clock_samples_.end(),
+        [](const ClockSample& a, const ClockSample& b) { return a.rtt_us < b.rtt_us; });
+    clock_offset_us_ = best->offset_us;
+    clock_rtt_us_ = best->rtt_us;
+    clock_synced_ = true;
+}
+
+void LatencyTracker::on_frame_timing(int64_t pts, const FrameTimingSample& timing, int64_t arrival_us)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_[pts] = { timing, arrival_us };
+    while (pending_.size() > MAX_PENDING_FRAMES) {
+        pending_.erase(pending_.begin());
+    }
+}
+
+void LatencyTracker::on_frame_presented(int64_t pts)
+{
+    const int64_t present_us = now_us();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = pending_.find(pts);
+    if (it != pending_.end()) {
+        const FrameTimingSample& timing = it->second.timing;
+        const int64_t arrival_us = it->second.arrival_us;
+
+        frames_++;
+        convert_sum_ms_ += timing.converted_us / 1000.0;
+        ring_wait_sum_ms_ += (static_cast<int64_t>(timing.encode_start_us) - timing.converted_us) / 1000.0;
+        encode_sum_ms_ += (static_cast<int64_t>(timing.encoded_us) - timing.encode_start_us) / 1000.0;
+        packetize_sum_ms_ += (static_cast<int64_t>(timing.sent_us) - timing.encoded_us) / 1000.0;
+        client_sum_ms_ += (present_us - arrival_us) / 1000.0;
+
+        if (clock_synced_) {
+            // 换算到服务端时钟后与采集时刻相减
+            const double total_ms = (present_us + clock_offset_us_ - timing.capture_wall_us) / 1000.0;
+            const double network_ms = (arrival_us + clock_offset_us_ - timing.capture_wall_us - timing.sent_us) / 1000.0;
+            synced_frames_++;
+            network_sum_ms_ += network_ms;
+            total_sum_ms_ += total_ms;
+            max_total_ms_ = std::max(max_total_ms_, total_ms);
+        }
+    }
+    // 更早的帧不会再呈现
+    pending_.erase(pending_.begin(), pending_.upper_bound(pts));
+}
+
+LatencyStats LatencyTracker::take_stats()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    LatencyStats stats;
+    stats.frames = frames_;
+    stats.clock_synced = clock_synced_;
+    stats.clock_offset_ms = clock_offset_us_ / 1000.0;
+    stats.clock_rtt_ms = clock_rtt_us_ / 1000.0;
+    if (frames_ > 0) {
+        stats.convert_ms = convert_sum_ms_ / frames_;
+        stats.ring_wait_ms = ring_wait_sum_ms_ / frames_;
+        stats.encode_ms = encode_sum_ms_ / frames_;
+        stats.packetize_ms = packetize_sum_ms_ / frames_;
+        stats.client_ms = client_sum_ms_ / frames_;
+    }
+    if (synced_frames_ > 0) {
+        stats.network_ms = network_sum_ms_ / synced_frames_;
+        stats.total_ms = total_sum_ms_ / synced_frames_;
+        stats.max_total_ms = max_total_ms_;
+    }
+
+    frames_ = 0;
+    synced_frames_ = 0;
+    convert_sum_ms_ = 0.0;
+    ring_wait_sum_ms_ = 0.0;
+    encode_sum_ms_ = 0.0;
+    packetize_sum_ms_ = 0.0;
+    client_sum_ms_ = 0.0;
+    network_sum_ms_ = 0.0;
+    total_sum_ms_ = 0.0;
+    max_total_ms_ = 0.0;
+    return stats;
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <mutex>
+#include <cstdint>
+#include <deque>
+#include <map>
+
+// 服务端一帧各阶段的时间（VideoTiming 数据报），偏移均相对采集时刻
+struct FrameTimingSample
+{
+    int64_t capture_wall_us = 0; // 服务端系统时钟（Unix 微秒）
+    uint32_t converted_us = 0;
+    uint32_t encode_start_us = 0;
+    uint32_t encoded_us = 0;
+    uint32_t sent_us = 0;
+};
+
+// 统计窗口内各阶段的平均时延（毫秒）
+struct LatencyStats
+{
+    int frames = 0;               // 已呈现并完成测量的帧数
+    bool clock_synced = false;    // 尚无心跳样本时，网络与合计两项为 0
+    double convert_ms = 0.0;      // 采集 -> 转换完成
+    double ring_wait_ms = 0.0;    // 转换完成 -> 开始编码
+    double encode_ms = 0.0;       // 开始编码 -> 编码完成
+    double packetize_ms = 0.0;    // 编码完成 -> 交给发送调度器
+    double network_ms = 0.0;      // 交给发送调度器 -> 客户端收到（含发送队列）
+    double client_ms = 0.0;       // 客户端收到 -> 呈现（抖动缓冲、解码、帧缓冲）
+    double total_ms = 0.0;
+    double max_total_ms = 0.0;
+    double clock_offset_ms = 0.0; // 服务端时钟 - 客户端时钟
+    double clock_rtt_ms = 0.0;    // 所用心跳样本的往返时延，时钟差的误差不超过它的一半
+};
+
+// 端到端时延测量：从服务端采集到客户端把帧交给渲染。
+// 服务端随每帧发来采集时刻与各阶段偏移，客户端记录收到与呈现的时刻（系统时钟）；
+// 两端时钟差由心跳往返按 NTP 的方式估计，取最近若干次中往返时延最小的一次
+class LatencyTracker
+{
+public:
+    LatencyTracker();
+
+    void reset();
+    // 心跳回复：客户端发出与收到的时刻（系统时钟毫秒），服务端回复时的时刻（系统时钟微秒）
+    void on_clock_sample(int64_t client_send_ms, int64_t server_us, int64_t client_recv_ms);
+    // 收到 VideoTiming 数据报，arrival_us 为客户端系统时钟
+    void on_frame_timing(int64_t pts, const FrameTimingSample& timing, int64_t arrival_us);
+    // 原始帧交给渲染时调用（GUI 线程），插帧结果不计
+    void on_frame_presented(int64_t pts);
+    // 取出统计窗口内的平均值并清零计数
+    LatencyStats take_stats();
+
+    // 客户端系统时钟（Unix 微秒）
+    static int64_t now_us();
+
+private:
+    // 等待呈现的帧数上限，超出时丢弃最旧的记录
+    static constexpr size_t MAX_PENDING_FRAMES = 300;
+    // 参与时钟差估计的最近心跳样本数
+    static constexpr size_t CLOCK_SAMPLE_WINDOW = 16;
+
+    struct PendingFrame
+    {
+        FrameTimingSample timing;
+        int64_t arrival_us;
+    };
+
+    struct ClockSample
+    {
+        int64_t rtt_us;
+        int64_t offset_us;
+    };
+
+    std::mutex mtx_;
+
+    std::map<int64_t, PendingFrame> pending_; // pts -> 服务端时间与到达时刻
+    std::deque<ClockSample> clock_samples_;
+    bool clock_synced_;
+    int64_t clock_offset_us_;
+    int64_t clock_rtt_us_;
+
+    int frames_;
+    int synced_frames_;
+    double convert_sum_ms_;
+    double ring_wait_sum_ms_;
+    double encode_sum_ms_;
+    double packetize_sum_ms_;
+    double client_sum_ms_;
+    double network_sum_ms_;
+    double total_sum_ms_;
+    double max_total_ms_;
+};
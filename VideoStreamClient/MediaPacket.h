@@ -1,11 +1,13 @@
 ﻿#pragma once
 #include <cstdint>
 #include <QByteArray> 
+#include "shared_config.h"
 
 struct MediaPacket {
     uint32_t seq;
     int64_t ts;
     QByteArray payload; //类型改为 QByteArray
+    AppConfig::PacketType type = AppConfig::PacketType::Audio; // 【新增】音频包的编码（原始 PCM / Opus）
 
     bool operator>(const MediaPacket& other) const {
         return seq > other.seq;
@@ -0,0 +1,181 @@
+﻿#include "PresentationScheduler.h"
+#include <QOpenGLWidget>
+#include <QScreen>
+#include <QWindow>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // 刷新周期估计的平滑系数
+    constexpr double REFRESH_EMA_ALPHA = 0.05;
+    // 若超过该时长没有发生交换（窗口被遮挡、最小化等），由看门狗重新驱动循环
+    constexpr int WATCHDOG_INTERVAL_MS = 100;
+    // 等待显示的帧最多记录这么多，异常情况下（如停止绘制）不无限增长
+    constexpr size_t MAX_PENDING_TARGETS = 64;
+}
+
+PresentationScheduler::PresentationScheduler(QOpenGLWidget* widget, QObject* parent)
+    : QObject(parent), m_widget(widget)
+{
+    m_clock.start();
+
+    m_watchdogTimer = new QTimer(this);
+    m_watchdogTimer->setSingleShot(true);
+    connect(m_watchdogTimer, &QTimer::timeout, this, &PresentationScheduler::onWatchdogTimeout);
+
+    if (m_widget) {
+        connect(m_widget, &QOpenGLWidget::frameSwapped, this, &PresentationScheduler::onFrameSwapped);
+        // 用屏幕报告的刷新率作为初值，之后以实测的交换间隔为准
+        QScreen* screen = m_widget->screen();
+        if (screen && screen->refreshRate() > 1.0) {
+            m_refreshIntervalMs = 1000.0 / screen->refreshRate();
+        }
+    }
+}
+
+PresentationScheduler::~PresentationScheduler() = default;
+
+void PresentationScheduler::start()
+{
+    if (m_running) return;
+    m_running = true;
+    m_lastSwapMs = -1.0;
+    m_predictedVsyncMs = -1.0;
+    m_pendingTargets.clear();
+    m_paintedPts = -1;
+    m_swapsShowingLast = 0;
+    m_lastDisplayedPts = -1;
+    qDebug() << "[Presenter] 呈现调度已启动，初始刷新周期:" << m_refreshIntervalMs << "ms";
+    scheduleNextSwap();
+}
+
+void PresentationScheduler::stop()
+{
+    m_running = false;
+    m_watchdogTimer->stop();
+}
+
+void PresentationScheduler::scheduleNextSwap()
+{
+    if (!m_running || !m_widget) return;
+    m_widget->update();
+    m_watchdogTimer->start(WATCHDOG_INTERVAL_MS);
+}
+
+void PresentationScheduler::onFrameSwapped()
+{
+    if (!m_running) return;
+
+    const double now = m_clock.nsecsElapsed() / 1e6;
+
+    if (m_lastSwapMs >= 0.0) {
+        const double interval = now - m_lastSwapMs;
+        // 只用接近一个刷新周期的间隔更新估计，漏掉的 vsync 或卡顿不参与平滑
+        if (interval > m_refreshIntervalMs * 0.5 && interval < m_refreshIntervalMs * 1.5) {
+            m_refreshIntervalMs += REFRESH_EMA_ALPHA * (interval - m_refreshIntervalMs);
+        }
+    }
+    m_lastSwapMs = now;
+
+    // 【修改】这次交换显示的是上一次 paintGL 绘制的帧
+    if (m_paintedPts >= 0 && m_paintedPts != m_lastDisplayedPts) {
+        onFrameDisplayed(m_paintedPts, now);
+    }
+    else if (m_lastDisplayedPts >= 0) {
+        m_swapsShowingLast++;
+    }
+
+    m_predictedVsyncMs = now + m_refreshIntervalMs;
+
+    emit vsyncTick(m_predictedVsyncMs - m_clock.nsecsElapsed() / 1e6);
+
+    scheduleNextSwap();
+}
+
+void PresentationScheduler::onWatchdogTimeout()
+{
+    if (!m_running) return;
+    // 交换停滞期间的预测已失效，重新开始测量
+    m_lastSwapMs = -1.0;
+    m_predictedVsyncMs = -1.0;
+    emit vsyncTick(m_refreshIntervalMs);
+    scheduleNextSwap();
+}
+
+void PresentationScheduler::notifyFrameQueued(int64_t pts_ms, int64_t target_pts_ms)
+{
+    // vsyncTick 的目标媒体时间对应预测的下一次 vsync，媒体时钟以 1 倍速推进
+    const double vsync_ms = m_predictedVsyncMs >= 0.0 ? m_predictedVsyncMs : m_clock.nsecsElapsed() / 1e6 + m_refreshIntervalMs;
+    m_pendingTargets[pts_ms] = vsync_ms + static_cast<double>(pts_ms - target_pts_ms);
+    while (m_pendingTargets.size() > MAX_PENDING_TARGETS) {
+        m_pendingTargets.erase(m_pendingTargets.begin());
+    }
+}
+
+void PresentationScheduler::onFramePainted(qint64 pts_ms)
+{
+    m_paintedPts = pts_ms;
+}
+
+void PresentationScheduler::onFrameDisplayed(int64_t pts_ms, double display_ms)
+{
+    if (m_lastDisplayedPts >= 0 && pts_ms < m_lastDisplayedPts) {
+        // PTS 回退（跳转、重新播放）：之前的记录已无意义
+        m_lastDisplayedPts = -1;
+        m_swapsShowingLast = 0;
+        for (auto it = m_pendingTargets.begin(); it != m_pendingTargets.end() && it->first < pts_ms; ) {
+            it = m_pendingTargets.erase(it);
+        }
+    }
+
+    // 在它之前派发却没有显示过的帧，已在 VideoWidget 中被更新的帧取代
+    for (auto it = m_pendingTargets.begin(); it != m_pendingTargets.end() && it->first < pts_ms; ) {
+        if (it->first > m_lastDisplayedPts) m_droppedFrames++;
+        it = m_pendingTargets.erase(it);
+    }
+    auto target = m_pendingTargets.find(pts_ms);
+    if (target != m_pendingTargets.end()) {
+        const double abs_error = std::abs(display_ms - target->second);
+        m_errorSumMs += abs_error;
+        m_errorMaxMs = std::max(m_errorMaxMs, abs_error);
+        m_errorSamples++;
+        m_pendingTargets.erase(target);
+    }
+
+    m_presentedFrames++;
+    if (m_lastDisplayedPts >= 0) {
+        // 上一帧应当占用的 vsync 数，超出部分即为重复显示
+        const double frame_duration = static_cast<double>(pts_ms - m_lastDisplayedPts);
+        const int expected = std::max(1, static_cast<int>(std::lround(frame_duration / m_refreshIntervalMs)));
+        if (m_swapsShowingLast > expected) {
+            m_duplicatedFrames += m_swapsShowingLast - expected;
+        }
+    }
+    m_lastDisplayedPts = pts_ms;
+    m_swapsShowingLast = 1;
+}
+
+void PresentationScheduler::addDroppedFrames(int count)
+{
+    if (count > 0) m_droppedFrames += count;
+}
+
+PresentationStats PresentationScheduler::takeStats()
+{
+    PresentationStats stats;
+    stats.refresh_interval_ms = m_refreshIntervalMs;
+    stats.avg_present_error_ms = m_errorSamples > 0 ? m_errorSumMs / m_errorSamples : 0.0;
+    stats.max_present_error_ms = m_errorMaxMs;
+    stats.presented_frames = m_presentedFrames;
+    stats.duplicated_frames = m_duplicatedFrames;
+    stats.dropped_frames = m_droppedFrames;
+
+    m_errorSumMs = 0.0;
+    m_errorMaxMs = 0.0;
+    m_errorSamples = 0;
+    m_presentedFrames = 0;
+    m_duplicatedFrames = 0;
+    m_droppedFrames = 0;
+    return stats;
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QPointer>
+#include <cstdint>
+#include <map>
+
+class QOpenGLWidget;
+
+// 呈现统计（由 takeStats 取出后清零）
+struct PresentationStats {
+    double refresh_interval_ms = 0.0;   // 估计的显示刷新周期
+    double avg_present_error_ms = 0.0;  // 【修改】帧实际显示的时刻与其 PTS 对应的目标时刻的平均偏差（绝对值）
+    double max_present_error_ms = 0.0;
+    int presented_frames = 0;           // 真正显示到屏幕上的新帧
+    int duplicated_frames = 0;          // 超出帧时长、被额外重复显示的 vsync 次数
+    int dropped_frames = 0;             // 未被显示就被跳过的解码帧（含已派发但被更新的帧取代的）
+};
+
+// 基于 frameSwapped 的呈现调度器：
+// 每次缓冲交换后预测下一次 vsync 的时刻，并通过 vsyncTick 通知选择该时刻应显示的帧。
+// 交换链由 swapInterval=1 节拍，因此 update() 的调用被自然地对齐到显示器刷新。
+// 【修改】呈现统计以 VideoWidget 实际绘制的帧为准：派发时记下每个 PTS 的目标显示时刻，
+// 绘制它的那次交换完成时计算误差，重复与丢帧也由实际显示的 PTS 序列得出
+class PresentationScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PresentationScheduler(QOpenGLWidget* widget, QObject* parent = nullptr);
+    ~PresentationScheduler();
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    // 【修改】选帧逻辑把帧交给 VideoWidget 时调用；target_pts_ms 为本次 vsyncTick 对应的媒体时间
+    void notifyFrameQueued(int64_t pts_ms, int64_t target_pts_ms);
+    void addDroppedFrames(int count);
+
+public slots:
+    // 【新增】连接 VideoWidget::framePainted
+    void onFramePainted(qint64 pts_ms);
+
+    double refreshIntervalMs() const { return m_refreshIntervalMs; }
+    PresentationStats takeStats();
+
+signals:
+    // vsync_lead_ms: 距离预测的下一次 vsync 还有多少毫秒
+    void vsyncTick(double vsync_lead_ms);
+
+private slots:
+    void onFrameSwapped();
+    void onWatchdogTimeout();
+
+private:
+    void scheduleNextSwap();
+    void onFrameDisplayed(int64_t pts_ms, double display_ms);
+
+    QPointer<QOpenGLWidget> m_widget;
+    QElapsedTimer m_clock;
+    QTimer* m_watchdogTimer = nullptr;
+    bool m_running = false;
+
+    double m_refreshIntervalMs = 1000.0 / 60.0;
+    double m_lastSwapMs = -1.0;
+    double m_predictedVsyncMs = -1.0;
+
+    // 统计
+    double m_errorSumMs = 0.0;
+    double m_errorMaxMs = 0.0;
+    int m_errorSamples = 0;
+    int m_presentedFrames = 0;
+    int m_duplicatedFrames = 0;
+    int m_droppedFrames = 0;
+
+    // 【修改】已派发、尚未显示的帧: PTS -> 目标显示时刻（m_clock 毫秒）
+    std::map<int64_t, double> m_pendingTargets;
+    int64_t m_paintedPts = -1;
+    // 重复帧判定：当前显示的帧及它已经停留的交换次数
+    int m_swapsShowingLast = 0;
+    int64_t m_lastDisplayedPts = -1;
+};
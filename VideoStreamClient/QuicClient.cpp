@@ -1,4 +1,5 @@
 ﻿#include "QuicClient.h"
+#include "LatencyTracker.h" // 【新增】
 #include <QDebug>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -52,6 +53,9 @@ void QuicClient::cleanup()
     }
     m_control_stream = nullptr;
     // 【移除】缓冲区清理
+    // 【新增】新连接的传输序号从头开始
+    m_controlReceiveBuffer.clear();
+    m_transportFeedback.reset();
 }
 
 void QuicClient::connectToServer(const QString& host, quint16 port)
@@ -189,6 +193,7 @@ void QuicClient::sendControlCommand(const QByteArray& command)
     auto* request = new (std::nothrow) SendRequest();
     if (!request) return;
     request->Data = command;
+    request->Data.append('\n'); // 【新增】以换行分隔消息
     request->QuicBuffer.Buffer = (uint8_t*)request->Data.data();
     request->QuicBuffer.Length = request->Data.size();
 
@@ -205,6 +210,43 @@ QUIC_STATUS QUIC_API QuicClient::ConnectionCallback(HQUIC Connection, void* Cont
 }
 
 // 【核心修改】处理数据报接收事件
+void QuicClient::dispatchDatagram(const uint8_t* data, uint32_t length)
+{
+    const uint32_t HEADER_SIZE = AppConfig::DATAGRAM_HEADER_SIZE;
+    AppConfig::PacketType type = static_cast<AppConfig::PacketType>(*data);
+
+    if (type == AppConfig::PacketType::Bundle) {
+        // 记录格式为 [u16 长度][完整的内层数据报]，内层不会再是合并包
+        uint32_t offset = HEADER_SIZE;
+        while (offset + 2 <= length) {
+            const uint32_t record_size = (static_cast<uint32_t>(data[offset]) << 8) | data[offset + 1];
+            offset += 2;
+            if (record_size < HEADER_SIZE || offset + record_size > length) {
+                qDebug() << "[QuicClient] 合并包格式错误，丢弃剩余部分。";
+                break;
+            }
+            if (static_cast<AppConfig::PacketType>(data[offset]) != AppConfig::PacketType::Bundle) {
+                dispatchDatagram(data + offset, record_size);
+            }
+            offset += record_size;
+        }
+        return;
+    }
+
+    // 将整个数据报（包含我们的头）封装到 QByteArray 中
+    QByteArray packet(reinterpret_cast<const char*>(data), length);
+
+    if (type == AppConfig::PacketType::Video) {
+        emit videoPacketReceived(packet);
+    }
+    else if (type == AppConfig::PacketType::Audio || type == AppConfig::PacketType::AudioOpus) { // 【修改】Opus 包同样交给音频链路
+        emit audioPacketReceived(packet);
+    }
+    else if (type == AppConfig::PacketType::VideoTiming) { // 【新增】在收到时取时间，不计入跨线程排队
+        emit videoTimingReceived(packet, LatencyTracker::now_us());
+    }
+}
+
 QUIC_STATUS QuicClient::HandleConnectionEvent(HQUIC Connection, QUIC_CONNECTION_EVENT* Event) {
     switch (Event->Type) {
     case QUIC_CONNECTION_EVENT_CONNECTED:
@@ -226,24 +268,16 @@ QUIC_STATUS QuicClient::HandleConnectionEvent(HQUIC Connection, QUIC_CONNECTION_
         const QUIC_BUFFER* datagram = Event->DATAGRAM_RECEIVED.Buffer;
 
         // 我们只处理一个 buffer 的情况，因为我们发送时也是一个 buffer
-        if (datagram->Length < (sizeof(AppConfig::PacketType) + sizeof(int64_t))) {
+        if (datagram->Length < AppConfig::DATAGRAM_HEADER_SIZE) {
             // 包太小，无法包含我们的头，直接忽略
             break;
         }
 
-        const uint8_t* buffer_ptr = datagram->Buffer;
-        AppConfig::PacketType type = static_cast<AppConfig::PacketType>(*buffer_ptr);
-
-        // 将整个数据报（包含我们的头）封装到 QByteArray 中
-        QByteArray packet(reinterpret_cast<const char*>(datagram->Buffer), datagram->Length);
-
-        if (type == AppConfig::PacketType::Video) {
-            emit videoPacketReceived(packet);
-        }
-        else if (type == AppConfig::PacketType::Audio) {
-            emit audioPacketReceived(packet);
-        }
+        // 【新增】记录传输序号与到达时间（合并包只有外层带序号）
+        const uint8_t* seq_ptr = datagram->Buffer + AppConfig::TRANSPORT_SEQ_OFFSET;
+        m_transportFeedback.on_datagram(static_cast<uint16_t>((seq_ptr[0] << 8) | seq_ptr[1]));
 
+        dispatchDatagram(datagram->Buffer, datagram->Length);
         break;
     }
 #ifdef QUIC_API_ENABLE_PREVIEW_FEATURES
@@ -289,29 +323,19 @@ QUIC_STATUS QuicClient::HandleStreamEvent(HQUIC Stream, QUIC_STREAM_EVENT* Event
         sendControlCommand("{\"command\":\"get_list\"}");
         break;
     case QUIC_STREAM_EVENT_RECEIVE: {
-        QByteArray received_data;
         for (uint32_t i = 0; i < Event->RECEIVE.BufferCount; ++i) {
-            received_data.append(
+            m_controlReceiveBuffer.append(
                 reinterpret_cast<const char*>(Event->RECEIVE.Buffers[i].Buffer),
                 Event->RECEIVE.Buffers[i].Length
             );
         }
-        // 以下 JSON 解析逻辑保持不变
-        QJsonDocument doc = QJsonDocument::fromJson(received_data);
-        if (doc.isArray()) {
-            QList<QString> videoList;
-            for (const auto& val : doc.array()) videoList.append(val.toString());
-            emit connectionSuccess(videoList);
-        }
-        else if (doc.isObject()) {
-            QJsonObject obj = doc.object();
-            if (obj.contains("command") && obj["command"] == "play_info") {
-                emit playInfoReceived(obj["duration"].toDouble());
-            }
-            else if (obj.contains("command") && obj["command"] == "heartbeat_reply") {
-                qint64 client_ts = obj["client_ts"].toVariant().toLongLong();
-                qint64 now_ts = QDateTime::currentMSecsSinceEpoch();
-                emit latencyUpdated(static_cast<double>(now_ts - client_ts) / 2.0);
+        // 【修改】一次接收可能包含半条或多条消息，按换行逐条处理
+        int lineEnd;
+        while ((lineEnd = m_controlReceiveBuffer.indexOf('\n')) >= 0) {
+            const QByteArray message = m_controlReceiveBuffer.left(lineEnd);
+            m_controlReceiveBuffer.remove(0, lineEnd + 1);
+            if (!message.isEmpty()) {
+                handleControlMessage(message);
             }
         }
         break;
@@ -328,4 +352,40 @@ QUIC_STATUS QuicClient::HandleStreamEvent(HQUIC Stream, QUIC_STREAM_EVENT* Event
         break;
     }
     return QUIC_STATUS_SUCCESS;
-}
\ No newline at end of file
+}
+
+void QuicClient::handleControlMessage(const QByteArray& message)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(message);
+    if (doc.isArray()) {
+        QList<QString> videoList;
+        for (const auto& val : doc.array()) videoList.append(val.toString());
+        emit connectionSuccess(videoList);
+    }
+    else if (doc.isObject()) {
+        QJsonObject obj = doc.object();
+        if (obj.contains("command") && obj["command"] == "play_info") {
+            // 【新增】打印协商出的音频格式；实际解码按每个包头里的类型进行
+            if (obj.contains("audio")) {
+                QJsonObject audio = obj["audio"].toObject();
+                qDebug() << "[QuicClient] 音频编码:" << audio["codec"].toString()
+                    << audio["sample_rate"].toInt() << "Hz x" << audio["channels"].toInt()
+                    << audio["bitrate"].toInt() / 1000 << "kbps";
+            }
+            // 【新增】旧服务端不带该字段，按 IDR 模式处理
+            const QString refresh = obj["video"].toObject()["refresh"].toString(AppConfig::VIDEO_REFRESH_IDR);
+            qDebug() << "[QuicClient] 视频丢包恢复方式:" << refresh;
+            emit videoRefreshModeReceived(refresh == AppConfig::VIDEO_REFRESH_INTRA);
+            emit playInfoReceived(obj["duration"].toDouble());
+        }
+        else if (obj.contains("command") && obj["command"] == "heartbeat_reply") {
+            qint64 client_ts = obj["client_ts"].toVariant().toLongLong();
+            qint64 now_ts = QDateTime::currentMSecsSinceEpoch();
+            emit latencyUpdated(static_cast<double>(now_ts - client_ts) / 2.0);
+            // 【新增】旧服务端不带服务端时间
+            if (obj.contains("server_ts_us")) {
+                emit clockSampleReceived(client_ts, static_cast<qint64>(obj["server_ts_us"].toDouble()), now_ts);
+            }
+        }
+    }
+}
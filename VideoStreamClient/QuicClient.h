@@ -7,6 +7,7 @@
 #include <msquic.h>
 #include <atomic>
 #include "shared_config.h" // 包含 shared_config.h 以获取 PacketType
+#include "TransportFeedback.h"
 
 class QuicClient : public QObject
 {
@@ -16,6 +17,9 @@ public:
     explicit QuicClient(QObject* parent = nullptr);
     ~QuicClient();
 
+    // 【新增】数据报到达记录，由工作线程定期取出发回服务端（内部加锁，可跨线程访问）
+    TransportFeedback& transportFeedback() { return m_transportFeedback; }
+
 public slots:
     void connectToServer(const QString& host, quint16 port);
     void disconnectFromServer();
@@ -25,10 +29,16 @@ signals:
     void connectionSuccess(const QList<QString>& videoList);
     void connectionFailed(const QString& reason);
     void playInfoReceived(double duration);
+    // 【新增】服务端的丢包恢复方式：true 为周期性帧内刷新，false 为按请求插入 IDR
+    void videoRefreshModeReceived(bool intraRefresh);
     // 【修改】信号传递的是完整的包（包含自定义头）
     void videoPacketReceived(const QByteArray& packet);
     void audioPacketReceived(const QByteArray& packet);
+    // 【新增】VideoTiming 数据报，arrivalUs 为收到时的客户端系统时钟（微秒）
+    void videoTimingReceived(const QByteArray& packet, qint64 arrivalUs);
     void latencyUpdated(double latencyMs);
+    // 【新增】一次心跳往返的三个时刻，用于估计两端时钟差
+    void clockSampleReceived(qint64 clientSendMs, qint64 serverUs, qint64 clientRecvMs);
     // 传递估计的带宽
     void bandwidthUpdated(uint64_t bits_per_second);
 private:
@@ -49,12 +59,20 @@ private:
 
     std::atomic<bool> m_is_running{ false };
 
+    // 【新增】控制消息以换行分隔，缓存未收完的部分
+    QByteArray m_controlReceiveBuffer;
+    TransportFeedback m_transportFeedback;
+
     // 【移除】不再需要接收缓冲区和处理函数
     // QByteArray m_video_receive_buffer;
     // QByteArray m_audio_receive_buffer;
     // void ProcessStreamBuffer(HQUIC Stream);
 
     void cleanup();
+    // 【新增】按类型分发一个数据报；合并包（PacketType::Bundle）拆成内层数据报逐个分发
+    void dispatchDatagram(const uint8_t* data, uint32_t length);
+    // 【新增】处理一条完整的控制消息
+    void handleControlMessage(const QByteArray& message);
 
     static QUIC_STATUS QUIC_API ConnectionCallback(HQUIC Connection, void* Context, QUIC_CONNECTION_EVENT* Event);
     static QUIC_STATUS QUIC_API StreamCallback(HQUIC Stream, void* Context, QUIC_STREAM_EVENT* Event);
@@ -1,163 +1,119 @@
 ﻿#include "RIFEInterpolator.h"
+#include "FramePool.h"
+#include "ColorConversionKernels.h"
+#include "InferenceRuntime.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <set>
 #include <stdexcept>
 #include <vector>
-#include <opencv2/opencv.hpp>
 #include <QDebug>
 
-// ONNX Runtime C API 头文件
-#include <onnxruntime_c_api.h>
-
 extern "C" {
 #include <libavutil/frame.h>
-#include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
 }
 
-// 辅助函数 (保持不变)
 namespace {
-    bool avframe_to_mat_bgr(const AVFrame* av_frame, cv::Mat& out_mat) {
-        if (!av_frame || av_frame->format != AV_PIX_FMT_YUV420P) return false;
-        SwsContext* sws_ctx = sws_getContext(av_frame->width, av_frame->height, (AVPixelFormat)av_frame->format, av_frame->width, av_frame->height, AV_PIX_FMT_BGR24, SWS_BILINEAR, nullptr, nullptr, nullptr);
-        if (!sws_ctx) return false;
-        out_mat = cv::Mat(av_frame->height, av_frame->width, CV_8UC3);
-        int dst_stride = static_cast<int>(out_mat.step);
-        uint8_t* dst_data = out_mat.data;
-        sws_scale(sws_ctx, av_frame->data, av_frame->linesize, 0, av_frame->height, &dst_data, &dst_stride);
-        sws_freeContext(sws_ctx);
-        return true;
+    // 模型要求输入宽高为 32 的倍数
+    constexpr int TENSOR_ALIGN = 32;
+    // 动态 batch 模型一次 Run 的最大帧数（4 倍插帧需要 3 帧）
+    constexpr int MAX_BATCH = 4;
+    // 无 timestep 输入时，递归中点的最大深度：t 被量化到 1/8
+    constexpr int DYADIC_DENOMINATOR = 8;
+    // 结果缓存：t 的量化精度与最多保留的帧数
+    constexpr int T_KEY_SCALE = 1024;
+    constexpr size_t MAX_CACHE_ENTRIES = 16;
+
+    // 一次推理任务：在 prev 与 next 之间生成时刻 t 的帧（无 timestep 输入时 t 恒为 0.5）
+    struct BatchJob {
+        const AVFrame* prev;
+        const AVFrame* next;
+        float t;
+    };
+
+    struct CacheEntry {
+        int64_t prev_pts;
+        int64_t next_pts;
+        int width;
+        int height;
+        int t_key;
+        AVFrame* frame;
+    };
+
+    int t_key_of(double t) {
+        return static_cast<int>(std::lround(t * T_KEY_SCALE));
+    }
+
+    bool is_valid_pair(const AVFrame* prev, const AVFrame* next) {
+        if (!prev || !next || prev->format != AV_PIX_FMT_YUV420P || next->format != AV_PIX_FMT_YUV420P) return false;
+        return prev->width == next->width && prev->height == next->height;
     }
 
-    AVFrame* mat_bgr_to_avframe(const cv::Mat& mat) {
-        AVFrame* frame = av_frame_alloc();
-        if (!frame) return nullptr;
-        frame->width = mat.cols;
-        frame->height = mat.rows;
-        frame->format = AV_PIX_FMT_YUV420P;
-        if (av_frame_get_buffer(frame, 32) < 0) { av_frame_free(&frame); return nullptr; }
-        SwsContext* sws_ctx = sws_getContext(mat.cols, mat.rows, AV_PIX_FMT_BGR24, mat.cols, mat.rows, AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
-        if (!sws_ctx) { av_frame_free(&frame); return nullptr; }
-        int src_stride = static_cast<int>(mat.step);
-        const uint8_t* src_data = mat.data;
-        sws_scale(sws_ctx, &src_data, &src_stride, 0, mat.rows, frame->data, frame->linesize);
-        sws_freeContext(sws_ctx);
-        return frame;
+    ColorConversionKernels::YuvPlanes planes_of(const AVFrame* frame) {
+        return ColorConversionKernels::YuvPlanes{
+            { frame->data[0], frame->data[1], frame->data[2] },
+            { frame->linesize[0], frame->linesize[1], frame->linesize[2] } };
     }
 }
 
 // Pimpl (Pointer to Implementation) 结构体定义
 struct RIFEInterpolator::Impl {
-    const OrtApi* ort_api = nullptr;
-    OrtEnv* env = nullptr;
-    OrtSessionOptions* session_options = nullptr;
-    OrtSession* session = nullptr;
-    OrtAllocator* allocator = nullptr;
+    // 【修改】会话、OrtEnv 与输入输出绑定交给共享的推理运行时
+    InferenceSession session{ "RIFE" };
 
+    // 持久化的输入张量：缓冲区只在分辨率变化或 batch 超出容量时重建并重新绑定，填充区域在重建时清零一次
     std::vector<float> input1_tensor_values;
     std::vector<float> input2_tensor_values;
+    std::vector<float> timestep_values;
+    std::vector<int64_t> timestep_shape;
 
-    std::vector<std::string> input_node_name_strings;
-    std::vector<std::string> output_node_name_strings;
-    std::vector<const char*> input_node_names;
-    std::vector<const char*> output_node_names;
+    // 【新增】模型能力：第三个输入为 timestep；第一维为动态 batch
+    bool has_timestep = false;
+    bool dynamic_batch = false;
+    std::vector<int64_t> timestep_dims; // 模型声明的 timestep 形状（-1 为动态维）
+
+    // 【新增】已生成的中间帧，键为 (prev pts, next pts, 宽, 高, t)
+    std::deque<CacheEntry> cache;
 
     bool initialized = false;
     int inpWidth = 0;
     int inpHeight = 0;
+    int inpBatch = 0; // 已绑定的 batch 容量，只增不减
 
-    void CheckStatus(OrtStatus* status) const {
-        if (status != nullptr) {
-            const char* msg = ort_api->GetErrorMessage(status);
-            std::string error_message = "ONNX Runtime Error: ";
-            error_message += msg;
-            ort_api->ReleaseStatus(status);
-            throw std::runtime_error(error_message);
-        }
-    }
-
-    // 构造函数现在是空的
     Impl() = default;
 
     ~Impl() {
-        if (ort_api) {
-            if (session) ort_api->ReleaseSession(session);
-            if (session_options) ort_api->ReleaseSessionOptions(session_options);
-            if (env) ort_api->ReleaseEnv(env);
-        }
+        clear_cache();
     }
 
     // 所有初始化逻辑都在这里
     bool initialize(const std::string& model_path, std::string& error_message) {
-        ort_api = OrtGetApiBase()->GetApi(ORT_API_VERSION);
-        if (!ort_api) {
-            error_message = "Fatal: Could not get ONNX Runtime API base.";
+        if (!session.load(model_path, true, error_message)) {
+            initialized = false;
             return false;
         }
 
         try {
-            CheckStatus(ort_api->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "RIFE-Interpolator", &env));
-            CheckStatus(ort_api->CreateSessionOptions(&session_options));
-
-            // ========== START: MODIFIED FOR GPU ACCELERATION ==========
-            OrtCUDAProviderOptions cuda_options{};
-            OrtStatus* cuda_status = ort_api->SessionOptionsAppendExecutionProvider_CUDA(session_options, &cuda_options);
-
-            if (cuda_status != nullptr) {
-                const char* msg = ort_api->GetErrorMessage(cuda_status);
-                qWarning() << "[RIFE] Could not enable CUDA execution provider. Reason:" << msg;
-                ort_api->ReleaseStatus(cuda_status);
-                qWarning() << "[RIFE] Falling back to CPU. Performance will be limited.";
+            // 【修改】支持 (img0, img1) 与 (img0, img1, timestep) 两种模型
+            const size_t num_input_nodes = session.input_count();
+            if (num_input_nodes != 2 && num_input_nodes != 3) {
+                throw std::runtime_error("Invalid ONNX model. Expected 2 or 3 inputs.");
             }
-            else {
-                qInfo() << "[RIFE] CUDA execution provider enabled successfully. Using GPU for inference.";
+            if (session.output_count() < 1) {
+                throw std::runtime_error("Invalid ONNX model. Expected at least 1 output.");
             }
-            // ========== END: MODIFIED FOR GPU ACCELERATION ==========
-
-            std::wstring model_path_w(model_path.begin(), model_path.end());
-            CheckStatus(ort_api->CreateSession(env, model_path_w.c_str(), session_options, &session));
-
-            CheckStatus(ort_api->GetAllocatorWithDefaultOptions(&allocator));
-
-            size_t num_input_nodes, num_output_nodes;
-            CheckStatus(ort_api->SessionGetInputCount(session, &num_input_nodes));
-            CheckStatus(ort_api->SessionGetOutputCount(session, &num_output_nodes));
-
-            if (num_input_nodes != 2) {
-                throw std::runtime_error("Invalid ONNX model. Expected 2 inputs.");
-            }
-
-            for (size_t i = 0; i < num_input_nodes; ++i) {
-                char* input_name_ptr = nullptr;
-                CheckStatus(ort_api->SessionGetInputName(session, i, allocator, &input_name_ptr));
-                if (input_name_ptr) {
-                    input_node_name_strings.emplace_back(input_name_ptr);
-                    allocator->Free(allocator, input_name_ptr);
-                }
-                else {
-                    throw std::runtime_error("Failed to get input name for node index " + std::to_string(i));
-                }
-            }
-            for (const auto& name : input_node_name_strings) {
-                input_node_names.push_back(name.c_str());
-            }
-
-            for (size_t i = 0; i < num_output_nodes; ++i) {
-                char* output_name_ptr = nullptr;
-                CheckStatus(ort_api->SessionGetOutputName(session, i, allocator, &output_name_ptr));
-                if (output_name_ptr) {
-                    output_node_name_strings.emplace_back(output_name_ptr);
-                    allocator->Free(allocator, output_name_ptr);
-                }
-                else {
-                    throw std::runtime_error("Failed to get output name for node index " + std::to_string(i));
-                }
-            }
-            for (const auto& name : output_node_name_strings) {
-                output_node_names.push_back(name.c_str());
-            }
-
+            has_timestep = (num_input_nodes == 3);
+            const std::vector<int64_t> image_dims = session.input_dims(0);
+            if (has_timestep) timestep_dims = session.input_dims(2);
+            // 标量 timestep 无法按 batch 展开
+            dynamic_batch = !image_dims.empty() && image_dims[0] < 0 && (!has_timestep || !timestep_dims.empty());
+
+            qInfo() << "[RIFE] Model inputs:" << num_input_nodes
+                << "timestep:" << has_timestep << "dynamic batch:" << dynamic_batch;
             initialized = true;
             return true;
-
         }
         catch (const std::runtime_error& e) {
             error_message = e.what();
@@ -166,71 +122,220 @@ struct RIFEInterpolator::Impl {
         }
     }
 
-    void preprocess(const cv::Mat& img, std::vector<float>& input_tensor) {
-        cv::Mat rgbimg;
-        cv::cvtColor(img, rgbimg, cv::COLOR_BGR2RGB);
+    // 按帧尺寸准备输入张量（宽高向上对齐到 32），能容纳 batch 个任务时直接复用。
+    // 较小的批次沿用已绑定的容量、只填前几个槽位，其余槽位保留上次的输入、输出被丢弃：
+    // 4 倍插帧时批次在 1 与 2 之间交替、2x/4x 切换时也不会反复重建清零输入并重新绑定输出
+    void ensure_input_tensors(int width, int height, int batch) {
+        const int pw = (width + TENSOR_ALIGN - 1) / TENSOR_ALIGN * TENSOR_ALIGN;
+        const int ph = (height + TENSOR_ALIGN - 1) / TENSOR_ALIGN * TENSOR_ALIGN;
+        if (pw == inpWidth && ph == inpHeight && batch <= inpBatch) return;
+
+        batch = std::max(batch, inpBatch);
+        inpWidth = pw;
+        inpHeight = ph;
+        inpBatch = batch;
+
+        const size_t tensor_size = static_cast<size_t>(batch) * 3 * pw * ph;
+        input1_tensor_values.assign(tensor_size, 0.0f);
+        input2_tensor_values.assign(tensor_size, 0.0f);
+
+        const std::vector<int64_t> input_img_shape = { batch, 3, ph, pw };
+        session.bind_input(0, input1_tensor_values.data(), tensor_size * sizeof(float), input_img_shape, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+        session.bind_input(1, input2_tensor_values.data(), tensor_size * sizeof(float), input_img_shape, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+
+        if (has_timestep) {
+            // timestep 形状跟随模型声明：标量、[N]、[N,1] 或 [N,1,H,W]（H/W 为 1 时按广播处理）
+            timestep_shape = timestep_dims;
+            if (!timestep_shape.empty()) timestep_shape[0] = batch;
+            if (timestep_shape.size() == 4) {
+                timestep_shape[1] = 1;
+                timestep_shape[2] = (timestep_shape[2] == 1) ? 1 : ph;
+                timestep_shape[3] = (timestep_shape[3] == 1) ? 1 : pw;
+            }
+            size_t count = 1;
+            for (size_t i = 0; i < timestep_shape.size(); ++i) {
+                if (timestep_shape[i] < 0) timestep_shape[i] = 1;
+                count *= static_cast<size_t>(timestep_shape[i]);
+            }
+            timestep_values.assign(count, 0.5f);
+            session.bind_input(2, timestep_values.data(), count * sizeof(float), timestep_shape, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT);
+        }
+    }
 
-        const int h = rgbimg.rows;
-        const int w = rgbimg.cols;
-        const int align = 32;
-        int ph = h, pw = w;
+    // 【修改】YUV420P 一次遍历直接写入归一化的平面 RGB 张量
+    void preprocess(const AVFrame* frame, float* input_tensor) {
+        ColorConversionKernels::yuv420p_to_rgb_planar(planes_of(frame), frame->width, frame->height,
+            input_tensor, inpWidth, inpHeight);
+    }
 
-        if (h % align != 0 || w % align != 0) {
-            ph = (int((h - 1) / align) + 1) * align;
-            pw = (int((w - 1) / align) + 1) * align;
-            cv::copyMakeBorder(rgbimg, rgbimg, 0, ph - h, 0, pw - w, cv::BORDER_CONSTANT, 0);
+    // 把 batch 中第 index 个任务写入输入张量；与上一个任务同一帧时直接拷贝
+    void fill_batch_slot(const std::vector<BatchJob>& jobs, size_t index) {
+        const size_t slot_size = static_cast<size_t>(3) * inpWidth * inpHeight;
+        float* in1 = input1_tensor_values.data() + index * slot_size;
+        float* in2 = input2_tensor_values.data() + index * slot_size;
+        if (index > 0 && jobs[index].prev == jobs[index - 1].prev) std::memcpy(in1, in1 - slot_size, slot_size * sizeof(float));
+        else preprocess(jobs[index].prev, in1);
+        if (index > 0 && jobs[index].next == jobs[index - 1].next) std::memcpy(in2, in2 - slot_size, slot_size * sizeof(float));
+        else preprocess(jobs[index].next, in2);
+
+        if (has_timestep) {
+            const size_t per_item = timestep_values.size() / static_cast<size_t>(inpBatch);
+            std::fill_n(timestep_values.begin() + index * per_item, per_item, jobs[index].t);
         }
+    }
 
-        inpHeight = rgbimg.rows;
-        inpWidth = rgbimg.cols;
-
-        rgbimg.convertTo(rgbimg, CV_32FC3, 1.0 / 255.0);
+    // 【修改】模型输出（平面 RGB，[0,1]）直接截断并转换回 YUV420P，裁掉对齐填充；只取前 count 个槽位
+    std::vector<AVFrame*> postprocess(int count, int width, int height) {
+        const std::vector<int64_t>& output_shape = session.output_shape(0);
+        if (output_shape.size() != 4 || output_shape[0] != inpBatch || output_shape[1] != 3) {
+            throw std::runtime_error("Unexpected RIFE output shape.");
+        }
+        const int out_h = static_cast<int>(output_shape[2]);
+        const int out_w = static_cast<int>(output_shape[3]);
+        if (out_w < width || out_h < height) {
+            throw std::runtime_error("RIFE output is smaller than the source frame.");
+        }
+        const float* pdata = static_cast<const float*>(session.output_data(0));
+
+        std::vector<AVFrame*> frames(count, nullptr);
+        const size_t slot_size = static_cast<size_t>(3) * out_w * out_h;
+        for (int i = 0; i < count; ++i) {
+            AVFrame* frame = FramePool::instance().acquire(width, height, AV_PIX_FMT_YUV420P);
+            if (!frame) continue;
+            ColorConversionKernels::rgb_planar_to_yuv420p(pdata + i * slot_size, out_w, out_h, planes_of(frame), width, height);
+            frames[i] = frame;
+        }
+        return frames;
+    }
 
-        const int image_area = inpHeight * inpWidth;
-        input_tensor.resize(static_cast<size_t>(3) * image_area);
+    // 执行一批推理任务（所有帧尺寸相同），返回与 jobs 对应的新帧，失败为 nullptr
+    std::vector<AVFrame*> run_batch(const std::vector<BatchJob>& jobs) {
+        std::vector<AVFrame*> results;
+        const size_t max_batch = dynamic_batch ? MAX_BATCH : 1;
+        const int width = jobs.front().prev->width;
+        const int height = jobs.front().prev->height;
+
+        for (size_t begin = 0; begin < jobs.size(); begin += max_batch) {
+            const size_t count = std::min(max_batch, jobs.size() - begin);
+            const std::vector<BatchJob> chunk(jobs.begin() + begin, jobs.begin() + begin + count);
+            try {
+                ensure_input_tensors(width, height, static_cast<int>(count));
+                for (size_t i = 0; i < count; ++i) fill_batch_slot(chunk, i);
+                session.run();
+                std::vector<AVFrame*> frames = postprocess(static_cast<int>(count), width, height);
+                results.insert(results.end(), frames.begin(), frames.end());
+            }
+            catch (const std::runtime_error& e) {
+                qCritical() << "[RIFE] Interpolation failed:" << e.what();
+                results.resize(begin + count, nullptr);
+            }
+        }
+        return results;
+    }
 
-        std::vector<cv::Mat> rgbChannels(3);
-        cv::split(rgbimg, rgbChannels);
+    // ---------------- 结果缓存 ----------------
 
-        memcpy(input_tensor.data(), (float*)rgbChannels[0].data, image_area * sizeof(float));
-        memcpy(input_tensor.data() + image_area, (float*)rgbChannels[1].data, image_area * sizeof(float));
-        memcpy(input_tensor.data() + 2 * image_area, (float*)rgbChannels[2].data, image_area * sizeof(float));
+    AVFrame* cache_find(const AVFrame* prev, const AVFrame* next, int t_key) const {
+        for (const CacheEntry& entry : cache) {
+            if (entry.prev_pts == prev->pts && entry.next_pts == next->pts
+                && entry.width == prev->width && entry.height == prev->height && entry.t_key == t_key) return entry.frame;
+        }
+        return nullptr;
     }
 
-    cv::Mat postprocess(OrtValue* output_tensor) {
-        float* pdata;
-        CheckStatus(ort_api->GetTensorMutableData(output_tensor, (void**)&pdata));
-
-        OrtTensorTypeAndShapeInfo* shape_info;
-        CheckStatus(ort_api->GetTensorTypeAndShape(output_tensor, &shape_info));
-        std::vector<int64_t> output_shape;
-        size_t num_dims;
-        CheckStatus(ort_api->GetDimensionsCount(shape_info, &num_dims));
-        output_shape.resize(num_dims);
-        CheckStatus(ort_api->GetDimensions(shape_info, output_shape.data(), num_dims));
+    void cache_store(const AVFrame* prev, const AVFrame* next, int t_key, AVFrame* frame) {
+        if (!frame) return;
+        cache.push_back(CacheEntry{ prev->pts, next->pts, prev->width, prev->height, t_key, frame });
+        while (cache.size() > MAX_CACHE_ENTRIES) {
+            av_frame_free(&cache.front().frame);
+            cache.pop_front();
+        }
+    }
 
-        const int out_h = static_cast<int>(output_shape[2]);
-        const int out_w = static_cast<int>(output_shape[3]);
-        const int channel_step = out_h * out_w;
+    void clear_cache() {
+        for (CacheEntry& entry : cache) av_frame_free(&entry.frame);
+        cache.clear();
+    }
 
-        cv::Mat rmat(out_h, out_w, CV_32FC1, pdata);
-        cv::Mat gmat(out_h, out_w, CV_32FC1, pdata + channel_step);
-        cv::Mat bmat(out_h, out_w, CV_32FC1, pdata + 2 * channel_step);
+    // ---------------- 生成指定时刻的中间帧 ----------------
+
+    // 模型带 timestep：缺失的时刻一次批量推理
+    void resolve_with_timestep(const AVFrame* prev, const AVFrame* next, const std::vector<double>& ts) {
+        std::vector<BatchJob> jobs;
+        std::vector<int> keys;
+        for (double t : ts) {
+            const int key = t_key_of(t);
+            if (cache_find(prev, next, key) || std::find(keys.begin(), keys.end(), key) != keys.end()) continue;
+            jobs.push_back(BatchJob{ prev, next, static_cast<float>(t) });
+            keys.push_back(key);
+        }
+        if (jobs.empty()) return;
+        std::vector<AVFrame*> frames = run_batch(jobs);
+        for (size_t i = 0; i < frames.size(); ++i) cache_store(prev, next, keys[i], frames[i]);
+    }
 
-        rmat *= 255.f; gmat *= 255.f; bmat *= 255.f;
-        cv::threshold(rmat, rmat, 255, 255, cv::THRESH_TRUNC); cv::threshold(rmat, rmat, 0, 0, cv::THRESH_TOZERO);
-        cv::threshold(gmat, gmat, 255, 255, cv::THRESH_TRUNC); cv::threshold(gmat, gmat, 0, 0, cv::THRESH_TOZERO);
-        cv::threshold(bmat, bmat, 255, 255, cv::THRESH_TRUNC); cv::threshold(bmat, bmat, 0, 0, cv::THRESH_TOZERO);
+    // 模型只能生成中点：t 量化为 n/8，按层（1/2 → 1/4 → 1/8）递归二分，
+    // 同一层的所有中点放入同一批推理
+    void resolve_with_midpoints(const AVFrame* prev, const AVFrame* next, const std::vector<int>& numerators) {
+        std::set<int> needed;
+        std::vector<int> pending(numerators);
+        while (!pending.empty()) {
+            const int n = pending.back();
+            pending.pop_back();
+            if (n <= 0 || n >= DYADIC_DENOMINATOR || !needed.insert(n).second) continue;
+            const int step = n & -n; // 所在层的半区间长度
+            pending.push_back(n - step);
+            pending.push_back(n + step);
+        }
 
-        std::vector<cv::Mat> channel_mats(3);
-        channel_mats[0] = bmat; channel_mats[1] = gmat; channel_mats[2] = rmat;
+        auto frame_at = [&](int n) -> const AVFrame* {
+            if (n == 0) return prev;
+            if (n == DYADIC_DENOMINATOR) return next;
+            return cache_find(prev, next, n * (T_KEY_SCALE / DYADIC_DENOMINATOR));
+        };
+
+        for (int step = DYADIC_DENOMINATOR / 2; step >= 1; step /= 2) {
+            std::vector<BatchJob> jobs;
+            std::vector<int> level;
+            for (int n : needed) {
+                if ((n & -n) != step || frame_at(n)) continue;
+                const AVFrame* lo = frame_at(n - step);
+                const AVFrame* hi = frame_at(n + step);
+                if (!lo || !hi) continue; // 上一层失败
+                jobs.push_back(BatchJob{ lo, hi, 0.5f });
+                level.push_back(n);
+            }
+            if (jobs.empty()) continue;
+            std::vector<AVFrame*> frames = run_batch(jobs);
+            for (size_t i = 0; i < frames.size(); ++i) {
+                cache_store(prev, next, level[i] * (T_KEY_SCALE / DYADIC_DENOMINATOR), frames[i]);
+            }
+        }
+    }
 
-        cv::Mat dstimg;
-        cv::merge(channel_mats, dstimg);
-        dstimg.convertTo(dstimg, CV_8UC3);
+    // 生成（或从缓存取出）各时刻的帧，返回新引用
+    std::vector<AVFrame*> resolve(const AVFrame* prev, const AVFrame* next, const std::vector<double>& ts) {
+        std::vector<int> keys;
+        if (has_timestep) {
+            resolve_with_timestep(prev, next, ts);
+            for (double t : ts) keys.push_back(t_key_of(t));
+        }
+        else {
+            std::vector<int> numerators;
+            for (double t : ts) {
+                const int n = std::min(DYADIC_DENOMINATOR - 1, std::max(1, static_cast<int>(std::lround(t * DYADIC_DENOMINATOR))));
+                numerators.push_back(n);
+                keys.push_back(n * (T_KEY_SCALE / DYADIC_DENOMINATOR));
+            }
+            resolve_with_midpoints(prev, next, numerators);
+        }
 
-        if (ort_api && shape_info) ort_api->ReleaseTensorTypeAndShapeInfo(shape_info);
-        return dstimg;
+        std::vector<AVFrame*> results;
+        for (int key : keys) {
+            AVFrame* cached = cache_find(prev, next, key);
+            results.push_back(cached ? av_frame_clone(cached) : nullptr);
+        }
+        return results;
     }
 };
 
@@ -252,56 +357,33 @@ bool RIFEInterpolator::is_initialized() const {
     return pimpl && pimpl->initialized;
 }
 
-AVFrame* RIFEInterpolator::interpolate(const AVFrame* prev, const AVFrame* next, double /*factor*/) {
-    if (!is_initialized()) return nullptr;
-
-    cv::Mat mat1, mat2;
-    if (!avframe_to_mat_bgr(prev, mat1) || !avframe_to_mat_bgr(next, mat2)) return nullptr;
-
-    const int srch = mat1.rows;
-    const int srcw = mat1.cols;
-
-    pimpl->preprocess(mat1, pimpl->input1_tensor_values);
-    pimpl->preprocess(mat2, pimpl->input2_tensor_values);
-
-    std::vector<int64_t> input_img_shape = { 1, 3, pimpl->inpHeight, pimpl->inpWidth };
-
-    OrtValue* input_tensors[2] = { nullptr, nullptr };
-    OrtValue* output_tensor = nullptr;
-    AVFrame* result_frame = nullptr;
+bool RIFEInterpolator::supports_timestep() const {
+    return is_initialized() && pimpl->has_timestep;
+}
 
-    try {
-        OrtMemoryInfo* memory_info;
-        pimpl->CheckStatus(pimpl->ort_api->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
+bool RIFEInterpolator::supports_batch() const {
+    return is_initialized() && pimpl->dynamic_batch;
+}
 
-        pimpl->CheckStatus(pimpl->ort_api->CreateTensorWithDataAsOrtValue(memory_info, pimpl->input1_tensor_values.data(), pimpl->input1_tensor_values.size() * sizeof(float), input_img_shape.data(), input_img_shape.size(), ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &input_tensors[0]));
-        pimpl->CheckStatus(pimpl->ort_api->CreateTensorWithDataAsOrtValue(memory_info, pimpl->input2_tensor_values.data(), pimpl->input2_tensor_values.size() * sizeof(float), input_img_shape.data(), input_img_shape.size(), ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &input_tensors[1]));
+void RIFEInterpolator::clear_cache() {
+    if (pimpl) pimpl->clear_cache();
+}
 
-        pimpl->ort_api->ReleaseMemoryInfo(memory_info);
+AVFrame* RIFEInterpolator::interpolate(const AVFrame* prev, const AVFrame* next, double factor) {
+    if (!is_initialized() || !is_valid_pair(prev, next)) return nullptr;
+    if (factor <= 0.0) return av_frame_clone(prev);
+    if (factor >= 1.0) return av_frame_clone(next);
 
-        pimpl->CheckStatus(pimpl->ort_api->Run(
-            pimpl->session,
-            nullptr,
-            pimpl->input_node_names.data(),
-            (const OrtValue* const*)input_tensors,
-            pimpl->input_node_names.size(),
-            pimpl->output_node_names.data(),
-            pimpl->output_node_names.size(),
-            &output_tensor));
+    std::vector<AVFrame*> results = pimpl->resolve(prev, next, { factor });
+    return results.front();
+}
 
-        cv::Mat interpolated_bgr = pimpl->postprocess(output_tensor);
-        cv::Mat final_bgr = interpolated_bgr(cv::Rect{ 0, 0, srcw, srch });
-        result_frame = mat_bgr_to_avframe(final_bgr);
+std::vector<AVFrame*> RIFEInterpolator::interpolate_steps(const AVFrame* prev, const AVFrame* next, int multiplier) {
+    if (multiplier < 2 || !is_initialized() || !is_valid_pair(prev, next)) return {};
 
+    std::vector<double> ts;
+    for (int i = 1; i < multiplier; ++i) {
+        ts.push_back(static_cast<double>(i) / multiplier);
     }
-    catch (const std::runtime_error& e) {
-        qCritical() << "[RIFE] Interpolation failed:" << e.what();
-        result_frame = nullptr;
-    }
-
-    if (input_tensors[0]) pimpl->ort_api->ReleaseValue(input_tensors[0]);
-    if (input_tensors[1]) pimpl->ort_api->ReleaseValue(input_tensors[1]);
-    if (output_tensor) pimpl->ort_api->ReleaseValue(output_tensor);
-
-    return result_frame;
-}
\ No newline at end of file
+    return pimpl->resolve(prev, next, ts);
+}
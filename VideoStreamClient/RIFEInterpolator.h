@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 // 前向声明FFmpeg结构体
 struct AVFrame;
@@ -15,8 +16,22 @@ public:
     bool initialize(const std::string& model_path, std::string& error_message);
 
     bool is_initialized() const;
+
+    // 【修改】生成 prev 与 next 之间时刻 factor (0,1) 的中间帧，调用方负责 av_frame_free。
+    // 模型带 timestep 输入时直接按 factor 推理；否则以递归中点逼近（精度 1/8）。
     AVFrame* interpolate(const AVFrame* prev, const AVFrame* next, double factor);
 
+    // 【新增】一次生成 multiplier-1 个均匀分布的中间帧（t = i / multiplier），按 t 递增返回，失败的位置为 nullptr。
+    // 模型支持动态 batch 时同一层的所有帧在一次 Run 中完成。
+    std::vector<AVFrame*> interpolate_steps(const AVFrame* prev, const AVFrame* next, int multiplier);
+
+    // 【新增】模型是否接受 timestep 输入 / 是否支持动态 batch
+    bool supports_timestep() const;
+    bool supports_batch() const;
+
+    // 【新增】释放缓存的中间帧；换片、跳转后 pts 会重复出现，须由插帧线程在重置时调用
+    void clear_cache();
+
     // 允许移动，但禁止拷贝
     RIFEInterpolator(RIFEInterpolator&&) noexcept;
     RIFEInterpolator& operator=(RIFEInterpolator&&) noexcept;
@@ -24,6 +39,7 @@ public:
     RIFEInterpolator& operator=(const RIFEInterpolator&) = delete;
 
 private:
+    // 注意：推理与结果缓存都不加锁，只应在插帧线程中调用
     // Pimpl设计模式：将所有实现细节隐藏起来
     struct Impl;
     std::unique_ptr<Impl> pimpl;
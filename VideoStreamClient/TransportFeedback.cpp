@@ -0,0 +1,69 @@
+﻿#include "TransportFeedback.h"
+
+TransportFeedback::TransportFeedback()
+    : epoch_(std::chrono::steady_clock::now())
+{
+    reset();
+}
+
+void TransportFeedback::reset()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    arrivals_.clear();
+    max_seq_ = -1;
+    next_report_seq_ = -1;
+}
+
+void TransportFeedback::on_datagram(uint16_t transport_seq)
+{
+    const int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - epoch_).count();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // 16 位序号展开成连续的 64 位序号，按与当前最大序号的有符号差值处理回环
+    int64_t seq = transport_seq;
+    if (max_seq_ >= 0) {
+        const int16_t diff = static_cast<int16_t>(transport_seq - static_cast<uint16_t>(max_seq_));
+        seq = max_seq_ + diff;
+    }
+    if (next_report_seq_ < 0) {
+        next_report_seq_ = seq;
+    }
+    // 已经作为丢包反馈过的迟到包不再上报
+    if (seq < next_report_seq_) {
+        return;
+    }
+
+    arrivals_.emplace(seq, now_us);
+    if (seq > max_seq_) {
+        max_seq_ = seq;
+    }
+}
+
+TransportFeedbackReport TransportFeedback::take_report()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    TransportFeedbackReport report;
+    if (arrivals_.empty()) {
+        return report;
+    }
+
+    int64_t first = next_report_seq_;
+    if (max_seq_ - first + 1 > MAX_REPORT_PACKETS) {
+        first = max_seq_ - MAX_REPORT_PACKETS + 1;
+    }
+
+    report.base_seq = static_cast<uint16_t>(first);
+    report.arrival_us.assign(static_cast<size_t>(max_seq_ - first + 1), -1);
+    for (const auto& entry : arrivals_) {
+        if (entry.first >= first) {
+            report.arrival_us[static_cast<size_t>(entry.first - first)] = entry.second;
+        }
+    }
+
+    arrivals_.clear();
+    next_report_seq_ = max_seq_ + 1;
+    return report;
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 一次反馈：从 base_seq 开始连续的传输序号，未收到的包到达时间为 -1
+struct TransportFeedbackReport
+{
+    uint16_t base_seq = 0;
+    std::vector<int64_t> arrival_us;
+};
+
+// 记录每个数据报的传输序号与到达时间，定期打包成反馈发回服务端，供其估计带宽
+// 到达时间取自本地单调时钟，服务端只使用差值
+class TransportFeedback
+{
+public:
+    TransportFeedback();
+
+    void reset();
+    // 收到一个数据报时调用（MsQuic 回调线程）
+    void on_datagram(uint16_t transport_seq);
+    // 取出上次反馈之后到目前最大序号的记录；没有新包时 arrival_us 为空
+    TransportFeedbackReport take_report();
+
+private:
+    // 单次反馈最多覆盖的包数，超出的旧记录直接丢弃
+    static constexpr int64_t MAX_REPORT_PACKETS = 1000;
+
+    std::mutex mtx_;
+    const std::chrono::steady_clock::time_point epoch_;
+
+    std::map<int64_t, int64_t> arrivals_; // 展开后的序号 -> 到达时间(us)
+    int64_t max_seq_;                     // 展开后的最大序号，-1 表示尚未收到
+    int64_t next_report_seq_;             // 下一次反馈的起始序号
+};
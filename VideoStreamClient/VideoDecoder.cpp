@@ -1,6 +1,8 @@
 ﻿#include "VideoDecoder.h"
 #include "JitterBuffer.h"
 #include "DecodedFrameBuffer.h"
+#include "EnhancementStage.h"
+#include "FramePool.h"
 #include "shared_config.h"
 #include "MediaPacket.h"
 
@@ -13,6 +15,8 @@ extern "C" {
 
 #include <QDebug>
 #include <QCoreApplication>
+#include <algorithm>
+#include <cstdint>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -28,6 +32,34 @@ inline uint16_t ntohs_portable(uint16_t value) {
 #endif
 }
 
+namespace {
+    // 重组超时：超过该时长仍不完整的帧视为丢失
+    constexpr qint64 REASSEMBLY_TIMEOUT_MS = 500;
+    // 关键帧请求未得到响应时的重发间隔，约为几个 RTT
+    constexpr qint64 KEYFRAME_RETRY_MS = 300;
+    // 记录的已丢失帧数量上限
+    constexpr size_t MAX_DROPPED_FRAME_HISTORY = 32;
+
+    // 返回 Annex B 码流中第一个 VCL NAL 单元的类型，找不到时返回 -1
+    int firstVclNalType(const uint8_t* data, int size)
+    {
+        for (int i = 0; i + 3 < size; ++i) {
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+                const int type = (data[i + 3] >> 1) & 0x3F;
+                if (type < 32) return type;
+                i += 2;
+            }
+        }
+        return -1;
+    }
+
+    // IRAP（BLA/IDR/CRA）：不依赖之前的帧，解码器可以从这里重新开始
+    bool isIrapNal(int type) { return type >= 16 && type <= 23; }
+
+    // 子层非参考帧（TRAIL_N、TSA_N、STSA_N、RADL_N、RASL_N），丢失后不影响后续帧
+    bool isNonReferenceNal(int type) { return type >= 0 && type <= 14 && type % 2 == 0; }
+}
+
 static enum AVPixelFormat get_hw_format(AVCodecContext* ctx, const enum AVPixelFormat* pix_fmts)
 {
     VideoDecoder* decoder = static_cast<VideoDecoder*>(ctx->opaque);
@@ -70,21 +102,12 @@ VideoDecoder::VideoDecoder(JitterBuffer& inputBuffer, DecodedFrameBuffer& output
 {
     m_cleanupTimer = new QTimer(this);
     connect(m_cleanupTimer, &QTimer::timeout, this, &VideoDecoder::cleanupReassemblyBuffer);
-
-    // 【新增】分配用于格式净化的帧
-    m_sw_frame = av_frame_alloc();
 }
 
 VideoDecoder::~VideoDecoder()
 {
     stopDecoding();
     cleanupFFmpeg();
-
-    // 【新增】确保释放 m_sw_frame
-    if (m_sw_frame) {
-        av_frame_free(&m_sw_frame);
-        m_sw_frame = nullptr;
-    }
 }
 
 bool VideoDecoder::initFFmpeg()
@@ -165,7 +188,7 @@ bool VideoDecoder::initFFmpeg()
         m_hw_frame = av_frame_alloc();
     }
 
-    if (!m_packet || !m_frame || !m_sw_frame || (m_hw_device_type != AV_HWDEVICE_TYPE_NONE && !m_hw_frame)) {
+    if (!m_packet || !m_frame || (m_hw_device_type != AV_HWDEVICE_TYPE_NONE && !m_hw_frame)) {
         cleanupFFmpeg();
         return false;
     }
@@ -218,6 +241,9 @@ void VideoDecoder::startDecoding()
     }
 
     m_reassemblyBuffer.clear();
+    m_droppedFramePts.clear();
+    m_resetRequested = false;
+    m_waitingForKeyframe = false;
     m_isDecoding = true;
     m_cleanupTimer->start(200);
     qDebug() << "[Decoder] 视频解码循环启动。";
@@ -253,10 +279,72 @@ void VideoDecoder::decodeLoop()
     }
 }
 
+void VideoDecoder::markReferenceBroken(const char* reason)
+{
+    if (!m_intraRefreshMode) {
+        m_waitingForKeyframe = true;
+    }
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - m_lastKeyframeRequestMs < KEYFRAME_RETRY_MS) return;
+    m_lastKeyframeRequestMs = now;
+    qDebug() << "[Decoder] 参考链断裂(" << reason << ")，请求关键帧。";
+    emit keyframeNeeded(QString::fromUtf8(reason));
+}
+
+bool VideoDecoder::dropIncompleteFramesBefore(int64_t pts)
+{
+    bool reference_lost = false;
+    auto it = m_reassemblyBuffer.begin();
+    while (it != m_reassemblyBuffer.end() && it->first < pts) {
+        // 首个分片还在时可以看出帧类型，非参考帧丢了不影响后续解码
+        const auto first = it->second.fragments.find(0);
+        const bool disposable = first != it->second.fragments.end()
+            && isNonReferenceNal(firstVclNalType(reinterpret_cast<const uint8_t*>(first->second.constData()), first->second.size()));
+        if (!disposable) reference_lost = true;
+
+        m_droppedFramePts.push_back(it->first);
+        if (m_droppedFramePts.size() > MAX_DROPPED_FRAME_HISTORY) m_droppedFramePts.pop_front();
+        it = m_reassemblyBuffer.erase(it);
+    }
+    return reference_lost;
+}
+
+void VideoDecoder::checkReferenceSequence(uint16_t referenceSeq, const uint8_t* payload, int size, uint16_t fragmentIndex)
+{
+    const uint16_t seq = referenceSeq & AppConfig::REFERENCE_SEQ_MASK;
+    const bool is_reference = (referenceSeq & AppConfig::REFERENCE_SEQ_FLAG) != 0;
+    if (!m_referenceSeqValid) {
+        m_referenceSeqValid = true;
+        m_lastReferenceSeq = seq;
+        return;
+    }
+    // 落后超过半个序号空间的视为迟到的旧数据报
+    const uint16_t ahead = (seq - m_lastReferenceSeq) & AppConfig::REFERENCE_SEQ_MASK;
+    if (ahead == 0 || ahead > AppConfig::REFERENCE_SEQ_MASK / 2) return;
+    m_lastReferenceSeq = seq;
+
+    // 参考帧自己占一个新序号，非参考帧沿用上一个
+    const int lost = ahead - (is_reference ? 1 : 0);
+    if (lost <= 0) return;
+    // IRAP 重新开始参考链，此前丢的帧不影响它（服务端丢弃参考帧后正是跳到下一个 IDR）
+    if (fragmentIndex == 0 && isIrapNal(firstVclNalType(payload, size))) return;
+    qDebug() << "[Decoder] 参考帧序号跳过" << lost << "个。";
+    markReferenceBroken("整帧丢失");
+}
+
 void VideoDecoder::processDatagram(const MediaPacket& packet)
 {
+    // 【新增】跳转后旧的分片和参考帧都已无用，等待服务端的下一个关键帧
+    if (m_resetRequested.exchange(false)) {
+        m_reassemblyBuffer.clear();
+        m_droppedFramePts.clear();
+        m_waitingForKeyframe = !m_intraRefreshMode;
+        m_lastKeyframeRequestMs = QDateTime::currentMSecsSinceEpoch();
+        m_referenceSeqValid = false;
+    }
+
     const QByteArray& data = packet.payload;
-    const int HEADER_SIZE = 1 + 8 + 2 + 2;
+    const int HEADER_SIZE = AppConfig::DATAGRAM_HEADER_SIZE;
     if (data.size() < HEADER_SIZE) return;
 
     const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data.constData());
@@ -269,6 +357,16 @@ void VideoDecoder::processDatagram(const MediaPacket& packet)
     ptr += sizeof(uint16_t);
     uint16_t fragment_index;
     memcpy(&fragment_index, ptr, sizeof(uint16_t));
+    // 【修改】分片序号同样是网络字节序；分片大小随服务端的数据报上限变化，按序号顺序拼接即可，不依赖固定的分片长度
+    fragment_index = ntohs_portable(fragment_index);
+    if (fragment_count == 0 || fragment_index >= fragment_count) return;
+    // 【新增】整帧丢失检测（对每个分片都检查，首个到达的分片即可发现缺口）
+    uint16_t reference_seq;
+    memcpy(&reference_seq, data.constData() + AppConfig::REFERENCE_SEQ_OFFSET, sizeof(uint16_t));
+    checkReferenceSequence(ntohs_portable(reference_seq), reinterpret_cast<const uint8_t*>(data.constData()) + HEADER_SIZE,
+        data.size() - HEADER_SIZE, fragment_index);
+    // 【新增】已判定丢失的帧的迟到分片，不再重新开始重组
+    if (std::find(m_droppedFramePts.begin(), m_droppedFramePts.end(), timestamp) != m_droppedFramePts.end()) return;
     const QByteArray payload = data.mid(HEADER_SIZE);
     QByteArray frame_to_decode;
 
@@ -297,12 +395,31 @@ void VideoDecoder::processDatagram(const MediaPacket& packet)
 
     if (frame_to_decode.isEmpty()) return;
 
+    // 【新增】服务端按 pts 顺序发送，比刚完成的帧更早、仍不完整的帧已经不可能补齐
+    if (dropIncompleteFramesBefore(timestamp)) {
+        markReferenceBroken("帧分片丢失");
+    }
+
+    // 【新增】等待关键帧期间跳过非 IRAP 帧（画面停在最后一个正确帧），超过重发间隔仍未等到则再次请求
+    if (m_waitingForKeyframe && !m_intraRefreshMode) {
+        if (!isIrapNal(firstVclNalType(reinterpret_cast<const uint8_t*>(frame_to_decode.constData()), frame_to_decode.size()))) {
+            markReferenceBroken("等待关键帧");
+            return;
+        }
+        m_waitingForKeyframe = false;
+        qDebug() << "[Decoder] 收到关键帧，恢复解码。";
+    }
+
     av_packet_unref(m_packet);
     if (av_new_packet(m_packet, frame_to_decode.size()) < 0) return;
     memcpy(m_packet->data, frame_to_decode.constData(), frame_to_decode.size());
     m_packet->pts = packet.ts;
 
     int ret = avcodec_send_packet(m_codecContext, m_packet);
+    // 【新增】码流无法解析通常是参考帧缺失造成的
+    if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        markReferenceBroken("解码失败");
+    }
     if (ret >= 0) {
         while (ret >= 0) {
             AVFrame* received_frame = (m_hw_device_type != AV_HWDEVICE_TYPE_NONE) ? m_hw_frame : m_frame;
@@ -311,6 +428,13 @@ void VideoDecoder::processDatagram(const MediaPacket& packet)
             if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
             else if (ret < 0) break;
 
+            // 【新增】解码器标记为损坏的帧不显示
+            if (received_frame->decode_error_flags || (received_frame->flags & AV_FRAME_FLAG_CORRUPT)) {
+                markReferenceBroken("解码帧损坏");
+                av_frame_unref(received_frame);
+                continue;
+            }
+
             AVFrame* final_cpu_frame = nullptr;
             if (m_hw_device_type != AV_HWDEVICE_TYPE_NONE) {
                 if (av_hwframe_transfer_data(m_frame, m_hw_frame, 0) < 0) {
@@ -334,30 +458,27 @@ void VideoDecoder::processDatagram(const MediaPacket& packet)
                 continue;
             }
 
-            av_frame_unref(m_sw_frame);
-            m_sw_frame->width = final_cpu_frame->width;
-            m_sw_frame->height = final_cpu_frame->height;
-            m_sw_frame->format = AV_PIX_FMT_YUV420P;
-            if (av_frame_get_buffer(m_sw_frame, 0) < 0) {
+            // 【修改】直接转换到从帧池取得的帧中，省去一次分配和 clone
+            AVFrame* out_frame = FramePool::instance().acquire(final_cpu_frame->width, final_cpu_frame->height, AV_PIX_FMT_YUV420P);
+            if (!out_frame) {
                 av_frame_unref(m_hw_frame);
                 av_frame_unref(m_frame);
                 continue;
             }
 
             sws_scale(m_sws_ctx_fixup, (const uint8_t* const*)final_cpu_frame->data, final_cpu_frame->linesize,
-                0, final_cpu_frame->height, m_sw_frame->data, m_sw_frame->linesize);
-
-            m_sw_frame->pts = final_cpu_frame->pts;
+                0, final_cpu_frame->height, out_frame->data, out_frame->linesize);
 
-            AVFrame* frame_clone = av_frame_clone(m_sw_frame);
-            if (frame_clone) {
-                auto decodedFrame = std::make_unique<DecodedFrame>(frame_clone);
-                m_outputBuffer.add_frame(std::move(decodedFrame));
+            out_frame->pts = final_cpu_frame->pts;
+            if (m_enhancementStage) {
+                m_enhancementStage->push(std::make_unique<DecodedFrame>(out_frame));
+            }
+            else {
+                m_outputBuffer.add_frame(std::make_unique<DecodedFrame>(out_frame));
             }
 
             av_frame_unref(m_hw_frame);
             av_frame_unref(m_frame);
-            av_frame_unref(m_sw_frame);
         }
     }
     av_packet_unref(m_packet);
@@ -365,13 +486,15 @@ void VideoDecoder::processDatagram(const MediaPacket& packet)
 
 void VideoDecoder::cleanupReassemblyBuffer()
 {
-    auto it = m_reassemblyBuffer.begin();
-    while (it != m_reassemblyBuffer.end()) {
-        if (it->second.first_received_time.msecsTo(QDateTime::currentDateTime()) > 500) {
-            it = m_reassemblyBuffer.erase(it);
-        }
-        else {
-            ++it;
+    // 【修改】超时的不完整帧同样按丢失处理；之前的帧也一并丢弃，保持按 pts 顺序
+    const QDateTime now = QDateTime::currentDateTime();
+    int64_t expired_pts = INT64_MIN;
+    for (const auto& pair : m_reassemblyBuffer) {
+        if (pair.second.first_received_time.msecsTo(now) > REASSEMBLY_TIMEOUT_MS) {
+            expired_pts = pair.first;
         }
     }
+    if (expired_pts != INT64_MIN && dropIncompleteFramesBefore(expired_pts + 1)) {
+        markReferenceBroken("帧重组超时");
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <QThread>
 #include <QTimer>
 #include <atomic>
+#include <deque>
 #include <map>
 #include <vector>
 #include <QByteArray>
@@ -20,6 +21,7 @@ extern "C" {
 class JitterBuffer;
 class DecodedFrameBuffer;
 class MediaPacket;
+class EnhancementStage;
 
 class VideoDecoder : public QObject
 {
@@ -32,6 +34,18 @@ public:
     // public getter，用于让回调函数访问私有成员
     enum AVPixelFormat get_hw_pixel_format() const { return m_hw_pix_fmt; }
 
+    // 【新增】设置后解码帧先交给超分阶段，由它放入帧缓冲区；需在开始解码前调用
+    void setEnhancementStage(EnhancementStage* stage) { m_enhancementStage = stage; }
+
+    // 【新增】服务端使用周期性帧内刷新时，参考链断裂后继续解码显示，不冻结画面等待 IRAP
+    void setIntraRefreshMode(bool enabled) { m_intraRefreshMode = enabled; }
+    // 【新增】跳转后丢弃重组中的分片并等待关键帧；可跨线程调用，由解码线程处理
+    void requestReset() { m_resetRequested = true; }
+
+signals:
+    // 【新增】参考链断裂，需要服务端发送关键帧
+    void keyframeNeeded(const QString& reason);
+
 public slots:
     void startDecoding();
     void stopDecoding();
@@ -44,6 +58,12 @@ private:
     void cleanupFFmpeg();
     void decodeLoop();
     void processDatagram(const MediaPacket& packet);
+    // 【新增】参考链断裂：IDR 模式下冻结画面直到 IRAP 到达，并按重发间隔请求关键帧
+    void markReferenceBroken(const char* reason);
+    // 【新增】丢弃重组缓冲区中 pts 早于给定值的不完整帧，返回其中是否有参考帧
+    bool dropIncompleteFramesBefore(int64_t pts);
+    // 【新增】按数据报头中的参考帧序号发现整帧都没收到的参考帧（分片重组看不到这种丢失）
+    void checkReferenceSequence(uint16_t referenceSeq, const uint8_t* payload, int size, uint16_t fragmentIndex);
 
     // 用于重组的结构和缓冲区
     struct FragmentedFrame {
@@ -52,12 +72,23 @@ private:
         std::map<uint16_t, QByteArray> fragments;
     };
     std::map<int64_t, FragmentedFrame> m_reassemblyBuffer;
+    // 【新增】已判定丢失的帧，其迟到分片直接忽略
+    std::deque<int64_t> m_droppedFramePts;
+
+    // 【新增】参考链状态（仅解码线程访问，两个标志除外）
+    std::atomic<bool> m_intraRefreshMode{ false };
+    std::atomic<bool> m_resetRequested{ false };
+    bool m_waitingForKeyframe = false;
+    qint64 m_lastKeyframeRequestMs = 0;
+    bool m_referenceSeqValid = false;
+    uint16_t m_lastReferenceSeq = 0;
 
     QTimer* m_cleanupTimer;
 
     std::atomic<bool> m_isDecoding;
     JitterBuffer& m_inputBuffer;
     DecodedFrameBuffer& m_outputBuffer;
+    EnhancementStage* m_enhancementStage = nullptr;
     MasterClock& m_clock;
 
     AVCodecContext* m_codecContext = nullptr;
@@ -67,7 +98,6 @@ private:
 
     // 【新增】用于格式规范化的成员
     SwsContext* m_sws_ctx_fixup = nullptr;
-    AVFrame* m_sw_frame = nullptr; // 用于存放 sws_scale 输出的标准CPU帧
 
     // 硬件加速相关成员
     AVBufferRef* m_hw_device_ctx = nullptr;
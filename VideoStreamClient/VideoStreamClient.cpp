@@ -12,6 +12,17 @@
 #include "ClickableSlider.h"
 #include "DebugWindow.h"
 #include "ChartWidget.h"
+#include "PresentationScheduler.h"
+#include "FramePool.h"
+#include "InterpolationKernels.h"
+#include "InterpolationEngine.h"
+#include "ColorConversionKernels.h"
+#include "InferenceRuntime.h"
+#include "Float16Kernels.h"
+#include "EnhancementGovernor.h"
+#include "EnhancementStage.h"
+#include "AudioKernels.h"
+#include "LatencyTracker.h"
 
 #include <QDebug>
 #include <QKeyEvent>
@@ -32,6 +43,11 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
+namespace {
+    // 【新增】解码帧缓冲的时延，超分阶段的队列深度也按它计算
+    constexpr int DECODED_BUFFER_DELAY_MS = 100;
+}
+
 VideoStreamClient::VideoStreamClient(QWidget* parent)
     : QMainWindow(parent),
     m_workerThread(nullptr),
@@ -47,11 +63,17 @@ VideoStreamClient::VideoStreamClient(QWidget* parent)
     m_decodedFrameBuffer = std::make_unique<DecodedFrameBuffer>();
     m_rife_interpolator = std::make_unique<RIFEInterpolator>();
     m_fsrcnnUpscaler = std::make_unique<FSRCNNUpscaler>(); // 修改：创建FSRCNN实例
+    m_enhancementGovernor = std::make_unique<EnhancementGovernor>();
+    m_latencyTracker = std::make_unique<LatencyTracker>();
 
     // ======================【在这里添加代码】======================
     // 设置一个100毫秒的缓冲延迟。
-    m_decodedFrameBuffer->set_buffer_duration(100);
+    m_decodedFrameBuffer->set_buffer_duration(DECODED_BUFFER_DELAY_MS);
     // ===============================================================
+    qDebug() << "[Main] 帧插值内核:" << InterpolationKernels::isa_name(InterpolationKernels::active_isa());
+    qDebug() << "[Main] RIFE 色彩转换内核:" << ColorConversionKernels::active_isa_name();
+    qDebug() << "[Main] FSRCNN fp16 转换内核:" << Float16Kernels::isa_name(Float16Kernels::active_isa());
+    qDebug() << "[Main] 音频增益内核:" << AudioKernels::isa_name(AudioKernels::active_isa());
 
     // 初始化UI、工作线程、媒体线程和信号槽连接
     initUI();
@@ -63,10 +85,11 @@ VideoStreamClient::VideoStreamClient(QWidget* parent)
     m_animationTimer = new QTimer(this);
     connect(m_animationTimer, &QTimer::timeout, this, &VideoStreamClient::onAnimationStep);
 
-    // 初始化渲染定时器，控制画面更新频率
-    m_renderTimer = new QTimer(this);
-    connect(m_renderTimer, &QTimer::timeout, this, &VideoStreamClient::onRenderTimerTimeout);
-    m_renderTimer->start(8); // 目标约120Hz刷新率
+    // 【修改】渲染节拍跟随显示器的缓冲交换 (frameSwapped)，每个 vsync 选一次帧
+    m_presentationScheduler = new PresentationScheduler(m_videoWidget, this);
+    connect(m_videoWidget, &VideoWidget::framePainted, m_presentationScheduler, &PresentationScheduler::onFramePainted); // 【新增】
+    connect(m_presentationScheduler, &PresentationScheduler::vsyncTick, this, &VideoStreamClient::onVsyncTick);
+    m_presentationScheduler->start();
 
     // 初始化状态更新定时器（用于更新FPS、延迟等信息）
     m_lastFpsUpdateTime = QDateTime::currentMSecsSinceEpoch();
@@ -88,11 +111,21 @@ VideoStreamClient::~VideoStreamClient()
         m_videoDecodeThread->quit();
         m_videoDecodeThread->wait();
     }
+    if (m_enhancementThread && m_enhancementThread->isRunning()) {
+        m_enhancementStage->stopProcessing();
+        m_enhancementThread->quit();
+        m_enhancementThread->wait();
+    }
     if (m_audioPlayThread && m_audioPlayThread->isRunning()) {
         QMetaObject::invokeMethod(m_audioPlayer, "stopPlaying", Qt::QueuedConnection);
         m_audioPlayThread->quit();
         m_audioPlayThread->wait();
     }
+    if (m_interpolationThread && m_interpolationThread->isRunning()) {
+        m_interpolationEngine->stopInterpolating();
+        m_interpolationThread->quit();
+        m_interpolationThread->wait();
+    }
     qDebug() << "客户端主窗口已销毁。";
 }
 
@@ -300,6 +333,7 @@ void VideoStreamClient::initConnections()
                 if (success) {
                     QMessageBox::information(this, "成功", "RIFE功能已成功开启！");
                     updateRIFEButtonState(true);
+                    resetEnhancementGovernor();
                 }
                 else {
                     QMessageBox::critical(this, "RIFE加载失败", QString::fromStdString(error_message));
@@ -309,10 +343,12 @@ void VideoStreamClient::initConnections()
             }
             else {
                 updateRIFEButtonState(true);
+                resetEnhancementGovernor();
             }
         }
         else {
             updateRIFEButtonState(false);
+            m_interpolationEngine->setEnabled(false);
         }
         });
 
@@ -327,6 +363,8 @@ void VideoStreamClient::initConnections()
                 if (success) {
                     QMessageBox::information(this, "成功", "FSRCNN 功能已成功开启！");
                     updateFSRCNNButtonState(true);
+                    m_enhancementStage->setEnabled(true);
+                    resetEnhancementGovernor();
                 }
                 else {
                     QMessageBox::critical(this, "FSRCNN 加载失败", QString::fromStdString(error_message));
@@ -336,16 +374,24 @@ void VideoStreamClient::initConnections()
             }
             else {
                 updateFSRCNNButtonState(true);
+                m_enhancementStage->setEnabled(true);
+                resetEnhancementGovernor();
             }
         }
         else {
             updateFSRCNNButtonState(false);
+            m_enhancementStage->setEnabled(false);
         }
         });
     connect(m_worker, &ClientWorker::connectionSuccess, this, &VideoStreamClient::handleConnectionSuccess);
     connect(m_worker, &ClientWorker::connectionFailed, this, &VideoStreamClient::handleConnectionFailed);
     connect(m_worker, &ClientWorker::playInfoReceived, this, &VideoStreamClient::handlePlayInfo);
     connect(m_worker, &ClientWorker::latencyUpdated, this, &VideoStreamClient::onLatencyUpdated);
+    // 【新增】解码线程发现参考链断裂后经工作线程的控制流请求关键帧
+    connect(m_videoDecoder, &VideoDecoder::keyframeNeeded, m_worker, &ClientWorker::requestKeyframe, Qt::QueuedConnection);
+    connect(m_worker, &ClientWorker::videoRefreshModeReceived, this, [this](bool intraRefresh) {
+        m_videoDecoder->setIntraRefreshMode(intraRefresh);
+        });
 }
 
 void VideoStreamClient::updateRIFEButtonState(bool enabled) {
@@ -367,88 +413,52 @@ void VideoStreamClient::updateFSRCNNButtonState(bool enabled) {
     }
 }
 
-void VideoStreamClient::onRenderTimerTimeout()
+// 【新增】调节器的档位只收紧用户开关，不会打开用户关闭的功能
+void VideoStreamClient::applyEnhancementLevel(EnhancementLevel level)
+{
+    m_enhancementStage->setLevel(level);
+    m_interpolationEngine->setReducedMode(level == EnhancementLevel::Reduced);
+    m_interpolationEngine->setEnabled(m_rifeSwitchButton->isChecked() && m_rife_interpolator->is_initialized()
+        && level != EnhancementLevel::Off);
+}
+
+void VideoStreamClient::resetEnhancementGovernor()
+{
+    m_enhancementGovernor->reset();
+    applyEnhancementLevel(m_enhancementGovernor->level());
+}
+
+void VideoStreamClient::onVsyncTick(double vsyncLeadMs)
 {
     // 【修改】时钟的推进现在由 get_time_ms 内部基于系统时间计算，不再需要外部 update
-    // 所以此函数主要逻辑不变，但其行为会因为 MasterClock 的改变而变得正确
+    // 选帧的目标时间是下一次 vsync 时刻的媒体时间，而不是当前时刻
 
     if (m_masterClock->is_paused()) {
         return;
     }
 
-    int64_t target_pts = m_masterClock->get_time_ms();
-    if (target_pts < 0) return;
-
-    std::unique_ptr<DecodedFrame> decoded_frame_wrapper;
-    bool is_original_frame = false;
+    int64_t now_pts = m_masterClock->get_time_ms();
+    if (now_pts < 0) return;
+    int64_t target_pts = now_pts + static_cast<int64_t>(std::lround(vsyncLeadMs));
 
-    // RIFE开启时，采用新的强制插帧优先逻辑
-    if (m_rifeSwitchButton->isChecked() && m_rife_interpolator->is_initialized()) {
-        const AVFrame* prev_frame = nullptr;
-        const AVFrame* next_frame = nullptr;
-        double factor = 0.0;
-
-        m_decodedFrameBuffer->get_interpolation_frames(target_pts, prev_frame, next_frame, factor);
-
-        if (prev_frame && next_frame && factor > 0.01 && factor < 0.99) {
-            AVFrame* rife_frame = m_rife_interpolator->interpolate(prev_frame, next_frame, factor);
-            if (rife_frame) {
-                decoded_frame_wrapper = std::make_unique<DecodedFrame>(rife_frame);
-                is_original_frame = false;
-            }
-        }
-
-        if (!decoded_frame_wrapper) {
-            decoded_frame_wrapper = m_decodedFrameBuffer->get_frame(target_pts);
-            if (decoded_frame_wrapper) {
-                is_original_frame = true;
-            }
-        }
-    }
-    else {
-        // RIFE关闭时的原始逻辑：总是获取原始帧
-        decoded_frame_wrapper = m_decodedFrameBuffer->get_frame(target_pts);
-        if (decoded_frame_wrapper) {
-            is_original_frame = true;
-        }
-    }
+    // 【修改】RIFE 中间帧由 InterpolationEngine 在后台预先生成并插入缓冲区，
+    // 渲染线程只取用已完成的帧，不再同步推理
+    std::unique_ptr<DecodedFrame> decoded_frame_wrapper = m_decodedFrameBuffer->get_frame(target_pts);
 
-    // 如果以上所有尝试都失败了，使用最后的备用方案：获取一个最接近的帧（通常是线性插值）
+    // 【修改】两帧之间的 vsync：这段区间没有 RIFE 生成的中间帧时（RIFE 关闭、降级模式跳过的帧对、
+    // 赶不上截止时间的帧对），用上一次显示的帧与下一帧做 SIMD 线性混合，每个 vsync 都能得到与目标时刻对应的画面
     if (!decoded_frame_wrapper) {
         decoded_frame_wrapper = m_decodedFrameBuffer->get_interpolated_frame(target_pts);
-        if (decoded_frame_wrapper) {
-            is_original_frame = true;
-        }
     }
 
+    // 没有新的帧需要显示：保持当前纹理，不做重复上传
     if (!decoded_frame_wrapper) return;
 
-    // 在处理前，先记录原始分辨率
-    AVFrame* original_frame = decoded_frame_wrapper->frame.get();
-    if (original_frame) {
-        m_originalWidth = original_frame->width;
-        m_originalHeight = original_frame->height;
-    }
-
-    // 修改：FSRCNN 超分处理
-    AVFrame* frame_to_render = nullptr;
-    if (m_fsrcnnSwitchButton->isChecked() && m_fsrcnnUpscaler->is_initialized()) {
-        AVFrame* upscaled_frame = m_fsrcnnUpscaler->upscale(original_frame);
-        if (upscaled_frame) {
-            m_upscaledWidth = upscaled_frame->width;
-            m_upscaledHeight = upscaled_frame->height;
-            decoded_frame_wrapper = std::make_unique<DecodedFrame>(upscaled_frame);
-            frame_to_render = decoded_frame_wrapper->frame.get();
-        }
-        else {
-            frame_to_render = original_frame;
-        }
-    }
-    else {
-        m_upscaledWidth = 0;
-        m_upscaledHeight = 0;
-        frame_to_render = original_frame;
-    }
+    const bool is_original_frame = !decoded_frame_wrapper->interpolated;
+
+    // 【修改】FSRCNN 超分已在解码后的 EnhancementStage 中完成，缓冲区里的帧即为最终分辨率，
+    // 同一帧被多次呈现也不会重复推理
+    AVFrame* frame_to_render = decoded_frame_wrapper->frame.get();
 
     if (!frame_to_render || !frame_to_render->data[0]) {
         return;
@@ -459,12 +469,16 @@ void VideoStreamClient::onRenderTimerTimeout()
         return;
     }
 
-    QMetaObject::invokeMethod(m_videoWidget, "onFrameDecoded", Qt::QueuedConnection, Q_ARG(AVFrame*, frame_clone));
+    // 与 VideoWidget 同在 GUI 线程，直接派发可省去一次事件循环的延迟
+    const int64_t presented_pts = decoded_frame_wrapper->frame->pts;
+    m_presentationScheduler->notifyFrameQueued(presented_pts, target_pts); // 【修改】先记录目标时刻，显示与否由 VideoWidget 回报
+    m_videoWidget->onFrameDecoded(frame_clone);
 
     m_renderedFrameCount++;
     if (is_original_frame)
     {
         m_frameCount++;
+        m_latencyTracker->on_frame_presented(presented_pts); // 【新增】
     }
 
     if (m_currentDurationSec > 0 && !m_progressSlider->isSliderDown()) {
@@ -482,7 +496,7 @@ void VideoStreamClient::onRenderTimerTimeout()
 void VideoStreamClient::initWorkerThread()
 {
     m_workerThread = new QThread(this);
-    m_worker = new ClientWorker(*m_networkMonitor, *m_videoJitterBuffer, *m_audioJitterBuffer);
+    m_worker = new ClientWorker(*m_networkMonitor, *m_videoJitterBuffer, *m_audioJitterBuffer, *m_latencyTracker);
     m_worker->moveToThread(m_workerThread);
     connect(m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
     m_workerThread->start();
@@ -491,8 +505,18 @@ void VideoStreamClient::initWorkerThread()
 
 void VideoStreamClient::initMediaThreads()
 {
+    // 【新增】超分阶段先于解码器创建，解码帧经它放入帧缓冲区
+    m_enhancementThread = new QThread(this);
+    m_enhancementStage = new EnhancementStage(*m_decodedFrameBuffer, *m_masterClock, *m_fsrcnnUpscaler);
+    m_enhancementStage->setBufferDelay(DECODED_BUFFER_DELAY_MS);
+    m_enhancementStage->moveToThread(m_enhancementThread);
+    connect(m_enhancementThread, &QThread::finished, m_enhancementStage, &QObject::deleteLater);
+    m_enhancementThread->start();
+    QMetaObject::invokeMethod(m_enhancementStage, "startProcessing", Qt::QueuedConnection);
+
     m_videoDecodeThread = new QThread(this);
     m_videoDecoder = new VideoDecoder(*m_videoJitterBuffer, *m_decodedFrameBuffer, *m_masterClock);
+    m_videoDecoder->setEnhancementStage(m_enhancementStage);
     m_videoDecoder->moveToThread(m_videoDecodeThread);
     connect(m_videoDecodeThread, &QThread::finished, m_videoDecoder, &QObject::deleteLater);
     m_videoDecodeThread->start();
@@ -502,6 +526,13 @@ void VideoStreamClient::initMediaThreads()
     m_audioPlayer->moveToThread(m_audioPlayThread);
     connect(m_audioPlayThread, &QThread::finished, m_audioPlayer, &QObject::deleteLater);
     m_audioPlayThread->start();
+
+    m_interpolationThread = new QThread(this);
+    m_interpolationEngine = new InterpolationEngine(*m_decodedFrameBuffer, *m_masterClock, *m_rife_interpolator);
+    m_interpolationEngine->moveToThread(m_interpolationThread);
+    connect(m_interpolationThread, &QThread::finished, m_interpolationEngine, &QObject::deleteLater);
+    m_interpolationThread->start();
+    QMetaObject::invokeMethod(m_interpolationEngine, "startInterpolating", Qt::QueuedConnection);
 }
 
 void VideoStreamClient::resetPlaybackUI()
@@ -527,6 +558,7 @@ void VideoStreamClient::resetPlaybackUI()
     // 新增：重置FSRCNN按钮状态
     updateFSRCNNButtonState(false);
     if (m_fsrcnnSwitchButton) m_fsrcnnSwitchButton->setChecked(false);
+    if (m_enhancementStage) m_enhancementStage->setEnabled(false);
 
     m_originalWidth = 0;
     m_originalHeight = 0;
@@ -537,6 +569,7 @@ void VideoStreamClient::resetPlaybackUI()
         m_debugWindow->bitrateChart()->clearChart();
         m_debugWindow->fpsChart()->clearChart();
         m_debugWindow->latencyChart()->clearChart();
+        m_debugWindow->presentErrorChart()->clearChart();
     }
     m_currentFps = 0.0;
     m_frameCount = 0;
@@ -630,6 +663,9 @@ void VideoStreamClient::onConnectBtnClicked()
         QJsonObject config = doc.object();
         QString ip = m_ipEntry->text();
         quint16 port = static_cast<quint16>(config.value("server_port").toInt(9998));
+        // 【新增】推理线程数（0 = ONNX Runtime 默认），对之后加载的模型生效
+        InferenceRuntime::instance().set_thread_counts(config.value("inference_intra_op_threads").toInt(0),
+            config.value("inference_inter_op_threads").toInt(0));
 
         statusBar()->showMessage("状态: 正在连接 " + ip + "...");
         m_connectBtn->setEnabled(false);
@@ -679,7 +715,12 @@ void VideoStreamClient::onPlayBtnClicked()
     m_masterClock->reset();
     m_videoJitterBuffer->reset();
     m_audioJitterBuffer->reset();
+    m_audioPlayer->requestFlush();
     m_decodedFrameBuffer->reset();
+    m_videoDecoder->requestReset();
+    m_enhancementStage->requestReset();
+    m_interpolationEngine->requestReset();
+    resetEnhancementGovernor();
 
     QMetaObject::invokeMethod(m_videoDecoder, "startDecoding", Qt::QueuedConnection);
     QMetaObject::invokeMethod(m_audioPlayer, "startPlaying", Qt::QueuedConnection);
@@ -742,7 +783,10 @@ void VideoStreamClient::onSliderReleased()
     // 清空所有缓冲区
     m_videoJitterBuffer->reset();
     m_audioJitterBuffer->reset();
+    m_audioPlayer->requestFlush();
     m_decodedFrameBuffer->reset();
+    m_enhancementStage->requestReset();
+    m_interpolationEngine->requestReset();
 
     m_masterClock->seek(static_cast<int64_t>(targetSec * 1000.0));
 
@@ -784,6 +828,39 @@ void VideoStreamClient::updateStatus()
         m_lastFpsUpdateTime = now;
     }
 
+    // 呈现统计：vsync 误差、丢帧与重复帧
+    m_presentationScheduler->addDroppedFrames(m_decodedFrameBuffer->take_dropped_count());
+    PresentationStats presentStats = m_presentationScheduler->takeStats();
+    m_interpolationEngine->setDisplayInterval(presentStats.refresh_interval_ms);
+    InterpolationStats interpStats = m_interpolationEngine->takeStats();
+    EnhancementStageStats stageStats = m_enhancementStage->takeStats();
+    LatencyStats latencyStats = m_latencyTracker->take_stats(); // 【新增】
+    const int upscaledFrames = stageStats.model_frames + stageStats.resized_frames;
+    m_originalWidth = stageStats.source_width;
+    m_originalHeight = stageStats.source_height;
+    m_upscaledWidth = stageStats.output_width;
+    m_upscaledHeight = stageStats.output_height;
+
+    // 【新增】增强档位调节：推理耗时与呈现截止时间比较，过载降档、空闲升档
+    const bool enhancementActive = (m_fsrcnnSwitchButton->isChecked() && m_fsrcnnUpscaler->is_initialized())
+        || (m_rifeSwitchButton->isChecked() && m_rife_interpolator->is_initialized());
+    if (enhancementActive && m_masterClock->get_time_ms() >= 0 && !m_masterClock->is_paused()) {
+        EnhancementLoad load;
+        load.frame_budget_ms = stageStats.avg_frame_interval_ms;
+        load.upscale_frames = upscaledFrames;
+        load.upscale_avg_ms = stageStats.avg_upscale_ms;
+        load.interp_budget_ms = interpStats.avg_pair_interval_ms;
+        load.interp_avg_ms = interpStats.avg_inference_ms;
+        load.interp_generated = interpStats.generated;
+        load.interp_dropped = interpStats.dropped_deadline;
+        EnhancementDecision decision = m_enhancementGovernor->update(load);
+        if (decision.changed) {
+            qInfo() << "[Governor] 增强档位 ->" << EnhancementGovernor::level_name(decision.level)
+                << "|" << QString::fromStdString(decision.reason);
+            applyEnhancementLevel(decision.level);
+        }
+    }
+
     NetworkStats stats = m_networkMonitor->get_statistics();
     double currentBitrateKbps = stats.bitrate_bps / 1000.0;
     double latency = m_currentLatencyMs.load();
@@ -793,7 +870,89 @@ void VideoStreamClient::updateStatus()
             m_debugWindow->bitrateChart()->updateChart(currentBitrateKbps);
             m_debugWindow->fpsChart()->updateChart(m_renderedFps);
             m_debugWindow->latencyChart()->updateChart(latency);
+            m_debugWindow->presentErrorChart()->updateChart(presentStats.avg_present_error_ms);
+        }
+        m_debugWindow->setPresentationInfo(QString("刷新周期: %1 ms | 显示时刻误差(均/峰): %2 / %3 ms | 呈现: %4 | 丢帧: %5 | 重复: %6")
+            .arg(presentStats.refresh_interval_ms, 0, 'f', 2)
+            .arg(presentStats.avg_present_error_ms, 0, 'f', 2)
+            .arg(presentStats.max_present_error_ms, 0, 'f', 2)
+            .arg(presentStats.presented_frames)
+            .arg(presentStats.dropped_frames)
+            .arg(presentStats.duplicated_frames));
+
+        // 【新增】只有实时采集的流带逐帧时间戳；尚无时钟样本时只显示两端各自的部分
+        if (latencyStats.frames == 0) {
+            m_debugWindow->setGlassToGlassInfo("端到端时延: N/A（仅直播源提供）");
+        }
+        else {
+            const QString total = latencyStats.clock_synced
+                ? QString("%1 ms (峰 %2 ms)").arg(latencyStats.total_ms, 0, 'f', 1).arg(latencyStats.max_total_ms, 0, 'f', 1)
+                : QString("等待时钟同步");
+            m_debugWindow->setGlassToGlassInfo(QString("端到端时延: %1 | 转换 %2 | 环等待 %3 | 编码 %4 | 分片 %5 | 网络 %6 | 客户端 %7 ms | 时钟差 %8 ms (RTT %9 ms)")
+                .arg(total)
+                .arg(latencyStats.convert_ms, 0, 'f', 1)
+                .arg(latencyStats.ring_wait_ms, 0, 'f', 1)
+                .arg(latencyStats.encode_ms, 0, 'f', 1)
+                .arg(latencyStats.packetize_ms, 0, 'f', 1)
+                .arg(latencyStats.network_ms, 0, 'f', 1)
+                .arg(latencyStats.client_ms, 0, 'f', 1)
+                .arg(latencyStats.clock_offset_ms, 0, 'f', 1)
+                .arg(latencyStats.clock_rtt_ms, 0, 'f', 1));
+        }
+
+        // 【新增】音频播放调度：水位/目标、抖动、丢包隐藏、时间伸缩
+        AudioPlayoutStats audioStats = m_audioPlayer->takeStats();
+        m_debugWindow->setAudioInfo(QString("音频缓冲: %1 / 目标 %2 ms | 抖动 %3 ms | 隐藏 %4 次 (%5 ms) | 伸缩 %6 (加速 %7 / 减速 %8) | 迟到丢弃 %9 | 跳过 %10 ms | 重新缓冲 %11 | 欠载 %12")
+            .arg(audioStats.buffer_ms, 0, 'f', 1)
+            .arg(audioStats.target_ms, 0, 'f', 1)
+            .arg(audioStats.jitter_ms, 0, 'f', 1)
+            .arg(audioStats.concealments)
+            .arg(audioStats.concealed_ms, 0, 'f', 0)
+            .arg(audioStats.stretch_ratio, 0, 'f', 3)
+            .arg(audioStats.accelerated)
+            .arg(audioStats.expanded)
+            .arg(audioStats.late_dropped)
+            .arg(audioStats.skipped_ms, 0, 'f', 0)
+            .arg(audioStats.rebuffers)
+            .arg(audioStats.underruns));
+
+        QStringList poolLines;
+        for (const auto& pool : FramePool::instance().get_stats()) {
+            poolLines << QString("%1x%2 fmt%3: 峰值 %4 帧 (%5 MB), 累计取用 %6")
+                .arg(pool.width).arg(pool.height).arg(pool.format)
+                .arg(pool.high_water)
+                .arg(pool.high_water * pool.frame_bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                .arg(pool.acquired);
+        }
+        QString interpInfo = m_interpolationEngine->isEnabled()
+            ? QString("RIFE 插帧: %1x | 生成 %2 | 超时跳过 %3 | 平均推理 %4 ms")
+                .arg(interpStats.multiplier).arg(interpStats.generated).arg(interpStats.dropped_deadline).arg(interpStats.avg_inference_ms, 0, 'f', 1)
+            : QString("RIFE 插帧: 关闭");
+        for (const auto& timing : InferenceRuntime::instance().take_timings()) {
+            if (timing.runs == 0) continue;
+            interpInfo += QString("\n%1 Run: %2 次 | 均 %3 ms | 峰 %4 ms | 重新绑定 %5")
+                .arg(QString::fromStdString(timing.tag)).arg(timing.runs)
+                .arg(timing.avg_ms, 0, 'f', 1).arg(timing.max_ms, 0, 'f', 1).arg(timing.rebinds);
+        }
+        m_debugWindow->setInterpolationInfo(interpInfo);
+        if (enhancementActive) {
+            const EnhancementDecision& decision = m_enhancementGovernor->last_decision();
+            QString enhanceInfo = QString("增强档位: %1 | 压力 %2 | %3")
+                .arg(EnhancementGovernor::level_name(decision.level))
+                .arg(decision.pressure, 0, 'f', 2)
+                .arg(QString::fromStdString(decision.reason));
+            if (m_enhancementStage->isEnabled()) {
+                enhanceInfo += QString("\n超分阶段: 模型 %1 | 双三次 %2 | 直通 %3 | 均 %4 / 预算 %5 ms | 队列峰值 %6 / 上限 %7")
+                    .arg(stageStats.model_frames).arg(stageStats.resized_frames).arg(stageStats.passed_frames)
+                    .arg(stageStats.avg_upscale_ms, 0, 'f', 1).arg(stageStats.avg_frame_interval_ms, 0, 'f', 1)
+                    .arg(stageStats.max_queue_depth).arg(stageStats.queue_limit);
+            }
+            m_debugWindow->setEnhancementInfo(enhanceInfo);
+        }
+        else {
+            m_debugWindow->setEnhancementInfo(QString("增强档位: 未启用"));
         }
+        m_debugWindow->setFramePoolInfo(poolLines.isEmpty() ? QString("帧池: N/A") : "帧池:\n" + poolLines.join("\n"));
     }
 
     if (m_masterClock->get_time_ms() >= 0 && !m_masterClock->is_paused()) {
@@ -825,7 +984,7 @@ void VideoStreamClient::updateStatus()
 
     // 修改：更新分辨率标签
     if (m_originalWidth > 0 && m_originalHeight > 0) {
-        if (m_fsrcnnSwitchButton->isChecked() && m_upscaledWidth > 0 && m_upscaledHeight > 0) {
+        if (m_fsrcnnSwitchButton->isChecked() && m_upscaledWidth > 0 && m_upscaledWidth != m_originalWidth) {
             m_resolutionLabel->setText(QString("分辨率: %1x%2 → %3x%4")
                 .arg(m_originalWidth).arg(m_originalHeight)
                 .arg(m_upscaledWidth).arg(m_upscaledHeight));
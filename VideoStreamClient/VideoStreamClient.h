@@ -16,6 +16,12 @@ class AudioPlayer;
 class DebugWindow;
 class RIFEInterpolator;
 class FSRCNNUpscaler; // 修改
+class PresentationScheduler;
+class InterpolationEngine;
+class EnhancementGovernor;
+class EnhancementStage;
+class LatencyTracker;
+enum class EnhancementLevel;
 
 class VideoStreamClient : public QMainWindow
 {
@@ -37,13 +43,23 @@ private:
     void resetPlaybackUI();
     void updateRIFEButtonState(bool enabled);
     void updateFSRCNNButtonState(bool enabled); // 修改
+    // 【新增】把调节器的档位下发给超分阶段与插帧引擎；档位为 Off 时暂停插帧
+    void applyEnhancementLevel(EnhancementLevel level);
+    void resetEnhancementGovernor();
 
     QThread* m_videoDecodeThread = nullptr;
     VideoDecoder* m_videoDecoder = nullptr;
     QThread* m_audioPlayThread = nullptr;
     AudioPlayer* m_audioPlayer = nullptr;
+    // 【新增】后台 RIFE 插帧线程
+    QThread* m_interpolationThread = nullptr;
+    InterpolationEngine* m_interpolationEngine = nullptr;
+    // 【新增】解码后的超分阶段
+    QThread* m_enhancementThread = nullptr;
+    EnhancementStage* m_enhancementStage = nullptr;
 
-    QTimer* m_renderTimer = nullptr;
+    // 【修改】由显示器 vsync 驱动的呈现调度器取代原先 8ms 的渲染定时器
+    PresentationScheduler* m_presentationScheduler = nullptr;
 
     std::unique_ptr<MasterClock> m_masterClock;
     std::unique_ptr<NetworkMonitor> m_networkMonitor;
@@ -52,6 +68,8 @@ private:
     std::unique_ptr<DecodedFrameBuffer> m_decodedFrameBuffer;
     std::unique_ptr<RIFEInterpolator> m_rife_interpolator;
     std::unique_ptr<FSRCNNUpscaler> m_fsrcnnUpscaler; // 修改
+    std::unique_ptr<EnhancementGovernor> m_enhancementGovernor; // 【新增】
+    std::unique_ptr<LatencyTracker> m_latencyTracker; // 【新增】端到端时延测量
 
     QThread* m_workerThread;
     ClientWorker* m_worker;
@@ -113,7 +131,7 @@ private slots:
     void handleConnectionFailed(const QString& reason);
     void onPlayBtnClicked();
     void handlePlayInfo(double duration);
-    void onRenderTimerTimeout();
+    void onVsyncTick(double vsyncLeadMs);
     void onVolumeChanged(int value);
     void onPlayPauseBtnClicked();
     void onSliderReleased();
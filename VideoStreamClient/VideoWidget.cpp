@@ -2,6 +2,7 @@
 #include <QOpenGLBuffer>
 #include <QDebug>
 #include <QOpenGLPixelTransferOptions>
+#include <cstring>
 #include <vector>
 
 extern "C" {
@@ -58,14 +59,32 @@ VideoWidget::VideoWidget(QWidget* parent)
     format.setVersion(3, 3);
     format.setProfile(QSurfaceFormat::CoreProfile);
     setFormat(format);
+
+    // 拷贝线程负责把解码帧写入已映射的 PBO，GUI 线程只做映射/解除映射和发起 DMA
+    m_copyThread = std::thread(&VideoWidget::copyThreadLoop, this);
 }
 
 VideoWidget::~VideoWidget()
 {
+    {
+        std::lock_guard<std::mutex> lock(m_copyMutex);
+        m_copyThreadExit = true;
+    }
+    m_copyCond.notify_all();
+    if (m_copyThread.joinable()) {
+        m_copyThread.join();
+    }
+    for (auto& job : m_copyJobs) {
+        av_frame_free(&job.frame);
+    }
+    m_copyJobs.clear();
+    if (m_pendingFrame) av_frame_free(&m_pendingFrame);
+
     makeCurrent();
-    if (m_textureY_id) glDeleteTextures(1, &m_textureY_id);
-    if (m_textureU_id) glDeleteTextures(1, &m_textureU_id);
-    if (m_textureV_id) glDeleteTextures(1, &m_textureV_id);
+    releaseUploadRing();
+    for (auto& set : m_textures) {
+        glDeleteTextures(3, set);
+    }
     if (m_vbo) glDeleteBuffers(1, &m_vbo);
     if (m_vao) glDeleteVertexArrays(1, &m_vao);
     doneCurrent();
@@ -109,26 +128,17 @@ void VideoWidget::initializeGL()
 
     // --- 【核心修改】 ---
     // 将纹理过滤器从 GL_LINEAR 改为 GL_NEAREST，以保留像素细节，避免模糊
-    glGenTextures(1, &m_textureY_id);
-    glBindTexture(GL_TEXTURE_2D, m_textureY_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glGenTextures(1, &m_textureU_id);
-    glBindTexture(GL_TEXTURE_2D, m_textureU_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glGenTextures(1, &m_textureV_id);
-    glBindTexture(GL_TEXTURE_2D, m_textureV_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // 两组 Y/U/V 纹理实现双缓冲
+    for (auto& set : m_textures) {
+        glGenTextures(3, set);
+        for (GLuint tex : set) {
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+    }
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -145,81 +155,284 @@ void VideoWidget::resizeGL(int w, int h)
 
 void VideoWidget::paintGL()
 {
+    // 【修改】上一次 vsync 选中的帧必须在这次交换中显示：等拷贝线程写完 PBO，
+    // 随即上传并在本次绘制中使用，不再等到 fence 完成后的下一次 paintGL 才切换纹理组
+    waitForCopyJobs();
+    collectFinishedUploads();
+    uploadNewestFrame();
+
     glClear(GL_COLOR_BUFFER_BIT);
 
-    if (m_video_w == 0 || m_video_h == 0) {
-        return;
-    }
+    if (m_video_w != 0 && m_video_h != 0 && m_frontTextureSet >= 0) {
+        m_shaderProgram.bind();
 
-    m_shaderProgram.bind();
+        float scale_x = 1.0f;
+        float scale_y = 1.0f;
+        if (m_widget_aspect > m_video_aspect) {
+            scale_x = m_video_aspect / m_widget_aspect;
+            scale_y = 1.0f;
+        }
+        else {
+            scale_x = 1.0f;
+            scale_y = m_widget_aspect / m_video_aspect;
+        }
+        m_shaderProgram.setUniformValue("scale", scale_x, scale_y);
 
-    float scale_x = 1.0f;
-    float scale_y = 1.0f;
-    if (m_widget_aspect > m_video_aspect) {
-        scale_x = m_video_aspect / m_widget_aspect;
-        scale_y = 1.0f;
-    }
-    else {
-        scale_x = 1.0f;
-        scale_y = m_widget_aspect / m_video_aspect;
-    }
-    m_shaderProgram.setUniformValue("scale", scale_x, scale_y);
+        const GLuint* front = m_textures[m_frontTextureSet];
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, front[0]);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, front[1]);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, front[2]);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_textureY_id);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_textureU_id);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_textureV_id);
+        glBindVertexArray(m_vao);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindVertexArray(0);
 
-    glBindVertexArray(m_vao);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+        m_shaderProgram.release();
+    }
+    emit framePainted(m_frontTextureSet >= 0 ? m_texturePts[m_frontTextureSet] : -1);
 
-    m_shaderProgram.release();
+    // 为下一帧准备好映射的缓冲区，并把积压的帧交给拷贝线程
+    // 【修改】绘制节拍完全由 PresentationScheduler 决定，这里不再自行请求 update()
+    mapFreeSlots();
+    if (m_pendingFrame && dispatchFrame(m_pendingFrame)) {
+        m_pendingFrame = nullptr;
+    }
 }
 
 void VideoWidget::onFrameDecoded(AVFrame* frame)
 {
-    if (!frame || !frame->data[0] || !frame->data[1] || !frame->data[2] || frame->format != AV_PIX_FMT_YUV420P) {
+    if (!frame || !frame->data[0] || !frame->data[1] || !frame->data[2] || frame->format != AV_PIX_FMT_YUV420P || !isValid()) {
         if (frame) av_frame_free(&frame);
         return;
     }
 
-    makeCurrent();
-
     if (m_video_w != frame->width || m_video_h != frame->height) {
-        m_video_w = frame->width;
-        m_video_h = frame->height;
-        if (m_video_h > 0) {
-            m_video_aspect = static_cast<float>(m_video_w) / static_cast<float>(m_video_h);
-        }
+        makeCurrent();
+        reconfigureUploadRing(frame->width, frame->height);
+        doneCurrent();
+    }
 
-        glBindTexture(GL_TEXTURE_2D, m_textureY_id);
+    if (!dispatchFrame(frame)) {
+        // 环中没有可写的 PBO，只保留最新的一帧等待下一次绘制
+        if (m_pendingFrame) av_frame_free(&m_pendingFrame);
+        m_pendingFrame = frame;
+    }
+}
+
+// 分辨率变化时重建纹理和 PBO 环 (要求 GL 上下文为当前)
+void VideoWidget::reconfigureUploadRing(int width, int height)
+{
+    // 等待拷贝线程写完所有已派发的任务，之后才能安全地解除映射
+    {
+        std::unique_lock<std::mutex> lock(m_copyMutex);
+        m_copyCond.wait(lock, [this] { return m_copyJobsInFlight == 0; });
+    }
+    releaseUploadRing();
+
+    m_video_w = width;
+    m_video_h = height;
+    if (m_video_h > 0) {
+        m_video_aspect = static_cast<float>(m_video_w) / static_cast<float>(m_video_h);
+    }
+
+    const size_t luma_bytes = static_cast<size_t>(width) * height;
+    const size_t chroma_bytes = static_cast<size_t>(width / 2) * (height / 2);
+    m_planeOffsets[0] = 0;
+    m_planeOffsets[1] = luma_bytes;
+    m_planeOffsets[2] = luma_bytes + chroma_bytes;
+    m_frameBytes = luma_bytes + 2 * chroma_bytes;
+
+    for (auto& set : m_textures) {
+        glBindTexture(GL_TEXTURE_2D, set[0]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_video_w, m_video_h, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-        glBindTexture(GL_TEXTURE_2D, m_textureU_id);
+        glBindTexture(GL_TEXTURE_2D, set[1]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_video_w / 2, m_video_h / 2, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-        glBindTexture(GL_TEXTURE_2D, m_textureV_id);
+        glBindTexture(GL_TEXTURE_2D, set[2]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_video_w / 2, m_video_h / 2, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
     }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_frontTextureSet = -1;
+    m_texturePts[0] = m_texturePts[1] = -1;
+
+    for (auto& slot : m_slots) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(m_frameBytes), nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    mapFreeSlots();
+}
+
+void VideoWidget::releaseUploadRing()
+{
+    for (auto& slot : m_slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        if (slot.pbo) {
+            if (slot.mapped) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            glDeleteBuffers(1, &slot.pbo);
+            slot.pbo = 0;
+        }
+        slot.mapped = nullptr;
+        slot.state = SlotFree;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
 
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[0]);
-    glBindTexture(GL_TEXTURE_2D, m_textureY_id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_video_w, m_video_h, GL_RED, GL_UNSIGNED_BYTE, frame->data[0]);
+void VideoWidget::mapFreeSlots()
+{
+    if (m_frameBytes == 0) return;
+    for (auto& slot : m_slots) {
+        if (slot.state.load() != SlotFree || !slot.pbo) continue;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        // 该 PBO 上一次的 DMA 已由 fence 确认完成，可以无同步地整体丢弃旧内容
+        void* ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(m_frameBytes),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (ptr) {
+            slot.mapped = static_cast<uint8_t*>(ptr);
+            slot.state = SlotMapped;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
 
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[1]);
-    glBindTexture(GL_TEXTURE_2D, m_textureU_id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_video_w / 2, m_video_h / 2, GL_RED, GL_UNSIGNED_BYTE, frame->data[1]);
+bool VideoWidget::dispatchFrame(AVFrame* frame)
+{
+    if (frame->width != m_video_w || frame->height != m_video_h) {
+        av_frame_free(&frame);
+        return true;
+    }
+    for (int i = 0; i < PBO_RING_SIZE; ++i) {
+        auto& slot = m_slots[i];
+        if (slot.state.load() != SlotMapped) continue;
+        slot.state = SlotFilling;
+        slot.sequence = m_nextSequence++;
+        slot.pts = frame->pts;
+        {
+            std::lock_guard<std::mutex> lock(m_copyMutex);
+            m_copyJobs.push_back({ i, frame });
+            m_copyJobsInFlight++;
+        }
+        m_copyCond.notify_all();
+        return true;
+    }
+    return false;
+}
 
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[2]);
-    glBindTexture(GL_TEXTURE_2D, m_textureV_id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_video_w / 2, m_video_h / 2, GL_RED, GL_UNSIGNED_BYTE, frame->data[2]);
+// 派发给拷贝线程的帧通常在 vsyncTick 与随后的 paintGL 之间就已写完，这里最多等待一帧的 memcpy
+void VideoWidget::waitForCopyJobs()
+{
+    std::unique_lock<std::mutex> lock(m_copyMutex);
+    m_copyCond.wait(lock, [this] { return m_copyJobsInFlight == 0; });
+}
 
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+// fence 完成说明 GPU 已读完该 PBO，槽位可以重新映射
+void VideoWidget::collectFinishedUploads()
+{
+    for (auto& slot : m_slots) {
+        if (slot.state.load() != SlotUploading || !slot.fence) continue;
+        GLenum result = glClientWaitSync(slot.fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            slot.state = SlotFree;
+        }
+    }
+}
 
-    doneCurrent();
+void VideoWidget::uploadNewestFrame()
+{
+    // 选出最新填充完成的槽位，更旧的已过时，直接回收
+    int newest = -1;
+    for (int i = 0; i < PBO_RING_SIZE; ++i) {
+        if (m_slots[i].state.load() != SlotFilled) continue;
+        if (newest < 0 || m_slots[i].sequence > m_slots[newest].sequence) newest = i;
+    }
+    if (newest < 0) return;
+    for (int i = 0; i < PBO_RING_SIZE; ++i) {
+        auto& slot = m_slots[i];
+        if (i == newest || slot.state.load() != SlotFilled) continue;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        slot.mapped = nullptr;
+        slot.state = SlotFree;
+    }
 
-    av_frame_free(&frame);
+    auto& slot = m_slots[newest];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    slot.mapped = nullptr;
+
+    const int texture_set = (m_frontTextureSet == 0) ? 1 : 0;
+    const GLuint* back = m_textures[texture_set];
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, back[0]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_video_w, m_video_h, GL_RED, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(m_planeOffsets[0]));
+    glBindTexture(GL_TEXTURE_2D, back[1]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_video_w / 2, m_video_h / 2, GL_RED, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(m_planeOffsets[1]));
+    glBindTexture(GL_TEXTURE_2D, back[2]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_video_w / 2, m_video_h / 2, GL_RED, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(m_planeOffsets[2]));
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // 同一上下文中的后续绘制由驱动保证在上传之后执行，可以立即使用该纹理组
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SlotUploading;
+    m_frontTextureSet = texture_set;
+    m_texturePts[texture_set] = slot.pts;
+}
+
+void VideoWidget::copyThreadLoop()
+{
+    while (true) {
+        CopyJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_copyMutex);
+            m_copyCond.wait(lock, [this] { return m_copyThreadExit || !m_copyJobs.empty(); });
+            if (m_copyThreadExit) return;
+            job = m_copyJobs.front();
+            m_copyJobs.pop_front();
+        }
 
-    update();
+        copyFrameToBuffer(job.frame, m_slots[job.slot].mapped);
+        // 拷贝完成后立即释放，帧缓冲区尽早归还 FramePool
+        av_frame_free(&job.frame);
+        m_slots[job.slot].state = SlotFilled;
+
+        {
+            std::lock_guard<std::mutex> lock(m_copyMutex);
+            m_copyJobsInFlight--;
+        }
+        m_copyCond.notify_all();
+    }
+}
+
+// 将 YUV420P 帧按 Y/U/V 顺序紧密拷贝到映射的 PBO 中，去掉 linesize 的行填充
+void VideoWidget::copyFrameToBuffer(const AVFrame* frame, uint8_t* dst)
+{
+    for (int plane = 0; plane < 3; ++plane) {
+        const int w = (plane == 0) ? frame->width : frame->width / 2;
+        const int h = (plane == 0) ? frame->height : frame->height / 2;
+        const uint8_t* src = frame->data[plane];
+        const int src_stride = frame->linesize[plane];
+        if (src_stride == w) {
+            memcpy(dst, src, static_cast<size_t>(w) * h);
+            dst += static_cast<size_t>(w) * h;
+            continue;
+        }
+        for (int y = 0; y < h; ++y) {
+            memcpy(dst, src + static_cast<size_t>(y) * src_stride, w);
+            dst += w;
+        }
+    }
 }
\ No newline at end of file
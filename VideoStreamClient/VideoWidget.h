@@ -4,7 +4,12 @@
 #include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 struct AVFrame;
@@ -20,17 +25,64 @@ public:
 public slots:
     void onFrameDecoded(AVFrame* frame);
 
+signals:
+    // 【新增】每次 paintGL 绘制的纹理组对应的帧 PTS（尚无画面时为 -1），紧随其后的缓冲交换即把它显示出来
+    void framePainted(qint64 pts_ms);
+
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
     void paintGL() override;
 
 private:
+    // --- PBO 异步上传环 ---
+    // 每个槽位持有一个 PBO，内部按 Y/U/V 顺序紧密排列三个平面。
+    // 状态流转: Free -(GL线程映射)-> Mapped -(派发给拷贝线程)-> Filling -(拷贝完成)-> Filled
+    //          -(GL线程解除映射并发起 glTexSubImage2D)-> Uploading -(fence 完成)-> Free
+    // 【修改】上传与绘制在同一次 paintGL 中完成，fence 只用于确认 PBO 可以重新映射
+    enum SlotState : int { SlotFree, SlotMapped, SlotFilling, SlotFilled, SlotUploading };
+    static constexpr int PBO_RING_SIZE = 3;
+    struct UploadSlot {
+        GLuint pbo = 0;
+        uint8_t* mapped = nullptr;
+        std::atomic<int> state{ SlotFree };
+        GLsync fence = nullptr;
+        uint64_t sequence = 0;
+        int64_t pts = -1; // 【新增】
+    };
+    struct CopyJob {
+        int slot;
+        AVFrame* frame;
+    };
+
+    void reconfigureUploadRing(int width, int height);
+    void releaseUploadRing();
+    void mapFreeSlots();
+    bool dispatchFrame(AVFrame* frame);
+    void waitForCopyJobs();
+    void collectFinishedUploads();
+    void uploadNewestFrame();
+    void copyThreadLoop();
+    static void copyFrameToBuffer(const AVFrame* frame, uint8_t* dst);
+
     QOpenGLShaderProgram m_shaderProgram;
 
-    GLuint m_textureY_id = 0;
-    GLuint m_textureU_id = 0;
-    GLuint m_textureV_id = 0;
+    // 纹理双缓冲: 新帧上传到上一次未绘制的那组，避免覆盖仍可能被 GPU 读取的纹理
+    GLuint m_textures[2][3] = {};
+    int m_frontTextureSet = -1;
+    int64_t m_texturePts[2] = { -1, -1 }; // 【新增】各纹理组当前内容的 PTS
+    UploadSlot m_slots[PBO_RING_SIZE];
+    size_t m_planeOffsets[3] = {};
+    size_t m_frameBytes = 0;
+    uint64_t m_nextSequence = 1;
+    AVFrame* m_pendingFrame = nullptr; // 所有槽位都忙时暂存最新的一帧
+
+    std::thread m_copyThread;
+    std::mutex m_copyMutex;
+    std::condition_variable m_copyCond;
+    std::deque<CopyJob> m_copyJobs;
+    int m_copyJobsInFlight = 0;
+    bool m_copyThreadExit = false;
 
     int m_video_w = 0;
     int m_video_h = 0;
@@ -2,11 +2,31 @@
 #include <iostream>
 #include <iomanip> 
 #include <algorithm>
+#include <cstdlib>
+
+namespace {
+    // 编码码率占网络码率的比例，留出音频、包头与编码器瞬时超调的余量
+    constexpr double VIDEO_BITRATE_SHARE = 0.9;
+    // 目标码率变化超过该比例才打印
+    constexpr double LOG_CHANGE_RATIO = 0.1;
+    // 【新增】编码码率不超过拥塞控制器可发送速率的该比例，余量留给音频、包头与重传
+    constexpr double CONGESTION_BITRATE_SHARE = 0.85;
+
+    const char* usage_name(BandwidthUsage usage)
+    {
+        switch (usage) {
+        case BandwidthUsage::Overusing: return "过载";
+        case BandwidthUsage::Underusing: return "欠载";
+        default: return "正常";
+        }
+    }
+}
 
 AdaptiveStreamController::AdaptiveStreamController()
+    : m_estimator(std::make_shared<BandwidthEstimator>())
 {
     // 初始化时使用一个默认值，稍后会被 set_video_resolution 覆盖
-    initialize_quality_levels(1080);
+    initialize_quality_levels(1080, {});
 }
 
 ABRDecision AdaptiveStreamController::get_decision()
@@ -19,12 +39,12 @@ ABRDecision AdaptiveStreamController::get_decision()
     };
 }
 
-void AdaptiveStreamController::set_video_resolution(int width, int height)
+void AdaptiveStreamController::set_video_resolution(int width, int height, const std::vector<QualityLevel>& ladder)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
 
     // 根据源视频的高度，初始化可用的质量层级列表
-    initialize_quality_levels(height);
+    initialize_quality_levels(height, ladder);
 
     // 设置初始状态
     m_current_level_index = 0; // 默认从最高质量开始
@@ -34,37 +54,86 @@ void AdaptiveStreamController::set_video_resolution(int width, int height)
     m_target_fps.store(initial_level.target_fps);
     m_target_height.store(initial_level.height);
     m_change_state = ChangeState::Stable;
+    // 【新增】估计器从起始码率开始试探
+    m_estimator->reset(static_cast<int64_t>(initial_level.start_bitrate_bps / VIDEO_BITRATE_SHARE));
+    m_last_logged_bitrate = initial_level.start_bitrate_bps;
+    m_congestion_cap_bps = 0;
+    m_congestion_limited = false;
 
     std::cout << "[服务端-控制器] 源分辨率 " << width << "x" << height
         << ", ABR已初始化。起始目标: " << initial_level.height << "p@" << initial_level.target_fps << "fps, "
         << initial_level.start_bitrate_bps / 1024 << " kbps" << std::endl;
 }
 
-void AdaptiveStreamController::update_client_feedback(const std::string& trend)
+void AdaptiveStreamController::on_transport_feedback(const std::vector<PacketFeedback>& packets)
 {
+    const BandwidthEstimate estimate = m_estimator->on_transport_feedback(packets);
     std::lock_guard<std::mutex> lock(m_mutex);
+    apply_network_bitrate_locked(estimate);
+}
+
+void AdaptiveStreamController::on_connection_stats(const ConnectionStats& stats)
+{
+    // 拥塞控制器能持续发送的速率：带宽估计与窗口允许的速率一致时取前者（BBR 的窗口是带宽时延积的数倍），
+    // 否则（Cubic 等没有带宽估计）以窗口为准
+    const bool bandwidth_valid = stats.bandwidth_bps > 0 &&
+        (stats.pacing_rate_bps == 0 || stats.bandwidth_bps <= stats.pacing_rate_bps);
+    const int64_t available_bps = bandwidth_valid ? stats.bandwidth_bps : stats.pacing_rate_bps;
+    m_estimator->on_network_statistics(bandwidth_valid ? stats.bandwidth_bps : 0, stats.smoothed_rtt_us);
+
+    if (available_bps <= 0) return;
+    int64_t cap = static_cast<int64_t>(available_bps * CONGESTION_BITRATE_SHARE);
+    // 窗口已满或 MsQuic 开始丢弃数据报，说明发送已跟不上，以实际发出的速率为准
+    const bool window_full = stats.congestion_window > 0 && stats.bytes_in_flight >= stats.congestion_window;
+    if ((stats.datagram_send_failures > 0 || window_full) && stats.send_rate_bps > 0) {
+        cap = std::min(cap, static_cast<int64_t>(stats.send_rate_bps * CONGESTION_BITRATE_SHARE));
+    }
 
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_congestion_cap_bps = cap;
     if (m_quality_levels.empty()) return;
 
-    // 1. 根据反馈调整当前码率
-    int64_t current_bitrate = m_target_bitrate_bps.load();
-    int64_t new_bitrate = current_bitrate;
+    // 只负责及时下调；上调仍由传输层反馈驱动
+    const int64_t current = m_target_bitrate_bps.load();
     const auto& current_level = m_quality_levels[m_current_level_index];
-
-    if (trend == "increase") {
-        new_bitrate = static_cast<int64_t>(current_bitrate * 1.10); // 每次增加10%
+    const bool limited = cap < current;
+    if (limited) {
+        m_target_bitrate_bps.store(std::max(current_level.min_bitrate_bps, cap));
     }
-    else if (trend == "decrease") {
-        new_bitrate = static_cast<int64_t>(current_bitrate * 0.85); // 每次降低15%
+    if (limited != m_congestion_limited) {
+        m_congestion_limited = limited;
+        if (limited) {
+            std::cout << "[服务端-控制器] 码率受拥塞控制器限制: 可发送 " << available_bps / 1024 << " kbps (RTT "
+                << stats.smoothed_rtt_us / 1000 << " ms, 发送失败 " << stats.datagram_send_failures
+                << "), 目标码率降至: " << m_target_bitrate_bps.load() / 1024 << " kbps" << std::endl;
+        }
     }
+}
 
-    // 将码率限制在当前分辨率层级的范围内
-    new_bitrate = std::max(current_level.min_bitrate_bps, std::min(current_level.max_bitrate_bps, new_bitrate));
+void AdaptiveStreamController::apply_network_bitrate_locked(const BandwidthEstimate& estimate)
+{
+    if (m_quality_levels.empty()) return;
 
-    if (new_bitrate != current_bitrate) {
-        m_target_bitrate_bps.store(new_bitrate);
-        std::cout << "[服务端-控制器] 收到反馈 '" << trend
-            << "', 调整目标码率至: " << new_bitrate / 1024 << " kbps" << std::endl;
+    // 1. 【修改】码率直接取估计值（扣除余量），不再按固定步长逐次调整
+    int64_t network_bitrate = static_cast<int64_t>(estimate.target_bitrate_bps * VIDEO_BITRATE_SHARE);
+    // 【新增】同时不超过拥塞控制器允许的速率
+    if (m_congestion_cap_bps > 0) {
+        network_bitrate = std::min(network_bitrate, m_congestion_cap_bps);
+    }
+    const auto& current_level = m_quality_levels[m_current_level_index];
+
+    // 将码率限制在当前分辨率层级的范围内
+    int64_t new_bitrate = std::max(current_level.min_bitrate_bps, std::min(current_level.max_bitrate_bps, network_bitrate));
+    m_target_bitrate_bps.store(new_bitrate);
+
+    // 反馈每 50ms 一次，只在明显变化时打印
+    if (std::abs(new_bitrate - m_last_logged_bitrate) > m_last_logged_bitrate * LOG_CHANGE_RATIO) {
+        m_last_logged_bitrate = new_bitrate;
+        std::cout << "[服务端-控制器] 带宽估计 " << estimate.target_bitrate_bps / 1024 << " kbps (接收 "
+            << estimate.acked_bitrate_bps / 1024 << " kbps, 链路容量 " << estimate.link_capacity_bps / 1024
+            << " kbps, 丢包 " << std::fixed << std::setprecision(1) << estimate.loss_rate * 100.0 << "%, "
+            << usage_name(estimate.usage) << "), 调整目标码率至: " << new_bitrate / 1024 << " kbps" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
     }
 
     // 2. 检查是否需要考虑升/降档 (分辨率和帧率)
@@ -80,7 +149,8 @@ void AdaptiveStreamController::update_client_feedback(const std::string& trend)
             // 确认升档！
             m_current_level_index--;
             const auto& next_level = m_quality_levels[m_current_level_index];
-            m_target_bitrate_bps.store(next_level.start_bitrate_bps);
+            // 【修改】新档位的码率同样跟随网络估计
+            m_target_bitrate_bps.store(std::max(next_level.min_bitrate_bps, std::min(next_level.max_bitrate_bps, network_bitrate)));
             m_target_fps.store(next_level.target_fps);
             m_target_height.store(next_level.height);
             m_change_state = ChangeState::Stable;
@@ -97,7 +167,7 @@ void AdaptiveStreamController::update_client_feedback(const std::string& trend)
             // 确认降档！
             m_current_level_index++;
             const auto& next_level = m_quality_levels[m_current_level_index];
-            m_target_bitrate_bps.store(next_level.start_bitrate_bps);
+            m_target_bitrate_bps.store(std::max(next_level.min_bitrate_bps, std::min(next_level.max_bitrate_bps, network_bitrate)));
             m_target_fps.store(next_level.target_fps);
             m_target_height.store(next_level.height);
             m_change_state = ChangeState::Stable;
@@ -110,19 +180,26 @@ void AdaptiveStreamController::update_client_feedback(const std::string& trend)
     }
 }
 
-// 【新增】根据源视频高度，动态生成一个可用的质量层级列表
-void AdaptiveStreamController::initialize_quality_levels(int source_height)
+const std::vector<QualityLevel>& AdaptiveStreamController::default_quality_levels()
 {
-    m_quality_levels.clear();
-
     // 模板，可拓展添加
-    const std::vector<QualityLevel> all_levels = {
+    static const std::vector<QualityLevel> levels = {
         {2160, 3840, 60, 4000 * 1024, 30000 * 1024, 8000 * 1024}, // 4K
         {1440, 2560, 60, 2000 * 1024, 8000 * 1024,  3000 * 1024}, // 2K
         {1080, 1920, 60, 500 * 1024,  4000 * 1024,  1500 * 1024}, // 1080p
         {720,  1280, 30, 200 * 1024,  1500 * 1024,  800 * 1024},  // 720p
         {480,  640,  30, 100 * 1024,  800 * 1024,   400 * 1024}   // 480p
     };
+    return levels;
+}
+
+// 【新增】根据源视频高度，动态生成一个可用的质量层级列表
+void AdaptiveStreamController::initialize_quality_levels(int source_height, const std::vector<QualityLevel>& ladder)
+{
+    m_quality_levels.clear();
+
+    // 【修改】优先使用按内容生成的阶梯
+    const std::vector<QualityLevel>& all_levels = ladder.empty() ? default_quality_levels() : ladder;
 
     // 只添加那些分辨率不高于源视频的层级
     for (const auto& level : all_levels) {
@@ -3,7 +3,9 @@
 #include <mutex>
 #include <chrono>
 #include <atomic>
+#include <memory>
 #include <vector> // 【新增】
+#include "BandwidthEstimator.h"
 
 // 【新增】定义一个结构体来描述每个分辨率/质量层级
 struct QualityLevel {
@@ -22,6 +24,19 @@ struct ABRDecision {
     int target_height; // 使用 height 作为层级的唯一标识
 };
 
+// 【新增】服务端 QUIC 连接的统计（ConnectionStatsSampler 每 100ms 采样一次），未知的值为 0
+struct ConnectionStats {
+    int64_t smoothed_rtt_us = 0;
+    int64_t min_rtt_us = 0;
+    uint64_t congestion_window = 0;    // 字节
+    uint64_t bytes_in_flight = 0;      // 字节
+    int64_t pacing_rate_bps = 0;       // 拥塞窗口 / 平滑 RTT
+    int64_t bandwidth_bps = 0;         // 拥塞控制器（BBR）的带宽估计
+    int64_t send_rate_bps = 0;         // 采样区间内实际发出的速率
+    double loss_rate = 0.0;            // 采样区间内的丢包率
+    uint32_t datagram_send_failures = 0; // 采样区间内 MsQuic 未能发出而丢弃的数据报
+};
+
 
 class AdaptiveStreamController
 {
@@ -31,11 +46,23 @@ public:
     // 【修改】接口现在返回一个包含所有决策的结构体
     ABRDecision get_decision();
 
-    void update_client_feedback(const std::string& trend);
-    void set_video_resolution(int width, int height);
+    // 【修改】客户端不再上报升/降趋势，改为逐包的到达时间（传输层反馈），由带宽估计器给出目标码率
+    void on_transport_feedback(const std::vector<PacketFeedback>& packets);
+    // 【修改】服务端连接统计：带宽估计、RTT 交给带宽估计器作为链路容量参考，
+    // 并把目标码率限制在拥塞控制器允许发送速率的一定比例以内
+    void on_connection_stats(const ConnectionStats& stats);
+    // 【新增】发送调度器通过它分配传输序号、记录发送时间
+    std::shared_ptr<BandwidthEstimator> bandwidth_estimator() const { return m_estimator; }
+    // 【修改】ladder 为按内容复杂度生成的码率阶梯（由高到低），为空时使用默认阶梯
+    void set_video_resolution(int width, int height, const std::vector<QualityLevel>& ladder = {});
+
+    // 【新增】按"中等复杂度"内容设定的默认阶梯，也是内容自适应阶梯的缩放基准
+    static const std::vector<QualityLevel>& default_quality_levels();
 
 private:
-    void initialize_quality_levels(int source_height);
+    void initialize_quality_levels(int source_height, const std::vector<QualityLevel>& ladder);
+    // 【新增】按网络允许的码率设置编码码率，并判断是否需要升/降档，需持有锁
+    void apply_network_bitrate_locked(const BandwidthEstimate& estimate);
 
     std::mutex m_mutex;
 
@@ -48,6 +75,14 @@ private:
     int m_current_level_index = 0;
     std::vector<QualityLevel> m_quality_levels;
 
+    // 【新增】带宽估计器与打印节流
+    std::shared_ptr<BandwidthEstimator> m_estimator;
+    int64_t m_last_logged_bitrate = 0;
+
+    // 【新增】拥塞控制器允许的码率上限，0 表示尚无统计
+    int64_t m_congestion_cap_bps = 0;
+    bool m_congestion_limited = false;
+
     // 【新增】用于升/降档延迟确认的成员
     enum class ChangeState { Stable, ConsideringUpgrade, ConsideringDowngrade };
     ChangeState m_change_state = ChangeState::Stable;
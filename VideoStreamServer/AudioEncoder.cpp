@@ -0,0 +1,166 @@
+﻿#include "AudioEncoder.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+}
+
+namespace {
+    const char* OPUS_ENCODER_NAME = "libopus";
+    // 上游时间戳与按样本数推算的时间戳相差超过该值时重新对齐
+    constexpr int64_t PTS_RESYNC_MS = 40;
+
+    // libopus 私有选项设置失败时只打印警告（旧版 FFmpeg 不支持 fec/dtx），不影响编码
+    void set_opus_option(AVCodecContext* ctx, const char* name, int64_t value)
+    {
+        if (av_opt_set_int(ctx->priv_data, name, value, 0) < 0) {
+            std::cerr << "[AudioEncoder] 警告: 当前 FFmpeg 的 libopus 不支持选项 " << name << std::endl;
+        }
+    }
+}
+
+AudioEncoder::AudioEncoder()
+{
+}
+
+AudioEncoder::~AudioEncoder()
+{
+    cleanup();
+}
+
+bool AudioEncoder::opus_available()
+{
+    return avcodec_find_encoder_by_name(OPUS_ENCODER_NAME) != nullptr;
+}
+
+void AudioEncoder::cleanup()
+{
+    if (m_encoder_ctx) { avcodec_free_context(&m_encoder_ctx); m_encoder_ctx = nullptr; }
+    if (m_frame) { av_frame_free(&m_frame); m_frame = nullptr; }
+    if (m_packet) { av_packet_free(&m_packet); m_packet = nullptr; }
+}
+
+bool AudioEncoder::initialize(const AudioStreamFormat& format)
+{
+    cleanup();
+    m_format = format;
+    reset();
+    if (!m_format.opus) {
+        std::cout << "[AudioEncoder] 音频以原始 PCM 发送 -> " << m_format.sample_rate << "Hz x"
+            << m_format.channels << ", 每包 " << m_format.frame_samples << " 样本" << std::endl;
+        return true;
+    }
+
+    const AVCodec* encoder = avcodec_find_encoder_by_name(OPUS_ENCODER_NAME);
+    if (!encoder) {
+        std::cerr << "[AudioEncoder] 错误: 找不到 libopus 编码器。" << std::endl;
+        return false;
+    }
+    m_encoder_ctx = avcodec_alloc_context3(encoder);
+    if (!m_encoder_ctx) {
+        std::cerr << "[AudioEncoder] 错误: 无法分配音频编码器上下文。" << std::endl;
+        return false;
+    }
+
+    m_encoder_ctx->sample_rate = m_format.sample_rate;
+    av_channel_layout_default(&m_encoder_ctx->ch_layout, m_format.channels);
+    m_encoder_ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+    m_encoder_ctx->bit_rate = m_format.bitrate_bps;
+    m_encoder_ctx->time_base = { 1, m_format.sample_rate };
+
+    // lowdelay 关闭 SILK/混合模式以换取最小算法时延，但也就没有 FEC，因此用 audio 模式
+    av_opt_set(m_encoder_ctx->priv_data, "application", "audio", 0);
+    set_opus_option(m_encoder_ctx, "frame_duration", AppConfig::OPUS_FRAME_MS);
+    set_opus_option(m_encoder_ctx, "packet_loss", AppConfig::OPUS_EXPECTED_LOSS_PERC);
+    set_opus_option(m_encoder_ctx, "fec", 1);
+    set_opus_option(m_encoder_ctx, "dtx", 1);
+
+    if (avcodec_open2(m_encoder_ctx, encoder, nullptr) < 0) {
+        std::cerr << "[AudioEncoder] 错误: 无法打开 Opus 编码器。" << std::endl;
+        cleanup();
+        return false;
+    }
+    m_format.frame_samples = m_encoder_ctx->frame_size;
+
+    m_frame = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    m_frame->format = m_encoder_ctx->sample_fmt;
+    m_frame->nb_samples = m_encoder_ctx->frame_size;
+    av_channel_layout_copy(&m_frame->ch_layout, &m_encoder_ctx->ch_layout);
+    m_frame->sample_rate = m_encoder_ctx->sample_rate;
+    if (av_frame_get_buffer(m_frame, 0) < 0) {
+        std::cerr << "[AudioEncoder] 错误: 无法分配音频帧。" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    std::cout << "[AudioEncoder] Opus 编码器已初始化 -> " << m_format.sample_rate << "Hz x" << m_format.channels
+        << ", " << m_format.bitrate_bps / 1000 << " kbps, 每帧 " << m_format.frame_samples << " 样本" << std::endl;
+    return true;
+}
+
+void AudioEncoder::reset()
+{
+    m_pending.clear();
+    m_base_pts_ms = -1;
+    m_samples_in = 0;
+    if (m_encoder_ctx) {
+        avcodec_flush_buffers(m_encoder_ctx);
+    }
+}
+
+void AudioEncoder::encode(const int16_t* samples, int frames, int64_t pts_ms, const PacketCallback& on_packet)
+{
+    if (!samples || frames <= 0) return;
+    if (m_format.opus && !m_encoder_ctx) return;
+
+    // 以 reset 后的第一个样本为基准按样本数推算时间戳，不受上游分块大小影响；
+    // 与上游时间戳偏差过大（源文件音频有断档、采集时钟漂移）时重新对齐
+    const int64_t queued_frames = m_samples_in + static_cast<int64_t>(m_pending.size() / m_format.channels);
+    const int64_t expected_pts_ms = m_base_pts_ms + queued_frames * 1000 / m_format.sample_rate;
+    if (m_base_pts_ms < 0 || std::llabs(pts_ms - expected_pts_ms) > PTS_RESYNC_MS) {
+        m_base_pts_ms = pts_ms - queued_frames * 1000 / m_format.sample_rate;
+    }
+    m_pending.insert(m_pending.end(), samples, samples + static_cast<size_t>(frames) * m_format.channels);
+
+    const size_t frame_size = static_cast<size_t>(m_format.frame_samples) * m_format.channels;
+    size_t offset = 0;
+    while (m_pending.size() - offset >= frame_size) {
+        encode_frame(m_pending.data() + offset, on_packet);
+        offset += frame_size;
+    }
+    m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+}
+
+void AudioEncoder::encode_frame(const int16_t* samples, const PacketCallback& on_packet)
+{
+    const int64_t frame_pts_ms = m_base_pts_ms + m_samples_in * 1000 / m_format.sample_rate;
+    const uint32_t frame_bytes = static_cast<uint32_t>(m_format.frame_samples * m_format.channels * sizeof(int16_t));
+
+    if (!m_format.opus) {
+        m_samples_in += m_format.frame_samples;
+        on_packet(AppConfig::PacketType::Audio, reinterpret_cast<const uint8_t*>(samples), frame_bytes, frame_pts_ms);
+        return;
+    }
+
+    if (av_frame_make_writable(m_frame) < 0) return;
+    std::memcpy(m_frame->data[0], samples, frame_bytes);
+    m_frame->pts = m_samples_in;
+    m_samples_in += m_format.frame_samples;
+    if (avcodec_send_frame(m_encoder_ctx, m_frame) < 0) {
+        std::cerr << "[AudioEncoder] 错误: 发送音频帧到编码器失败。" << std::endl;
+        return;
+    }
+
+    while (avcodec_receive_packet(m_encoder_ctx, m_packet) == 0) {
+        // 包的 pts 已扣除编码器的前导填充，对应解码输出第一个样本的媒体时间
+        const int64_t packet_pts_ms = m_base_pts_ms + m_packet->pts * 1000 / m_format.sample_rate;
+        // DTX 静音期的包只有 1~2 字节，照常发送，解码端据此输出舒适噪声而不是当成丢包
+        on_packet(AppConfig::PacketType::AudioOpus, m_packet->data, static_cast<uint32_t>(m_packet->size), packet_pts_ms);
+        av_packet_unref(m_packet);
+    }
+}
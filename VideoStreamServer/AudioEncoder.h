@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "shared_config.h"
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+// 【新增】播放时协商出的音频传输格式
+struct AudioStreamFormat {
+    bool opus = false;
+    int sample_rate = AppConfig::AUDIO_RATE;
+    int channels = AppConfig::AUDIO_CHANNELS;
+    int frame_samples = AppConfig::AUDIO_CHUNK_SAMPLES; // 每个包的样本数（每声道）
+    int bitrate_bps = 0;                                // 仅 Opus 有效
+};
+
+// 【新增】推流端的音频编码阶段：输入交织的 S16 PCM，按协商格式切成整包后
+// 以原始 PCM 发送，或经 libopus 编码（带内 FEC + DTX）后发送
+class AudioEncoder
+{
+public:
+    using PacketCallback = std::function<void(AppConfig::PacketType type, const uint8_t* data, uint32_t size, int64_t pts_ms)>;
+
+    AudioEncoder();
+    ~AudioEncoder();
+
+    // 当前环境能否编码 Opus（FFmpeg 是否带 libopus）
+    static bool opus_available();
+
+    bool initialize(const AudioStreamFormat& format);
+    const AudioStreamFormat& format() const { return m_format; }
+
+    // samples 为 frames * channels 个交织样本，pts_ms 为第一个样本的时间戳
+    void encode(const int16_t* samples, int frames, int64_t pts_ms, const PacketCallback& on_packet);
+    // 跳转后丢弃未凑满一包的样本并清空编码器内部状态
+    void reset();
+
+    AudioEncoder(const AudioEncoder&) = delete;
+    AudioEncoder& operator=(const AudioEncoder&) = delete;
+
+private:
+    void encode_frame(const int16_t* samples, const PacketCallback& on_packet);
+    void cleanup();
+
+    AudioStreamFormat m_format;
+    AVCodecContext* m_encoder_ctx = nullptr;
+    AVFrame* m_frame = nullptr;
+    AVPacket* m_packet = nullptr;
+
+    std::vector<int16_t> m_pending;   // 未凑满一包的样本
+    int64_t m_base_pts_ms = -1;       // reset 之后第一个样本的时间戳
+    int64_t m_samples_in = 0;         // reset 之后送入的样本数（每声道）
+};
@@ -0,0 +1,363 @@
+﻿#define NOMINMAX
+#include "BandwidthEstimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // 发送记录容量，需覆盖一个反馈周期加上 RTT 内发出的数据报
+    constexpr size_t HISTORY_SIZE = 8192;
+
+    // 到达间隔分组与趋势线（参数取自 GCC）
+    constexpr int64_t GROUP_SPAN_US = 5000;
+    constexpr size_t TRENDLINE_WINDOW = 20;
+    constexpr double TRENDLINE_SMOOTHING = 0.9;
+    constexpr double TRENDLINE_GAIN = 4.0;
+    constexpr int MAX_DELTAS_FOR_GAIN = 60;
+    // 客户端时钟跳变（重连、系统休眠）时放弃当前分组
+    constexpr double MAX_ARRIVAL_DELTA_MS = 10000.0;
+
+    // 自适应阈值
+    constexpr double THRESHOLD_INITIAL = 12.5;
+    constexpr double THRESHOLD_MIN = 6.0;
+    constexpr double THRESHOLD_MAX = 600.0;
+    constexpr double THRESHOLD_K_UP = 0.0087;
+    constexpr double THRESHOLD_K_DOWN = 0.039;
+    constexpr double OVERUSE_TIME_MS = 10.0;
+
+    // 码率控制
+    constexpr int64_t ACKED_WINDOW_US = 500000;
+    constexpr int64_t MIN_ACKED_SPAN_US = 100000;
+    constexpr double DECREASE_FACTOR = 0.85;
+    constexpr double MAX_ACKED_RATIO = 1.5;
+    constexpr double MULTIPLICATIVE_INCREASE_PER_SEC = 0.08;
+    // 首次过载之前链路容量未知，快速试探
+    constexpr double STARTUP_INCREASE_PER_SEC = 0.5;
+    constexpr double NEAR_CAPACITY_RATIO = 0.85;
+    constexpr double CAPACITY_EMA_ALPHA = 0.2;
+    constexpr int64_t MIN_DECREASE_INTERVAL_US = 200000;
+    constexpr int64_t DEFAULT_RTT_US = 100000;
+    constexpr int64_t RESPONSE_TIME_EXTRA_US = 100000;
+    constexpr double PACKET_BITS = 1200.0 * 8;
+    constexpr int64_t MIN_BITRATE_BPS = 100 * 1000;
+    constexpr int64_t MAX_BITRATE_BPS = 50 * 1000 * 1000;
+
+    // 丢包
+    constexpr int MIN_LOSS_SAMPLES = 20;
+    constexpr double LOSS_HIGH = 0.10;
+    constexpr int64_t LOSS_DECREASE_INTERVAL_US = 300000;
+
+    // BBR 估计超过该时长未更新视为失效
+    constexpr int64_t BBR_SAMPLE_TIMEOUT_US = 2000000;
+}
+
+BandwidthEstimator::BandwidthEstimator()
+    : m_epoch(Clock::now()),
+    m_history(HISTORY_SIZE)
+{
+    reset(0);
+}
+
+int64_t BandwidthEstimator::now_us() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_epoch).count();
+}
+
+void BandwidthEstimator::reset(int64_t start_bitrate_bps)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    reset_delay_state_locked();
+    m_acked.clear();
+    m_acked_bytes = 0;
+    m_feedback_total = 0;
+    m_feedback_lost = 0;
+    m_loss_rate = 0.0;
+    m_last_loss_decrease_us = -1;
+    m_rate_state = RateState::Hold;
+    m_target_bps = std::clamp(start_bitrate_bps, MIN_BITRATE_BPS, MAX_BITRATE_BPS);
+    m_last_update_us = -1;
+    m_last_decrease_us = -1;
+    m_capacity_ema_bps = 0.0;
+}
+
+void BandwidthEstimator::reset_delay_state_locked()
+{
+    m_group = PacketGroup();
+    m_prev_group = PacketGroup();
+    m_accumulated_delay_ms = 0.0;
+    m_smoothed_delay_ms = 0.0;
+    m_first_arrival_us = -1;
+    m_trend_samples.clear();
+    m_num_deltas = 0;
+    m_prev_trend = 0.0;
+    m_threshold = THRESHOLD_INITIAL;
+    m_last_threshold_update_us = -1;
+    m_time_over_using_ms = -1.0;
+    m_overuse_counter = 0;
+    m_usage = BandwidthUsage::Normal;
+}
+
+uint16_t BandwidthEstimator::register_packet(uint32_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint16_t seq = m_next_seq++;
+    SentPacket& entry = m_history[seq % HISTORY_SIZE];
+    entry.transport_seq = seq;
+    entry.size = size;
+    entry.send_us = -1;
+    return seq;
+}
+
+void BandwidthEstimator::on_packet_sent(uint16_t transport_seq)
+{
+    const int64_t now = now_us();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SentPacket& entry = m_history[transport_seq % HISTORY_SIZE];
+    if (entry.transport_seq == transport_seq && entry.send_us < 0) {
+        entry.send_us = now;
+    }
+}
+
+void BandwidthEstimator::on_network_statistics(int64_t bandwidth_bps, int64_t smoothed_rtt_us)
+{
+    const int64_t now = now_us();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (bandwidth_bps > 0) {
+        m_bbr_bandwidth_bps = bandwidth_bps;
+        m_bbr_sample_us = now;
+    }
+    if (smoothed_rtt_us > 0) {
+        m_rtt_us = smoothed_rtt_us;
+    }
+}
+
+BandwidthEstimate BandwidthEstimator::on_transport_feedback(const std::vector<PacketFeedback>& packets)
+{
+    const int64_t now = now_us();
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const PacketFeedback& packet : packets) {
+        const SentPacket& sent = m_history[packet.transport_seq % HISTORY_SIZE];
+        // 记录已被覆盖，或数据报没有真正发出（MsQuic 丢弃/取消），不参与估计
+        if (sent.transport_seq != packet.transport_seq || sent.send_us < 0) continue;
+        m_feedback_total++;
+        if (!packet.received) {
+            m_feedback_lost++;
+            continue;
+        }
+        on_received_locked(sent, packet.arrival_us);
+    }
+
+    if (m_feedback_total >= MIN_LOSS_SAMPLES) {
+        m_loss_rate = static_cast<double>(m_feedback_lost) / m_feedback_total;
+        m_feedback_total = 0;
+        m_feedback_lost = 0;
+    }
+
+    update_rate_locked(now);
+
+    BandwidthEstimate estimate;
+    estimate.target_bitrate_bps = m_target_bps;
+    estimate.acked_bitrate_bps = acked_bitrate_locked();
+    estimate.link_capacity_bps = link_capacity_locked(now);
+    estimate.loss_rate = m_loss_rate;
+    estimate.usage = m_usage;
+    return estimate;
+}
+
+void BandwidthEstimator::on_received_locked(const SentPacket& sent, int64_t arrival_us)
+{
+    // 接收速率窗口；客户端时钟跳变时重新开始
+    if (!m_acked.empty() && std::fabs((arrival_us - m_acked.back().first) / 1000.0) > MAX_ARRIVAL_DELTA_MS) {
+        m_acked.clear();
+        m_acked_bytes = 0;
+    }
+    m_acked.emplace_back(arrival_us, sent.size);
+    m_acked_bytes += sent.size;
+    while (!m_acked.empty() && m_acked.front().first < arrival_us - ACKED_WINDOW_US) {
+        m_acked_bytes -= m_acked.front().second;
+        m_acked.pop_front();
+    }
+
+    if (!m_group.valid) {
+        m_group = { true, sent.send_us, sent.send_us, arrival_us };
+        return;
+    }
+    if (sent.send_us < m_group.first_send_us) return; // 乱序到达的旧组成员
+    if (sent.send_us - m_group.first_send_us <= GROUP_SPAN_US) {
+        m_group.last_send_us = std::max(m_group.last_send_us, sent.send_us);
+        m_group.last_arrival_us = std::max(m_group.last_arrival_us, arrival_us);
+        return;
+    }
+
+    // 新的一组开始，上一组已完整，与更早的一组比较
+    if (m_prev_group.valid) {
+        const double send_delta_ms = (m_group.last_send_us - m_prev_group.last_send_us) / 1000.0;
+        const double arrival_delta_ms = (m_group.last_arrival_us - m_prev_group.last_arrival_us) / 1000.0;
+        if (std::fabs(arrival_delta_ms) > MAX_ARRIVAL_DELTA_MS) {
+            reset_delay_state_locked();
+            m_group = { true, sent.send_us, sent.send_us, arrival_us };
+            return;
+        }
+        update_trendline_locked(arrival_delta_ms - send_delta_ms, send_delta_ms, m_group.last_arrival_us);
+    }
+    m_prev_group = m_group;
+    m_group = { true, sent.send_us, sent.send_us, arrival_us };
+}
+
+void BandwidthEstimator::update_trendline_locked(double delay_delta_ms, double send_delta_ms, int64_t arrival_us)
+{
+    m_num_deltas = std::min(m_num_deltas + 1, 1000);
+    m_accumulated_delay_ms += delay_delta_ms;
+    m_smoothed_delay_ms = TRENDLINE_SMOOTHING * m_smoothed_delay_ms + (1.0 - TRENDLINE_SMOOTHING) * m_accumulated_delay_ms;
+    if (m_first_arrival_us < 0) m_first_arrival_us = arrival_us;
+
+    m_trend_samples.emplace_back((arrival_us - m_first_arrival_us) / 1000.0, m_smoothed_delay_ms);
+    if (m_trend_samples.size() > TRENDLINE_WINDOW) m_trend_samples.pop_front();
+
+    // 对窗口内的 (时间, 时延) 做最小二乘，斜率即排队时延的增长速度
+    double trend = m_prev_trend;
+    if (m_trend_samples.size() == TRENDLINE_WINDOW) {
+        double mean_x = 0.0, mean_y = 0.0;
+        for (const auto& sample : m_trend_samples) {
+            mean_x += sample.first;
+            mean_y += sample.second;
+        }
+        mean_x /= m_trend_samples.size();
+        mean_y /= m_trend_samples.size();
+        double numerator = 0.0, denominator = 0.0;
+        for (const auto& sample : m_trend_samples) {
+            numerator += (sample.first - mean_x) * (sample.second - mean_y);
+            denominator += (sample.first - mean_x) * (sample.first - mean_x);
+        }
+        if (denominator > 0.0) trend = numerator / denominator;
+    }
+    detect_locked(trend, send_delta_ms, arrival_us);
+}
+
+void BandwidthEstimator::detect_locked(double trend, double send_delta_ms, int64_t arrival_us)
+{
+    if (m_num_deltas < 2) return;
+    const double modified_trend = std::min(m_num_deltas, MAX_DELTAS_FOR_GAIN) * trend * TRENDLINE_GAIN;
+
+    if (modified_trend > m_threshold) {
+        if (m_time_over_using_ms < 0.0) {
+            m_time_over_using_ms = send_delta_ms / 2.0;
+        }
+        else {
+            m_time_over_using_ms += send_delta_ms;
+        }
+        m_overuse_counter++;
+        // 持续一段时间且趋势没有回落才判为过载，避免单次抖动触发降速
+        if (m_time_over_using_ms > OVERUSE_TIME_MS && m_overuse_counter > 1 && trend >= m_prev_trend) {
+            m_time_over_using_ms = 0.0;
+            m_overuse_counter = 0;
+            m_usage = BandwidthUsage::Overusing;
+        }
+    }
+    else if (modified_trend < -m_threshold) {
+        m_time_over_using_ms = -1.0;
+        m_overuse_counter = 0;
+        m_usage = BandwidthUsage::Underusing;
+    }
+    else {
+        m_time_over_using_ms = -1.0;
+        m_overuse_counter = 0;
+        m_usage = BandwidthUsage::Normal;
+    }
+    m_prev_trend = trend;
+    update_threshold_locked(modified_trend, arrival_us);
+}
+
+// 阈值跟随趋势缓慢变化：与其他 TCP 流竞争时不至于一直判为过载而饿死
+void BandwidthEstimator::update_threshold_locked(double modified_trend, int64_t arrival_us)
+{
+    if (m_last_threshold_update_us < 0) m_last_threshold_update_us = arrival_us;
+    const double abs_trend = std::fabs(modified_trend);
+    // 突发的尖峰不调整阈值
+    if (abs_trend > m_threshold + 15.0) {
+        m_last_threshold_update_us = arrival_us;
+        return;
+    }
+    const double k = abs_trend < m_threshold ? THRESHOLD_K_DOWN : THRESHOLD_K_UP;
+    const double dt_ms = std::min((arrival_us - m_last_threshold_update_us) / 1000.0, 100.0);
+    m_threshold = std::clamp(m_threshold + k * (abs_trend - m_threshold) * dt_ms, THRESHOLD_MIN, THRESHOLD_MAX);
+    m_last_threshold_update_us = arrival_us;
+}
+
+int64_t BandwidthEstimator::acked_bitrate_locked() const
+{
+    if (m_acked.size() < 2) return 0;
+    const int64_t span_us = m_acked.back().first - m_acked.front().first;
+    if (span_us < MIN_ACKED_SPAN_US) return 0;
+    return static_cast<int64_t>(m_acked_bytes * 8 * 1000000.0 / span_us);
+}
+
+int64_t BandwidthEstimator::link_capacity_locked(int64_t now) const
+{
+    if (m_bbr_sample_us >= 0 && now - m_bbr_sample_us <= BBR_SAMPLE_TIMEOUT_US) {
+        return m_bbr_bandwidth_bps;
+    }
+    return static_cast<int64_t>(m_capacity_ema_bps);
+}
+
+void BandwidthEstimator::update_rate_locked(int64_t now)
+{
+    const double dt_s = m_last_update_us < 0 ? 0.0 : std::min((now - m_last_update_us) / 1e6, 1.0);
+    m_last_update_us = now;
+    const int64_t acked = acked_bitrate_locked();
+    const int64_t rtt_us = m_rtt_us > 0 ? m_rtt_us : DEFAULT_RTT_US;
+    double target = static_cast<double>(m_target_bps);
+
+    switch (m_usage) {
+    case BandwidthUsage::Overusing:
+        // 每个 RTT 最多降一次，降到实际接收速率以下，让瓶颈队列排空
+        if (m_last_decrease_us < 0 || now - m_last_decrease_us >= std::max(rtt_us, MIN_DECREASE_INTERVAL_US)) {
+            const double base = acked > 0 ? static_cast<double>(acked) : target;
+            target = std::min(target, DECREASE_FACTOR * base);
+            if (acked > 0) {
+                m_capacity_ema_bps = m_capacity_ema_bps <= 0.0 ? acked
+                    : m_capacity_ema_bps + CAPACITY_EMA_ALPHA * (acked - m_capacity_ema_bps);
+            }
+            m_last_decrease_us = now;
+        }
+        m_rate_state = RateState::Decrease;
+        break;
+    case BandwidthUsage::Underusing:
+        // 队列正在排空，保持码率直到时延稳定
+        m_rate_state = RateState::Hold;
+        break;
+    case BandwidthUsage::Normal:
+        if (m_rate_state != RateState::Increase) {
+            m_rate_state = RateState::Increase;
+            break; // 从本次更新开始计时
+        }
+        {
+            // 接收速率明显超过历次降速时的容量，说明链路变好了，重新试探
+            if (m_capacity_ema_bps > 0.0 && acked > MAX_ACKED_RATIO * m_capacity_ema_bps) {
+                m_capacity_ema_bps = 0.0;
+            }
+            const int64_t capacity = link_capacity_locked(now);
+            if (capacity > 0 && target >= NEAR_CAPACITY_RATIO * capacity) {
+                // 接近链路容量：每个响应时间增加约一个包
+                const double response_time_s = (rtt_us + RESPONSE_TIME_EXTRA_US) / 1e6;
+                target += PACKET_BITS * dt_s / response_time_s;
+            }
+            else {
+                const bool startup = m_last_decrease_us < 0 && capacity <= 0;
+                target *= std::pow(1.0 + (startup ? STARTUP_INCREASE_PER_SEC : MULTIPLICATIVE_INCREASE_PER_SEC), dt_s);
+            }
+            if (acked > 0) {
+                target = std::min(target, MAX_ACKED_RATIO * acked + 10000.0);
+            }
+        }
+        break;
+    }
+
+    // 丢包严重时额外下调，时延检测对短队列的瓶颈不敏感
+    if (m_loss_rate > LOSS_HIGH && (m_last_loss_decrease_us < 0 || now - m_last_loss_decrease_us >= LOSS_DECREASE_INTERVAL_US)) {
+        target *= 1.0 - 0.5 * m_loss_rate;
+        m_last_loss_decrease_us = now;
+    }
+
+    m_target_bps = std::clamp(static_cast<int64_t>(target), MIN_BITRATE_BPS, MAX_BITRATE_BPS);
+}
@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// 客户端回报的一个数据报：收到时带到达时间（客户端时钟，只有差值有意义）
+struct PacketFeedback {
+    uint16_t transport_seq;
+    bool received;
+    int64_t arrival_us;
+};
+
+// 时延检测器对网络的判断
+enum class BandwidthUsage { Normal, Overusing, Underusing };
+
+// 一次估计的结果，供控制器决策与打印
+struct BandwidthEstimate {
+    int64_t target_bitrate_bps = 0;
+    int64_t acked_bitrate_bps = 0;    // 客户端实际收到的速率，未知时为 0
+    int64_t link_capacity_bps = 0;    // BBR 估计或历次降速时的接收速率，未知时为 0
+    double loss_rate = 0.0;
+    BandwidthUsage usage = BandwidthUsage::Normal;
+};
+
+// 发送端带宽估计（类 GCC），输入为客户端的逐包到达时间：
+// - 时延：按发送时间 5ms 分组，组间的到达间隔减发送间隔累积成排队时延，对最近 20 个平滑值做线性回归，
+//   趋势与自适应阈值比较，持续超过阈值判为过载，低于负阈值判为欠载
+// - 码率：AIMD。过载时降到接收速率的 0.85 倍；正常时离链路容量较远按每秒 8% 乘性增长（首次过载前
+//   按每秒 50% 试探），接近时按每个响应时间一个包的量加性增长；任何时候不超过接收速率的 1.5 倍
+// - 丢包：累计的丢包率超过 10% 时按丢包率下调
+// - 链路容量优先使用 MsQuic 拥塞控制器（BBR）的带宽估计
+// 线程安全：发送记录来自发送线程与 MsQuic 回调，反馈来自控制流回调
+class BandwidthEstimator
+{
+public:
+    BandwidthEstimator();
+
+    // 新的一路流开始时调用；传输序号继续递增，不重置
+    void reset(int64_t start_bitrate_bps);
+    // 为即将交给 MsQuic 的数据报分配传输序号
+    uint16_t register_packet(uint32_t size);
+    // 数据报写入 QUIC 包时调用（DATAGRAM_SEND_STATE_CHANGED: SENT），以此作为发送时间
+    void on_packet_sent(uint16_t transport_seq);
+    // MsQuic 的网络统计：拥塞控制器的带宽估计与平滑 RTT
+    void on_network_statistics(int64_t bandwidth_bps, int64_t smoothed_rtt_us);
+    // 处理一批反馈（按传输序号递增），返回更新后的估计
+    BandwidthEstimate on_transport_feedback(const std::vector<PacketFeedback>& packets);
+
+    BandwidthEstimator(const BandwidthEstimator&) = delete;
+    BandwidthEstimator& operator=(const BandwidthEstimator&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct SentPacket {
+        uint16_t transport_seq = 0;
+        uint32_t size = 0;
+        int64_t send_us = -1; // 尚未真正发出（或被 MsQuic 丢弃）时为 -1
+    };
+
+    // 发送时间相近（一次突发）的一组包
+    struct PacketGroup {
+        bool valid = false;
+        int64_t first_send_us = 0;
+        int64_t last_send_us = 0;
+        int64_t last_arrival_us = 0;
+    };
+
+    enum class RateState { Hold, Increase, Decrease };
+
+    int64_t now_us() const;
+    void reset_delay_state_locked();
+    void on_received_locked(const SentPacket& sent, int64_t arrival_us);
+    void update_trendline_locked(double delay_delta_ms, double send_delta_ms, int64_t arrival_us);
+    void detect_locked(double trend, double send_delta_ms, int64_t arrival_us);
+    void update_threshold_locked(double modified_trend, int64_t arrival_us);
+    int64_t acked_bitrate_locked() const;
+    int64_t link_capacity_locked(int64_t now) const;
+    void update_rate_locked(int64_t now);
+
+    std::mutex m_mutex;
+    const Clock::time_point m_epoch;
+
+    // 发送记录，按传输序号取模索引
+    std::vector<SentPacket> m_history;
+    uint16_t m_next_seq = 0;
+
+    // 到达间隔分组
+    PacketGroup m_group;
+    PacketGroup m_prev_group;
+
+    // 趋势线
+    double m_accumulated_delay_ms = 0.0;
+    double m_smoothed_delay_ms = 0.0;
+    int64_t m_first_arrival_us = -1;
+    std::deque<std::pair<double, double>> m_trend_samples; // (到达时间 ms, 平滑后的累积时延 ms)
+    int m_num_deltas = 0;
+    double m_prev_trend = 0.0;
+
+    // 过载检测
+    double m_threshold = 0.0;
+    int64_t m_last_threshold_update_us = -1;
+    double m_time_over_using_ms = -1.0;
+    int m_overuse_counter = 0;
+    BandwidthUsage m_usage = BandwidthUsage::Normal;
+
+    // 接收速率窗口：(到达时间, 字节数)
+    std::deque<std::pair<int64_t, uint32_t>> m_acked;
+    uint64_t m_acked_bytes = 0;
+
+    // 丢包统计，攒够一定包数再判断
+    int m_feedback_total = 0;
+    int m_feedback_lost = 0;
+    double m_loss_rate = 0.0;
+    int64_t m_last_loss_decrease_us = -1;
+
+    // 码率控制
+    RateState m_rate_state = RateState::Hold;
+    int64_t m_target_bps = 0;
+    int64_t m_last_update_us = -1;
+    int64_t m_last_decrease_us = -1;
+    double m_capacity_ema_bps = 0.0;   // 历次过载降速时的接收速率
+
+    // MsQuic 的网络统计
+    int64_t m_bbr_bandwidth_bps = 0;
+    int64_t m_bbr_sample_us = -1;
+    int64_t m_rtt_us = 0;
+};
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <algorithm> // 【新增】为 std::min 提供头文件
 
 extern "C" {
@@ -27,6 +28,15 @@ inline uint16_t htons_portable(uint16_t value) {
 #endif
 }
 
+// 【新增】VideoTiming 负载中的 u32 字段
+inline uint32_t htonl_portable(uint32_t value) {
+#ifdef _WIN32
+    return _byteswap_ulong(value);
+#else
+    return htonl(value);
+#endif
+}
+
 inline uint64_t htonll_portable(uint64_t value) {
 #ifdef _WIN32
     return _byteswap_uint64(value);
@@ -37,14 +47,53 @@ inline uint64_t htonll_portable(uint64_t value) {
 #endif
 }
 
+namespace {
+    constexpr uint32_t DATAGRAM_HEADER_SIZE = AppConfig::DATAGRAM_HEADER_SIZE; // 【修改】Type, PTS, Count, Index, TransportSeq, ReferenceSeq
+    constexpr uint32_t PACK_RECORD_HEADER_SIZE = 2;          // 每条记录前的 u16 长度
+    // 分片负载的下限，防止异常的数据报上限把一帧切成过多分片
+    constexpr uint32_t MIN_DATAGRAM_PAYLOAD_SIZE = 512;
+    constexpr int FRAGMENT_STATS_INTERVAL_SEC = 5;
+    // 两次强制关键帧的最小间隔；客户端在关键帧到达前可能重复请求
+    constexpr int KEYFRAME_MIN_INTERVAL_MS = 100;
+    // 【新增】等待编码输出的时间记录上限；低延迟编码器每帧立即输出，正常情况下最多一条
+    constexpr size_t MAX_PENDING_TIMINGS = 16;
+
+    // HEVC：取第一个 VCL NAL 的类型，TRAIL_N/TSA_N/STSA_N/RADL_N/RASL_N 等偶数类型（<= 14）不被参考
+    bool is_hevc_non_reference(const uint8_t* data, int size)
+    {
+        for (int i = 0; i + 3 < size; ++i) {
+            if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) continue;
+            const int nal_type = (data[i + 3] >> 1) & 0x3F;
+            if (nal_type < 32) return nal_type <= 14 && nal_type % 2 == 0;
+            i += 2;
+        }
+        return false;
+    }
+
+    void write_datagram_header(uint8_t* ptr, AppConfig::PacketType type, int64_t pts, uint16_t count, uint16_t index)
+    {
+        *ptr++ = static_cast<uint8_t>(type);
+        uint64_t pts_net = htonll_portable(pts);
+        memcpy(ptr, &pts_net, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        uint16_t count_net = htons_portable(count);
+        memcpy(ptr, &count_net, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+        uint16_t index_net = htons_portable(index);
+        memcpy(ptr, &index_net, sizeof(uint16_t));
+    }
+}
+
 BaseStreamer::BaseStreamer(const QUIC_API_TABLE* msquic, HQUIC connection, std::shared_ptr<AdaptiveStreamController> controller)
     : m_msquic(msquic),
     m_connection(connection),
+    m_send_scheduler(msquic, connection, controller->bandwidth_estimator()),
     m_controller(controller),
     m_control_block(std::make_shared<StreamControlBlock>())
 {
     m_encoded_packet = av_packet_alloc();
     m_scaled_frame = av_frame_alloc();
+    m_audio_encoder.initialize(AudioStreamFormat());
 }
 
 BaseStreamer::~BaseStreamer()
@@ -61,6 +110,7 @@ BaseStreamer::~BaseStreamer()
 void BaseStreamer::stop()
 {
     m_control_block->running = false;
+    m_send_scheduler.stop();
 }
 
 void BaseStreamer::seek(double time_sec)
@@ -71,6 +121,9 @@ void BaseStreamer::seek(double time_sec)
 void BaseStreamer::pause()
 {
     m_control_block->paused = true;
+    // 【新增】暂停后不会再有音频把合并包推满，立即发出
+    std::lock_guard<std::mutex> lock(m_pack_mutex);
+    flush_pack_locked();
 }
 
 void BaseStreamer::resume()
@@ -78,9 +131,54 @@ void BaseStreamer::resume()
     m_control_block->paused = false;
 }
 
+AudioStreamFormat BaseStreamer::set_audio_format(const AudioStreamFormat& format)
+{
+    if (!m_audio_encoder.initialize(format)) {
+        std::cerr << "[BaseStreamer] 音频编码器初始化失败，回退到原始 PCM。" << std::endl;
+        m_audio_encoder.initialize(AudioStreamFormat());
+    }
+    return m_audio_encoder.format();
+}
+
+void BaseStreamer::send_audio(const int16_t* samples, int frames, int64_t pts_ms)
+{
+    m_audio_encoder.encode(samples, frames, pts_ms,
+        [this](AppConfig::PacketType type, const uint8_t* data, uint32_t size, int64_t pts) {
+            send_quic_data(type, data, size, pts);
+        });
+}
+
+void BaseStreamer::set_max_datagram_size(uint32_t size)
+{
+    if (size <= DATAGRAM_HEADER_SIZE) return;
+    const uint32_t payload = std::max(MIN_DATAGRAM_PAYLOAD_SIZE, size - DATAGRAM_HEADER_SIZE);
+    if (m_max_datagram_payload.exchange(payload) != payload) {
+        std::cout << "[BaseStreamer] 数据报上限 " << size << " 字节，分片负载调整为 " << payload << " 字节。" << std::endl;
+    }
+}
+
+void BaseStreamer::request_keyframe()
+{
+    m_keyframe_requested = true;
+}
+
+void BaseStreamer::reset_send_path()
+{
+    m_audio_encoder.reset();
+    m_send_scheduler.clear_video();
+    std::lock_guard<std::mutex> lock(m_pack_mutex);
+    m_pack_buffer.clear();
+    m_pack_records = 0;
+    m_pack_priorities.clear();
+}
+
 void BaseStreamer::cleanup()
 {
     std::cout << "[BaseStreamer] 开始清理基类资源..." << std::endl;
+    if (m_pack_datagrams_total > 0) {
+        std::cout << "[BaseStreamer] 小包合并: " << m_packed_records_total << " 个数据报合并为 "
+            << m_pack_datagrams_total << " 个发送。" << std::endl;
+    }
     if (m_video_encoder_ctx) {
         avcodec_free_context(&m_video_encoder_ctx);
         m_video_encoder_ctx = nullptr;
@@ -102,6 +200,7 @@ bool BaseStreamer::initialize_video_encoder(int width, int height, int fps)
     if (m_video_encoder_ctx) {
         avcodec_free_context(&m_video_encoder_ctx);
     }
+    m_pending_timings.clear(); // 【新增】旧编码器中未输出的帧不会再输出
     const AVCodec* encoder = avcodec_find_encoder_by_name("hevc_nvenc");
     if (!encoder) {
         std::cerr << "[BaseStreamer] 错误: 找不到 hevc_nvenc 编码器。" << std::endl;
@@ -130,6 +229,24 @@ bool BaseStreamer::initialize_video_encoder(int width, int height, int fps)
     av_opt_set(m_video_encoder_ctx->priv_data, "rc", "vbr", 0);    // 可变码率
     av_opt_set(m_video_encoder_ctx->priv_data, "cq", "21", 0);     // 恒定质量模式下的质量值
 
+    // 【新增】实时采集：不使用 B 帧，不在编码器内部排队（delay=0），送入一帧即可取回该帧的码流
+    if (m_low_latency_encoder) {
+        m_video_encoder_ctx->max_b_frames = 0;
+        av_opt_set_int(m_video_encoder_ctx->priv_data, "zerolatency", 1, 0);
+        av_opt_set_int(m_video_encoder_ctx->priv_data, "delay", 0, 0);
+    }
+
+    // 【新增】丢包恢复方式
+    if (m_intra_refresh) {
+        // 周期性帧内刷新：gop_size 作为刷新周期（帧），NVENC 随之改为无限 GOP
+        m_video_encoder_ctx->gop_size = std::max(1, fps * AppConfig::INTRA_REFRESH_PERIOD_MS / 1000);
+        av_opt_set_int(m_video_encoder_ctx->priv_data, "intra-refresh", 1, 0);
+        av_opt_set_int(m_video_encoder_ctx->priv_data, "forced-idr", 0, 0); // 强制关键帧时只插入帧内帧
+    }
+    else {
+        av_opt_set_int(m_video_encoder_ctx->priv_data, "forced-idr", 1, 0); // 强制关键帧编码为 IDR，客户端可从此处重新开始解码
+    }
+
     // 4. 打开编码器
     if (avcodec_open2(m_video_encoder_ctx, encoder, nullptr) < 0) {
         std::cerr << "[BaseStreamer] 错误: 无法打开视频编码器。" << std::endl;
@@ -150,7 +267,7 @@ bool BaseStreamer::initialize_video_encoder(int width, int height, int fps)
     return true;
 }
 
-void BaseStreamer::encode_and_send_video(AVFrame* frame)
+void BaseStreamer::encode_and_send_video(AVFrame* frame, const FrameTiming* timing)
 {
     // 如果是 flush 操作 (frame == nullptr)，直接发送 null 帧给编码器
     if (frame == nullptr) {
@@ -162,6 +279,8 @@ void BaseStreamer::encode_and_send_video(AVFrame* frame)
         }
     }
     else { // 正常的帧编码流程
+        const auto encode_started = std::chrono::steady_clock::now(); // 【新增】缩放与编码都计入编码阶段
+
         // 1. 获取ABR控制器的最新决策
         ABRDecision decision = m_controller->get_decision();
 
@@ -213,10 +332,34 @@ void BaseStreamer::encode_and_send_video(AVFrame* frame)
             frame_to_encode = scaled_frame;
         }
 
+        // 【修改】发送调度器丢弃了参考帧，或客户端报告参考链断裂，强制插入关键帧
+        const AVPictureType original_pict_type = frame_to_encode->pict_type;
+        if (m_send_scheduler.take_keyframe_request()) {
+            std::cout << "[BaseStreamer] 参考帧已被丢弃，需要关键帧。" << std::endl;
+            m_force_keyframe_pending = true;
+        }
+        if (m_keyframe_requested.exchange(false)) {
+            m_force_keyframe_pending = true;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (m_force_keyframe_pending && now - m_last_forced_keyframe >= std::chrono::milliseconds(KEYFRAME_MIN_INTERVAL_MS)) {
+            frame_to_encode->pict_type = AV_PICTURE_TYPE_I;
+            m_force_keyframe_pending = false;
+            m_last_forced_keyframe = now;
+        }
+
         // 5. 发送帧给编码器
         if (avcodec_send_frame(m_video_encoder_ctx, frame_to_encode) < 0) {
             // 错误处理
         }
+        else if (timing) {
+            // 【新增】编码器输出同一 pts 的包时再补上后续阶段的时间
+            m_pending_timings.push_back({ frame->pts, *timing, encode_started });
+            if (m_pending_timings.size() > MAX_PENDING_TIMINGS) {
+                m_pending_timings.pop_front();
+            }
+        }
+        frame_to_encode->pict_type = original_pict_type;
 
         // 如果创建了临时缩放帧，释放它
         if (scaled_frame) {
@@ -235,18 +378,42 @@ void BaseStreamer::encode_and_send_video(AVFrame* frame)
             // 错误处理
             break;
         }
-        send_quic_data(AppConfig::PacketType::Video, m_encoded_packet->data, m_encoded_packet->size, m_encoded_packet->pts);
+        // 【修改】按帧类型确定发送优先级
+        SendPriority priority = SendPriority::Reference;
+        if (m_encoded_packet->flags & AV_PKT_FLAG_KEY) {
+            priority = SendPriority::KeyFrame;
+        }
+        else if ((m_encoded_packet->flags & AV_PKT_FLAG_DISPOSABLE) || is_hevc_non_reference(m_encoded_packet->data, m_encoded_packet->size)) {
+            priority = SendPriority::NonReference;
+        }
+        const auto encoded = std::chrono::steady_clock::now();
+        send_quic_data(AppConfig::PacketType::Video, m_encoded_packet->data, m_encoded_packet->size, m_encoded_packet->pts, priority);
+        send_frame_timing(m_encoded_packet->pts, encoded); // 【新增】
         av_packet_unref(m_encoded_packet);
     }
 }
 
-void BaseStreamer::send_quic_data(AppConfig::PacketType type, const uint8_t* payload, uint32_t payload_size, int64_t pts)
+void BaseStreamer::send_quic_data(AppConfig::PacketType type, const uint8_t* payload, uint32_t payload_size, int64_t pts, SendPriority priority)
 {
     if (!m_connection || !payload) return;
 
-    const uint32_t HEADER_SIZE = 1 + 8 + 2 + 2; // Type, PTS, Count, Index
+    const uint32_t HEADER_SIZE = DATAGRAM_HEADER_SIZE; // 【修改】Type, PTS, Count, Index, TransportSeq, ReferenceSeq
+    // 【修改】整帧使用同一个分片大小，即使发送途中上限发生变化
+    const uint32_t max_payload = m_max_datagram_payload.load();
+    // 【新增】参考帧序号：IDR 和参考帧各占一个新序号，非参考帧沿用上一个
+    uint16_t reference_seq = 0;
+    if (type == AppConfig::PacketType::Video) {
+        if (priority != SendPriority::NonReference) {
+            m_reference_seq = (m_reference_seq + 1) & AppConfig::REFERENCE_SEQ_MASK;
+            reference_seq = m_reference_seq | AppConfig::REFERENCE_SEQ_FLAG;
+        }
+        else {
+            reference_seq = m_reference_seq;
+        }
+    }
+    const uint16_t reference_seq_net = htons_portable(reference_seq);
 
-    if (payload_size <= MAX_DATAGRAM_PAYLOAD_SIZE) {
+    if (payload_size <= max_payload) {
         std::vector<uint8_t> buffer(HEADER_SIZE + payload_size);
         uint8_t* ptr = buffer.data();
         *ptr++ = static_cast<uint8_t>(type);
@@ -259,15 +426,44 @@ void BaseStreamer::send_quic_data(AppConfig::PacketType type, const uint8_t* pay
         uint16_t index_net = htons_portable(0);
         memcpy(ptr, &index_net, sizeof(uint16_t));
         ptr += sizeof(uint16_t);
+        ptr += sizeof(uint16_t); // 传输序号由发送调度器填写
+        memcpy(ptr, &reference_seq_net, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
         memcpy(ptr, payload, payload_size);
-        SendDatagram(buffer.data(), static_cast<uint32_t>(buffer.size()));
+        m_stat_header_bytes += HEADER_SIZE;
+        if (type == AppConfig::PacketType::Video) {
+            m_stat_video_frames++;
+            m_stat_video_fragments++;
+        }
+        // 【修改】音频进入合并包；视频队列空闲时非参考帧优先搭上待发的合并包，
+        // IDR 与参考帧单独入队，保留它们更长的截止时间
+        flush_stale_pack();
+        const bool is_audio = type == AppConfig::PacketType::Audio || type == AppConfig::PacketType::AudioOpus;
+        if (is_audio && AppConfig::AUDIO_PACK_BUDGET_MS > 0) {
+            const AudioStreamFormat& format = audio_format();
+            pack_audio_datagram(buffer, pts, format.frame_samples * 1000 / format.sample_rate);
+        }
+        else if (is_audio || priority != SendPriority::NonReference || !m_send_scheduler.video_idle()
+            || !piggyback_datagram(buffer, priority)) {
+            std::vector<std::vector<uint8_t>> datagrams;
+            datagrams.push_back(std::move(buffer));
+            enqueue_frame(is_audio ? SendPriority::Audio : priority, std::move(datagrams));
+        }
     }
     else {
-        uint16_t fragment_count = static_cast<uint16_t>(std::ceil(static_cast<double>(payload_size) / MAX_DATAGRAM_PAYLOAD_SIZE));
+        uint16_t fragment_count = static_cast<uint16_t>(std::ceil(static_cast<double>(payload_size) / max_payload));
+        m_stat_header_bytes += static_cast<uint64_t>(HEADER_SIZE) * fragment_count;
+        if (type == AppConfig::PacketType::Video) {
+            m_stat_video_frames++;
+            m_stat_video_fragments += fragment_count;
+        }
         uint16_t count_net = htons_portable(fragment_count);
+        // 【修改】整帧的分片一起入队，调度器只会整帧丢弃
+        std::vector<std::vector<uint8_t>> datagrams;
+        datagrams.reserve(fragment_count);
         for (uint16_t i = 0; i < fragment_count; ++i) {
-            uint32_t offset = i * MAX_DATAGRAM_PAYLOAD_SIZE;
-            uint32_t current_payload_size = std::min(MAX_DATAGRAM_PAYLOAD_SIZE, payload_size - offset);
+            uint32_t offset = i * max_payload;
+            uint32_t current_payload_size = std::min(max_payload, payload_size - offset);
             std::vector<uint8_t> buffer(HEADER_SIZE + current_payload_size);
             uint8_t* ptr = buffer.data();
             *ptr++ = static_cast<uint8_t>(type);
@@ -279,36 +475,168 @@ void BaseStreamer::send_quic_data(AppConfig::PacketType type, const uint8_t* pay
             uint16_t index_net = htons_portable(i);
             memcpy(ptr, &index_net, sizeof(uint16_t));
             ptr += sizeof(uint16_t);
+            ptr += sizeof(uint16_t); // 传输序号由发送调度器填写
+            memcpy(ptr, &reference_seq_net, sizeof(uint16_t));
+            ptr += sizeof(uint16_t);
             memcpy(ptr, payload + offset, current_payload_size);
-            SendDatagram(buffer.data(), static_cast<uint32_t>(buffer.size()));
+            datagrams.push_back(std::move(buffer));
         }
+        const bool is_audio = type == AppConfig::PacketType::Audio || type == AppConfig::PacketType::AudioOpus;
+        enqueue_frame(is_audio ? SendPriority::Audio : priority, std::move(datagrams));
+    }
+
+    if (type == AppConfig::PacketType::Video) {
+        report_fragment_stats();
+    }
+}
+
+void BaseStreamer::send_frame_timing(int64_t pts, std::chrono::steady_clock::time_point encoded)
+{
+    // 没有 B 帧时编码器按输入顺序输出，更早的记录对应被编码器丢掉的帧
+    while (!m_pending_timings.empty() && m_pending_timings.front().pts < pts) {
+        m_pending_timings.pop_front();
+    }
+    if (m_pending_timings.empty() || m_pending_timings.front().pts != pts) return;
+    const PendingFrameTiming pending = m_pending_timings.front();
+    m_pending_timings.pop_front();
+
+    const auto sent = std::chrono::steady_clock::now();
+    auto offset_us = [&pending](std::chrono::steady_clock::time_point t) {
+        const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(t - pending.timing.captured).count();
+        return static_cast<uint32_t>(std::max<int64_t>(0, us));
+    };
+    const uint32_t offsets[] = {
+        offset_us(pending.timing.converted),
+        offset_us(pending.encode_started),
+        offset_us(encoded),
+        offset_us(sent),
+    };
+
+    uint8_t payload[AppConfig::VIDEO_TIMING_PAYLOAD_SIZE];
+    const uint64_t capture_net = htonll_portable(static_cast<uint64_t>(pending.timing.capture_wall_us));
+    memcpy(payload, &capture_net, sizeof(uint64_t));
+    for (size_t i = 0; i < 4; ++i) {
+        const uint32_t offset_net = htonl_portable(offsets[i]);
+        memcpy(payload + sizeof(uint64_t) + i * sizeof(uint32_t), &offset_net, sizeof(uint32_t));
     }
+    // 跟在视频帧之后入队；按非参考帧调度，被丢弃时不会触发关键帧请求
+    send_quic_data(AppConfig::PacketType::VideoTiming, payload, sizeof(payload), pts, SendPriority::NonReference);
 }
 
-void BaseStreamer::SendDatagram(const uint8_t* data, uint32_t length) {
-    if (!m_connection) return;
+void BaseStreamer::report_fragment_stats()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_stat_last_report < std::chrono::seconds(FRAGMENT_STATS_INTERVAL_SEC)) return;
+    m_stat_last_report = now;
+
+    const uint64_t frames = m_stat_video_frames.exchange(0);
+    const uint64_t fragments = m_stat_video_fragments.exchange(0);
+    const uint64_t datagrams = m_stat_datagrams.exchange(0);
+    const uint64_t header_bytes = m_stat_header_bytes.exchange(0);
+    const uint64_t total_bytes = m_stat_total_bytes.exchange(0);
+    if (frames == 0 || total_bytes == 0) return;
+
+    std::cout << "[BaseStreamer] 分片统计: 负载上限 " << m_max_datagram_payload.load() << " 字节, 平均每帧 "
+        << static_cast<double>(fragments) / frames << " 片, 数据报 " << datagrams << " 个, 头部开销 "
+        << header_bytes << " 字节 (" << 100.0 * header_bytes / total_bytes << "%)" << std::endl;
+
+    const SendSchedulerStats send_stats = m_send_scheduler.take_stats();
+    std::cout << "[BaseStreamer] 发送队列: 排队时延 平均 " << send_stats.avg_queue_delay_ms << " ms / 最大 "
+        << send_stats.max_queue_delay_ms << " ms, 排队 " << send_stats.queued_frames << " 帧, MsQuic 待发 "
+        << send_stats.msquic_queued << " 个, 丢弃 音频/IDR/参考/非参考 = "
+        << send_stats.dropped_frames[0] << "/" << send_stats.dropped_frames[1] << "/"
+        << send_stats.dropped_frames[2] << "/" << send_stats.dropped_frames[3]
+        << " (" << send_stats.dropped_bytes / 1024 << " KB)" << std::endl;
+}
+
+void BaseStreamer::pack_audio_datagram(const std::vector<uint8_t>& datagram, int64_t pts, int duration_ms)
+{
+    const uint32_t max_size = DATAGRAM_HEADER_SIZE + m_max_datagram_payload.load();
+    const uint32_t record_size = PACK_RECORD_HEADER_SIZE + static_cast<uint32_t>(datagram.size());
+    std::lock_guard<std::mutex> lock(m_pack_mutex);
 
-    auto* context = new (std::nothrow) SendRequestContext();
-    if (!context) {
-        std::cerr << "[BaseStreamer] 错误: 无法为 SendRequestContext 分配内存" << std::endl;
-        return;
+    // 放不下，或时间戳回退（跳转），先把已有的发出去
+    if (m_pack_records > 0 && (m_pack_buffer.size() + record_size > max_size || pts < m_pack_first_pts)) {
+        flush_pack_locked();
+    }
+    if (m_pack_records == 0) {
+        m_pack_buffer.assign(DATAGRAM_HEADER_SIZE, 0);
+        m_pack_first_pts = pts;
+        m_pack_started = std::chrono::steady_clock::now();
+    }
+    uint16_t size_net = htons_portable(static_cast<uint16_t>(datagram.size()));
+    const uint8_t* size_ptr = reinterpret_cast<const uint8_t*>(&size_net);
+    m_pack_buffer.insert(m_pack_buffer.end(), size_ptr, size_ptr + sizeof(uint16_t));
+    m_pack_buffer.insert(m_pack_buffer.end(), datagram.begin(), datagram.end());
+    m_pack_records++;
+    m_pack_priorities.push_back(SendPriority::Audio);
+
+    // 攒够时延预算，或再来一个同样大小的帧就放不下时立即发出
+    if (pts + duration_ms - m_pack_first_pts >= AppConfig::AUDIO_PACK_BUDGET_MS
+        || m_pack_buffer.size() + record_size > max_size) {
+        flush_pack_locked();
     }
+}
 
-    // .assign的正确用法是 (first_iterator, last_iterator)
-    context->Data.assign(data, data + length);
-    context->QuicBuffer.Buffer = context->Data.data();
-    context->QuicBuffer.Length = static_cast<uint32_t>(context->Data.size());
+// 调用方已确认视频队列空闲，搭车的只会是单片视频帧，不会越过排队中的旧帧
+// 【修改】记下视频帧的优先级，合并包按音频调度，搭车的视频帧过期时计入丢帧
+bool BaseStreamer::piggyback_datagram(const std::vector<uint8_t>& datagram, SendPriority priority)
+{
+    const uint32_t max_size = DATAGRAM_HEADER_SIZE + m_max_datagram_payload.load();
+    std::lock_guard<std::mutex> lock(m_pack_mutex);
+    if (m_pack_records == 0 || m_pack_buffer.size() + PACK_RECORD_HEADER_SIZE + datagram.size() > max_size) {
+        return false;
+    }
+    uint16_t size_net = htons_portable(static_cast<uint16_t>(datagram.size()));
+    const uint8_t* size_ptr = reinterpret_cast<const uint8_t*>(&size_net);
+    m_pack_buffer.insert(m_pack_buffer.end(), size_ptr, size_ptr + sizeof(uint16_t));
+    m_pack_buffer.insert(m_pack_buffer.end(), datagram.begin(), datagram.end());
+    m_pack_records++;
+    m_pack_priorities.push_back(priority);
+    flush_pack_locked();
+    return true;
+}
 
-    QUIC_STATUS Status = m_msquic->DatagramSend(
-        m_connection,
-        &context->QuicBuffer,
-        1,
-        QUIC_SEND_FLAG_NONE,
-        context
-    );
+void BaseStreamer::flush_pack_locked()
+{
+    if (m_pack_records == 0) return;
+    std::vector<std::vector<uint8_t>> datagrams(1);
+    if (m_pack_records == 1) {
+        // 只有一条记录时直接发内层数据报，省掉外层头
+        datagrams[0].assign(m_pack_buffer.begin() + DATAGRAM_HEADER_SIZE + PACK_RECORD_HEADER_SIZE, m_pack_buffer.end());
+        enqueue_frame(m_pack_priorities.front(), std::move(datagrams));
+    }
+    else {
+        write_datagram_header(m_pack_buffer.data(), AppConfig::PacketType::Bundle, m_pack_first_pts, m_pack_records, 0);
+        m_stat_header_bytes += DATAGRAM_HEADER_SIZE + static_cast<uint64_t>(PACK_RECORD_HEADER_SIZE) * m_pack_records;
+        datagrams[0] = m_pack_buffer;
+        // 【修改】按音频调度，但带上每条记录的优先级，搭车的视频帧过期时按视频丢帧处理
+        m_stat_datagrams++;
+        m_stat_total_bytes += datagrams[0].size();
+        m_send_scheduler.enqueue_bundle(m_pack_priorities, std::move(datagrams));
+    }
+    m_packed_records_total += m_pack_records;
+    m_pack_datagrams_total++;
+    m_pack_buffer.clear();
+    m_pack_records = 0;
+    m_pack_priorities.clear();
+}
 
-    if (QUIC_FAILED(Status)) {
-        std::cerr << "[BaseStreamer] 错误: DatagramSend 失败，代码: 0x" << std::hex << Status << std::endl;
-        delete context;
+// 音频断流（文件结束、采集卡顿）时合并包不会再被推满，按墙钟兜底
+void BaseStreamer::flush_stale_pack()
+{
+    std::lock_guard<std::mutex> lock(m_pack_mutex);
+    if (m_pack_records > 0 && std::chrono::steady_clock::now() - m_pack_started
+        > std::chrono::milliseconds(AppConfig::AUDIO_PACK_BUDGET_MS)) {
+        flush_pack_locked();
     }
-}
\ No newline at end of file
+}
+
+void BaseStreamer::enqueue_frame(SendPriority priority, std::vector<std::vector<uint8_t>> datagrams)
+{
+    for (const auto& datagram : datagrams) {
+        m_stat_datagrams++;
+        m_stat_total_bytes += datagram.size();
+    }
+    m_send_scheduler.enqueue(priority, std::move(datagrams));
+}
@@ -2,8 +2,14 @@
 
 #include "IStreamer.h"
 #include "AdaptiveStreamController.h"
+#include "AudioEncoder.h"
+#include "SendScheduler.h"
 #include "shared_config.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <msquic.h>
 #include <vector>
 
@@ -11,6 +17,14 @@ struct AVCodecContext;
 struct AVPacket;
 struct AVFrame;
 struct SwsContext;
+
+// 【新增】实时采集的一帧在进入编码之前的时间，编码输出后连同后续阶段以 VideoTiming 数据报发出
+struct FrameTiming {
+    int64_t capture_wall_us = 0; // 采集时刻，服务端系统时钟（Unix 微秒）
+    std::chrono::steady_clock::time_point captured;
+    std::chrono::steady_clock::time_point converted;
+};
+
 class BaseStreamer : public IStreamer, public std::enable_shared_from_this<BaseStreamer>
 {
 public:
@@ -25,36 +39,93 @@ public:
     void seek(double time_sec) override;
     void pause() final;
     void resume() final;
+    // 【新增】按连接的最大数据报长度调整分片大小，可从 QUIC 回调线程调用
+    void set_max_datagram_size(uint32_t size) final;
+    // 【新增】可从 QUIC 回调线程调用，由编码线程在下一帧处理
+    void request_keyframe() final;
+
+    // 【新增】设置播放时协商出的音频格式，需在 start() 之前调用；
+    // Opus 编码器打开失败时回退到原始 PCM，返回实际生效的格式
+    AudioStreamFormat set_audio_format(const AudioStreamFormat& format);
+    // 【新增】丢包恢复方式：true 为周期性帧内刷新，false 为按需 IDR；需在 start() 之前调用
+    void set_intra_refresh(bool enabled) { m_intra_refresh = enabled; }
 protected:
     bool initialize_video_encoder(int width, int height, int fps);
-    void encode_and_send_video(AVFrame* frame);
-    // 【修改】send_quic_data 现在内部处理分片
-    void send_quic_data(AppConfig::PacketType type, const uint8_t* payload, uint32_t payload_size, int64_t pts);
+    // 【修改】timing 非空时，该帧编码输出后紧接着发送它的 VideoTiming 数据报
+    void encode_and_send_video(AVFrame* frame, const FrameTiming* timing = nullptr);
+    // 【修改】send_quic_data 现在内部处理分片；priority 仅对视频有效，音频总是最高优先级
+    void send_quic_data(AppConfig::PacketType type, const uint8_t* payload, uint32_t payload_size, int64_t pts,
+        SendPriority priority = SendPriority::Reference);
+    // 【新增】把交织的 S16 PCM（audio_format() 的采样率与声道数）交给音频编码阶段，凑满一包后发送
+    void send_audio(const int16_t* samples, int frames, int64_t pts_ms);
+    const AudioStreamFormat& audio_format() const { return m_audio_encoder.format(); }
+    // 【修改】跳转后清空音频编码器、尚未发出的合并包和发送队列中的旧视频帧
+    void reset_send_path();
     virtual void cleanup();
     // 【新增】用于缩放的上下文和目标帧
     SwsContext* m_scaler_ctx = nullptr;
     AVFrame* m_scaled_frame = nullptr;
     // 【新增】跟踪当前编码器使用的分辨率
     int m_current_encoder_height = 0;
+    // 【新增】实时采集使用：关闭 B 帧与编码器内部的帧缓冲，每帧送入后立即取回码流
+    bool m_low_latency_encoder = false;
 private:
-    // 【新增】一个辅助函数专门用于发送单个数据报（可能是分片）
-    void SendDatagram(const uint8_t* data, uint32_t length);
+    // 【修改】一帧的数据报（分片或合并包）交给发送调度器，不再直接调用 DatagramSend
+    void enqueue_frame(SendPriority priority, std::vector<std::vector<uint8_t>> datagrams);
 
-    struct SendRequestContext {
-        QUIC_BUFFER QuicBuffer;
-        std::vector<uint8_t> Data;
+    // 【新增】小包合并：音频数据报先放入合并包，攒够 AUDIO_PACK_BUDGET_MS 的媒体时长或填满一个数据报后发出；
+    // 有待发音频且视频队列空闲时，放得下的单片非参考帧搭车后立即发出
+    void pack_audio_datagram(const std::vector<uint8_t>& datagram, int64_t pts, int duration_ms);
+    bool piggyback_datagram(const std::vector<uint8_t>& datagram, SendPriority priority);
+    void flush_pack_locked();
+    void flush_stale_pack();
+    // 【新增】周期性打印分片统计（每帧分片数、头部开销）与发送队列统计
+    void report_fragment_stats();
+    // 【新增】编码输出 pts 对应的帧已交给发送调度器后，发送它的 VideoTiming 数据报
+    void send_frame_timing(int64_t pts, std::chrono::steady_clock::time_point encoded);
+
+    // 【新增】已送入编码器、尚未输出的帧的时间记录，按 pts 递增
+    struct PendingFrameTiming {
+        int64_t pts;
+        FrameTiming timing;
+        std::chrono::steady_clock::time_point encode_started;
     };
+    std::deque<PendingFrameTiming> m_pending_timings;
 
 protected:
     const QUIC_API_TABLE* m_msquic;
     HQUIC m_connection;
 
+    // 【新增】发送调度器：优先级、截止时间丢帧，并负责释放发送上下文
+    SendScheduler m_send_scheduler;
+
     std::shared_ptr<StreamControlBlock> m_control_block;
     std::shared_ptr<AdaptiveStreamController> m_controller;
 
     AVCodecContext* m_video_encoder_ctx = nullptr;
     AVPacket* m_encoded_packet = nullptr;
 
+    // 【新增】音频编码阶段（原始 PCM 或 Opus）
+    AudioEncoder m_audio_encoder;
+
+    // 【新增】合并包状态；摄像头的音频、视频在不同线程发送，需加锁
+    std::mutex m_pack_mutex;
+    std::vector<uint8_t> m_pack_buffer;
+    uint16_t m_pack_records = 0;
+    std::vector<SendPriority> m_pack_priorities; // 【新增】每条记录的优先级，合并包过期时据此统计搭车视频的丢帧
+    int64_t m_pack_first_pts = 0;
+    std::chrono::steady_clock::time_point m_pack_started;
+    uint64_t m_packed_records_total = 0;
+    uint64_t m_pack_datagrams_total = 0;
+
+    // 【新增】分片统计；音频与视频可能在不同线程发送，计数用原子变量
+    std::atomic<uint64_t> m_stat_video_frames{ 0 };
+    std::atomic<uint64_t> m_stat_video_fragments{ 0 };
+    std::atomic<uint64_t> m_stat_datagrams{ 0 };
+    std::atomic<uint64_t> m_stat_header_bytes{ 0 };
+    std::atomic<uint64_t> m_stat_total_bytes{ 0 };
+    std::chrono::steady_clock::time_point m_stat_last_report = std::chrono::steady_clock::now();
+
     // 不再需要m_last_strategy和m_base_bitrate
     // StreamStrategy m_last_strategy = { 0.0, 0 };
     // int64_t m_base_bitrate = 1500 * 1024;
@@ -63,7 +134,17 @@ protected:
     int64_t m_last_set_bitrate = 0;
     int m_last_set_height = 0;
     int m_last_set_fps = 0;
-    // 定义一个安全的数据报负载大小阈值(MTU)
-    const uint32_t MAX_DATAGRAM_PAYLOAD_SIZE = 1200;
+
+    // 【新增】关键帧请求：客户端请求与发送调度器的请求合并，限制强制关键帧的频率
+    std::atomic<bool> m_keyframe_requested{ false };
+    bool m_force_keyframe_pending = false;
+    std::chrono::steady_clock::time_point m_last_forced_keyframe;
+    // 【新增】最近一个 IDR / 参考帧的序号，写入视频数据报头，供客户端发现整帧丢失
+    uint16_t m_reference_seq = 0;
+    bool m_intra_refresh = false;
+    // 【修改】数据报负载上限随连接的最大数据报长度（路径 MTU）变化；
+    // 收到 DATAGRAM_STATE_CHANGED 之前使用保守的默认值
+    static constexpr uint32_t DEFAULT_DATAGRAM_PAYLOAD_SIZE = 1200;
+    std::atomic<uint32_t> m_max_datagram_payload{ DEFAULT_DATAGRAM_PAYLOAD_SIZE };
 
 };
\ No newline at end of file
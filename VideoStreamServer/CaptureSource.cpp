@@ -0,0 +1,119 @@
+﻿#include "CaptureSource.h"
+#include "DeviceCaptureSource.h"
+#include "SyntheticCaptureSource.h"
+#include "FileReplaySource.h"
+#include <cstdlib>
+#include <cerrno>
+
+namespace {
+    constexpr const char* REPLAY_PREFIX = "replay:";
+    constexpr int MAX_DIMENSION = 7680;
+    constexpr int MAX_FPS = 240;
+
+    bool parse_int(const std::string& text, int min_value, int max_value, int& out)
+    {
+        if (text.empty()) return false;
+        char* end = nullptr;
+        errno = 0;
+        const long value = std::strtol(text.c_str(), &end, 10);
+        if (errno != 0 || *end != '\0' || value < min_value || value > max_value) return false;
+        out = static_cast<int>(value);
+        return true;
+    }
+}
+
+bool LiveSourceConfig::parse(const std::string& source, LiveSourceConfig& config, std::string& error)
+{
+    error.clear();
+    const size_t query_pos = source.find('?');
+    const std::string base = source.substr(0, query_pos);
+    const std::string query = query_pos == std::string::npos ? std::string() : source.substr(query_pos + 1);
+
+    LiveSourceConfig parsed;
+    const std::string replay_prefix = REPLAY_PREFIX;
+    if (base == "camera") {
+        parsed.video = Video::Camera;
+        parsed.audio = Audio::Microphone;
+    }
+    else if (base == "test_pattern") {
+        parsed.video = Video::TestPattern;
+        parsed.audio = Audio::Tone;
+    }
+    else if (base.compare(0, replay_prefix.size(), replay_prefix) == 0 && base.size() > replay_prefix.size()) {
+        parsed.video = Video::FileReplay;
+        parsed.audio = Audio::Tone;
+        parsed.path = base.substr(replay_prefix.size());
+    }
+    else {
+        return false; // 普通的点播文件
+    }
+
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+        const std::string item = query.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) continue;
+
+        const size_t eq = item.find('=');
+        const std::string key = item.substr(0, eq);
+        const std::string value = eq == std::string::npos ? std::string() : item.substr(eq + 1);
+        bool ok = true;
+        if (key == "width") {
+            ok = parse_int(value, 0, MAX_DIMENSION, parsed.width);
+            parsed.width &= ~1; // YUV420P 要求偶数
+        }
+        else if (key == "height") {
+            ok = parse_int(value, 0, MAX_DIMENSION, parsed.height);
+            parsed.height &= ~1;
+        }
+        else if (key == "fps") {
+            ok = parse_int(value, 0, MAX_FPS, parsed.fps);
+        }
+        else if (key == "device") {
+            ok = parse_int(value, 0, 64, parsed.device);
+        }
+        else if (key == "audio") {
+            if (value == "mic") parsed.audio = Audio::Microphone;
+            else if (value == "tone") parsed.audio = Audio::Tone;
+            else ok = false;
+        }
+        else if (key == "tone_hz") {
+            int hz = 0;
+            ok = parse_int(value, 20, 20000, hz);
+            parsed.tone_hz = hz;
+        }
+        else {
+            error = "未知的参数: " + key;
+            return false;
+        }
+        if (!ok) {
+            error = "参数取值无效: " + item;
+            return false;
+        }
+    }
+
+    config = parsed;
+    return true;
+}
+
+std::unique_ptr<IVideoSource> create_video_source(const LiveSourceConfig& config)
+{
+    switch (config.video) {
+    case LiveSourceConfig::Video::TestPattern:
+        return std::make_unique<TestPatternSource>(config.width, config.height, config.fps);
+    case LiveSourceConfig::Video::FileReplay:
+        return std::make_unique<FileReplaySource>(config.path, config.width, config.height, config.fps);
+    default:
+        return std::make_unique<CameraSource>(config.device, config.width, config.height, config.fps);
+    }
+}
+
+std::unique_ptr<IAudioSource> create_audio_source(const LiveSourceConfig& config)
+{
+    if (config.audio == LiveSourceConfig::Audio::Tone) {
+        return std::make_unique<ToneSource>(config.tone_hz);
+    }
+    return std::make_unique<MicrophoneSource>();
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include "AudioEncoder.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 直播推流的采集源：LiveStreamer 从视频源取帧、从音频源取样本，不关心它们来自设备还是合成
+// 数据源字符串（客户端 play 命令的 source）：
+//   camera[?device=0]                    摄像头 + 麦克风
+//   test_pattern                         运动测试图 + 测试音，不依赖任何设备
+//   replay:<videos 下的文件>              循环读取文件的视频轨，按实时节奏发出
+// 均可附加 width、height、fps（0 表示使用源本身的值）以及 audio=mic|tone、tone_hz，
+// 例如 test_pattern?width=1920&height=1080&fps=60
+struct LiveSourceConfig {
+    enum class Video { Camera, TestPattern, FileReplay };
+    enum class Audio { Microphone, Tone };
+
+    Video video = Video::Camera;
+    Audio audio = Audio::Microphone;
+    std::string path;        // FileReplay：文件路径
+    int device = 0;          // Camera：设备序号
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    double tone_hz = 440.0;  // Tone：基础音的频率
+
+    // 不是直播数据源时返回 false；参数无法解析时返回 false 并写入 error
+    static bool parse(const std::string& source, LiveSourceConfig& config, std::string& error);
+};
+
+// 视频源产出的一帧，数据在下一次 read() 之前有效
+struct VideoSourceFrame {
+    const uint8_t* data[4] = { nullptr, nullptr, nullptr, nullptr };
+    int linesize[4] = { 0, 0, 0, 0 };
+    int width = 0;
+    int height = 0;
+    int format = -1; // AVPixelFormat
+};
+
+class IVideoSource
+{
+public:
+    virtual ~IVideoSource() = default;
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    // 阻塞到下一帧就绪（按源自身的帧率），暂时取不到帧时返回 false
+    virtual bool read(VideoSourceFrame& frame) = 0;
+
+    // open() 之后有效：推流使用的分辨率，read() 返回的帧在转换时缩放到该尺寸
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    virtual const char* name() const = 0;
+};
+
+class IAudioSource
+{
+public:
+    virtual ~IAudioSource() = default;
+
+    // format 为协商出的音频格式，read() 按其采样率与声道数输出交织的 S16
+    virtual bool open(const AudioStreamFormat& format) = 0;
+    virtual void close() = 0;
+    // 阻塞到 frames 个采样就绪（按实时节奏），失败时返回 false
+    virtual bool read(int16_t* samples, int frames) = 0;
+    virtual const char* name() const = 0;
+};
+
+std::unique_ptr<IVideoSource> create_video_source(const LiveSourceConfig& config);
+std::unique_ptr<IAudioSource> create_audio_source(const LiveSourceConfig& config);
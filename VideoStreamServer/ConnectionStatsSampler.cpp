@@ -0,0 +1,110 @@
+﻿#define NOMINMAX
+#include "ConnectionStatsSampler.h"
+#include "AdaptiveStreamController.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    // 采样间隔：短于码率控制器的反应时间，又不至于每个 ACK 都读取一次
+    constexpr auto SAMPLE_INTERVAL = std::chrono::milliseconds(100);
+    // 统计汇总的打印间隔
+    constexpr auto SUMMARY_INTERVAL = std::chrono::seconds(5);
+}
+
+ConnectionStatsSampler::ConnectionStatsSampler(const QUIC_API_TABLE* msquic, HQUIC connection, std::shared_ptr<AdaptiveStreamController> controller)
+    : m_msquic(msquic),
+    m_connection(connection),
+    m_controller(std::move(controller)),
+    m_last_summary(Clock::now())
+{
+}
+
+#ifdef QUIC_API_ENABLE_PREVIEW_FEATURES
+void ConnectionStatsSampler::on_network_statistics(const QUIC_NETWORK_STATISTICS& stats)
+{
+    m_bytes_in_flight = stats.BytesInFlight;
+    m_posted_bytes = stats.PostedBytes;
+    // Bandwidth 单位为字节/秒
+    m_bandwidth_bps = stats.Bandwidth * 8;
+    maybe_sample(Clock::now());
+}
+#endif
+
+void ConnectionStatsSampler::on_datagram_send_state(QUIC_DATAGRAM_SEND_STATE state)
+{
+    if (state == QUIC_DATAGRAM_SEND_CANCELED) {
+        m_send_failures++;
+        m_send_failures_total++;
+    }
+    else if (state == QUIC_DATAGRAM_SEND_LOST_DISCARDED) {
+        m_datagrams_lost_total++;
+    }
+    maybe_sample(Clock::now());
+}
+
+void ConnectionStatsSampler::maybe_sample(Clock::time_point now)
+{
+    if (m_has_sample && now - m_last_sample < SAMPLE_INTERVAL) return;
+
+    QUIC_STATISTICS_V2 stats = {};
+    uint32_t size = sizeof(stats);
+    if (QUIC_FAILED(m_msquic->GetParam(m_connection, QUIC_PARAM_CONN_STATISTICS_V2, &size, &stats))) {
+        return;
+    }
+
+    // 丢包按 MsQuic 判定的疑似丢包扣除误判
+    const uint64_t lost_packets = stats.SendSuspectedLostPackets - std::min(stats.SendSuspectedLostPackets, stats.SendSpuriousLostPackets);
+    const double elapsed_sec = std::chrono::duration<double>(now - m_last_sample).count();
+
+    ConnectionStats sample;
+    sample.smoothed_rtt_us = stats.Rtt;
+    sample.min_rtt_us = stats.MinRtt;
+    sample.congestion_window = stats.SendCongestionWindow;
+    sample.bytes_in_flight = m_bytes_in_flight;
+    // 与 MsQuic 的 pacing 计算一致：一个 RTT 内发完一个拥塞窗口
+    if (stats.Rtt > 0) {
+        sample.pacing_rate_bps = static_cast<int64_t>(stats.SendCongestionWindow * 8 * 1000000ull / stats.Rtt);
+    }
+    sample.bandwidth_bps = static_cast<int64_t>(m_bandwidth_bps);
+    if (m_has_sample && elapsed_sec > 0.0) {
+        sample.send_rate_bps = static_cast<int64_t>((stats.SendTotalBytes - m_last_send_bytes) * 8 / elapsed_sec);
+        const uint64_t sent = stats.SendTotalPackets - m_last_send_packets;
+        if (sent > 0) {
+            sample.loss_rate = static_cast<double>(lost_packets - std::min(lost_packets, m_last_lost_packets)) / sent;
+        }
+    }
+    sample.datagram_send_failures = m_send_failures;
+
+    m_last_send_bytes = stats.SendTotalBytes;
+    m_last_send_packets = stats.SendTotalPackets;
+    m_last_lost_packets = lost_packets;
+    m_smoothed_rtt_us = stats.Rtt;
+    m_min_rtt_us = stats.MinRtt;
+    m_congestion_window = stats.SendCongestionWindow;
+    const bool first_sample = !m_has_sample;
+    m_has_sample = true;
+    m_last_sample = now;
+
+    // 第一次采样只建立基准，增量从下一次开始有效
+    if (!first_sample) {
+        m_controller->on_connection_stats(sample);
+    }
+
+    if (now - m_last_summary >= SUMMARY_INTERVAL) {
+        m_last_summary = now;
+        print_summary(sample.pacing_rate_bps, sample.send_rate_bps, sample.loss_rate);
+    }
+    m_send_failures = 0;
+}
+
+void ConnectionStatsSampler::print_summary(int64_t pacing_rate_bps, int64_t send_rate_bps, double loss_rate)
+{
+    std::cout << "[连接统计] RTT " << m_smoothed_rtt_us / 1000.0 << " ms (最小 " << m_min_rtt_us / 1000.0
+        << " ms), cwnd " << m_congestion_window / 1024 << " KB, 在途 " << m_bytes_in_flight / 1024
+        << " KB, 待发 " << m_posted_bytes / 1024 << " KB, pacing " << pacing_rate_bps / 1024
+        << " kbps, 带宽估计 " << m_bandwidth_bps / 1024 << " kbps, 发送 " << send_rate_bps / 1024
+        << " kbps, 丢包 " << std::fixed << std::setprecision(1) << loss_rate * 100.0
+        << "%, 数据报丢失累计 " << m_datagrams_lost_total << ", 发送失败累计 " << m_send_failures_total << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <msquic.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+class AdaptiveStreamController;
+
+// 每个连接一个的统计采样器：定期读取 QUIC_PARAM_CONN_STATISTICS_V2，结合 NETWORK_STATISTICS 事件
+// （在途字节、拥塞窗口、带宽估计）与数据报发送结果，汇总成 ConnectionStats 交给码率控制器
+//
+// 只在该连接的回调中调用：回调运行在连接所属的工作线程上，GetParam 可直接执行而不必排队等待，
+// 因此无需单独的采样线程，也不会在关闭连接时与工作线程互相等待。没有回调就不采样，此时连接也没有在发送
+class ConnectionStatsSampler
+{
+public:
+    ConnectionStatsSampler(const QUIC_API_TABLE* msquic, HQUIC connection, std::shared_ptr<AdaptiveStreamController> controller);
+
+#ifdef QUIC_API_ENABLE_PREVIEW_FEATURES
+    void on_network_statistics(const QUIC_NETWORK_STATISTICS& stats);
+#endif
+    // DATAGRAM_SEND_STATE_CHANGED：CANCELED 计为发送失败（MsQuic 未能发出而丢弃）
+    void on_datagram_send_state(QUIC_DATAGRAM_SEND_STATE state);
+
+    ConnectionStatsSampler(const ConnectionStatsSampler&) = delete;
+    ConnectionStatsSampler& operator=(const ConnectionStatsSampler&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 距上次采样超过间隔时读取统计并上报
+    void maybe_sample(Clock::time_point now);
+    void print_summary(int64_t pacing_rate_bps, int64_t send_rate_bps, double loss_rate);
+
+    const QUIC_API_TABLE* m_msquic;
+    HQUIC m_connection;
+    std::shared_ptr<AdaptiveStreamController> m_controller;
+
+    Clock::time_point m_last_sample;
+    Clock::time_point m_last_summary;
+    bool m_has_sample = false;
+
+    // 上次采样时的累计值，用于计算区间内的增量
+    uint64_t m_last_send_bytes = 0;
+    uint64_t m_last_send_packets = 0;
+    uint64_t m_last_lost_packets = 0;
+
+    // 来自 NETWORK_STATISTICS 事件的最新值
+    uint64_t m_bytes_in_flight = 0;
+    uint64_t m_posted_bytes = 0;
+    uint64_t m_bandwidth_bps = 0;
+
+    // 区间内的数据报发送结果
+    uint32_t m_send_failures = 0;
+    uint64_t m_send_failures_total = 0;
+    uint64_t m_datagrams_lost_total = 0;
+
+    // 最近一次采样，供打印
+    uint64_t m_smoothed_rtt_us = 0;
+    uint64_t m_min_rtt_us = 0;
+    uint64_t m_congestion_window = 0;
+};
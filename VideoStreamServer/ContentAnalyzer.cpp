@@ -0,0 +1,361 @@
+﻿#define NOMINMAX
+#include "ContentAnalyzer.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 阶梯文件格式或分析算法变化时递增，旧文件会被重新生成
+    constexpr int LADDER_FILE_VERSION = 1;
+    constexpr const char* LADDER_FILE_SUFFIX = ".ladder.json";
+
+    // 在片源的 5 个位置各分析 2 秒，片头片尾往往不具代表性
+    constexpr int ANALYSIS_WINDOWS = 5;
+    constexpr double ANALYSIS_WINDOW_SEC = 2.0;
+    // 分析在首次播放前同步进行，超过该时长即用已有的样本
+    constexpr auto ANALYSIS_TIME_BUDGET = std::chrono::seconds(3);
+    constexpr int MIN_ANALYZED_FRAMES = 10;
+    // 缩小到该宽度再计算，SI/TI 不随源分辨率变化，计算量也可忽略
+    constexpr int ANALYSIS_WIDTH = 480;
+    constexpr double ANALYSIS_PERCENTILE = 0.9;
+
+    // 默认阶梯对应的"中等复杂度"（P.910 常见测试序列的中间值）
+    constexpr double REFERENCE_SI = 60.0;
+    constexpr double REFERENCE_TI = 15.0;
+    // TI 接近 0 时避免码率被压得过低
+    constexpr double TI_OFFSET = 5.0;
+    constexpr double MIN_COMPLEXITY_SCALE = 0.4;
+    constexpr double MAX_COMPLEXITY_SCALE = 1.6;
+    // TI 低于该值视为静态内容（幻灯片、讲座），高帧率没有意义
+    constexpr double LOW_MOTION_TI = 3.0;
+    constexpr int LOW_MOTION_MAX_FPS = 30;
+
+    double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty()) return 0.0;
+        const size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    std::string ladder_path(const std::string& video_path)
+    {
+        return video_path + LADDER_FILE_SUFFIX;
+    }
+
+    // 视频的大小与修改时间，用于判断阶梯文件是否过期
+    nlohmann::json source_signature(const std::string& video_path)
+    {
+        std::error_code ec;
+        const fs::path path = fs::u8path(video_path);
+        const auto size = fs::file_size(path, ec);
+        if (ec) return nullptr;
+        const auto mtime = fs::last_write_time(path, ec);
+        if (ec) return nullptr;
+        return {
+            { "size", static_cast<uint64_t>(size) },
+            { "mtime", static_cast<int64_t>(mtime.time_since_epoch().count()) }
+        };
+    }
+
+    std::vector<QualityLevel> parse_levels(const nlohmann::json& levels_json)
+    {
+        std::vector<QualityLevel> levels;
+        for (const auto& item : levels_json) {
+            QualityLevel level;
+            level.height = item.at("height").get<int>();
+            level.width = item.at("width").get<int>();
+            level.target_fps = item.at("fps").get<int>();
+            level.min_bitrate_bps = item.at("min_kbps").get<int64_t>() * 1024;
+            level.max_bitrate_bps = item.at("max_kbps").get<int64_t>() * 1024;
+            level.start_bitrate_bps = item.at("start_kbps").get<int64_t>() * 1024;
+            levels.push_back(level);
+        }
+        return levels;
+    }
+
+    void print_ladder(const ContentComplexity& complexity, const std::vector<QualityLevel>& levels)
+    {
+        std::cout << "[内容分析] SI " << complexity.spatial_info << ", TI " << complexity.temporal_info
+            << " (" << complexity.frames_analyzed << " 帧), 码率阶梯:";
+        for (const auto& level : levels) {
+            std::cout << " " << level.height << "p@" << level.target_fps << " " << level.start_bitrate_bps / 1024
+                << "[" << level.min_bitrate_bps / 1024 << "-" << level.max_bitrate_bps / 1024 << "]";
+        }
+        std::cout << " kbps" << std::endl;
+    }
+}
+
+std::vector<QualityLevel> ContentAnalyzer::load_or_build_ladder(const std::string& video_path)
+{
+    const nlohmann::json signature = source_signature(video_path);
+    const std::string path = ladder_path(video_path);
+
+    std::ifstream ladder_file(fs::u8path(path));
+    if (ladder_file.is_open()) {
+        try {
+            nlohmann::json ladder_json;
+            ladder_file >> ladder_json;
+            if (ladder_json.value("version", 0) == LADDER_FILE_VERSION && ladder_json.value("source", nlohmann::json()) == signature) {
+                std::vector<QualityLevel> levels = parse_levels(ladder_json.at("levels"));
+                if (!levels.empty()) {
+                    ContentComplexity complexity;
+                    complexity.spatial_info = ladder_json.value("si", 0.0);
+                    complexity.temporal_info = ladder_json.value("ti", 0.0);
+                    complexity.frames_analyzed = ladder_json.value("frames", 0);
+                    print_ladder(complexity, levels);
+                    return levels;
+                }
+            }
+        }
+        catch (const nlohmann::json::exception& e) {
+            std::cerr << "[内容分析] 阶梯文件无效，重新分析: " << e.what() << std::endl;
+        }
+        ladder_file.close();
+    }
+
+    ContentComplexity complexity;
+    const auto analysis_start = std::chrono::steady_clock::now();
+    if (!analyze(video_path, complexity)) {
+        std::cerr << "[内容分析] 分析失败，使用默认码率阶梯。" << std::endl;
+        return {};
+    }
+    const std::vector<QualityLevel> levels = build_ladder(complexity);
+    std::cout << "[内容分析] 分析耗时 " << std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - analysis_start).count() << " ms" << std::endl;
+    print_ladder(complexity, levels);
+
+    nlohmann::json ladder_json;
+    ladder_json["version"] = LADDER_FILE_VERSION;
+    ladder_json["source"] = signature;
+    ladder_json["si"] = complexity.spatial_info;
+    ladder_json["ti"] = complexity.temporal_info;
+    ladder_json["fps"] = complexity.fps;
+    ladder_json["frames"] = complexity.frames_analyzed;
+    ladder_json["levels"] = nlohmann::json::array();
+    for (const auto& level : levels) {
+        ladder_json["levels"].push_back({
+            { "height", level.height },
+            { "width", level.width },
+            { "fps", level.target_fps },
+            { "min_kbps", level.min_bitrate_bps / 1024 },
+            { "max_kbps", level.max_bitrate_bps / 1024 },
+            { "start_kbps", level.start_bitrate_bps / 1024 }
+        });
+    }
+
+    // 先写临时文件再替换，避免留下写了一半的阶梯文件
+    const fs::path temp_path = fs::u8path(path + ".tmp");
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (out.is_open()) {
+            out << ladder_json.dump(2);
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp_path, fs::u8path(path), ec);
+    if (ec) {
+        std::cerr << "[内容分析] 无法写入阶梯文件 " << path << ": " << ec.message() << std::endl;
+        fs::remove(temp_path, ec);
+    }
+    return levels;
+}
+
+bool ContentAnalyzer::analyze(const std::string& video_path, ContentComplexity& complexity)
+{
+    AVFormatContext* format_ctx = nullptr;
+    if (avformat_open_input(&format_ctx, video_path.c_str(), nullptr, nullptr) != 0) return false;
+    if (avformat_find_stream_info(format_ctx, nullptr) < 0) {
+        avformat_close_input(&format_ctx);
+        return false;
+    }
+
+    const AVCodec* decoder = nullptr;
+    const int stream_index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    AVCodecContext* decoder_ctx = stream_index >= 0 ? avcodec_alloc_context3(decoder) : nullptr;
+    if (!decoder_ctx) {
+        avformat_close_input(&format_ctx);
+        return false;
+    }
+    AVStream* stream = format_ctx->streams[stream_index];
+    avcodec_parameters_to_context(decoder_ctx, stream->codecpar);
+    decoder_ctx->thread_count = 0; // 自动选择线程数
+    if (avcodec_open2(decoder_ctx, decoder, nullptr) < 0 || decoder_ctx->width <= 0 || decoder_ctx->height <= 0) {
+        avcodec_free_context(&decoder_ctx);
+        avformat_close_input(&format_ctx);
+        return false;
+    }
+
+    const AVRational frame_rate = av_guess_frame_rate(format_ctx, stream, nullptr);
+    complexity.fps = frame_rate.num > 0 && frame_rate.den > 0 ? av_q2d(frame_rate) : 0.0;
+
+    // 缩小后的灰度图，高度按比例并取偶数
+    const int width = std::min(ANALYSIS_WIDTH, decoder_ctx->width);
+    const int height = std::max(2, (decoder_ctx->height * width / decoder_ctx->width) & ~1);
+    std::vector<uint8_t> luma(static_cast<size_t>(width) * height);
+    std::vector<uint8_t> prev_luma(luma.size());
+    SwsContext* sws_ctx = nullptr;
+
+    // 时长已知且足够长时，在片源的各个位置取样；否则从头连续分析
+    const double duration_sec = format_ctx->duration != AV_NOPTS_VALUE ? static_cast<double>(format_ctx->duration) / AV_TIME_BASE : 0.0;
+    std::vector<double> window_starts;
+    if (duration_sec > ANALYSIS_WINDOWS * ANALYSIS_WINDOW_SEC * 2) {
+        for (int i = 0; i < ANALYSIS_WINDOWS; ++i) {
+            window_starts.push_back(duration_sec * (i + 0.5) / ANALYSIS_WINDOWS - ANALYSIS_WINDOW_SEC / 2);
+        }
+    }
+    else {
+        window_starts.push_back(0.0);
+    }
+    const double window_length = window_starts.size() > 1 ? ANALYSIS_WINDOW_SEC : ANALYSIS_WINDOWS * ANALYSIS_WINDOW_SEC;
+
+    std::vector<double> si_values;
+    std::vector<double> ti_values;
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    const auto deadline = std::chrono::steady_clock::now() + ANALYSIS_TIME_BUDGET;
+    bool out_of_time = false;
+
+    for (double window_start : window_starts) {
+        if (out_of_time) break;
+        if (window_start > 0.0) {
+            const int64_t target = static_cast<int64_t>(window_start / av_q2d(stream->time_base));
+            if (av_seek_frame(format_ctx, stream_index, target, AVSEEK_FLAG_BACKWARD) < 0) continue;
+        }
+        avcodec_flush_buffers(decoder_ctx);
+
+        bool has_prev = false;
+        bool window_done = false;
+        while (!window_done && av_read_frame(format_ctx, packet) >= 0) {
+            if (packet->stream_index == stream_index && avcodec_send_packet(decoder_ctx, packet) >= 0) {
+                while (avcodec_receive_frame(decoder_ctx, frame) >= 0) {
+                    const int64_t pts = frame->best_effort_timestamp;
+                    const double time_sec = pts != AV_NOPTS_VALUE ? pts * av_q2d(stream->time_base) : window_start;
+                    // 向前寻址落在关键帧上，跳过窗口之前的帧
+                    if (time_sec + 1e-3 < window_start) continue;
+                    if (time_sec >= window_start + window_length) {
+                        window_done = true;
+                        break;
+                    }
+
+                    sws_ctx = sws_getCachedContext(sws_ctx, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                        width, height, AV_PIX_FMT_GRAY8, SWS_AREA, nullptr, nullptr, nullptr);
+                    if (!sws_ctx) {
+                        window_done = true;
+                        break;
+                    }
+                    uint8_t* dst[4] = { luma.data(), nullptr, nullptr, nullptr };
+                    int dst_stride[4] = { width, 0, 0, 0 };
+                    sws_scale(sws_ctx, frame->data, frame->linesize, 0, frame->height, dst, dst_stride);
+
+                    si_values.push_back(spatial_info(luma.data(), width, height, width));
+                    if (has_prev) {
+                        ti_values.push_back(temporal_info(luma.data(), prev_luma.data(), width, height, width));
+                    }
+                    std::swap(luma, prev_luma);
+                    has_prev = true;
+                }
+            }
+            av_packet_unref(packet);
+            if (std::chrono::steady_clock::now() > deadline && static_cast<int>(si_values.size()) >= MIN_ANALYZED_FRAMES) {
+                out_of_time = true;
+                break;
+            }
+        }
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    sws_freeContext(sws_ctx);
+    avcodec_free_context(&decoder_ctx);
+    avformat_close_input(&format_ctx);
+
+    if (static_cast<int>(si_values.size()) < MIN_ANALYZED_FRAMES) return false;
+    complexity.spatial_info = percentile(si_values, ANALYSIS_PERCENTILE);
+    complexity.temporal_info = percentile(ti_values, ANALYSIS_PERCENTILE);
+    complexity.frames_analyzed = static_cast<int>(si_values.size());
+    return true;
+}
+
+std::vector<QualityLevel> ContentAnalyzer::build_ladder(const ContentComplexity& complexity)
+{
+    // 空间与时间复杂度各占一半权重（几何平均），相对默认阶梯的基准内容缩放
+    const double spatial_scale = std::max(complexity.spatial_info, 1.0) / REFERENCE_SI;
+    const double temporal_scale = (complexity.temporal_info + TI_OFFSET) / (REFERENCE_TI + TI_OFFSET);
+    const double scale = std::clamp(std::sqrt(spatial_scale * temporal_scale), MIN_COMPLEXITY_SCALE, MAX_COMPLEXITY_SCALE);
+
+    int max_fps = complexity.fps > 0.0 ? static_cast<int>(std::lround(complexity.fps)) : 0;
+    if (complexity.temporal_info < LOW_MOTION_TI) {
+        max_fps = max_fps > 0 ? std::min(max_fps, LOW_MOTION_MAX_FPS) : LOW_MOTION_MAX_FPS;
+    }
+
+    auto scaled = [scale](int64_t bitrate_bps) {
+        // 按 kbps 取整，与阶梯文件的单位一致
+        return static_cast<int64_t>(std::llround(bitrate_bps * scale / 1024.0)) * 1024;
+    };
+
+    std::vector<QualityLevel> levels = AdaptiveStreamController::default_quality_levels();
+    for (auto& level : levels) {
+        level.min_bitrate_bps = scaled(level.min_bitrate_bps);
+        level.max_bitrate_bps = scaled(level.max_bitrate_bps);
+        level.start_bitrate_bps = scaled(level.start_bitrate_bps);
+        if (max_fps > 0) {
+            level.target_fps = std::min(level.target_fps, max_fps);
+        }
+    }
+    return levels;
+}
+
+double ContentAnalyzer::spatial_info(const uint8_t* luma, int width, int height, int stride)
+{
+    if (width < 3 || height < 3) return 0.0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (int y = 1; y < height - 1; ++y) {
+        const uint8_t* above = luma + (y - 1) * stride;
+        const uint8_t* row = luma + y * stride;
+        const uint8_t* below = luma + (y + 1) * stride;
+        for (int x = 1; x < width - 1; ++x) {
+            const int gx = (above[x + 1] + 2 * row[x + 1] + below[x + 1]) - (above[x - 1] + 2 * row[x - 1] + below[x - 1]);
+            const int gy = (below[x - 1] + 2 * below[x] + below[x + 1]) - (above[x - 1] + 2 * above[x] + above[x + 1]);
+            const double magnitude = std::sqrt(static_cast<double>(gx * gx + gy * gy));
+            sum += magnitude;
+            sum_sq += magnitude * magnitude;
+        }
+    }
+    const double count = static_cast<double>(width - 2) * (height - 2);
+    const double mean = sum / count;
+    return std::sqrt(std::max(0.0, sum_sq / count - mean * mean));
+}
+
+double ContentAnalyzer::temporal_info(const uint8_t* luma, const uint8_t* prev_luma, int width, int height, int stride)
+{
+    if (width <= 0 || height <= 0) return 0.0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = luma + y * stride;
+        const uint8_t* prev_row = prev_luma + y * stride;
+        for (int x = 0; x < width; ++x) {
+            const double diff = static_cast<double>(row[x]) - prev_row[x];
+            sum += diff;
+            sum_sq += diff * diff;
+        }
+    }
+    const double count = static_cast<double>(width) * height;
+    const double mean = sum / count;
+    return std::sqrt(std::max(0.0, sum_sq / count - mean * mean));
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "AdaptiveStreamController.h"
+#include <string>
+#include <vector>
+
+// 一个片源的内容复杂度（ITU-T P.910）
+struct ContentComplexity {
+    double spatial_info = 0.0;  // SI：亮度 Sobel 梯度幅值的标准差，取各帧的 90 分位
+    double temporal_info = 0.0; // TI：相邻帧亮度差的标准差，取各帧的 90 分位
+    double fps = 0.0;           // 源帧率，未知时为 0
+    int frames_analyzed = 0;
+};
+
+// 按片源生成码率阶梯：从片源各处抽取几段解码，测量 SI/TI，
+// 按复杂度缩放默认阶梯的码率（卡通、幻灯片省码率，体育等高复杂度内容给足码率），
+// 低运动内容把帧率限制在 30fps。结果写在视频旁边的 <文件名>.ladder.json，之后直接读取
+class ContentAnalyzer
+{
+public:
+    // 读取阶梯文件；不存在、版本不符或视频已更新时重新分析并写回。
+    // 分析失败返回空列表，控制器使用默认阶梯
+    static std::vector<QualityLevel> load_or_build_ladder(const std::string& video_path);
+
+    static bool analyze(const std::string& video_path, ContentComplexity& complexity);
+    static std::vector<QualityLevel> build_ladder(const ContentComplexity& complexity);
+
+    // 8 位亮度平面的 SI/TI，供 analyze 使用
+    static double spatial_info(const uint8_t* luma, int width, int height, int stride);
+    static double temporal_info(const uint8_t* luma, const uint8_t* prev_luma, int width, int height, int stride);
+};
@@ -0,0 +1,131 @@
+﻿#define NOMINMAX
+#include "DeviceCaptureSource.h"
+#include <iostream>
+#include <algorithm>
+#include <opencv2/videoio.hpp>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+CameraSource::CameraSource(int device, int width, int height, int fps)
+    : m_device(device), m_requested_width(width), m_requested_height(height), m_requested_fps(fps)
+{
+}
+
+CameraSource::~CameraSource() {
+    close();
+}
+
+bool CameraSource::open() {
+    m_video_capture = std::make_unique<cv::VideoCapture>(m_device);
+    if (!m_video_capture->isOpened()) {
+        std::cerr << "[采集源] 无法打开摄像头 " << m_device << std::endl;
+        return false;
+    }
+    if (m_requested_width > 0 && m_requested_height > 0) {
+        m_video_capture->set(cv::CAP_PROP_FRAME_WIDTH, m_requested_width);
+        m_video_capture->set(cv::CAP_PROP_FRAME_HEIGHT, m_requested_height);
+    }
+    if (m_requested_fps > 0) {
+        m_video_capture->set(cv::CAP_PROP_FPS, m_requested_fps);
+    }
+    // 驱动只缓存一帧，read() 取到的总是最新的画面（后端不支持时忽略）
+    m_video_capture->set(cv::CAP_PROP_BUFFERSIZE, 1);
+
+    const int device_width = static_cast<int>(m_video_capture->get(cv::CAP_PROP_FRAME_WIDTH));
+    const int device_height = static_cast<int>(m_video_capture->get(cv::CAP_PROP_FRAME_HEIGHT));
+    m_output_width = (m_requested_width > 0 && m_requested_height > 0) ? m_requested_width : (device_width & ~1);
+    m_output_height = (m_requested_width > 0 && m_requested_height > 0) ? m_requested_height : (device_height & ~1);
+    if (m_output_width <= 0 || m_output_height <= 0) {
+        std::cerr << "[采集源] 摄像头 " << m_device << " 未报告有效的分辨率。" << std::endl;
+        return false;
+    }
+    std::cout << "[采集源] 摄像头 " << m_device << ": " << device_width << "x" << device_height
+        << " @ " << m_video_capture->get(cv::CAP_PROP_FPS) << " fps, 推流 " << m_output_width << "x" << m_output_height << std::endl;
+    return true;
+}
+
+void CameraSource::close() {
+    if (m_video_capture && m_video_capture->isOpened()) {
+        m_video_capture->release();
+    }
+    m_video_capture.reset();
+}
+
+bool CameraSource::read(VideoSourceFrame& frame) {
+    if (!m_video_capture || !m_video_capture->isOpened() || !m_video_capture->read(m_bgr_frame) || m_bgr_frame.empty()) {
+        return false;
+    }
+    frame = VideoSourceFrame();
+    frame.data[0] = m_bgr_frame.data;
+    frame.linesize[0] = static_cast<int>(m_bgr_frame.step[0]);
+    frame.width = m_bgr_frame.cols;
+    frame.height = m_bgr_frame.rows;
+    frame.format = AV_PIX_FMT_BGR24;
+    return true;
+}
+
+MicrophoneSource::~MicrophoneSource() {
+    close();
+}
+
+bool MicrophoneSource::open(const AudioStreamFormat& format) {
+    if (Pa_Initialize() != paNoError) return false;
+    m_pa_initialized = true;
+
+    // 按协商格式采集；多数麦克风只有单声道，超出设备能力的声道在 read() 中复制
+    m_channels = format.channels;
+    m_capture_channels = format.channels;
+    const PaDeviceIndex device = Pa_GetDefaultInputDevice();
+    if (device != paNoDevice) {
+        m_capture_channels = std::max(1, std::min(format.channels, Pa_GetDeviceInfo(device)->maxInputChannels));
+    }
+    if (Pa_OpenDefaultStream(&m_audio_stream, m_capture_channels, 0, paInt16, format.sample_rate, format.frame_samples, nullptr, nullptr) != paNoError) {
+        m_audio_stream = nullptr;
+        return false;
+    }
+    if (Pa_StartStream(m_audio_stream) != paNoError) {
+        std::cerr << "[采集源] 错误: 无法启动 PortAudio 流。" << std::endl;
+        return false;
+    }
+    m_capture_buffer.assign(static_cast<size_t>(format.frame_samples) * m_capture_channels, 0);
+    return true;
+}
+
+void MicrophoneSource::close() {
+    if (m_audio_stream) {
+        if (Pa_IsStreamActive(m_audio_stream) > 0) { // Pa_IsStreamActive 返回 1 表示活跃, 0 不活跃, < 0 错误
+            Pa_StopStream(m_audio_stream);
+        }
+        Pa_CloseStream(m_audio_stream);
+        m_audio_stream = nullptr;
+    }
+    if (m_pa_initialized) {
+        Pa_Terminate();
+        m_pa_initialized = false;
+    }
+}
+
+bool MicrophoneSource::read(int16_t* samples, int frames) {
+    if (!m_audio_stream) return false;
+    if (m_capture_channels >= m_channels) {
+        const PaError err = Pa_ReadStream(m_audio_stream, samples, frames);
+        return err == paNoError || err == paInputOverflowed;
+    }
+
+    const size_t needed = static_cast<size_t>(frames) * m_capture_channels;
+    if (m_capture_buffer.size() < needed) {
+        m_capture_buffer.resize(needed);
+    }
+    const PaError err = Pa_ReadStream(m_audio_stream, m_capture_buffer.data(), frames);
+    if (err != paNoError && err != paInputOverflowed) {
+        return false;
+    }
+    for (int i = 0; i < frames; ++i) {
+        for (int c = 0; c < m_channels; ++c) {
+            samples[i * m_channels + c] = m_capture_buffer[i * m_capture_channels + std::min(c, m_capture_channels - 1)];
+        }
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include "CaptureSource.h"
+#include <opencv2/core.hpp>
+#include <portaudio.h>
+#include <vector>
+
+namespace cv { class VideoCapture; }
+
+// 摄像头（OpenCV），帧率由设备决定
+class CameraSource final : public IVideoSource
+{
+public:
+    // width/height/fps 为 0 时使用设备默认值；否则作为请求交给驱动，驱动做不到的分辨率在转换时缩放
+    CameraSource(int device, int width, int height, int fps);
+    ~CameraSource() override;
+
+    bool open() override;
+    void close() override;
+    bool read(VideoSourceFrame& frame) override;
+
+    int width() const override { return m_output_width; }
+    int height() const override { return m_output_height; }
+    const char* name() const override { return "摄像头"; }
+
+private:
+    int m_device;
+    int m_requested_width;
+    int m_requested_height;
+    int m_requested_fps;
+    int m_output_width = 0;
+    int m_output_height = 0;
+
+    std::unique_ptr<cv::VideoCapture> m_video_capture;
+    cv::Mat m_bgr_frame;
+};
+
+// 默认输入设备的麦克风（PortAudio）
+class MicrophoneSource final : public IAudioSource
+{
+public:
+    MicrophoneSource() = default;
+    ~MicrophoneSource() override;
+
+    bool open(const AudioStreamFormat& format) override;
+    void close() override;
+    bool read(int16_t* samples, int frames) override;
+    const char* name() const override { return "麦克风"; }
+
+private:
+    PaStream* m_audio_stream = nullptr;
+    bool m_pa_initialized = false;
+    int m_channels = 1;
+    // 麦克风实际采集的声道数，少于协商的声道数时复制成多声道
+    int m_capture_channels = 1;
+    std::vector<int16_t> m_capture_buffer;
+};
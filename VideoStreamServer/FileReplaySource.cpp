@@ -0,0 +1,157 @@
+﻿#define NOMINMAX
+#include "FileReplaySource.h"
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+    constexpr double DEFAULT_FPS = 30.0;
+    constexpr double MAX_FPS = 240.0;
+}
+
+FileReplaySource::FileReplaySource(const std::string& path, int width, int height, int fps)
+    : m_path(path), m_requested_width(width), m_requested_height(height), m_requested_fps(fps)
+{
+}
+
+FileReplaySource::~FileReplaySource() {
+    close();
+}
+
+bool FileReplaySource::open() {
+    if (avformat_open_input(&m_format_ctx, m_path.c_str(), nullptr, nullptr) != 0) {
+        std::cerr << "[采集源] 无法打开回放文件: " << m_path << std::endl;
+        return false;
+    }
+    if (avformat_find_stream_info(m_format_ctx, nullptr) < 0) return false;
+
+    const AVCodec* decoder = nullptr;
+    m_stream_index = av_find_best_stream(m_format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    if (m_stream_index < 0 || !decoder) {
+        std::cerr << "[采集源] 回放文件中没有可解码的视频轨: " << m_path << std::endl;
+        return false;
+    }
+    AVStream* stream = m_format_ctx->streams[m_stream_index];
+    m_decoder_ctx = avcodec_alloc_context3(decoder);
+    if (!m_decoder_ctx) return false;
+    avcodec_parameters_to_context(m_decoder_ctx, stream->codecpar);
+    if (avcodec_open2(m_decoder_ctx, decoder, nullptr) < 0) return false;
+
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    if (!m_packet || !m_frame) return false;
+
+    m_fps = DEFAULT_FPS;
+    if (m_requested_fps > 0) {
+        m_fps = m_requested_fps;
+    }
+    else if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0) {
+        m_fps = std::min(MAX_FPS, av_q2d(stream->avg_frame_rate));
+    }
+    const bool sized = m_requested_width > 0 && m_requested_height > 0;
+    m_output_width = sized ? m_requested_width : (m_decoder_ctx->width & ~1);
+    m_output_height = sized ? m_requested_height : (m_decoder_ctx->height & ~1);
+    if (m_output_width <= 0 || m_output_height <= 0) return false;
+
+    m_draining = false;
+    m_decoded_since_rewind = false;
+    m_loop_count = 0;
+    m_frame_index = 0;
+    std::cout << "[采集源] 回放 " << m_path << ": " << m_decoder_ctx->width << "x" << m_decoder_ctx->height
+        << ", 推流 " << m_output_width << "x" << m_output_height << " @ " << m_fps << " fps" << std::endl;
+    return true;
+}
+
+void FileReplaySource::close() {
+    if (m_frame) { av_frame_free(&m_frame); }
+    if (m_packet) { av_packet_free(&m_packet); }
+    if (m_decoder_ctx) { avcodec_free_context(&m_decoder_ctx); }
+    if (m_format_ctx) { avformat_close_input(&m_format_ctx); }
+    m_stream_index = -1;
+}
+
+bool FileReplaySource::read(VideoSourceFrame& frame) {
+    if (!m_decoder_ctx) return false;
+
+    // 与测试图相同的节奏：第 n 帧在 m_start + n / fps 时交付，落后超过一帧时重新计时
+    const auto now = Clock::now();
+    if (m_frame_index == 0) {
+        m_start = now;
+    }
+    const auto interval = std::chrono::microseconds(static_cast<int64_t>(1000000 / m_fps));
+    auto due = m_start + std::chrono::microseconds(static_cast<int64_t>(m_frame_index * 1000000 / m_fps));
+    if (now - due > interval) {
+        m_start += now - due;
+        due = now;
+    }
+    std::this_thread::sleep_until(due);
+    m_frame_index++;
+
+    if (!decode_next_frame()) return false;
+
+    frame = VideoSourceFrame();
+    for (int i = 0; i < 4; ++i) {
+        frame.data[i] = m_frame->data[i];
+        frame.linesize[i] = m_frame->linesize[i];
+    }
+    frame.width = m_frame->width;
+    frame.height = m_frame->height;
+    frame.format = m_frame->format;
+    return true;
+}
+
+bool FileReplaySource::decode_next_frame() {
+    while (true) {
+        const int ret = avcodec_receive_frame(m_decoder_ctx, m_frame);
+        if (ret == 0) {
+            m_decoded_since_rewind = true;
+            return true;
+        }
+        if (ret == AVERROR_EOF) {
+            if (!rewind()) return false;
+            continue;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            return false;
+        }
+        if (m_draining) {
+            return false; // 排空中的解码器只应返回帧或 EOF
+        }
+
+        if (av_read_frame(m_format_ctx, m_packet) < 0) {
+            // 文件读完：送入空包，取出解码器中剩余的帧
+            m_draining = true;
+            avcodec_send_packet(m_decoder_ctx, nullptr);
+            continue;
+        }
+        if (m_packet->stream_index == m_stream_index) {
+            avcodec_send_packet(m_decoder_ctx, m_packet);
+        }
+        av_packet_unref(m_packet);
+    }
+}
+
+bool FileReplaySource::rewind() {
+    // 一整轮都没有解出帧的文件无法循环，避免空转
+    if (!m_decoded_since_rewind) {
+        std::cerr << "[采集源] 回放文件无法解码出视频帧: " << m_path << std::endl;
+        return false;
+    }
+    const AVStream* stream = m_format_ctx->streams[m_stream_index];
+    const int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (av_seek_frame(m_format_ctx, m_stream_index, start, AVSEEK_FLAG_BACKWARD) < 0) {
+        std::cerr << "[采集源] 回放文件无法回到开头: " << m_path << std::endl;
+        return false;
+    }
+    avcodec_flush_buffers(m_decoder_ctx);
+    m_draining = false;
+    m_decoded_since_rewind = false;
+    m_loop_count++;
+    std::cout << "[采集源] 回放 " << m_path << " 第 " << m_loop_count << " 次循环。" << std::endl;
+    return true;
+}
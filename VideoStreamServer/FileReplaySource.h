@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "CaptureSource.h"
+#include <chrono>
+#include <string>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+// 把文件的视频轨当作实时源：软件解码，按固定帧率交付，到结尾后回到开头循环。
+// 文件本身的时间戳只用来确定默认帧率，推流的时间戳仍由 LiveStreamer 按交付时刻生成
+class FileReplaySource final : public IVideoSource
+{
+public:
+    // width/height/fps 为 0 时使用文件本身的值
+    FileReplaySource(const std::string& path, int width, int height, int fps);
+    ~FileReplaySource() override;
+
+    bool open() override;
+    void close() override;
+    bool read(VideoSourceFrame& frame) override;
+
+    int width() const override { return m_output_width; }
+    int height() const override { return m_output_height; }
+    const char* name() const override { return "文件回放"; }
+
+private:
+    bool decode_next_frame();
+    bool rewind();
+
+    using Clock = std::chrono::steady_clock;
+
+    std::string m_path;
+    int m_requested_width;
+    int m_requested_height;
+    int m_requested_fps;
+    int m_output_width = 0;
+    int m_output_height = 0;
+    double m_fps = 30.0;
+
+    AVFormatContext* m_format_ctx = nullptr;
+    AVCodecContext* m_decoder_ctx = nullptr;
+    int m_stream_index = -1;
+    AVPacket* m_packet = nullptr;
+    AVFrame* m_frame = nullptr;
+    bool m_draining = false;
+    bool m_decoded_since_rewind = false;
+    int64_t m_loop_count = 0;
+
+    int64_t m_frame_index = 0;
+    Clock::time_point m_start;
+};
@@ -1,4 +1,5 @@
 ﻿#include "FileStreamer.h"
+#include "ContentAnalyzer.h"
 #include "shared_config.h"
 #include <iostream>
 #include <thread>
@@ -35,9 +36,12 @@ void FileStreamer::start()
     if (initialize_ffmpeg()) {
         // 在启动推流循环之前，立即设置正确的分辨率
         if (m_video_decoder_ctx) {
+            // 【新增】按片源复杂度生成的码率阶梯；首次播放时需要先分析（最多约 3 秒），之后读取缓存的阶梯文件
+            const std::vector<QualityLevel> ladder = ContentAnalyzer::load_or_build_ladder(m_video_path);
             m_controller->set_video_resolution(
                 m_video_decoder_ctx->width, 
-                m_video_decoder_ctx->height
+                m_video_decoder_ctx->height,
+                ladder
             );
         }
         
@@ -93,8 +97,10 @@ bool FileStreamer::initialize_ffmpeg() {
         AVChannelLayout in_layout;
         if (m_audio_decoder_ctx->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) { av_channel_layout_default(&in_layout, m_audio_decoder_ctx->ch_layout.nb_channels); }
         else { in_layout = m_audio_decoder_ctx->ch_layout; }
-        AVChannelLayout out_layout = AV_CHANNEL_LAYOUT_MONO;
-        swr_alloc_set_opts2(&m_swr_ctx, &out_layout, AV_SAMPLE_FMT_S16, AppConfig::AUDIO_RATE, &in_layout, m_audio_decoder_ctx->sample_fmt, m_audio_decoder_ctx->sample_rate, 0, nullptr);
+        // 【修改】输出格式跟随协商结果（PCM 16kHz 单声道或 Opus 48kHz 立体声）
+        AVChannelLayout out_layout;
+        av_channel_layout_default(&out_layout, audio_format().channels);
+        swr_alloc_set_opts2(&m_swr_ctx, &out_layout, AV_SAMPLE_FMT_S16, audio_format().sample_rate, &in_layout, m_audio_decoder_ctx->sample_fmt, m_audio_decoder_ctx->sample_rate, 0, nullptr);
         if (!m_swr_ctx || swr_init(m_swr_ctx) < 0) return false;
     }
     std::cout << "[文件推流] FFmpeg 初始化成功。" << std::endl;
@@ -142,6 +148,7 @@ void FileStreamer::stream_loop() {
                 if (m_video_decoder_ctx) avcodec_flush_buffers(m_video_decoder_ctx);
                 if (m_audio_decoder_ctx) avcodec_flush_buffers(m_audio_decoder_ctx);
                 if (m_video_encoder_ctx) avcodec_flush_buffers(m_video_encoder_ctx);
+                reset_send_path();
 
                 // 【核心修正】进入“寻帧同步”模式
                 bool sync_point_found = false;
@@ -235,12 +242,13 @@ void FileStreamer::resample_and_send_audio(AVFrame* frame) {
     if (!m_swr_ctx || !frame) return;
     uint8_t** output_buffer_array = nullptr;
     int linesize;
-    int output_samples = av_rescale_rnd(swr_get_delay(m_swr_ctx, frame->sample_rate) + frame->nb_samples, AppConfig::AUDIO_RATE, frame->sample_rate, AV_ROUND_UP);
-    av_samples_alloc_array_and_samples(&output_buffer_array, &linesize, AppConfig::AUDIO_CHANNELS, output_samples, AV_SAMPLE_FMT_S16, 0);
+    const int out_rate = audio_format().sample_rate;
+    int output_samples = av_rescale_rnd(swr_get_delay(m_swr_ctx, frame->sample_rate) + frame->nb_samples, out_rate, frame->sample_rate, AV_ROUND_UP);
+    av_samples_alloc_array_and_samples(&output_buffer_array, &linesize, audio_format().channels, output_samples, AV_SAMPLE_FMT_S16, 0);
     int samples_converted = swr_convert(m_swr_ctx, output_buffer_array, output_samples, (const uint8_t**)frame->data, frame->nb_samples);
     if (samples_converted > 0) {
-        int data_size = av_samples_get_buffer_size(nullptr, AppConfig::AUDIO_CHANNELS, samples_converted, AV_SAMPLE_FMT_S16, 1);
-        send_quic_data(AppConfig::PacketType::Audio, output_buffer_array[0], data_size, frame->pts);
+        // 【修改】交给音频编码阶段，按协商格式切包（并编码）后发送
+        send_audio(reinterpret_cast<const int16_t*>(output_buffer_array[0]), samples_converted, frame->pts);
     }
     if (output_buffer_array) {
         av_freep(&output_buffer_array[0]);
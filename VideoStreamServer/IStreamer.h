@@ -2,6 +2,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <memory>
 
 // 一个共享的结构体，用于从主线程控制推流线程
@@ -29,4 +30,10 @@ public:
     // 暂停和恢复接口
     virtual void pause() = 0;
     virtual void resume() = 0;
+
+    // 【新增】连接当前允许的最大数据报长度（含自定义头），路径 MTU 变化时由 QUIC 回调更新
+    virtual void set_max_datagram_size(uint32_t size) = 0;
+
+    // 【新增】客户端报告参考链断裂，下一帧强制编码为关键帧
+    virtual void request_keyframe() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,295 @@
+﻿#define NOMINMAX
+#include "LiveStreamer.h"
+#include "shared_config.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+    // 【新增】采集环深度：编码跟不上时最多积压这么多帧，多出的丢弃最旧的
+    constexpr size_t CAPTURE_RING_SIZE = 2;
+    // 环内的帧，加上正在转换与正在编码的各一帧
+    constexpr size_t FRAME_POOL_SIZE = CAPTURE_RING_SIZE + 2;
+    // 编码线程等待新帧的超时，用于及时响应停止
+    constexpr int RING_WAIT_MS = 100;
+    constexpr int PIPELINE_STATS_INTERVAL_SEC = 5;
+}
+
+LiveStreamer::LiveStreamer(
+    const QUIC_API_TABLE* msquic, HQUIC connection,
+    std::shared_ptr<AdaptiveStreamController> controller,
+    std::unique_ptr<IVideoSource> video_source,
+    std::unique_ptr<IAudioSource> audio_source)
+    : BaseStreamer(msquic, connection, controller),
+      m_video_source(std::move(video_source)),
+      m_audio_source(std::move(audio_source))
+{
+    m_low_latency_encoder = true; // 【修改】YUV 帧改为在 initialize_video_capture 中按帧环深度分配
+}
+
+LiveStreamer::~LiveStreamer() {
+    cleanup();
+}
+
+void LiveStreamer::start() {
+    if (initialize_video_capture() && initialize_audio_capture()) {
+        m_controller->set_video_resolution(m_frame_width, m_frame_height);
+        std::cout << "[直播推流] 视频源: " << m_video_source->name() << " " << m_frame_width << "x" << m_frame_height
+            << ", 音频源: " << m_audio_source->name() << std::endl;
+
+        m_control_block->running = true;
+        m_start_time = std::chrono::steady_clock::now();
+        m_stat_last_report = m_start_time;
+        m_audio_thread = std::thread(&LiveStreamer::audio_stream_loop, this);
+        m_capture_thread = std::thread(&LiveStreamer::capture_loop, this); // 【新增】
+        video_stream_loop();
+    }
+    else {
+        std::cerr << "[直播推流] 启动失败，初始化未完成。" << std::endl;
+        m_control_block->running = false;
+    }
+}
+
+void LiveStreamer::cleanup()
+{
+    // 【核心修复】使用新的、不会出错的“执行一次”守护逻辑
+    if (m_is_cleaned_up.exchange(true)) {
+        return; // 如果之前已经是 true，说明已经清理过，直接返回
+    }
+
+    // 停止循环（以防万一 stop() 没被调用）
+    m_control_block->running = false;
+    m_ring_cv.notify_all();
+
+    std::cout << "[直播推流] 开始清理直播特定资源..." << std::endl;
+
+    // 【新增】采集线程使用采集源与转换上下文，先于它们释放
+    if (m_capture_thread.joinable()) {
+        m_capture_thread.join();
+        std::cout << "[直播推流] 采集线程已汇合。" << std::endl;
+    }
+
+    if (m_audio_thread.joinable()) {
+        m_audio_thread.join();
+        std::cout << "[直播推流] 音频线程已汇合。" << std::endl;
+    }
+
+    // 【修改】设备的释放（PortAudio、OpenCV）移到各自的采集源中
+    if (m_audio_source) {
+        m_audio_source->close();
+        std::cout << "[直播推流] 音频源已关闭。" << std::endl;
+    }
+    if (m_video_source) {
+        m_video_source->close();
+        std::cout << "[直播推流] 视频源已关闭。" << std::endl;
+    }
+
+    if (m_sws_ctx_to_yuv) {
+        sws_freeContext(m_sws_ctx_to_yuv);
+        m_sws_ctx_to_yuv = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_ring_mutex);
+        for (auto& captured : m_ring) {
+            m_free_frames.push_back(captured.frame);
+        }
+        m_ring.clear();
+        for (AVFrame* frame : m_free_frames) {
+            av_frame_free(&frame);
+        }
+        m_free_frames.clear();
+    }
+
+    std::cout << "[直播推流] 直播特定资源已清理。" << std::endl;
+
+    BaseStreamer::cleanup();
+}
+
+bool LiveStreamer::initialize_video_capture() {
+    // 【修改】打开视频源，推流尺寸由源决定（摄像头的实际分辨率，或数据源字符串中指定的尺寸）
+    if (!m_video_source || !m_video_source->open()) return false;
+    m_frame_width = m_video_source->width();
+    m_frame_height = m_video_source->height();
+    for (size_t i = 0; i < FRAME_POOL_SIZE; ++i) {
+        AVFrame* frame = av_frame_alloc();
+        if (!frame) return false;
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = m_frame_width;
+        frame->height = m_frame_height;
+        if (av_frame_get_buffer(frame, 0) < 0) {
+            av_frame_free(&frame);
+            return false;
+        }
+        m_free_frames.push_back(frame);
+    }
+    return true;
+}
+
+bool LiveStreamer::initialize_audio_capture() {
+    // 【修改】音频源按协商格式（采样率、声道数）输出
+    return m_audio_source && m_audio_source->open(audio_format());
+}
+
+// 【新增】采集线程：从视频源取帧并立即转换到 YUV，与编码线程上一帧的编码重叠
+void LiveStreamer::capture_loop() {
+    VideoSourceFrame source_frame;
+    while (m_control_block->running) {
+        if (!m_video_source->read(source_frame)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        // read() 返回的时刻作为采集时刻，之前的曝光与驱动时延无法从这里测得
+        FrameTiming timing;
+        timing.captured = std::chrono::steady_clock::now();
+        timing.capture_wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        AVFrame* yuv_frame = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_ring_mutex);
+            if (m_free_frames.empty() && !m_ring.empty()) {
+                m_free_frames.push_back(m_ring.front().frame);
+                m_ring.pop_front();
+                m_stat_ring_dropped++;
+            }
+            if (!m_free_frames.empty()) {
+                yuv_frame = m_free_frames.back();
+                m_free_frames.pop_back();
+            }
+        }
+        if (!yuv_frame) {
+            continue;
+        }
+        // 编码器可能仍引用上次的缓冲区，此时换一块新的
+        if (av_frame_make_writable(yuv_frame) < 0) {
+            release_frame(yuv_frame);
+            continue;
+        }
+
+        // 【修改】源的像素格式与尺寸可能与推流不同（摄像头为 BGR，回放的文件为任意尺寸），统一转换
+        m_sws_ctx_to_yuv = sws_getCachedContext(m_sws_ctx_to_yuv, source_frame.width, source_frame.height, static_cast<AVPixelFormat>(source_frame.format), m_frame_width, m_frame_height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+        if (!m_sws_ctx_to_yuv) {
+            release_frame(yuv_frame);
+            continue;
+        }
+        sws_scale(m_sws_ctx_to_yuv, source_frame.data, source_frame.linesize, 0, source_frame.height, yuv_frame->data, yuv_frame->linesize);
+        yuv_frame->pts = std::chrono::duration_cast<std::chrono::milliseconds>(timing.captured - m_start_time).count();
+        timing.converted = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(m_ring_mutex);
+            while (m_ring.size() >= CAPTURE_RING_SIZE) {
+                m_free_frames.push_back(m_ring.front().frame);
+                m_ring.pop_front();
+                m_stat_ring_dropped++;
+            }
+            m_ring.push_back({ yuv_frame, timing });
+            m_stat_captured++;
+        }
+        m_ring_cv.notify_one();
+    }
+    std::cout << "[直播推流] 采集循环结束。" << std::endl;
+}
+
+void LiveStreamer::video_stream_loop() {
+    // 【修改】不再按固定的 30fps 休眠：新帧一到就编码，帧率按 ABR 决策的 target_fps 从采集帧中抽取
+    bool has_due = false;
+    std::chrono::steady_clock::time_point next_due;
+    int64_t last_pts = -1;
+
+    while (m_control_block->running) {
+        CapturedFrame captured;
+        {
+            std::unique_lock<std::mutex> lock(m_ring_mutex);
+            m_ring_cv.wait_for(lock, std::chrono::milliseconds(RING_WAIT_MS), [this] {
+                return !m_ring.empty() || !m_control_block->running;
+            });
+            if (m_ring.empty()) {
+                continue;
+            }
+            // 只编码最新的一帧，更早的帧已经过时
+            while (m_ring.size() > 1) {
+                m_free_frames.push_back(m_ring.front().frame);
+                m_ring.pop_front();
+                m_stat_stale_dropped++;
+            }
+            captured = m_ring.front();
+            m_ring.pop_front();
+        }
+
+        const int target_fps = std::max(1, m_controller->get_decision().target_fps);
+        const auto interval = std::chrono::microseconds(1000000 / target_fps);
+        const auto captured_at = captured.timing.captured;
+        // 比下一个编码时刻早得多的帧跳过；允许 1/4 个间隔的提前量，吸收采集间隔的抖动
+        if ((has_due && captured_at < next_due - interval / 4) || captured.frame->pts <= last_pts) {
+            release_frame(captured.frame);
+            m_stat_rate_skipped++;
+            continue;
+        }
+        // 落后超过一个间隔（采集帧率低于目标或曾经停顿）时从当前帧重新计时，不补帧
+        next_due = (has_due && captured_at - next_due < interval) ? next_due + interval : captured_at + interval;
+        has_due = true;
+        last_pts = captured.frame->pts;
+
+        m_stat_wait_sum_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - captured_at).count();
+        m_stat_encoded++;
+        encode_and_send_video(captured.frame, &captured.timing);
+        release_frame(captured.frame);
+
+        report_pipeline_stats(target_fps);
+    }
+    encode_and_send_video(nullptr);
+    std::cout << "[直播推流] 视频循环结束。" << std::endl;
+}
+
+void LiveStreamer::release_frame(AVFrame* frame) {
+    std::lock_guard<std::mutex> lock(m_ring_mutex);
+    m_free_frames.push_back(frame);
+}
+
+void LiveStreamer::report_pipeline_stats(int target_fps) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_stat_last_report < std::chrono::seconds(PIPELINE_STATS_INTERVAL_SEC)) return;
+    const double elapsed_sec = std::chrono::duration<double>(now - m_stat_last_report).count();
+    m_stat_last_report = now;
+
+    uint64_t captured = 0, ring_dropped = 0, stale_dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_ring_mutex);
+        captured = m_stat_captured;
+        ring_dropped = m_stat_ring_dropped;
+        stale_dropped = m_stat_stale_dropped;
+        m_stat_captured = m_stat_ring_dropped = m_stat_stale_dropped = 0;
+    }
+    std::cout << "[直播推流] 采集 " << captured / elapsed_sec << " fps, 编码 " << m_stat_encoded / elapsed_sec
+        << " fps (目标 " << target_fps << "), 丢弃 环满/过时/降帧率 = " << ring_dropped << "/" << stale_dropped << "/"
+        << m_stat_rate_skipped << ", 采集到开始编码 平均 "
+        << (m_stat_encoded > 0 ? m_stat_wait_sum_ms / m_stat_encoded : 0.0) << " ms" << std::endl;
+    m_stat_encoded = 0;
+    m_stat_rate_skipped = 0;
+    m_stat_wait_sum_ms = 0.0;
+}
+
+void LiveStreamer::audio_stream_loop() {
+    // 【修改】音频源已按协商的声道数输出（麦克风的声道复制在 MicrophoneSource 中完成）
+    const int frames = audio_format().frame_samples;
+    const int channels = audio_format().channels;
+    std::vector<int16_t> audio_buffer(static_cast<size_t>(frames) * channels);
+    while (m_control_block->running) {
+        if (m_audio_source->read(audio_buffer.data(), frames)) {
+            int64_t timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start_time).count();
+            // 【修改】交给音频编码阶段（原始 PCM 或 Opus）
+            send_audio(audio_buffer.data(), frames, timestamp_ms);
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    std::cout << "[直播推流] 音频循环结束。" << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "BaseStreamer.h"
+#include "CaptureSource.h" // 【新增】采集源
+#include <string>
+#include <thread>
+#include <condition_variable> // 【新增】采集环
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <atomic> // 【新增】为 std::atomic
+
+struct AVFrame;
+struct SwsContext;
+
+// 【修改】原 CameraStreamer：实时推流与具体的采集设备解耦，摄像头、测试图、文件回放都通过 IVideoSource/IAudioSource 接入
+class LiveStreamer final : public BaseStreamer
+{
+public:
+    LiveStreamer(
+        const QUIC_API_TABLE* msquic,
+        HQUIC connection,
+        std::shared_ptr<AdaptiveStreamController> controller,
+        std::unique_ptr<IVideoSource> video_source,
+        std::unique_ptr<IAudioSource> audio_source
+    );
+    ~LiveStreamer();
+
+    void start() override;
+
+private:
+    bool initialize_video_capture();
+    bool initialize_audio_capture();
+    void cleanup() override;
+
+    // 【修改】实时流水线：采集线程读取并转换到 YUV，放入帧环；video_stream_loop 按 ABR 目标帧率取最新的帧编码发送
+    void capture_loop();
+    void video_stream_loop();
+    void audio_stream_loop();
+    void release_frame(AVFrame* frame);
+    void report_pipeline_stats(int target_fps);
+
+    // 【新增】已转换、等待编码的一帧
+    struct CapturedFrame {
+        AVFrame* frame = nullptr;
+        FrameTiming timing;
+    };
+
+    std::chrono::steady_clock::time_point m_start_time;
+
+    // 【修改】采集源；帧尺寸为推流尺寸，源的帧在转换时缩放到该尺寸
+    std::unique_ptr<IVideoSource> m_video_source;
+    std::unique_ptr<IAudioSource> m_audio_source;
+    int m_frame_width = 0;
+    int m_frame_height = 0;
+    SwsContext* m_sws_ctx_to_yuv = nullptr; // 只在采集线程使用
+
+    // 【新增】采集线程与编码线程之间的帧环：环满时丢弃最旧的帧，编码线程只取最新的一帧
+    std::thread m_capture_thread;
+    std::mutex m_ring_mutex;
+    std::condition_variable m_ring_cv;
+    std::deque<CapturedFrame> m_ring;
+    std::vector<AVFrame*> m_free_frames; // 预先分配的 YUV 帧，采集与编码轮流使用
+
+    // 【新增】流水线统计，report_pipeline_stats() 打印后清零
+    uint64_t m_stat_captured = 0;      // 受 m_ring_mutex 保护
+    uint64_t m_stat_ring_dropped = 0;  // 受 m_ring_mutex 保护
+    uint64_t m_stat_stale_dropped = 0; // 受 m_ring_mutex 保护
+    uint64_t m_stat_rate_skipped = 0;
+    uint64_t m_stat_encoded = 0;
+    double m_stat_wait_sum_ms = 0.0;   // 采集到开始编码
+    std::chrono::steady_clock::time_point m_stat_last_report;
+
+    std::thread m_audio_thread;
+
+    // 【新增】一个健壮的“清理一次”标志
+    std::atomic<bool> m_is_cleaned_up{ false };
+};
\ No newline at end of file
@@ -2,9 +2,14 @@
 #include "StreamerManager.h"
 #include "FileSystemManager.h"
 #include "AdaptiveStreamController.h"
+#include "SendScheduler.h"
+#include "ConnectionStatsSampler.h"
+#include "shared_config.h"
 #include <msquic.h>
 #include <iostream>
 #include <vector>
+#include <cmath>
+#include <chrono> // 【新增】心跳回复带服务端时间
 #include<fstream>
 // Helper functions to decode hex string (for certificate hash)
 uint8_t DecodeHexChar(char c)
@@ -108,6 +113,12 @@ bool QuicServer::LoadConfiguration(const std::string& cert_hash)
     Settings.ServerResumptionLevel = QUIC_SERVER_RESUME_AND_ZERORTT;
     Settings.IsSet.ServerResumptionLevel = TRUE;
     Settings.CongestionControlAlgorithm = QUIC_CONGESTION_CONTROL_ALGORITHM_BBR;
+    Settings.IsSet.CongestionControlAlgorithm = TRUE; // 【修改】未置位时 MsQuic 会忽略上面的设置，仍使用 Cubic
+#ifdef QUIC_API_ENABLE_PREVIEW_FEATURES
+    // 【新增】周期性上报拥塞控制器的带宽估计与 RTT，作为码率估计的链路容量参考
+    Settings.NetStatsEventEnabled = TRUE;
+    Settings.IsSet.NetStatsEventEnabled = TRUE;
+#endif
     // 客户端将打开一个双向流用于控制
     Settings.PeerBidiStreamCount = 1;
     Settings.IsSet.PeerBidiStreamCount = TRUE;
@@ -128,6 +139,8 @@ bool QuicServer::LoadConfiguration(const std::string& cert_hash)
             config_file >> config_json;
             // 如果文件中存在该字段，则使用文件中的值
             pacing_enabled = config_json.value("pacing_enabled", true);
+            // 【新增】默认丢包恢复方式
+            m_intra_refresh_default = config_json.value("video_refresh", std::string(AppConfig::VIDEO_REFRESH_IDR)) == AppConfig::VIDEO_REFRESH_INTRA;
         }
         catch (...) {
             /* 忽略解析错误，使用默认值 */ 
@@ -183,17 +196,31 @@ QUIC_STATUS QUIC_API QuicServer::ListenerCallback(HQUIC, void* Context, QUIC_LIS
 
 QUIC_STATUS QuicServer::HandleListenerEvent(QUIC_LISTENER_EVENT* Event) {
     if (Event->Type == QUIC_LISTENER_EVENT_NEW_CONNECTION) {
-        m_msquic->SetCallbackHandler(Event->NEW_CONNECTION.Connection, (void*)ConnectionCallback, this);
-        return m_msquic->ConnectionSetConfiguration(Event->NEW_CONNECTION.Connection, m_configuration);
+        // 【修改】连接的上下文改为 ConnectionContext，在 SHUTDOWN_COMPLETE 时释放
+        HQUIC Connection = Event->NEW_CONNECTION.Connection;
+        auto* Ctx = new (std::nothrow) ConnectionContext{
+            this, std::make_unique<ConnectionStatsSampler>(m_msquic, Connection, m_streamer_manager->get_controller()) };
+        if (!Ctx) return QUIC_STATUS_OUT_OF_MEMORY;
+        m_msquic->SetCallbackHandler(Connection, (void*)ConnectionCallback, Ctx);
+        QUIC_STATUS Status = m_msquic->ConnectionSetConfiguration(Connection, m_configuration);
+        if (QUIC_FAILED(Status)) {
+            // 返回失败时 MsQuic 直接关闭连接，不会再有回调
+            delete Ctx;
+        }
+        return Status;
     }
     return QUIC_STATUS_NOT_SUPPORTED;
 }
 
 QUIC_STATUS QUIC_API QuicServer::ConnectionCallback(HQUIC Connection, void* Context, QUIC_CONNECTION_EVENT* Event) {
-    return static_cast<QuicServer*>(Context)->HandleConnectionEvent(Connection, Event);
+    auto* Ctx = static_cast<ConnectionContext*>(Context);
+    return Ctx->Server->HandleConnectionEvent(Connection, Event);
 }
 
 QUIC_STATUS QuicServer::HandleConnectionEvent(HQUIC Connection, QUIC_CONNECTION_EVENT* Event) {
+    auto* Ctx = static_cast<ConnectionContext*>(m_msquic->GetContext(Connection));
+    if (!Ctx) return QUIC_STATUS_INVALID_STATE;
+
     switch (Event->Type) {
     case QUIC_CONNECTION_EVENT_CONNECTED: {
         std::cout << "[QuicServer] 连接 " << Connection << " 已建立。" << std::endl;
@@ -210,10 +237,32 @@ QUIC_STATUS QuicServer::HandleConnectionEvent(HQUIC Connection, QUIC_CONNECTION_
         }
         break;
     }
+    case QUIC_CONNECTION_EVENT_DATAGRAM_STATE_CHANGED: {
+        // 【新增】握手完成及路径 MTU 探测结果变化时触发，分片大小随之调整
+        const uint16_t max_send_length = Event->DATAGRAM_STATE_CHANGED.SendEnabled ? Event->DATAGRAM_STATE_CHANGED.MaxSendLength : 0;
+        std::cout << "[QuicServer] 连接 " << Connection << " 数据报上限: " << max_send_length << " 字节" << std::endl;
+        if (max_send_length > 0) {
+            m_streamer_manager->update_max_datagram_size(max_send_length);
+        }
+        break;
+    }
+    case QUIC_CONNECTION_EVENT_DATAGRAM_SEND_STATE_CHANGED:
+        // 【新增】发送失败计入连接统计
+        Ctx->StatsSampler->on_datagram_send_state(Event->DATAGRAM_SEND_STATE_CHANGED.State);
+        // 【新增】数据报的发送上下文由发送调度器分配，到达最终状态时在这里释放
+        SendScheduler::on_send_state_changed(Event->DATAGRAM_SEND_STATE_CHANGED.ClientContext, Event->DATAGRAM_SEND_STATE_CHANGED.State);
+        break;
+#ifdef QUIC_API_ENABLE_PREVIEW_FEATURES
+    case QUIC_CONNECTION_EVENT_NETWORK_STATISTICS:
+        // 【修改】在途字节、拥塞窗口与带宽估计交给连接统计采样器，由其汇总后交给码率控制器
+        Ctx->StatsSampler->on_network_statistics(Event->NETWORK_STATISTICS);
+        break;
+#endif
     case QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE:
         std::cout << "[QuicServer] 连接 " << Connection << " 已完全关闭。" << std::endl;
         m_streamer_manager->stop_stream();
         m_msquic->ConnectionClose(Connection);
+        delete Ctx;
         break;
     case QUIC_CONNECTION_EVENT_PEER_STREAM_STARTED: {
         // 为每个新来的流创建一个上下文，包含服务器指针和连接句柄
@@ -239,16 +288,22 @@ QUIC_STATUS QuicServer::HandleStreamEvent(HQUIC Stream, QUIC_STREAM_EVENT* Event
 
     switch (Event->Type) {
     case QUIC_STREAM_EVENT_RECEIVE: {
-        std::string received_data;
         for (uint32_t i = 0; i < Event->RECEIVE.BufferCount; ++i) {
-            received_data.append(reinterpret_cast<const char*>(Event->RECEIVE.Buffers[i].Buffer), Event->RECEIVE.Buffers[i].Length);
-        }
-        try {
-            // 将连接句柄传递给命令处理器，以便start_stream可以获取它
-            HandleControlCommand(Ctx->Connection, Stream, nlohmann::json::parse(received_data));
+            Ctx->ReceiveBuffer.append(reinterpret_cast<const char*>(Event->RECEIVE.Buffers[i].Buffer), Event->RECEIVE.Buffers[i].Length);
         }
-        catch (const nlohmann::json::parse_error& e) {
-            std::cerr << "[QuicServer] 错误: 解析JSON失败: " << e.what() << std::endl;
+        // 【修改】反馈消息发送频繁，多条消息可能合并到一次接收中，按换行逐条处理
+        size_t line_end;
+        while ((line_end = Ctx->ReceiveBuffer.find('\n')) != std::string::npos) {
+            const std::string line = Ctx->ReceiveBuffer.substr(0, line_end);
+            Ctx->ReceiveBuffer.erase(0, line_end + 1);
+            if (line.empty()) continue;
+            try {
+                // 将连接句柄传递给命令处理器，以便start_stream可以获取它
+                HandleControlCommand(Ctx->Connection, Stream, nlohmann::json::parse(line));
+            }
+            catch (const nlohmann::json::exception& e) {
+                std::cerr << "[QuicServer] 错误: 解析JSON失败: " << e.what() << std::endl;
+            }
         }
         break;
     }
@@ -276,11 +331,16 @@ void QuicServer::HandleControlCommand(HQUIC Connection, HQUIC Stream, const nloh
     if (command_str == "get_list") {
         response_json = FileSystemManager::get_video_files();
         response_json.push_back("camera");
+        response_json.push_back("test_pattern"); // 【新增】不依赖采集设备的合成直播源，其余参数可直接写在 source 中
     }
     else if (command_str == "play") {
         std::string source = command_json.value("source", "");
         if (!source.empty()) {
-            response_json = m_streamer_manager->start_stream(source, Connection, this);
+            // 【新增】play 命令可指定丢包恢复方式，未指定时使用配置文件的默认值
+            const std::string refresh = command_json.value("video_refresh",
+                std::string(m_intra_refresh_default ? AppConfig::VIDEO_REFRESH_INTRA : AppConfig::VIDEO_REFRESH_IDR));
+            response_json = m_streamer_manager->start_stream(source, Connection, this, command_json.value("audio_codecs", nlohmann::json::array()),
+                refresh == AppConfig::VIDEO_REFRESH_INTRA);
         }
         else {
             response_json["error"] = "Source is empty";
@@ -291,6 +351,12 @@ void QuicServer::HandleControlCommand(HQUIC Connection, HQUIC Stream, const nloh
         if (time >= 0) m_streamer_manager->seek_stream(time);
         return; // seek命令不需要回复
     }
+    else if (command_str == "keyframe_request") {
+        // 【新增】客户端发现参考链断裂
+        std::cout << "[QuicServer] 收到关键帧请求: " << command_json.value("reason", "") << std::endl;
+        m_streamer_manager->request_keyframe();
+        return; // 无需回复
+    }
     else if (command_str == "pause") {
         m_streamer_manager->pause_stream();
         return; // 无需回复
@@ -299,13 +365,19 @@ void QuicServer::HandleControlCommand(HQUIC Connection, HQUIC Stream, const nloh
         m_streamer_manager->resume_stream();
         return; // 无需回复
     }
+    else if (command_str == "transport_feedback") {
+        // 【新增】逐包到达时间，驱动带宽估计
+        HandleTransportFeedback(command_json);
+        return; // 无需回复
+    }
     else if (command_str == "heartbeat") {
-        std::string trend = command_json.value("trend", "hold");
-        m_streamer_manager->get_controller()->update_client_feedback(trend);
-
+        // 【修改】码率由传输层反馈决定，心跳只用于测量时延
         if (command_json.contains("client_ts")) {
             response_json["command"] = "heartbeat_reply";
             response_json["client_ts"] = command_json["client_ts"];
+            // 【新增】服务端系统时钟（Unix 微秒），客户端据此估计两端时钟差，换算 VideoTiming 中的采集时刻
+            response_json["server_ts_us"] = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
         }
         else {
             return;
@@ -319,7 +391,7 @@ void QuicServer::HandleControlCommand(HQUIC Connection, HQUIC Stream, const nloh
         return;
     }
 
-    auto response_str = response_json.dump();
+    auto response_str = response_json.dump() + "\n"; // 【修改】以换行分隔消息
     auto* request = new (std::nothrow) SendRequest();
     if (!request) return;
 
@@ -331,4 +403,41 @@ void QuicServer::HandleControlCommand(HQUIC Connection, HQUIC Stream, const nloh
     if (QUIC_FAILED(m_msquic->StreamSend(Stream, &request->QuicBuffer, 1, QUIC_SEND_FLAG_NONE, request))) {
         delete request;
     }
-}
\ No newline at end of file
+}
+
+// 【新增】反馈格式：base_seq 为第一个包的传输序号，deltas 依次对应之后的每个包，
+// null 表示丢失，整数为与上一个收到的包的到达间隔（单位 TRANSPORT_FEEDBACK_DELTA_UNIT_US），
+// 第一个收到的包相对 ref_us
+void QuicServer::HandleTransportFeedback(const nlohmann::json& command_json)
+{
+    const auto base_it = command_json.find("base_seq");
+    const auto ref_it = command_json.find("ref_us");
+    const auto deltas_it = command_json.find("deltas");
+    if (base_it == command_json.end() || !base_it->is_number() ||
+        ref_it == command_json.end() || !ref_it->is_number() ||
+        deltas_it == command_json.end() || !deltas_it->is_array()) {
+        return;
+    }
+
+    // Qt 的 JSON 数字按 double 存储，这里统一按浮点数读取再取整
+    const uint16_t base_seq = static_cast<uint16_t>(std::llround(base_it->get<double>()));
+    int64_t arrival_us = std::llround(ref_it->get<double>());
+
+    std::vector<PacketFeedback> packets;
+    packets.reserve(deltas_it->size());
+    uint16_t seq = base_seq;
+    for (const auto& delta : *deltas_it) {
+        if (delta.is_number()) {
+            arrival_us += std::llround(delta.get<double>()) * AppConfig::TRANSPORT_FEEDBACK_DELTA_UNIT_US;
+            packets.push_back({ seq, true, arrival_us });
+        }
+        else {
+            packets.push_back({ seq, false, 0 });
+        }
+        ++seq;
+    }
+
+    if (!packets.empty()) {
+        m_streamer_manager->get_controller()->on_transport_feedback(packets);
+    }
+}
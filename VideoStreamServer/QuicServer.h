@@ -9,6 +9,7 @@
 
 // 前向声明
 class StreamerManager;
+class ConnectionStatsSampler;
 
 class QuicServer
 {
@@ -27,6 +28,14 @@ private:
     struct StreamContext {
         QuicServer* Server;
         HQUIC Connection;
+        // 【新增】控制消息以换行分隔，一次接收可能包含半条或多条消息
+        std::string ReceiveBuffer;
+    };
+
+    // 【新增】每个连接的上下文：连接统计采样器只在该连接的回调中使用
+    struct ConnectionContext {
+        QuicServer* Server;
+        std::unique_ptr<ConnectionStatsSampler> StatsSampler;
     };
 
     // 用于管理 StreamSend 异步操作内存的辅助结构体
@@ -44,6 +53,8 @@ private:
     // 关联的业务逻辑
     std::shared_ptr<StreamerManager> m_streamer_manager;
     std::atomic<bool> m_running{ false };
+    // 【新增】config.json 中 "video_refresh" 指定的默认丢包恢复方式，play 命令可覆盖
+    bool m_intra_refresh_default = false;
 
     // --- MsQuic 回调函数 (C-Style, static) ---
     static QUIC_STATUS QUIC_API ListenerCallback(HQUIC Listener, void* Context, QUIC_LISTENER_EVENT* Event);
@@ -59,4 +70,6 @@ private:
     bool LoadConfiguration(const std::string& cert_hash);
     // 【关键改变】HandleControlCommand 需要知道是哪个 Connection
     void HandleControlCommand(HQUIC Connection, HQUIC Stream, const nlohmann::json& command_json);
+    // 【新增】解析客户端的传输层反馈，交给码率控制器
+    void HandleTransportFeedback(const nlohmann::json& command_json);
 };
\ No newline at end of file
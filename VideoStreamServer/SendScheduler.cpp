@@ -0,0 +1,300 @@
+﻿#define NOMINMAX
+#include "SendScheduler.h"
+#include "BandwidthEstimator.h"
+#include "shared_config.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+namespace {
+    // 各类帧从入队到开始发送的最长等待时间；参考帧过期会导致后续帧一并丢弃，给得更宽
+    constexpr int AUDIO_DEADLINE_MS = 150;
+    constexpr int KEYFRAME_DEADLINE_MS = 500;
+    constexpr int REFERENCE_DEADLINE_MS = 250;
+    constexpr int NON_REFERENCE_DEADLINE_MS = 120;
+    // 交给 MsQuic 但尚未发出的数据报上限，约一个视频帧的量，避免排队转移到 MsQuic 内部
+    constexpr int MAX_MSQUIC_QUEUED = 32;
+    // 窗口占满时的轮询间隔；MsQuic 回调只更新计数，不唤醒发送线程
+    constexpr int WINDOW_POLL_MS = 1;
+
+    std::chrono::milliseconds deadline_for(SendPriority priority)
+    {
+        switch (priority) {
+        case SendPriority::Audio: return std::chrono::milliseconds(AUDIO_DEADLINE_MS);
+        case SendPriority::KeyFrame: return std::chrono::milliseconds(KEYFRAME_DEADLINE_MS);
+        case SendPriority::Reference: return std::chrono::milliseconds(REFERENCE_DEADLINE_MS);
+        default: return std::chrono::milliseconds(NON_REFERENCE_DEADLINE_MS);
+        }
+    }
+}
+
+size_t SendScheduler::Frame::bytes() const
+{
+    size_t total = 0;
+    for (const auto& datagram : datagrams) total += datagram.size();
+    return total;
+}
+
+SendScheduler::SendScheduler(const QUIC_API_TABLE* msquic, HQUIC connection, std::shared_ptr<BandwidthEstimator> estimator)
+    : m_msquic(msquic),
+    m_connection(connection),
+    m_msquic_queued(std::make_shared<std::atomic<int>>(0)),
+    m_estimator(std::move(estimator))
+{
+    m_thread = std::thread(&SendScheduler::send_loop, this);
+}
+
+SendScheduler::~SendScheduler()
+{
+    stop();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void SendScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_audio.clear();
+        m_video.clear();
+        m_video_in_progress = false;
+    }
+    m_cv.notify_all();
+}
+
+void SendScheduler::enqueue(SendPriority priority, std::vector<std::vector<uint8_t>> datagrams)
+{
+    if (datagrams.empty()) return;
+    const Clock::time_point now = Clock::now();
+    Frame frame{ priority, now, now + deadline_for(priority), std::move(datagrams) };
+    frame.video_priority = priority;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        if (priority == SendPriority::Audio) {
+            m_audio.push_back(std::move(frame));
+        }
+        else if (priority == SendPriority::KeyFrame) {
+            // 新的 IDR 使排队中尚未开始发送的旧帧失去意义
+            auto first_idle = m_video.begin() + (m_video_in_progress ? 1 : 0);
+            for (auto it = first_idle; it != m_video.end(); ++it) drop_frame_locked(*it);
+            m_video.erase(first_idle, m_video.end());
+            m_drop_until_keyframe = false;
+            m_video.push_back(std::move(frame));
+        }
+        else if (m_drop_until_keyframe) {
+            // 参考链已断，等 IDR
+            drop_frame_locked(frame);
+            return;
+        }
+        else {
+            m_video.push_back(std::move(frame));
+        }
+    }
+    m_cv.notify_one();
+}
+
+void SendScheduler::enqueue_bundle(const std::vector<SendPriority>& record_priorities, std::vector<std::vector<uint8_t>> datagrams)
+{
+    if (datagrams.empty() || record_priorities.empty()) return;
+    const Clock::time_point now = Clock::now();
+    SendPriority video = SendPriority::Audio;
+    for (SendPriority priority : record_priorities) {
+        if (priority != SendPriority::Audio && (video == SendPriority::Audio || priority < video)) {
+            video = priority;
+        }
+    }
+    Frame frame{ SendPriority::Audio, now, now + deadline_for(SendPriority::Audio), std::move(datagrams) };
+    frame.video_priority = video;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        // 合并包总含音频：走音频队列并使用音频的截止时间，搭车的视频不能让其中的音频晚到；
+        // 只在视频队列空闲时搭车，不会越过排队中的旧视频帧
+        m_audio.push_back(std::move(frame));
+    }
+    m_cv.notify_one();
+}
+
+void SendScheduler::clear_video()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto first_idle = m_video.begin() + (m_video_in_progress ? 1 : 0);
+    // 【修改】丢弃的帧与过期丢帧一样计入统计
+    for (auto it = first_idle; it != m_video.end(); ++it) drop_frame_locked(*it);
+    m_video.erase(first_idle, m_video.end());
+}
+
+bool SendScheduler::video_idle()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_video.empty() && !m_drop_until_keyframe;
+}
+
+bool SendScheduler::take_keyframe_request()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::exchange(m_keyframe_requested, false);
+}
+
+SendSchedulerStats SendScheduler::take_stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SendSchedulerStats stats = m_stats;
+    stats.avg_queue_delay_ms = m_stats.frames_sent > 0 ? m_delay_sum_ms / m_stats.frames_sent : 0.0;
+    stats.queued_frames = m_audio.size() + m_video.size();
+    stats.msquic_queued = m_msquic_queued->load();
+    m_stats = SendSchedulerStats();
+    m_delay_sum_ms = 0.0;
+    return stats;
+}
+
+void SendScheduler::drop_frame_locked(const Frame& frame)
+{
+    m_stats.dropped_frames[static_cast<int>(frame.priority)]++;
+    // 【新增】合并包里搭车的视频帧也计入对应类别
+    if (frame.video_priority != frame.priority) {
+        m_stats.dropped_frames[static_cast<int>(frame.video_priority)]++;
+    }
+    m_stats.dropped_bytes += frame.bytes();
+}
+
+void SendScheduler::on_expired_locked(const Frame& frame)
+{
+    if (frame.video_priority == SendPriority::KeyFrame || frame.video_priority == SendPriority::Reference) {
+        m_drop_until_keyframe = true;
+        m_keyframe_requested = true;
+    }
+}
+
+void SendScheduler::drop_stale_video_locked(Clock::time_point now)
+{
+    while (!m_video.empty() && !m_video_in_progress) {
+        Frame& front = m_video.front();
+        const bool expired = now > front.deadline;
+        const bool undecodable = m_drop_until_keyframe && front.priority != SendPriority::KeyFrame;
+        if (!expired && !undecodable) return;
+
+        if (expired) {
+            // 参考帧（或 IDR）丢了，后续 P 帧都无法解码
+            on_expired_locked(front);
+        }
+        drop_frame_locked(front);
+        m_video.pop_front();
+    }
+    // 队列中已经有新的 IDR 在等待时不必再请求
+    if (m_drop_until_keyframe && !m_video.empty() && m_video.front().priority == SendPriority::KeyFrame) {
+        m_drop_until_keyframe = false;
+    }
+}
+
+void SendScheduler::record_sent_locked(const Frame& frame, Clock::time_point now)
+{
+    const double delay_ms = std::chrono::duration<double, std::milli>(now - frame.enqueued).count();
+    m_stats.frames_sent++;
+    m_delay_sum_ms += delay_ms;
+    m_stats.max_queue_delay_ms = std::max(m_stats.max_queue_delay_ms, delay_ms);
+}
+
+void SendScheduler::send_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        if (m_audio.empty() && m_video.empty()) {
+            m_cv.wait(lock);
+            continue;
+        }
+        if (m_msquic_queued->load() >= MAX_MSQUIC_QUEUED) {
+            m_cv.wait_for(lock, std::chrono::milliseconds(WINDOW_POLL_MS));
+            continue;
+        }
+
+        const Clock::time_point now = Clock::now();
+        // 【修改】合并包的截止时间可能长于其后的纯音频帧，逐个检查；已开始发送的帧不截断
+        for (auto it = m_audio.begin(); it != m_audio.end();) {
+            if (it->next > 0 || now <= it->deadline) {
+                ++it;
+                continue;
+            }
+            on_expired_locked(*it);
+            drop_frame_locked(*it);
+            it = m_audio.erase(it);
+        }
+        drop_stale_video_locked(now);
+
+        // 音频优先；视频帧一旦开始发送就发完，期间音频仍可插队
+        std::deque<Frame>* queue = !m_audio.empty() ? &m_audio : (!m_video.empty() ? &m_video : nullptr);
+        if (!queue) continue;
+        Frame& frame = queue->front();
+        if (queue == &m_video) m_video_in_progress = true;
+
+        // 发送时不持锁，数据报本身在帧出队前不会被其他线程改动
+        std::vector<uint8_t> datagram = std::move(frame.datagrams[frame.next]);
+        lock.unlock();
+        const bool ok = send_datagram(datagram);
+        lock.lock();
+        if (!m_running) break;
+        // 发送期间 clear_video() 只会保留正在发送的队头，引用仍然有效
+        if (ok) m_stats.datagrams_sent++;
+        if (++frame.next == frame.datagrams.size()) {
+            record_sent_locked(frame, Clock::now());
+            if (queue == &m_video) m_video_in_progress = false;
+            queue->pop_front();
+        }
+    }
+}
+
+bool SendScheduler::send_datagram(std::vector<uint8_t>& data)
+{
+    if (!m_connection) return false;
+
+    auto* context = new (std::nothrow) DatagramContext();
+    if (!context) {
+        std::cerr << "[SendScheduler] 错误: 无法为发送上下文分配内存" << std::endl;
+        return false;
+    }
+    context->data = std::move(data);
+    context->buffer.Buffer = context->data.data();
+    context->buffer.Length = static_cast<uint32_t>(context->data.size());
+    context->msquic_queued = m_msquic_queued;
+    m_msquic_queued->fetch_add(1);
+
+    // 【新增】传输序号按交给 MsQuic 的顺序分配，写在头的最后两个字节
+    if (m_estimator && context->data.size() >= AppConfig::DATAGRAM_HEADER_SIZE) {
+        context->estimator = m_estimator;
+        context->transport_seq = m_estimator->register_packet(static_cast<uint32_t>(context->data.size()));
+        context->data[AppConfig::TRANSPORT_SEQ_OFFSET] = static_cast<uint8_t>(context->transport_seq >> 8);
+        context->data[AppConfig::TRANSPORT_SEQ_OFFSET + 1] = static_cast<uint8_t>(context->transport_seq & 0xFF);
+    }
+
+    QUIC_STATUS status = m_msquic->DatagramSend(m_connection, &context->buffer, 1, QUIC_SEND_FLAG_NONE, context);
+    if (QUIC_FAILED(status)) {
+        std::cerr << "[SendScheduler] 错误: DatagramSend 失败，代码: 0x" << std::hex << status << std::dec << std::endl;
+        m_msquic_queued->fetch_sub(1);
+        delete context;
+        return false;
+    }
+    return true;
+}
+
+void SendScheduler::on_send_state_changed(void* client_context, QUIC_DATAGRAM_SEND_STATE state)
+{
+    auto* context = static_cast<DatagramContext*>(client_context);
+    if (!context) return;
+    // SENT 表示已写入 QUIC 包，离开了 MsQuic 的发送队列；取消/丢弃时不会先报告 SENT
+    if (!context->left_queue && (state == QUIC_DATAGRAM_SEND_SENT || QUIC_DATAGRAM_SEND_STATE_IS_FINAL(state))) {
+        context->left_queue = true;
+        context->msquic_queued->fetch_sub(1);
+        // 【新增】只有真正发出的数据报才有发送时间，被丢弃的不参与带宽估计
+        if (state == QUIC_DATAGRAM_SEND_SENT && context->estimator) {
+            context->estimator->on_packet_sent(context->transport_seq);
+        }
+    }
+    if (QUIC_DATAGRAM_SEND_STATE_IS_FINAL(state)) {
+        delete context;
+    }
+}
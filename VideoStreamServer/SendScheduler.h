@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include <msquic.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class BandwidthEstimator;
+
+// 【新增】发送优先级，数值越小越重要
+enum class SendPriority : uint8_t {
+    Audio = 0,
+    KeyFrame = 1,      // IDR
+    Reference = 2,     // 被后续帧参考的 P 帧
+    NonReference = 3,  // 不被参考，丢掉不影响后续解码
+};
+
+// 【新增】发送队列统计，take_stats() 取出后计数清零
+struct SendSchedulerStats {
+    uint64_t frames_sent = 0;
+    uint64_t datagrams_sent = 0;
+    uint64_t dropped_frames[4] = { 0, 0, 0, 0 }; // 按 SendPriority 分类
+    uint64_t dropped_bytes = 0;
+    double avg_queue_delay_ms = 0.0;  // 入队到最后一个数据报交给 MsQuic
+    double max_queue_delay_ms = 0.0;
+    size_t queued_frames = 0;         // 当前排队的帧数
+    int msquic_queued = 0;            // 已交给 MsQuic 但尚未发出的数据报数
+};
+
+// 【新增】每个连接一个的发送调度器，位于分片/打包与 DatagramSend 之间：
+// - 音频优先发送；视频保持解码顺序（FIFO），优先级只决定拥塞时先丢谁
+// - 每帧带一个按类型设定的截止时间，过期的帧整帧丢弃，已开始发送的帧不会被截断
+// - 丢掉参考帧后，直到下一个 IDR 之前的视频帧都无法解码，一并丢弃，并请求编码器插入 IDR
+// - 交给 MsQuic 但尚未发出的数据报数量有上限，排队发生在这里，新的 IDR 才能越过过期的帧
+// - 【新增】交给 MsQuic 前在头里填写传输序号，真正发出时通知带宽估计器，作为传输层反馈的发送时间
+class SendScheduler
+{
+public:
+    SendScheduler(const QUIC_API_TABLE* msquic, HQUIC connection, std::shared_ptr<BandwidthEstimator> estimator);
+    ~SendScheduler();
+
+    // 一帧的全部数据报（分片或合并包），作为整体调度
+    void enqueue(SendPriority priority, std::vector<std::vector<uint8_t>> datagrams);
+    // 【新增】音频合并包（可能搭载一个单片视频帧）：走音频队列，使用音频的截止时间；
+    // 搭载的视频记录随合并包过期丢弃时计入丢帧，若为参考帧 / IDR 则与视频队列中一样等待并请求 IDR
+    void enqueue_bundle(const std::vector<SendPriority>& record_priorities, std::vector<std::vector<uint8_t>> datagrams);
+    // 停止发送线程，丢弃排队的帧
+    void stop();
+    // 跳转后丢弃排队中尚未开始发送的视频帧
+    void clear_video();
+    // 视频队列为空且没有等待 IDR 时返回 true，此时视频数据报可以直接搭音频合并包发送
+    bool video_idle();
+    // 因丢弃参考帧需要插入 IDR 时返回 true（取出即清除）
+    bool take_keyframe_request();
+    SendSchedulerStats take_stats();
+
+    // 由连接回调（QUIC_CONNECTION_EVENT_DATAGRAM_SEND_STATE_CHANGED）转交，负责释放发送上下文
+    static void on_send_state_changed(void* client_context, QUIC_DATAGRAM_SEND_STATE state);
+
+    SendScheduler(const SendScheduler&) = delete;
+    SendScheduler& operator=(const SendScheduler&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame {
+        SendPriority priority;
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+        std::vector<std::vector<uint8_t>> datagrams;
+        size_t next = 0; // 下一个待发的数据报
+        // 【新增】携带的视频记录中最重要的优先级；纯音频为 Audio，视频帧与 priority 相同
+        SendPriority video_priority = SendPriority::Audio;
+        size_t bytes() const;
+    };
+
+    // MsQuic 回调可能晚于调度器析构到达，计数放在共享块里
+    struct DatagramContext {
+        QUIC_BUFFER buffer;
+        std::vector<uint8_t> data;
+        std::shared_ptr<std::atomic<int>> msquic_queued;
+        std::shared_ptr<BandwidthEstimator> estimator;
+        uint16_t transport_seq = 0;
+        bool left_queue = false;
+    };
+
+    void send_loop();
+    // 从队头丢弃过期或已无法解码的视频帧，需持有锁
+    void drop_stale_video_locked(Clock::time_point now);
+    void drop_frame_locked(const Frame& frame);
+    // 【新增】帧过期丢弃后维护参考链：丢了 IDR 或参考帧，直到下一个 IDR 之前的视频都无法解码
+    void on_expired_locked(const Frame& frame);
+    bool send_datagram(std::vector<uint8_t>& data);
+    void record_sent_locked(const Frame& frame, Clock::time_point now);
+
+    const QUIC_API_TABLE* m_msquic;
+    HQUIC m_connection;
+    std::shared_ptr<std::atomic<int>> m_msquic_queued;
+    std::shared_ptr<BandwidthEstimator> m_estimator;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Frame> m_audio;
+    std::deque<Frame> m_video;
+    bool m_running = true;
+    bool m_video_in_progress = false;     // m_video 队头已开始发送
+    bool m_drop_until_keyframe = false;
+    bool m_keyframe_requested = false;
+
+    SendSchedulerStats m_stats;
+    double m_delay_sum_ms = 0.0;
+
+    std::thread m_thread;
+};
@@ -2,7 +2,8 @@
 #include "QuicServer.h" // 包含 QuicServer 的完整定义
 #include "IStreamer.h"
 #include "FileStreamer.h" 
-#include "CameraStreamer.h" 
+#include "LiveStreamer.h" // 【修改】原 CameraStreamer.h
+#include "CaptureSource.h" // 【新增】
 #include "AdaptiveStreamController.h"
 #include "shared_config.h"
 #include <iostream>
@@ -10,6 +11,30 @@
 
 namespace fs = std::filesystem;
 
+namespace {
+    // 【新增】按客户端声明的编码列表选择第一个双方都支持的音频格式；
+    // 旧客户端不带该字段时使用原始 PCM
+    AudioStreamFormat negotiate_audio_format(const nlohmann::json& offered)
+    {
+        AudioStreamFormat format;
+        if (!offered.is_array()) return format;
+        for (const auto& codec : offered) {
+            if (!codec.is_string()) continue;
+            const std::string name = codec.get<std::string>();
+            if (name == AppConfig::AUDIO_CODEC_OPUS && AudioEncoder::opus_available()) {
+                format.opus = true;
+                format.sample_rate = AppConfig::OPUS_RATE;
+                format.channels = AppConfig::OPUS_CHANNELS;
+                format.frame_samples = AppConfig::OPUS_RATE * AppConfig::OPUS_FRAME_MS / 1000;
+                format.bitrate_bps = AppConfig::OPUS_BITRATE;
+                break;
+            }
+            if (name == AppConfig::AUDIO_CODEC_PCM) break;
+        }
+        return format;
+    }
+}
+
 // 包含 FFmpeg 头文件以获取视频时长
 extern "C" {
 #include <libavformat/avformat.h>
@@ -27,7 +52,7 @@ StreamerManager::~StreamerManager()
 }
 
 // start_stream 方法的实现已更新
-nlohmann::json StreamerManager::start_stream(const std::string& source, HQUIC connection, QuicServer* quic_server)
+nlohmann::json StreamerManager::start_stream(const std::string& source, HQUIC connection, QuicServer* quic_server, const nlohmann::json& audio_codecs, bool intra_refresh)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
     std::cout << "[服务端-管理器] 请求开启新 QUIC 推流..." << std::endl;
@@ -43,13 +68,31 @@ nlohmann::json StreamerManager::start_stream(const std::string& source, HQUIC co
 
     nlohmann::json response;
     response["duration"] = 0.0;
+    std::shared_ptr<BaseStreamer> streamer;
 
     // 根据数据源选择不同的推流器
     // 注意：我们现在将 msquic_api 和 connection 句柄传递给推流器的构造函数
     // 这会导致编译错误，我们将在下一步修复
-    if (source == "camera") {
-        std::cout << "[服务端-管理器] 启动摄像头直播" << std::endl;
-        m_current_streamer = std::make_shared<CameraStreamer>(msquic_api, connection, m_controller);
+    // 【修改】直播数据源（camera、test_pattern、replay:<文件>，可带参数）统一由 LiveStreamer 推流
+    LiveSourceConfig live_config;
+    std::string source_error;
+    const bool is_live = LiveSourceConfig::parse(source, live_config, source_error);
+    if (!source_error.empty()) {
+        std::cerr << "[服务端-管理器] 错误: 数据源 " << source << " 无效，" << source_error << std::endl;
+        return nullptr;
+    }
+    if (is_live) {
+        if (live_config.video == LiveSourceConfig::Video::FileReplay) {
+            fs::path replay_fs_path = fs::path("videos") / fs::u8path(live_config.path);
+            if (!fs::exists(replay_fs_path)) {
+                std::wcerr << L"[服务端-管理器] 错误: 找不到回放文件 " << replay_fs_path.wstring() << std::endl;
+                return nullptr;
+            }
+            live_config.path = replay_fs_path.u8string();
+        }
+        std::cout << "[服务端-管理器] 启动直播: " << source << std::endl;
+        streamer = std::make_shared<LiveStreamer>(msquic_api, connection, m_controller,
+            create_video_source(live_config), create_audio_source(live_config));
     }
     else {
         fs::path source_path = fs::u8path(source);
@@ -78,8 +121,26 @@ nlohmann::json StreamerManager::start_stream(const std::string& source, HQUIC co
         }
 
         std::cout << "[服务端-管理器] 启动文件点播: " << source << std::endl;
-        m_current_streamer = std::make_shared<FileStreamer>(msquic_api, connection, m_controller, video_path_utf8);
+        streamer = std::make_shared<FileStreamer>(msquic_api, connection, m_controller, video_path_utf8);
+    }
+
+    // 【新增】音频编码协商，需在推流线程启动前完成
+    const AudioStreamFormat audio_format = streamer->set_audio_format(negotiate_audio_format(audio_codecs));
+    response["audio"] = {
+        { "codec", audio_format.opus ? AppConfig::AUDIO_CODEC_OPUS : AppConfig::AUDIO_CODEC_PCM },
+        { "sample_rate", audio_format.sample_rate },
+        { "channels", audio_format.channels },
+        { "frame_samples", audio_format.frame_samples },
+        { "bitrate", audio_format.bitrate_bps }
+    };
+    // 【新增】连接建立时已经拿到的数据报上限
+    if (m_max_datagram_size > 0) {
+        streamer->set_max_datagram_size(m_max_datagram_size);
     }
+    // 【新增】告知客户端丢包恢复方式：IDR 模式下客户端在收到关键帧前冻结画面
+    streamer->set_intra_refresh(intra_refresh);
+    response["video"] = { { "refresh", intra_refresh ? AppConfig::VIDEO_REFRESH_INTRA : AppConfig::VIDEO_REFRESH_IDR } };
+    m_current_streamer = streamer;
 
     // 启动推流线程的逻辑保持不变
     if (m_current_streamer) {
@@ -133,4 +194,21 @@ void StreamerManager::resume_stream()
     if (m_current_streamer) {
         m_current_streamer->resume();
     }
+}
+
+void StreamerManager::request_keyframe()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_current_streamer) {
+        m_current_streamer->request_keyframe();
+    }
+}
+
+void StreamerManager::update_max_datagram_size(uint32_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_max_datagram_size = size;
+    if (m_current_streamer && size > 0) {
+        m_current_streamer->set_max_datagram_size(size);
+    }
 }
\ No newline at end of file
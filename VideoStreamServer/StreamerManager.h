@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -21,7 +22,10 @@ public:
 
     // 启动推流的接口已改变：
     // 不再接收 udp::endpoint，而是接收 QUIC 连接句柄和 QuicServer 指针
-    nlohmann::json start_stream(const std::string& source, HQUIC connection, QuicServer* quic_server);
+    // 【修改】audio_codecs 为客户端支持的音频编码（按偏好排序），协商结果写入回复的 "audio" 字段；
+    // intra_refresh 选择丢包恢复方式，写入回复的 "video" 字段
+    nlohmann::json start_stream(const std::string& source, HQUIC connection, QuicServer* quic_server,
+        const nlohmann::json& audio_codecs = nlohmann::json(), bool intra_refresh = false);
 
     // 停止当前推流
     void stop_stream();
@@ -35,10 +39,17 @@ public:
 	// 暂停和恢复推流
     void pause_stream();
     void resume_stream();
+
+    // 【新增】连接的最大数据报长度变化（DATAGRAM_STATE_CHANGED），转交当前及之后创建的推流器
+    void update_max_datagram_size(uint32_t size);
+
+    // 【新增】转发客户端的关键帧请求
+    void request_keyframe();
 private:
     std::mutex m_mutex;
     std::thread m_stream_thread;
     std::shared_ptr<IStreamer> m_current_streamer;
+    std::atomic<uint32_t> m_max_datagram_size{ 0 }; // 0 表示尚未收到，推流器使用默认值
 
     // m_io_context 已被移除
     std::shared_ptr<AdaptiveStreamController> m_controller;
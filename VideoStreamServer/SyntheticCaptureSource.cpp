@@ -0,0 +1,271 @@
+﻿#define NOMINMAX
+#include "SyntheticCaptureSource.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+namespace {
+    constexpr int DEFAULT_WIDTH = 1280;
+    constexpr int DEFAULT_HEIGHT = 720;
+    constexpr int DEFAULT_FPS = 30;
+
+    constexpr uint8_t LUMA_BLACK = 16;
+    constexpr uint8_t LUMA_WHITE = 235;
+    constexpr uint8_t CHROMA_NEUTRAL = 128;
+
+    // 75% 彩条（BT.601 有限范围）：白、黄、青、绿、品红、红、蓝、黑
+    constexpr int BAR_COUNT = 8;
+    constexpr uint8_t BAR_Y[BAR_COUNT] = { 180, 162, 131, 112, 84, 65, 35, 16 };
+    constexpr uint8_t BAR_U[BAR_COUNT] = { 128, 44, 156, 72, 184, 100, 212, 128 };
+    constexpr uint8_t BAR_V[BAR_COUNT] = { 128, 142, 44, 58, 198, 212, 114, 128 };
+
+    constexpr int COUNTER_BITS = 32;
+    constexpr int BOX_CROSSING_SEC = 4;  // 移动方块横穿画面一次的时长
+    constexpr int RAMP_SPEED_PX = 4;     // 亮度渐变每帧滚动的像素
+
+    // 5x7 点阵，每行低 5 位，高位在左
+    struct Glyph { char ch; uint8_t rows[7]; };
+    constexpr Glyph FONT[] = {
+        { '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+        { '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+        { '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+        { '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+        { '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+        { '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+        { '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+        { '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+        { '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+        { '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+        { ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+        { '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+    };
+    constexpr int GLYPH_WIDTH = 5;
+    constexpr int GLYPH_HEIGHT = 7;
+
+    const Glyph* find_glyph(char ch) {
+        for (const Glyph& glyph : FONT) {
+            if (glyph.ch == ch) return &glyph;
+        }
+        return nullptr; // 空格等不绘制
+    }
+
+    constexpr double PI = 3.14159265358979323846;
+    constexpr double TONE_AMPLITUDE = 0.1;  // 约 -20 dBFS
+    constexpr double BEEP_FREQUENCY_HZ = 1000.0;
+    constexpr double BEEP_AMPLITUDE = 0.25;
+    constexpr int BEEP_DURATION_MS = 100;
+}
+
+TestPatternSource::TestPatternSource(int width, int height, int fps)
+    : m_width(width > 0 ? width : DEFAULT_WIDTH),
+      m_height(height > 0 ? height : DEFAULT_HEIGHT),
+      m_fps(fps > 0 ? fps : DEFAULT_FPS)
+{
+    // YUV420P 要求偶数尺寸；帧序号条与文字至少要放得下
+    m_width = std::max(64, m_width & ~1);
+    m_height = std::max(64, m_height & ~1);
+}
+
+int TestPatternSource::counter_cell_size(int height) {
+    return std::max(8, (height / 72) & ~1);
+}
+
+bool TestPatternSource::open() {
+    m_planes[0].assign(static_cast<size_t>(m_width) * m_height, LUMA_BLACK);
+    m_planes[1].assign(static_cast<size_t>(m_width / 2) * (m_height / 2), CHROMA_NEUTRAL);
+    m_planes[2].assign(static_cast<size_t>(m_width / 2) * (m_height / 2), CHROMA_NEUTRAL);
+    m_frame_index = 0;
+    return true;
+}
+
+void TestPatternSource::close() {
+    for (auto& plane : m_planes) {
+        plane.clear();
+        plane.shrink_to_fit();
+    }
+}
+
+bool TestPatternSource::read(VideoSourceFrame& frame) {
+    if (m_planes[0].empty()) return false;
+
+    // 第 n 帧在 m_start + n / fps 时“采集”完成
+    const auto now = Clock::now();
+    if (m_frame_index == 0) {
+        m_start = now;
+    }
+    const auto interval = std::chrono::microseconds(1000000 / m_fps);
+    auto due = m_start + std::chrono::microseconds(m_frame_index * 1000000 / m_fps);
+    if (now - due > interval) {
+        // 落后超过一帧（进程曾经停顿）时从现在重新计时，帧序号保持连续，不补帧
+        m_start += now - due;
+        due = now;
+    }
+    std::this_thread::sleep_until(due);
+
+    render(m_frame_index++);
+
+    frame = VideoSourceFrame();
+    for (int i = 0; i < 3; ++i) {
+        frame.data[i] = m_planes[i].data();
+        frame.linesize[i] = i == 0 ? m_width : m_width / 2;
+    }
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.format = AV_PIX_FMT_YUV420P;
+    return true;
+}
+
+void TestPatternSource::render(int64_t index) {
+    uint8_t* y_plane = m_planes[0].data();
+    uint8_t* u_plane = m_planes[1].data();
+    uint8_t* v_plane = m_planes[2].data();
+    const int chroma_width = m_width / 2;
+    const int bars_height = (m_height * 3 / 4) & ~1;
+
+    // 1. 彩条与滚动的亮度渐变：同一区域内各行相同，先生成一行再复制
+    uint8_t* bar_line = y_plane;
+    for (int x = 0; x < m_width; ++x) {
+        bar_line[x] = BAR_Y[x * BAR_COUNT / m_width];
+    }
+    for (int row = 1; row < bars_height; ++row) {
+        std::copy_n(bar_line, m_width, y_plane + static_cast<size_t>(row) * m_width);
+    }
+    uint8_t* ramp_line = y_plane + static_cast<size_t>(bars_height) * m_width;
+    const int offset = static_cast<int>(index * RAMP_SPEED_PX % m_width);
+    for (int x = 0; x < m_width; ++x) {
+        ramp_line[x] = static_cast<uint8_t>(LUMA_BLACK + ((x + offset) % m_width) * (LUMA_WHITE - LUMA_BLACK) / m_width);
+    }
+    for (int row = bars_height + 1; row < m_height; ++row) {
+        std::copy_n(ramp_line, m_width, y_plane + static_cast<size_t>(row) * m_width);
+    }
+    for (int x = 0; x < chroma_width; ++x) {
+        const int bar = x * 2 * BAR_COUNT / m_width;
+        u_plane[x] = BAR_U[bar];
+        v_plane[x] = BAR_V[bar];
+    }
+    for (int row = 1; row < m_height / 2; ++row) {
+        uint8_t* u_line = u_plane + static_cast<size_t>(row) * chroma_width;
+        uint8_t* v_line = v_plane + static_cast<size_t>(row) * chroma_width;
+        if (row < bars_height / 2) {
+            std::copy_n(u_plane, chroma_width, u_line);
+            std::copy_n(v_plane, chroma_width, v_line);
+        }
+        else {
+            std::fill_n(u_line, chroma_width, CHROMA_NEUTRAL);
+            std::fill_n(v_line, chroma_width, CHROMA_NEUTRAL);
+        }
+    }
+
+    // 2. 移动方块
+    const int box_size = std::max(2, (m_height / 6) & ~1);
+    const int64_t period = static_cast<int64_t>(m_fps) * BOX_CROSSING_SEC;
+    const int box_x = static_cast<int>((index % period) * (m_width - box_size) / period) & ~1;
+    fill_rect(box_x, ((bars_height - box_size) / 2) & ~1, box_size, box_size, LUMA_WHITE);
+
+    // 3. 帧序号（二进制与数字）、媒体时间，画在黑底上
+    const int cell = counter_cell_size(m_height);
+    const int scale = std::max(2, m_height / 180);
+    const int text_y = cell * 3;
+    const int64_t media_ms = index * 1000 / m_fps;
+    char text[48];
+    const int text_length = std::snprintf(text, sizeof(text), "%08lld %02lld:%02lld:%02lld.%03lld",
+        static_cast<long long>(index), static_cast<long long>(media_ms / 3600000),
+        static_cast<long long>(media_ms / 60000 % 60), static_cast<long long>(media_ms / 1000 % 60),
+        static_cast<long long>(media_ms % 1000));
+    fill_rect(0, 0, std::max(cell * (COUNTER_BITS + 2), cell * 2 + text_length * (GLYPH_WIDTH + 1) * scale),
+        text_y + (GLYPH_HEIGHT + 2) * scale, LUMA_BLACK);
+    const uint32_t counter = static_cast<uint32_t>(index);
+    for (int bit = 0; bit < COUNTER_BITS; ++bit) {
+        if (counter & (1u << (COUNTER_BITS - 1 - bit))) {
+            fill_rect(cell * (bit + 1), cell, cell, cell, LUMA_WHITE);
+        }
+    }
+    draw_text(text, cell, text_y, scale);
+
+    // 4. 整秒闪块
+    const int flash_size = cell * 4;
+    fill_rect(m_width - cell - flash_size, cell, flash_size, flash_size, index % m_fps == 0 ? LUMA_WHITE : LUMA_BLACK);
+}
+
+void TestPatternSource::fill_rect(int x, int y, int w, int h, uint8_t luma) {
+    const int x0 = std::max(0, x);
+    const int y0 = std::max(0, y);
+    const int x1 = std::min(m_width, x + w);
+    const int y1 = std::min(m_height, y + h);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int row = y0; row < y1; ++row) {
+        std::fill_n(m_planes[0].data() + static_cast<size_t>(row) * m_width + x0, x1 - x0, luma);
+    }
+    // 覆盖到的色度样本置为中性，矩形为灰度
+    const int chroma_width = m_width / 2;
+    for (int row = y0 / 2; row < (y1 + 1) / 2; ++row) {
+        std::fill_n(m_planes[1].data() + static_cast<size_t>(row) * chroma_width + x0 / 2, (x1 + 1) / 2 - x0 / 2, CHROMA_NEUTRAL);
+        std::fill_n(m_planes[2].data() + static_cast<size_t>(row) * chroma_width + x0 / 2, (x1 + 1) / 2 - x0 / 2, CHROMA_NEUTRAL);
+    }
+}
+
+void TestPatternSource::draw_text(const char* text, int x, int y, int scale) {
+    for (const char* p = text; *p; ++p, x += (GLYPH_WIDTH + 1) * scale) {
+        const Glyph* glyph = find_glyph(*p);
+        if (!glyph) continue;
+        for (int row = 0; row < GLYPH_HEIGHT; ++row) {
+            for (int col = 0; col < GLYPH_WIDTH; ++col) {
+                if (glyph->rows[row] & (1 << (GLYPH_WIDTH - 1 - col))) {
+                    fill_rect(x + col * scale, y + row * scale, scale, scale, LUMA_WHITE);
+                }
+            }
+        }
+    }
+}
+
+ToneSource::ToneSource(double frequency_hz)
+    : m_frequency_hz(frequency_hz)
+{
+}
+
+bool ToneSource::open(const AudioStreamFormat& format) {
+    m_sample_rate = format.sample_rate;
+    m_channels = format.channels;
+    m_sample_index = 0;
+    return m_sample_rate > 0 && m_channels > 0;
+}
+
+void ToneSource::close() {
+}
+
+bool ToneSource::read(int16_t* samples, int frames) {
+    // 第 n 个采样在 m_start + n / 采样率 时“采集”完成，与声卡一样整块交付
+    const auto now = Clock::now();
+    if (m_sample_index == 0) {
+        m_start = now;
+    }
+    const auto block = std::chrono::microseconds(static_cast<int64_t>(frames) * 1000000 / m_sample_rate);
+    auto ready = m_start + std::chrono::microseconds((m_sample_index + frames) * 1000000 / m_sample_rate);
+    if (now - ready > block) {
+        m_start += now - ready;
+        ready = now;
+    }
+    std::this_thread::sleep_until(ready);
+
+    const int64_t beep_samples = static_cast<int64_t>(m_sample_rate) * BEEP_DURATION_MS / 1000;
+    for (int i = 0; i < frames; ++i) {
+        const int64_t n = m_sample_index + i;
+        // 相位对周期取余，长时间运行时 sin 的参数不会失去精度
+        double value = TONE_AMPLITUDE * std::sin(2.0 * PI * std::fmod(n * m_frequency_hz / m_sample_rate, 1.0));
+        if (n % m_sample_rate < beep_samples) {
+            value += BEEP_AMPLITUDE * std::sin(2.0 * PI * std::fmod(n * BEEP_FREQUENCY_HZ / m_sample_rate, 1.0));
+        }
+        const int16_t sample = static_cast<int16_t>(std::lround(std::clamp(value, -1.0, 1.0) * 32767.0));
+        for (int c = 0; c < m_channels; ++c) {
+            samples[i * m_channels + c] = sample;
+        }
+    }
+    m_sample_index += frames;
+    return true;
+}
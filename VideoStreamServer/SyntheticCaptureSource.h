@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include "CaptureSource.h"
+#include <chrono>
+#include <vector>
+
+// 运动测试图（YUV420P），画面只取决于帧序号，同样的参数每次运行得到相同的编码输入：
+// - 上 3/4 为 75% 彩条，一个白色方块每 4 秒从左到右横穿一次；下 1/4 为向左滚动的亮度渐变
+// - 左上角第一行是帧序号的 32 位二进制（高位在前，白为 1），下面是数字形式的帧序号与媒体时间
+// - 右上角的方块在每个整秒的第一帧变白，与 ToneSource 的整秒提示音对应
+class TestPatternSource final : public IVideoSource
+{
+public:
+    // 任一参数为 0 时使用 1280x720、30fps
+    TestPatternSource(int width, int height, int fps);
+
+    bool open() override;
+    void close() override;
+    bool read(VideoSourceFrame& frame) override;
+
+    int width() const override { return m_width; }
+    int height() const override { return m_height; }
+    const char* name() const override { return "测试图"; }
+
+    // 帧序号条每一位的边长（像素），供接收端从解码后的画面读回帧序号
+    static int counter_cell_size(int height);
+
+private:
+    void render(int64_t index);
+    void fill_rect(int x, int y, int w, int h, uint8_t luma);
+    void draw_text(const char* text, int x, int y, int scale);
+
+    using Clock = std::chrono::steady_clock;
+
+    int m_width;
+    int m_height;
+    int m_fps;
+    std::vector<uint8_t> m_planes[3];
+    int64_t m_frame_index = 0;
+    Clock::time_point m_start;
+};
+
+// 测试音：持续的正弦基础音（约 -20 dBFS），每个整秒的前 100ms 叠加 1kHz 提示音，
+// 按采样时钟实时输出，各声道相同
+class ToneSource final : public IAudioSource
+{
+public:
+    explicit ToneSource(double frequency_hz);
+
+    bool open(const AudioStreamFormat& format) override;
+    void close() override;
+    bool read(int16_t* samples, int frames) override;
+    const char* name() const override { return "测试音"; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    double m_frequency_hz;
+    int m_sample_rate = 48000;
+    int m_channels = 1;
+    int64_t m_sample_index = 0;
+    Clock::time_point m_start;
+};
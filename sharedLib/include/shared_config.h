@@ -4,16 +4,64 @@
 namespace AppConfig {
     // --- 视频流参数 (应用级常量) ---
     constexpr const char* VIDEO_CODEC = "hevc";
+    // 【新增】丢包恢复方式（服务端 config.json 的 "video_refresh" 为默认值，play 命令可用同名字段覆盖，
+    // 实际生效的方式在 play_info 的 video.refresh 中返回）：
+    // "idr" 时客户端发现参考链断裂后请求关键帧，服务端强制插入 IDR；
+    // "intra_refresh" 时编码器改用周期性帧内刷新（没有周期 IDR 的码率尖峰），请求关键帧时只插入一个帧内帧
+    constexpr const char* VIDEO_REFRESH_IDR = "idr";
+    constexpr const char* VIDEO_REFRESH_INTRA = "intra_refresh";
+    constexpr int INTRA_REFRESH_PERIOD_MS = 1000; // 一轮帧内刷新覆盖整幅画面的时长
 
     // --- 音频流参数 (应用级常量) ---
     constexpr int AUDIO_CHUNK_SAMPLES = 256; // 样本数
     constexpr int AUDIO_CHANNELS = 1;      // 单声道
     constexpr int AUDIO_RATE = 16000;      // 采样率 (Hz)
 
+    // 【新增】Opus 音频编码：播放时协商，客户端未声明支持时回退到上面的原始 PCM
+    constexpr const char* AUDIO_CODEC_OPUS = "opus";
+    constexpr const char* AUDIO_CODEC_PCM = "pcm";
+    constexpr int OPUS_RATE = 48000;
+    constexpr int OPUS_CHANNELS = 2;
+    constexpr int OPUS_FRAME_MS = 20;
+    constexpr int OPUS_BITRATE = 64000;
+    constexpr int OPUS_EXPECTED_LOSS_PERC = 10; // 编码器按该丢包率为带内 FEC 分配码率
+
+    // 【新增】客户端播放设备的格式，PCM 与 Opus 都在客户端转换到该格式
+    constexpr int AUDIO_OUTPUT_RATE = 48000;
+    constexpr int AUDIO_OUTPUT_CHANNELS = 2;
+
+    // 【新增】小包合并的时延预算（毫秒）：多个音频帧攒到这么长的媒体时长（或填满一个数据报）再一起发送，
+    // 期间到来的视频尾片也可以搭车；设为 0 关闭合并，每个音频帧单独发送
+    constexpr int AUDIO_PACK_BUDGET_MS = 40;
+
     // --- 应用层协议常量 ---
     enum class PacketType : uint8_t {
         Video = 0,
-        Audio = 1
+        Audio = 1,      // 原始 S16 PCM（AUDIO_RATE, AUDIO_CHANNELS）
+        AudioOpus = 2,  // 【新增】Opus 帧（OPUS_RATE, OPUS_CHANNELS）
+        Bundle = 3,     // 【新增】合并包：头里的分片数为记录数，负载为若干 [u16 长度][完整的内层数据报]
+        VideoTiming = 4 // 【新增】实时采集一帧在服务端各阶段的时间戳，pts 与对应的视频帧相同
     };
 
+    // 【新增】数据报头：[u8 类型][u64 pts][u16 分片数][u16 分片序号][u16 传输序号][u16 参考帧序号]，均为网络字节序。
+    // 传输序号由服务端在数据报交给 MsQuic 时按实际发送顺序填写，所有类型共用一个序号空间；
+    // 合并包内层数据报的传输序号不使用
+    constexpr int DATAGRAM_HEADER_SIZE = 1 + 8 + 2 + 2 + 2 + 2;
+    constexpr int TRANSPORT_SEQ_OFFSET = 1 + 8 + 2 + 2;
+    // 【新增】参考帧序号（仅视频）：低 15 位按 IDR / 参考帧逐帧递增，最高位标记本帧就是该序号对应的参考帧；
+    // 非参考帧沿用最近一个参考帧的序号、最高位为 0，丢了不留缺口。同一帧的各分片相同。
+    // 客户端据此发现整帧（包括单片帧）都没收到的参考帧
+    constexpr int REFERENCE_SEQ_OFFSET = 1 + 8 + 2 + 2 + 2;
+    constexpr uint16_t REFERENCE_SEQ_FLAG = 0x8000;
+    constexpr uint16_t REFERENCE_SEQ_MASK = 0x7FFF;
+
+    // 【新增】传输层反馈：客户端按该间隔把收到的每个数据报的到达时间批量回报给服务端的带宽估计器
+    constexpr int TRANSPORT_FEEDBACK_INTERVAL_MS = 50;
+    constexpr int TRANSPORT_FEEDBACK_DELTA_UNIT_US = 250; // 到达间隔的量化单位（微秒）
+
+    // 【新增】VideoTiming 负载：[i64 采集时刻][u32 转换完成][u32 开始编码][u32 编码完成][u32 交给发送调度器]，网络字节序。
+    // 采集时刻为服务端系统时钟（Unix 微秒），其余为相对采集时刻的微秒数；紧跟在视频帧之后入队，
+    // 客户端收到它的时刻近似为整帧到达的时刻。两端时钟差由心跳回复中的 server_ts_us 估计
+    constexpr int VIDEO_TIMING_PAYLOAD_SIZE = 8 + 4 * 4;
+
 }
\ No newline at end of file
@@ -0,0 +1,273 @@
+﻿// Float16Kernels 正确性测试与微基准（独立控制台工具）
+// 1. 标量 half → float：全部 65536 个值与独立的 double 参考实现逐位比较
+// 2. 标量 float → half：按步长采样全部 float 位模式，与“在全部 half 值中找最近者、平局取偶数”的参考实现比较
+// 3. 每个可用的 SIMD 实现 (F16C / NEON) 与标量实现逐位比较，并测量 1080p 大小缓冲区上的吞吐
+// 任何不一致时返回非 0，供 ctest 使用。
+// 用法: Float16KernelsTest [float→half 采样步长，默认 7，1 为穷举]
+
+#include "Float16Kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+    using Isa = Float16Kernels::Isa;
+
+    constexpr size_t BENCH_COUNT = 1920 * 1080 * 3 + 5;  // 1080p RGB 平面，+5 覆盖 SIMD 尾部
+    constexpr int BENCH_REPEAT = 20;
+
+    int g_failures = 0;
+
+    void report_failure(const char* what, uint64_t input, uint64_t expected, uint64_t actual)
+    {
+        // 每类错误只打印前几条，避免刷屏
+        if (++g_failures <= 20) {
+            std::printf("  [失败] %s: 输入 0x%llx 期望 0x%llx 实际 0x%llx\n", what,
+                static_cast<unsigned long long>(input), static_cast<unsigned long long>(expected),
+                static_cast<unsigned long long>(actual));
+        }
+    }
+
+    uint32_t float_bits(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float bits_float(uint32_t bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // ---------------- 独立参考实现（只用 double 运算，不复用被测代码的位操作） ----------------
+
+    // half 的数值（有限值），double 可精确表示
+    double ref_half_value(uint16_t h)
+    {
+        const int exponent = (h >> 10) & 0x1f;
+        const int mantissa = h & 0x3ff;
+        const double magnitude = exponent == 0
+            ? std::ldexp(static_cast<double>(mantissa), -24)
+            : std::ldexp(static_cast<double>(mantissa | 0x400), exponent - 25);
+        return (h & 0x8000) ? -magnitude : magnitude;
+    }
+
+    // 全部非负有限 half 按数值升序排列（0x0000 ~ 0x7bff 本身就是升序），
+    // 末尾追加 2^16 代表无穷大：65504 与 65536 的中点 65520 平局时取偶数 (0x7c00)，正是 IEEE 的溢出规则
+    const std::vector<double>& positive_half_values()
+    {
+        static const std::vector<double> values = [] {
+            std::vector<double> v;
+            for (uint32_t h = 0; h <= 0x7bff; ++h) v.push_back(ref_half_value(static_cast<uint16_t>(h)));
+            v.push_back(65536.0);
+            return v;
+        }();
+        return values;
+    }
+
+    // 就近舍入到偶数：在有序表中二分查找相邻的两个候选，差值在 double 中是精确的
+    uint16_t ref_float_to_half(float value)
+    {
+        const uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+        const double magnitude = std::fabs(static_cast<double>(value));
+        if (std::isinf(value) || magnitude >= 65536.0) return sign | 0x7c00;
+
+        const std::vector<double>& values = positive_half_values();
+        const size_t upper = std::lower_bound(values.begin(), values.end(), magnitude) - values.begin();
+        if (values[upper] == magnitude) return static_cast<uint16_t>(sign | upper);
+        const size_t lower = upper - 1;
+        const double below = magnitude - values[lower];
+        const double above = values[upper] - magnitude;
+        size_t nearest;
+        if (below < above) nearest = lower;
+        else if (above < below) nearest = upper;
+        else nearest = (lower & 1) ? upper : lower;
+        return static_cast<uint16_t>(sign | nearest);
+    }
+
+    // ---------------- 1. half → float 穷举 ----------------
+
+    void test_half_to_float_exhaustive()
+    {
+        std::printf("half -> float: 穷举 65536 个值\n");
+        for (uint32_t h = 0; h < 65536; ++h) {
+            const float actual = Float16Kernels::half_to_float(static_cast<uint16_t>(h));
+            const bool is_nan = ((h >> 10) & 0x1f) == 0x1f && (h & 0x3ff);
+            const bool is_inf = ((h >> 10) & 0x1f) == 0x1f && !(h & 0x3ff);
+            if (is_nan) {
+                // NaN：必须是 quiet NaN，且符号与高位载荷保留
+                const uint32_t expected = ((h & 0x8000u) << 16) | 0x7fc00000 | ((h & 0x3ffu) << 13);
+                if (float_bits(actual) != expected) report_failure("half->float NaN", h, expected, float_bits(actual));
+                continue;
+            }
+            const float expected = is_inf
+                ? ((h & 0x8000) ? -INFINITY : INFINITY)
+                : static_cast<float>(ref_half_value(static_cast<uint16_t>(h)));
+            if (float_bits(actual) != float_bits(expected)) {
+                report_failure("half->float", h, float_bits(expected), float_bits(actual));
+            }
+        }
+    }
+
+    // ---------------- 2. float → half 采样 ----------------
+
+    void test_float_to_half_sampled(uint32_t step)
+    {
+        std::printf("float -> half: 步长 %u 采样全部 float 位模式\n", step);
+        for (uint64_t bits = 0; bits <= 0xffffffffull; bits += step) {
+            const float value = bits_float(static_cast<uint32_t>(bits));
+            const uint16_t actual = Float16Kernels::float_to_half(value);
+            if (std::isnan(value)) {
+                // NaN：结果必须是 quiet NaN 且符号保留，载荷不做要求
+                const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+                if ((actual & 0xfe00) != (sign | 0x7e00)) report_failure("float->half NaN", bits, sign | 0x7e00, actual);
+                continue;
+            }
+            const uint16_t expected = ref_float_to_half(value);
+            if (actual != expected) report_failure("float->half", bits, expected, actual);
+        }
+
+        // 步长采样之外，重点覆盖非规格化数、舍入平局和溢出边界附近的每一个值
+        const uint32_t edges[] = {
+            0x33000000,  // 2^-25：最小非规格化数的一半
+            0x387fc000,  // 最大非规格化数与最小规格化数之间
+            0x38800000,  // 2^-14：最小规格化数
+            0x477fe000,  // 65504：最大有限值
+            0x477ff000,  // 65520：溢出平局点
+        };
+        for (uint32_t edge : edges) {
+            for (uint32_t bits = edge - 0x2000; bits <= edge + 0x2000; ++bits) {
+                for (uint32_t sign : { 0u, 0x80000000u }) {
+                    const float value = bits_float(bits | sign);
+                    const uint16_t expected = ref_float_to_half(value);
+                    const uint16_t actual = Float16Kernels::float_to_half(value);
+                    if (actual != expected) report_failure("float->half 边界", bits | sign, expected, actual);
+                }
+            }
+        }
+    }
+
+    // ---------------- 3. SIMD 与标量逐位比较 + 吞吐 ----------------
+
+    struct BenchData {
+        std::vector<float> floats;
+        std::vector<uint16_t> halves;
+        std::vector<uint8_t> bytes;
+    };
+
+    BenchData make_bench_data()
+    {
+        BenchData data;
+        data.floats.resize(BENCH_COUNT);
+        data.halves.resize(BENCH_COUNT);
+        data.bytes.resize(BENCH_COUNT);
+        std::mt19937 rng(12345);
+        std::uniform_real_distribution<float> unit(-0.25f, 1.25f);
+        for (size_t i = 0; i < BENCH_COUNT; ++i) {
+            // 大部分是模型实际会遇到的 [0,1] 附近的值，混入任意位模式覆盖特殊值
+            data.floats[i] = (i % 8 == 0) ? bits_float(static_cast<uint32_t>(rng())) : unit(rng);
+            data.halves[i] = static_cast<uint16_t>(rng());
+            data.bytes[i] = static_cast<uint8_t>(rng());
+        }
+        return data;
+    }
+
+    template <typename Fn>
+    double time_ms(Fn&& fn)
+    {
+        fn();  // 预热
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_REPEAT; ++i) fn();
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / BENCH_REPEAT;
+    }
+
+    template <typename T>
+    void compare_outputs(const char* what, Isa isa, const std::vector<T>& expected, const std::vector<T>& actual)
+    {
+        for (size_t i = 0; i < expected.size(); ++i) {
+            if (std::memcmp(&expected[i], &actual[i], sizeof(T)) != 0) {
+                uint64_t e = 0, a = 0;
+                std::memcpy(&e, &expected[i], sizeof(T));
+                std::memcpy(&a, &actual[i], sizeof(T));
+                std::printf("  [失败] %s (%s) 下标 %zu\n", what, Float16Kernels::isa_name(isa), i);
+                report_failure(what, i, e, a);
+                return;
+            }
+        }
+    }
+
+    void test_and_bench_isas()
+    {
+        const BenchData data = make_bench_data();
+        std::vector<uint16_t> ref_f2h(BENCH_COUNT), ref_u2h(BENCH_COUNT);
+        std::vector<float> ref_h2f(BENCH_COUNT);
+        std::vector<uint8_t> ref_h2u(BENCH_COUNT);
+        std::vector<uint16_t> out_f2h(BENCH_COUNT), out_u2h(BENCH_COUNT);
+        std::vector<float> out_h2f(BENCH_COUNT);
+        std::vector<uint8_t> out_h2u(BENCH_COUNT);
+
+        std::printf("\n批量转换: %zu 个元素，每项取 %d 次平均 (ms)\n", BENCH_COUNT, BENCH_REPEAT);
+        std::printf("  %-8s %12s %12s %12s %12s\n", "ISA", "f32->f16", "f16->f32", "u8->f16", "f16->u8");
+
+        for (Isa isa : { Isa::Scalar, Isa::F16C, Isa::NEON }) {
+            if (!Float16Kernels::select_isa(isa)) {
+                std::printf("  %-8s (CPU 不支持，跳过)\n", Float16Kernels::isa_name(isa));
+                continue;
+            }
+            const bool is_reference = isa == Isa::Scalar;
+            std::vector<uint16_t>& f2h = is_reference ? ref_f2h : out_f2h;
+            std::vector<float>& h2f = is_reference ? ref_h2f : out_h2f;
+            std::vector<uint16_t>& u2h = is_reference ? ref_u2h : out_u2h;
+            std::vector<uint8_t>& h2u = is_reference ? ref_h2u : out_h2u;
+
+            const double t_f2h = time_ms([&] { Float16Kernels::float_to_half(data.floats.data(), f2h.data(), BENCH_COUNT); });
+            const double t_h2f = time_ms([&] { Float16Kernels::half_to_float(data.halves.data(), h2f.data(), BENCH_COUNT); });
+            const double t_u2h = time_ms([&] { Float16Kernels::u8_to_half_normalized(data.bytes.data(), u2h.data(), BENCH_COUNT); });
+            const double t_h2u = time_ms([&] { Float16Kernels::half_to_u8_clamped(data.halves.data(), h2u.data(), BENCH_COUNT); });
+            std::printf("  %-8s %12.3f %12.3f %12.3f %12.3f\n", Float16Kernels::isa_name(isa), t_f2h, t_h2f, t_u2h, t_h2u);
+
+            if (is_reference) {
+                // 标量批量路径本身也要与单值参考实现一致
+                for (size_t i = 0; i < BENCH_COUNT; ++i) {
+                    if (!std::isnan(data.floats[i]) && ref_f2h[i] != ref_float_to_half(data.floats[i])) {
+                        report_failure("批量 float->half (Scalar)", float_bits(data.floats[i]), ref_float_to_half(data.floats[i]), ref_f2h[i]);
+                        break;
+                    }
+                }
+                continue;
+            }
+            compare_outputs("批量 float->half", isa, ref_f2h, out_f2h);
+            compare_outputs("批量 half->float", isa, ref_h2f, out_h2f);
+            compare_outputs("u8->half", isa, ref_u2h, out_u2h);
+            compare_outputs("half->u8", isa, ref_h2u, out_h2u);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t step = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 7;
+    std::printf("默认实现: %s\n", Float16Kernels::isa_name(Float16Kernels::active_isa()));
+
+    test_half_to_float_exhaustive();
+    test_float_to_half_sampled(step > 0 ? step : 1);
+    test_and_bench_isas();
+
+    if (g_failures > 0) {
+        std::printf("\n共 %d 处不一致\n", g_failures);
+        return 1;
+    }
+    std::printf("\n全部通过\n");
+    return 0;
+}
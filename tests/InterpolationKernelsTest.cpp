@@ -0,0 +1,201 @@
+﻿// InterpolationKernels 正确性测试与微基准（独立控制台工具）
+// 1. 每个可用实现 (Scalar / SSE4.1 / AVX2 / NEON) 在随机尺寸、随机 stride 的平面上
+//    与直接按公式逐像素计算的独立参考实现逐字节比较，并检查行尾填充区没有被写入
+// 2. 测量每个实现混合一帧 1080p YUV420P（亮度边缘感知 + 两个色度平面）的耗时
+// 任何不一致时返回非 0，供 ctest 使用。
+
+#include "InterpolationKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+    using InterpolationKernels::Isa;
+    using InterpolationKernels::Plane;
+
+    constexpr Isa ALL_ISAS[] = { Isa::Scalar, Isa::SSE41, Isa::AVX2, Isa::NEON };
+    constexpr int RANDOM_CASES = 300;
+    constexpr int BENCH_REPEAT = 50;
+    constexpr uint8_t CANARY = 0xA5;
+
+    int g_failures = 0;
+
+    // ---------------- 独立参考实现 ----------------
+
+    int ref_lerp(int p, int n, int weight)
+    {
+        return (p * (256 - weight) + n * weight + 128) >> 8;
+    }
+
+    int ref_clamp_weight(int weight)
+    {
+        return weight < 0 ? 0 : (weight > 256 ? 256 : weight);
+    }
+
+    void ref_blend(const Plane& plane, int weight_q8, int edge_weight_q8, bool edge_aware, std::vector<uint8_t>& out)
+    {
+        const int w = ref_clamp_weight(weight_q8);
+        const int we = ref_clamp_weight(edge_weight_q8);
+        auto prev = [&](int x, int y) { return static_cast<int>(plane.prev[y * plane.prev_stride + x]); };
+        auto next = [&](int x, int y) { return static_cast<int>(plane.next[y * plane.next_stride + x]); };
+        out.assign(static_cast<size_t>(plane.width) * plane.height, 0);
+        for (int y = 0; y < plane.height; ++y) {
+            for (int x = 0; x < plane.width; ++x) {
+                int weight = w;
+                const bool interior = x > 0 && y > 0 && x < plane.width - 1 && y < plane.height - 1;
+                if (edge_aware && interior) {
+                    const int gp = std::max(std::abs(prev(x + 1, y) - prev(x - 1, y)), std::abs(prev(x, y + 1) - prev(x, y - 1)));
+                    const int gn = std::max(std::abs(next(x + 1, y) - next(x - 1, y)), std::abs(next(x, y + 1) - next(x, y - 1)));
+                    if (std::max(gp, gn) > InterpolationKernels::EDGE_GRADIENT_THRESHOLD) weight = we;
+                }
+                out[static_cast<size_t>(y) * plane.width + x] = static_cast<uint8_t>(ref_lerp(prev(x, y), next(x, y), weight));
+            }
+        }
+    }
+
+    // ---------------- 1. 随机平面逐字节比较 ----------------
+
+    struct TestCase {
+        int width, height;
+        int prev_stride, next_stride, dst_stride;
+        int weight, edge_weight;
+        std::vector<uint8_t> prev, next;
+    };
+
+    TestCase make_case(std::mt19937& rng, int index)
+    {
+        TestCase c;
+        // 宽度覆盖 SIMD 主循环和各种尾部长度；前几个用例覆盖 < 3 的退化尺寸
+        c.width = index < 4 ? 1 + index : 1 + static_cast<int>(rng() % 300);
+        c.height = index < 4 ? 1 + (3 - index) : 1 + static_cast<int>(rng() % 24);
+        c.prev_stride = c.width + static_cast<int>(rng() % 64);
+        c.next_stride = c.width + static_cast<int>(rng() % 64);
+        c.dst_stride = c.width + 1 + static_cast<int>(rng() % 64);
+        // 权重包含端点和需要钳位的越界值
+        const int weights[] = { 0, 1, 128, 255, 256, -7, 300 };
+        c.weight = (index % 5 == 0) ? weights[rng() % 7] : static_cast<int>(rng() % 257);
+        c.edge_weight = (index % 7 == 0) ? weights[rng() % 7] : c.weight * 7 / 10;
+        c.prev.resize(static_cast<size_t>(c.prev_stride) * c.height);
+        c.next.resize(static_cast<size_t>(c.next_stride) * c.height);
+        // 一半用例用平滑渐变加噪声，让边缘和非边缘像素都大量出现；另一半是纯随机
+        const bool smooth = rng() & 1;
+        for (int y = 0; y < c.height; ++y) {
+            for (int x = 0; x < c.prev_stride; ++x) {
+                c.prev[y * c.prev_stride + x] = static_cast<uint8_t>(smooth ? (x * 3 + y * 5 + rng() % 24) : rng());
+            }
+            for (int x = 0; x < c.next_stride; ++x) {
+                c.next[y * c.next_stride + x] = static_cast<uint8_t>(smooth ? (x * 3 + y * 2 + rng() % 24) : rng());
+            }
+        }
+        return c;
+    }
+
+    void check_case(const TestCase& c, bool edge_aware, int index)
+    {
+        std::vector<uint8_t> expected;
+        std::vector<uint8_t> dst(static_cast<size_t>(c.dst_stride) * c.height);
+        Plane plane{ c.prev.data(), c.prev_stride, c.next.data(), c.next_stride, dst.data(), c.dst_stride, c.width, c.height };
+        ref_blend(plane, c.weight, c.edge_weight, edge_aware, expected);
+
+        for (Isa isa : ALL_ISAS) {
+            if (!InterpolationKernels::select_isa(isa)) continue;
+            std::fill(dst.begin(), dst.end(), CANARY);
+            if (edge_aware) InterpolationKernels::blend_luma(plane, c.weight, c.edge_weight);
+            else InterpolationKernels::blend_plane(plane, c.weight);
+
+            for (int y = 0; y < c.height; ++y) {
+                for (int x = 0; x < c.dst_stride; ++x) {
+                    const uint8_t actual = dst[y * c.dst_stride + x];
+                    const uint8_t want = x < c.width ? expected[static_cast<size_t>(y) * c.width + x] : CANARY;
+                    if (actual == want) continue;
+                    if (++g_failures <= 20) {
+                        std::printf("  [失败] %s %s 用例 %d (%dx%d w=%d we=%d) 像素 (%d,%d) 期望 %d 实际 %d\n",
+                            InterpolationKernels::isa_name(isa), edge_aware ? "blend_luma" : "blend_plane", index,
+                            c.width, c.height, c.weight, c.edge_weight, x, y, want, actual);
+                    }
+                    goto next_isa;
+                }
+            }
+        next_isa:;
+        }
+    }
+
+    void test_random_planes()
+    {
+        std::printf("随机平面: %d 个用例，每个用例比较 blend_luma 和 blend_plane\n", RANDOM_CASES);
+        std::mt19937 rng(20240607);
+        for (int i = 0; i < RANDOM_CASES; ++i) {
+            const TestCase c = make_case(rng, i);
+            check_case(c, true, i);
+            check_case(c, false, i);
+        }
+    }
+
+    // ---------------- 2. 1080p 吞吐 ----------------
+
+    void bench_1080p()
+    {
+        constexpr int W = 1920, H = 1080;
+        constexpr int CW = W / 2, CH = H / 2;
+        // stride 按 FFmpeg 的习惯对齐到 64 字节
+        constexpr int STRIDE = 1984, CSTRIDE = 1024;
+        std::mt19937 rng(7);
+        std::vector<uint8_t> prev_y(STRIDE * H), next_y(STRIDE * H), dst_y(STRIDE * H);
+        std::vector<uint8_t> prev_c(CSTRIDE * CH), next_c(CSTRIDE * CH), dst_c(CSTRIDE * CH);
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < STRIDE; ++x) {
+                prev_y[y * STRIDE + x] = static_cast<uint8_t>(x / 4 + y / 3 + rng() % 32);
+                next_y[y * STRIDE + x] = static_cast<uint8_t>(x / 4 + y / 2 + rng() % 32);
+            }
+        }
+        for (auto& v : prev_c) v = static_cast<uint8_t>(rng());
+        for (auto& v : next_c) v = static_cast<uint8_t>(rng());
+
+        const Plane luma{ prev_y.data(), STRIDE, next_y.data(), STRIDE, dst_y.data(), STRIDE, W, H };
+        const Plane chroma{ prev_c.data(), CSTRIDE, next_c.data(), CSTRIDE, dst_c.data(), CSTRIDE, CW, CH };
+
+        std::printf("\n1080p YUV420P 单帧混合，取 %d 次平均\n", BENCH_REPEAT);
+        std::printf("  %-8s %12s %12s %12s %10s\n", "ISA", "luma(ms)", "chroma(ms)", "帧(ms)", "加速比");
+        double scalar_ms = 0.0;
+        for (Isa isa : ALL_ISAS) {
+            if (!InterpolationKernels::select_isa(isa)) {
+                std::printf("  %-8s (CPU 不支持，跳过)\n", InterpolationKernels::isa_name(isa));
+                continue;
+            }
+            auto time_ms = [](auto&& fn) {
+                fn();  // 预热
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < BENCH_REPEAT; ++i) fn();
+                const auto end = std::chrono::steady_clock::now();
+                return std::chrono::duration<double, std::milli>(end - start).count() / BENCH_REPEAT;
+            };
+            const double luma_ms = time_ms([&] { InterpolationKernels::blend_luma(luma, 128, 90); });
+            // U、V 两个平面
+            const double chroma_ms = 2.0 * time_ms([&] { InterpolationKernels::blend_plane(chroma, 128); });
+            const double frame_ms = luma_ms + chroma_ms;
+            if (isa == Isa::Scalar) scalar_ms = frame_ms;
+            std::printf("  %-8s %12.3f %12.3f %12.3f %9.2fx\n", InterpolationKernels::isa_name(isa),
+                luma_ms, chroma_ms, frame_ms, scalar_ms > 0.0 ? scalar_ms / frame_ms : 1.0);
+        }
+    }
+}
+
+int main()
+{
+    std::printf("默认实现: %s\n", InterpolationKernels::isa_name(InterpolationKernels::active_isa()));
+
+    test_random_planes();
+    bench_1080p();
+
+    if (g_failures > 0) {
+        std::printf("\n共 %d 处不一致\n", g_failures);
+        return 1;
+    }
+    std::printf("\n全部通过\n");
+    return 0;
+}